@@ -0,0 +1,116 @@
+// Database write benchmark
+//
+// Inserts trades into a local Postgres two ways and prints writes/second:
+//   1. the old path - SQL text per statement, one round trip each, over a
+//      pool of 5 connections (what the Drogon DbClient gives us)
+//   2. PgPipelineWriter - prepared statements sent in pipelined batches
+//
+// Point it at a scratch database, it writes rows with symbol BENCH and deletes them afterwards:
+//   ORDERBOOK_BENCH_CONNINFO="host=127.0.0.1 dbname=bench" ./db_write_bench [writes] [connections] [batch]
+#include "pg_pipeline.hpp"
+#include <libpq-fe.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace orderbook;
+using Clock = std::chrono::steady_clock;
+
+static std::string conninfo() {
+    if (const char* env = std::getenv("ORDERBOOK_BENCH_CONNINFO")) return env;
+    if (const char* env = std::getenv("ORDERBOOK_DB_CONNINFO")) return env;
+    return "host=127.0.0.1 port=5432 dbname=orderbookdb";
+}
+
+static bool exec(PGconn* conn, const char* sql) {
+    PGresult* res = PQexec(conn, sql);
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK || PQresultStatus(res) == PGRES_TUPLES_OK;
+    if (!ok) std::cerr << PQresultErrorMessage(res);
+    PQclear(res);
+    return ok;
+}
+
+static void report(const char* name, size_t writes, Clock::duration elapsed) {
+    double secs = std::chrono::duration<double>(elapsed).count();
+    std::cout << name << ": " << writes << " writes in " << secs << "s = "
+              << static_cast<uint64_t>(writes / secs) << " writes/s" << std::endl;
+}
+
+// Baseline: 5 connections, each sending SQL text and waiting for every insert
+static void bench_per_statement(size_t writes) {
+    const size_t pool = 5;
+    std::atomic<size_t> next{0};
+    auto t0 = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < pool; ++t) {
+        threads.emplace_back([&] {
+            PGconn* conn = PQconnectdb(conninfo().c_str());
+            const char* sql = PgPipelineWriter::sql(RecordType::InsertTrade);
+            while (true) {
+                size_t i = next++;
+                if (i >= writes) break;
+                std::string id = std::to_string(i), price = std::to_string(10000 + i % 100);
+                std::string write_id = StorageRecord::next_write_id();
+                const char* values[9] = {"BENCH", id.c_str(), id.c_str(), "bench_buyer", "bench_seller", price.c_str(), "1",
+                                         write_id.c_str(), nullptr};
+                PQclear(PQexecParams(conn, sql, 9, nullptr, values, nullptr, nullptr, 0));
+            }
+            PQfinish(conn);
+        });
+    }
+    for (auto& t : threads) t.join();
+    report("per-statement SQL, 5 connections", writes, Clock::now() - t0);
+}
+
+static void bench_pipeline(size_t writes, size_t connections, size_t batch) {
+    PgPipelineWriter writer(PgPipelineWriter::Options{conninfo(), connections, batch});
+    if (!writer.start()) {
+        std::cerr << "pipeline writer could not connect" << std::endl;
+        return;
+    }
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < writes; ++i) {
+        std::string id = std::to_string(i);
+        // ts (value 8) is NULL - the database stamps it
+        writer.write(StorageRecord{RecordType::InsertTrade, {"BENCH", id, id, "bench_buyer", "bench_seller",
+                                                             std::to_string(10000 + i % 100), "1",
+                                                             StorageRecord::next_write_id()}, 1u << 8});
+    }
+    writer.flush();
+    auto elapsed = Clock::now() - t0;
+    std::string name = "pipelined prepared, " + std::to_string(connections) + " connections, batch " + std::to_string(batch);
+    report(name.c_str(), writes, elapsed);
+    auto stats = writer.stats();
+    std::cout << "  " << stats.batches << " round trips, " << stats.rejected << " rejected" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t writes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t connections = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+    size_t batch = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 512;
+
+    PGconn* admin = PQconnectdb(conninfo().c_str());
+    if (PQstatus(admin) != CONNECTION_OK) {
+        std::cerr << "Can't connect: " << PQerrorMessage(admin);
+        PQfinish(admin);
+        return 1;
+    }
+    // Same columns the server's schema has, in case this is an empty scratch database
+    exec(admin, "CREATE TABLE IF NOT EXISTS trades (id BIGINT GENERATED ALWAYS AS IDENTITY, symbol TEXT NOT NULL, buy_order_id TEXT, "
+                "sell_order_id TEXT, buy_user_id TEXT, sell_user_id TEXT, price BIGINT NOT NULL, quantity BIGINT NOT NULL, "
+                "ts TIMESTAMPTZ NOT NULL DEFAULT NOW(), write_id TEXT);");
+    exec(admin, "CREATE UNIQUE INDEX IF NOT EXISTS trades_write_id_idx ON trades (write_id, ts);");
+
+    // The baseline is slow - give it a tenth of the writes so the run stays short
+    bench_per_statement(std::max<size_t>(1, writes / 10));
+    bench_pipeline(writes, connections, batch);
+
+    exec(admin, "DELETE FROM trades WHERE symbol = 'BENCH';");
+    PQfinish(admin);
+    return 0;
+}
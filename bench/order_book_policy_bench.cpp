@@ -0,0 +1,100 @@
+// Book layouts side by side: the same order flow through each BasicOrderBook policy
+//
+// Two instrument profiles - a liquid one trading within a few ticks with lots
+// of cancels, and a deep one spread over thousands of price levels - replayed
+// op for op into every combination. Single-threaded, no engine or server.
+// Run it with no arguments; an optional argument sets the op count per profile.
+
+#include "order_book_impl.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace orderbook;
+
+struct Op {
+    enum Kind { Add, Cancel, Modify } kind;
+    size_t order;           // Index into the orders of this run (the target, for cancel/modify)
+    Price price;
+    Quantity quantity;
+};
+
+struct Profile {
+    const char* name;
+    Price ticks;            // Prices are spread over this many levels around 100000
+    int add_pct, cancel_pct;  // The rest are modifies
+};
+
+struct Workload {
+    std::vector<Op> ops;
+    std::vector<Order> orders;  // Templates; each run makes fresh copies
+};
+
+static Workload make_workload(const Profile& profile, size_t n) {
+    std::mt19937_64 rng(42);
+    Workload w;
+    w.ops.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        int roll = static_cast<int>(rng() % 100);
+        Price price = 100000 - profile.ticks / 2 + rng() % profile.ticks;
+        Quantity quantity = 1 + rng() % 20;
+        if (roll < profile.add_pct || w.orders.empty()) {
+            auto side = rng() % 2 ? OrderSide::BUY : OrderSide::SELL;
+            // Lean each side away from the other so the book builds up depth instead of trading it all away
+            price += side == OrderSide::BUY ? 0 : profile.ticks / 4;
+            w.orders.emplace_back(std::to_string(w.orders.size()), "BENCH", side, OrderType::LIMIT, price, quantity, "mm" + std::to_string(rng() % 8));
+            w.ops.push_back({Op::Add, w.orders.size() - 1, price, quantity});
+        } else {
+            // Recent orders get cancelled and amended far more than old ones
+            size_t back = std::min<size_t>(w.orders.size(), 1 + rng() % 256);
+            Op::Kind kind = roll < profile.add_pct + profile.cancel_pct ? Op::Cancel : Op::Modify;
+            w.ops.push_back({kind, w.orders.size() - back, price, quantity});
+        }
+    }
+    return w;
+}
+
+template <typename Policy>
+static void run(const char* name, const Workload& w) {
+    BasicOrderBook<Policy> book("BENCH");
+    std::vector<std::shared_ptr<Order>> orders;
+    orders.reserve(w.orders.size());
+    for (const auto& o : w.orders) orders.push_back(std::make_shared<Order>(o));
+    size_t trades = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto& op : w.ops) {
+        const auto& order = orders[op.order];
+        switch (op.kind) {
+            case Op::Add: trades += book.add_order(order).size(); break;
+            case Op::Cancel: book.cancel_order(order->id); break;
+            case Op::Modify: book.modify_order(order->id, op.price, op.quantity); break;
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / w.ops.size();
+    std::printf("  %-34s %8.0f ns/op  %8zu trades  %6zu indexed\n", name, ns, trades, book.get_order_count());
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 300000;
+    const Profile profiles[] = {
+        {"liquid (20 levels, 45% cancels)", 20, 45, 45},
+        {"deep (4000 levels, 20% cancels)", 4000, 70, 20},
+    };
+    for (const auto& profile : profiles) {
+        auto w = make_workload(profile, n);
+        std::printf("%s, %zu ops\n", profile.name, w.ops.size());
+        run<ReferenceBookPolicy>("map/deque/map (reference)", w);
+        run<BookPolicy<VectorLevels>>("vector/deque/map", w);
+        run<BookPolicy<MapLevels, ListQueue>>("map/list/map", w);
+        run<BookPolicy<MapLevels, DequeQueue, HashIdIndex>>("map/deque/hash", w);
+        run<BookPolicy<VectorLevels, DequeQueue, HashIdIndex>>("vector/deque/hash", w);
+        run<BookPolicy<MapLevels, DequeQueue, OrderedIdIndex, HeapAllocation, NoLocking>>("map/deque/map, no locks", w);
+        run<BookPolicy<MapLevels, DequeQueue, OrderedIdIndex, PoolAllocation, NoLocking>>("map/deque/map, pool, no locks", w);
+        run<BookPolicy<VectorLevels, DequeQueue, HashIdIndex, PoolAllocation, NoLocking>>("vector/deque/hash, pool, no locks", w);
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Heap allocations and time per order request: jsoncpp DOM vs the arena fast path
+//
+// Covers the controller's own work on a place-order call - parse, validate,
+// build the reply text - not the engine or Drogon. Run it with no arguments.
+
+#include "fast_json.hpp"
+#include "request_arena.hpp"
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+using namespace orderbook;
+
+static const std::string BODY =
+    R"({"symbol":"BTC-USD","side":"buy","type":"limit","price":50000,"quantity":3,"user_id":"alice","tif":"GTC"})";
+
+struct Fill {
+    std::string buy_order_id = "1718000000000000001";
+    std::string sell_order_id = "1718000000000000002";
+    uint64_t price = 50000;
+    uint64_t quantity = 1;
+};
+
+// What placeOrder did before: a fresh reader, a DOM in, a DOM out, then writeString
+static size_t jsoncpp_request(const Fill& fill) {
+    Json::Value body;
+    Json::CharReaderBuilder builder;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string bodyStr = BODY;
+    reader->parse(bodyStr.c_str(), bodyStr.c_str() + bodyStr.size(), &body, &errs);
+    std::string symbol = body["symbol"].asString();
+    std::string user_id = body["user_id"].asString();
+    Json::Value resj;
+    resj["status"] = "partial";
+    resj["order_id"] = "1718000000000000003";
+    resj["trades"] = Json::Value(Json::arrayValue);
+    Json::Value t;
+    t["buy_order_id"] = fill.buy_order_id;
+    t["sell_order_id"] = fill.sell_order_id;
+    t["price"] = Json::UInt64(fill.price);
+    t["quantity"] = Json::UInt64(fill.quantity);
+    t["symbol"] = symbol;
+    resj["trades"].append(t);
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    return Json::writeString(wbuilder, resj).size() + user_id.size();
+}
+
+static size_t arena_request(const Fill& fill) {
+    RequestArena::Scope arena;
+    FlatJsonObject body;
+    body.parse(BODY);
+    auto symbol = body.string("symbol");
+    auto user_id = body.string("user_id");
+    JsonWriter out;
+    out.begin_object()
+        .field("status", "partial")
+        .field("order_id", "1718000000000000003")
+        .key("trades").begin_array()
+        .begin_object()
+        .field("buy_order_id", fill.buy_order_id)
+        .field("sell_order_id", fill.sell_order_id)
+        .field("price", fill.price)
+        .field("quantity", fill.quantity)
+        .field("symbol", symbol)
+        .end_object()
+        .end_array().end_object();
+    return out.view().size() + user_id.size();
+}
+
+template <typename Fn>
+static void run(const char* name, Fn fn) {
+    constexpr int N = 200000;
+    Fill fill;
+    size_t sink = fn(fill);                 // Warm up thread-locals and the arena block
+    uint64_t a0 = g_allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) sink += fn(fill);
+    auto t1 = std::chrono::steady_clock::now();
+    uint64_t allocs = g_allocs.load() - a0;
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / N;
+    std::printf("%-10s %8.1f allocs/request %9.0f ns/request  (%zu)\n", name, double(allocs) / N, ns, sink % 10);
+}
+
+int main() {
+    run("jsoncpp", jsoncpp_request);
+    run("arena", arena_request);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Storage backend benchmark
+//
+// Pushes the same stream of trade records through each backend and prints
+// throughput (including the final flush) and the latency of write() itself,
+// which is what the matching thread pays:
+//   null            - baseline, no I/O at all
+//   file            - local append-only journal
+//   file+fdatasync  - journal that syncs every append
+//   group commit    - synced journal with acks released per batch (ack latency, not write())
+//   postgres        - pipelined writer, only when ORDERBOOK_BENCH_CONNINFO is set
+//   file->postgres  - journal replicating to the pipelined writer, same condition
+//
+//   ./storage_bench [records] [journal path]
+#include "storage.hpp"
+#include "pg_pipeline.hpp"
+#include <libpq-fe.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace orderbook;
+using Clock = std::chrono::steady_clock;
+
+static std::vector<StorageRecord> make_records(size_t count) {
+    std::vector<StorageRecord> records;
+    records.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string id = std::to_string(i);
+        records.push_back(StorageRecord{RecordType::InsertTrade, {"BENCH", "b" + id, "s" + id, "bench_buyer",
+                                                                  "bench_seller", std::to_string(10000 + i % 100), "1",
+                                                                  StorageRecord::next_write_id()}, 1u << 8});
+    }
+    return records;
+}
+
+static void run(const char* name, Storage& storage, const std::vector<StorageRecord>& records) {
+    std::vector<uint64_t> latencies;
+    latencies.reserve(records.size());
+    auto t0 = Clock::now();
+    for (const auto& record : records) {
+        auto w0 = Clock::now();
+        storage.write(StorageRecord(record));
+        latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - w0).count());
+    }
+    storage.flush();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))]; };
+    std::printf("%-16s %10.0f rec/s   write() p50 %6llu ns  p99 %8llu ns  p99.9 %9llu ns\n",
+                name, records.size() / secs,
+                static_cast<unsigned long long>(pct(0.50)),
+                static_cast<unsigned long long>(pct(0.99)),
+                static_cast<unsigned long long>(pct(0.999)));
+}
+
+// Group commit: each record is acked once durable - report write-to-ack latency
+static void run_group_commit(const std::string& path, const std::vector<StorageRecord>& records) {
+    std::remove(path.c_str());
+    FileStorage::Options options;
+    options.path = path;
+    options.sync = true;
+    options.max_batch = 256;
+    options.flush_interval = std::chrono::microseconds(2000);
+    FileStorage storage(options);
+    if (!storage.start()) return;
+    std::vector<uint64_t> latencies(records.size());
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < records.size(); ++i) {
+        auto w0 = Clock::now();
+        storage.write(StorageRecord(records[i]));
+        storage.when_durable([&latencies, i, w0](bool) {
+            latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - w0).count();
+        });
+    }
+    storage.stop();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    auto batches = storage.stats().batches;
+    std::sort(latencies.begin(), latencies.end());
+    auto pct = [&](double p) { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))]; };
+    std::printf("%-16s %10.0f rec/s   ack p50 %8llu ns  p99 %8llu ns  p99.9 %9llu ns  (%llu syncs)\n",
+                "group commit", records.size() / secs,
+                static_cast<unsigned long long>(pct(0.50)),
+                static_cast<unsigned long long>(pct(0.99)),
+                static_cast<unsigned long long>(pct(0.999)),
+                static_cast<unsigned long long>(batches));
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    std::string path = argc > 2 ? argv[2] : "storage_bench.journal";
+    auto records = make_records(count);
+
+    {
+        NullStorage storage;
+        run("null", storage, records);
+    }
+    {
+        std::remove(path.c_str());
+        FileStorage::Options options;
+        options.path = path;
+        FileStorage storage(options);
+        if (storage.start()) run("file", storage, records);
+    }
+    {
+        std::remove(path.c_str());
+        FileStorage::Options options;
+        options.path = path;
+        options.sync = true;
+        FileStorage storage(options);
+        if (storage.start()) run("file+fdatasync", storage, records);
+    }
+    run_group_commit(path, records);
+
+    const char* conninfo = std::getenv("ORDERBOOK_BENCH_CONNINFO");
+    if (conninfo) {
+        {
+            PgPipelineWriter writer(PgPipelineWriter::Options{conninfo});
+            if (writer.start()) run("postgres", writer, records);
+        }
+        {
+            // Local writes at disk speed; time how long Postgres takes to catch up separately
+            std::remove(path.c_str());
+            std::remove((path + ".offset").c_str());
+            PgPipelineWriter writer(PgPipelineWriter::Options{conninfo});
+            if (writer.start()) {
+                FileStorage::Options options;
+                options.path = path;
+                options.replicate_to = &writer;
+                FileStorage storage(options);
+                if (storage.start()) {
+                    run("file->postgres", storage, records);
+                    auto t0 = Clock::now();
+                    while (storage.replicated() < records.size()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    writer.flush();
+                    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+                    std::printf("  replication caught up %.2fs after the last local write\n", secs);
+                }
+            }
+        }
+        PGconn* conn = PQconnectdb(conninfo);
+        PQclear(PQexec(conn, "DELETE FROM trades WHERE symbol = 'BENCH'"));
+        PQfinish(conn);
+    }
+
+    std::remove(path.c_str());
+    std::remove((path + ".offset").c_str());
+    return 0;
+}
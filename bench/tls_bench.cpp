@@ -0,0 +1,208 @@
+// WSS-style fan-out over TLS: user-space record encryption vs kernel TLS
+//
+// One sender thread pushes the same market-data frames to every connection,
+// the way the WebSocket broadcast does, over loopback to receivers on their
+// own threads. Each mode reports frames/s, MB/s and the sender's CPU time per
+// MB sent - the part kTLS takes off the IO threads. A second pass sends a
+// depth snapshot file to every connection: SSL_sendfile when the kernel holds
+// the keys, read + SSL_write otherwise.
+//
+// usage: tls_bench [connections=8] [frames per connection=50000] [frame bytes=256]
+//
+// kTLS needs OpenSSL 3 built with it and the kernel's tls module (modprobe tls).
+// Without them the kTLS run still happens, on the user-space path, and says so.
+
+#include "tls.hpp"
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace orderbook;
+
+static constexpr size_t SNAPSHOT_BYTES = 1 << 20;
+static constexpr int SNAPSHOT_ROUNDS = 16;
+
+struct Cert {
+    EVP_PKEY* key = nullptr;
+    X509* x509 = nullptr;
+};
+
+// Throwaway self-signed P-256 cert, so the bench doesn't need certs/
+static Cert make_cert() {
+    Cert cert;
+    cert.key = EVP_EC_gen("P-256");
+    cert.x509 = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.x509), 3600);
+    X509_set_pubkey(cert.x509, cert.key);
+    auto* name = X509_get_subject_name(cert.x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert.x509, name);
+    X509_sign(cert.x509, cert.key, EVP_sha256());
+    return cert;
+}
+
+static SSL_CTX* server_ctx(const Cert& cert, bool ktls) {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(ctx, cert.x509);
+    SSL_CTX_use_PrivateKey(ctx, cert.key);
+    // One cipher for both runs, and one the kernel can do
+    SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256");
+    if (ktls) SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    return ctx;
+}
+
+static double thread_cpu_seconds() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Result {
+    size_t offloaded = 0;       // Connections with kTLS on the send side
+    double frames_wall = 0, frames_cpu = 0;
+    double snapshot_wall = 0, snapshot_cpu = 0;
+    bool used_sendfile = false;
+};
+
+static Result run(const Cert& cert, bool ktls, int connections, size_t frames, size_t frame_bytes, int snapshot_fd) {
+    Result result;
+    SSL_CTX* sctx = server_ctx(cert, ktls);
+    SSL_CTX* cctx = SSL_CTX_new(TLS_client_method());
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    listen(listener, connections);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+
+    // Receivers just drain until the sender closes
+    std::vector<std::thread> receivers;
+    for (int i = 0; i < connections; ++i) {
+        receivers.emplace_back([cctx, addr] {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+            SSL* ssl = SSL_new(cctx);
+            SSL_set_fd(ssl, fd);
+            if (SSL_connect(ssl) == 1) {
+                std::vector<char> buf(64 * 1024);
+                while (SSL_read(ssl, buf.data(), static_cast<int>(buf.size())) > 0) {}
+            }
+            SSL_free(ssl);
+            close(fd);
+        });
+    }
+
+    std::vector<SSL*> conns;
+    for (int i = 0; i < connections; ++i) {
+        int fd = accept(listener, nullptr, nullptr);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        SSL* ssl = SSL_new(sctx);
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) != 1) {
+            ERR_print_errors_fp(stderr);
+            std::exit(1);
+        }
+        if (BIO_get_ktls_send(SSL_get_wbio(ssl))) ++result.offloaded;
+        conns.push_back(ssl);
+    }
+
+    // Pass 1: small frames, every frame to every connection
+    std::string frame(frame_bytes, 'x');
+    auto start = std::chrono::steady_clock::now();
+    double cpu = thread_cpu_seconds();
+    for (size_t f = 0; f < frames; ++f) {
+        for (SSL* ssl : conns) SSL_write(ssl, frame.data(), static_cast<int>(frame.size()));
+    }
+    result.frames_cpu = thread_cpu_seconds() - cpu;
+    result.frames_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Pass 2: the snapshot file to every connection
+    std::vector<char> staging(SNAPSHOT_BYTES);
+    start = std::chrono::steady_clock::now();
+    cpu = thread_cpu_seconds();
+    for (int round = 0; round < SNAPSHOT_ROUNDS; ++round) {
+        for (SSL* ssl : conns) {
+            if (BIO_get_ktls_send(SSL_get_wbio(ssl)) && SSL_sendfile(ssl, snapshot_fd, 0, SNAPSHOT_BYTES, 0) == static_cast<ossl_ssize_t>(SNAPSHOT_BYTES)) {
+                result.used_sendfile = true;
+                continue;
+            }
+            // What user-space TLS has to do: pull the file through a buffer and encrypt it
+            ssize_t n = pread(snapshot_fd, staging.data(), staging.size(), 0);
+            if (n > 0) SSL_write(ssl, staging.data(), static_cast<int>(n));
+        }
+    }
+    result.snapshot_cpu = thread_cpu_seconds() - cpu;
+    result.snapshot_wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (SSL* ssl : conns) {
+        SSL_shutdown(ssl);
+        int fd = SSL_get_fd(ssl);
+        SSL_free(ssl);
+        close(fd);
+    }
+    for (auto& t : receivers) t.join();
+    close(listener);
+    SSL_CTX_free(cctx);
+    SSL_CTX_free(sctx);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int connections = argc > 1 ? std::atoi(argv[1]) : 8;
+    size_t frames = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 50000;
+    size_t frame_bytes = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 256;
+
+    auto support = probe_ktls();
+    std::printf("%s\n", support.detail.c_str());
+    std::printf("%d connections, %zu frames of %zu bytes each, then %d x %zu KB snapshot\n\n",
+                connections, frames, frame_bytes, SNAPSHOT_ROUNDS, SNAPSHOT_BYTES / 1024);
+
+    // The snapshot lives in a real file so sendfile has something to send
+    char path[] = "/tmp/tls_bench_snapshotXXXXXX";
+    int snapshot_fd = mkstemp(path);
+    std::string snapshot(SNAPSHOT_BYTES, '\0');
+    for (size_t i = 0; i < snapshot.size(); ++i) snapshot[i] = static_cast<char>('0' + i % 10);
+    if (snapshot_fd < 0 || write(snapshot_fd, snapshot.data(), snapshot.size()) != static_cast<ssize_t>(snapshot.size())) {
+        std::perror("snapshot file");
+        return 1;
+    }
+    unlink(path);
+
+    Cert cert = make_cert();
+    double frame_mb = static_cast<double>(frames) * frame_bytes * connections / (1 << 20);
+    double snapshot_mb = static_cast<double>(SNAPSHOT_BYTES) * SNAPSHOT_ROUNDS * connections / (1 << 20);
+    std::printf("%-11s %9s %12s %9s %14s   %s\n", "path", "offloaded", "frames/s", "MB/s", "sender CPU/MB", "snapshot");
+    for (bool ktls : {false, true}) {
+        auto r = run(cert, ktls, connections, frames, frame_bytes, snapshot_fd);
+        std::printf("%-11s %5zu/%-3d %12.0f %9.1f %11.2f ms   %.1f MB/s, %.2f ms CPU/MB%s\n",
+                    ktls ? "kernel" : "user-space", r.offloaded, connections,
+                    frames * connections / r.frames_wall, frame_mb / r.frames_wall, r.frames_cpu * 1000 / frame_mb,
+                    snapshot_mb / r.snapshot_wall, r.snapshot_cpu * 1000 / snapshot_mb,
+                    r.used_sendfile ? " (sendfile)" : "");
+    }
+    if (!support.available()) std::printf("\nkTLS isn't available here, so both rows ran in user space\n");
+
+    close(snapshot_fd);
+    X509_free(cert.x509);
+    EVP_PKEY_free(cert.key);
+    return 0;
+}
@@ -0,0 +1,4 @@
+# find_package(orderbook) entry point for an installed orderbook_core
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+include("${CMAKE_CURRENT_LIST_DIR}/orderbookTargets.cmake")
@@ -0,0 +1,189 @@
+// Python bindings for the matching engine (module "veloxbook")
+//
+// Orders go in and fills come out as NumPy structured arrays, a whole batch
+// per call, so Python is crossed once per batch rather than once per order.
+// The GIL is released while the engine works on a batch.
+//
+// Order and user IDs are integers on this side. The engine keys on strings,
+// so they're converted on the way in and parsed back for the fills.
+
+#include "orderbook_core.hpp"
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+using namespace orderbook;
+
+namespace {
+
+// One row of an order batch: veloxbook.order_dtype
+struct OrderRecord {
+    uint64_t id;
+    uint8_t side;       // 0 = buy, 1 = sell
+    uint8_t type;       // 0 = limit, 1 = market
+    uint64_t price;
+    uint64_t quantity;
+    uint64_t user;
+    int64_t expiry;     // Unix seconds, 0 = never
+};
+
+// One fill: veloxbook.fill_dtype
+struct FillRecord {
+    uint64_t row;       // Batch row that traded
+    uint64_t buy_id;
+    uint64_t sell_id;
+    uint64_t price;
+    uint64_t quantity;
+    int64_t ts_ns;      // Trade timestamp (virtual time if the engine has it)
+};
+
+// One depth level: veloxbook.level_dtype
+struct LevelRecord {
+    uint64_t price;
+    uint64_t quantity;
+};
+
+uint64_t parse_id(const std::string& s) {
+    uint64_t v = 0;
+    std::from_chars(s.data(), s.data() + s.size(), v);
+    return v;
+}
+
+template <typename T>
+py::array_t<T> to_array(const std::vector<T>& rows) {
+    py::array_t<T> out(static_cast<py::ssize_t>(rows.size()));
+    if (!rows.empty()) std::memcpy(out.mutable_data(), rows.data(), rows.size() * sizeof(T));
+    return out;
+}
+
+using OrderBatch = py::array_t<OrderRecord, py::array::c_style | py::array::forcecast>;
+using IdBatch = py::array_t<uint64_t, py::array::c_style | py::array::forcecast>;
+
+/**
+ * The engine as Python sees it
+ *
+ * With virtual_time=True the engine runs on a VirtualClock that only moves
+ * with set_time_ns(), the same way the backtester drives it, so expiry and
+ * fill timestamps follow the research data rather than the wall.
+ */
+class PyEngine {
+public:
+    explicit PyEngine(bool virtual_time) {
+        if (virtual_time) engine_.set_clock(&clock_);
+    }
+
+    py::array_t<FillRecord> submit(const std::string& symbol, const OrderBatch& orders) {
+        auto in = orders.unchecked<1>();
+        std::vector<FillRecord> fills;
+        {
+            py::gil_scoped_release release;
+            for (py::ssize_t i = 0; i < in.shape(0); ++i) {
+                const auto& o = in(i);
+                auto order = std::make_shared<Order>(std::to_string(o.id), symbol,
+                                                     o.side ? OrderSide::SELL : OrderSide::BUY,
+                                                     o.type ? OrderType::MARKET : OrderType::LIMIT,
+                                                     o.price, o.quantity, std::to_string(o.user), 0, o.expiry);
+                for (const auto& t : engine_.add_order(order)) {
+                    fills.push_back({static_cast<uint64_t>(i), parse_id(t.buy_order_id), parse_id(t.sell_order_id), t.price, t.quantity,
+                                     std::chrono::duration_cast<std::chrono::nanoseconds>(t.timestamp.time_since_epoch()).count()});
+                }
+            }
+        }
+        return to_array(fills);
+    }
+
+    // True where the order was live and is now cancelled
+    py::array_t<bool> cancel(const IdBatch& ids) {
+        auto in = ids.unchecked<1>();
+        py::array_t<bool> out(in.shape(0));
+        auto result = out.mutable_unchecked<1>();
+        {
+            py::gil_scoped_release release;
+            for (py::ssize_t i = 0; i < in.shape(0); ++i) result(i) = engine_.cancel_order(std::to_string(in(i)));
+        }
+        return out;
+    }
+
+    // True where the order was found and amended
+    py::array_t<bool> modify(const IdBatch& ids, const IdBatch& prices, const IdBatch& quantities) {
+        auto id = ids.unchecked<1>();
+        auto price = prices.unchecked<1>();
+        auto quantity = quantities.unchecked<1>();
+        if (price.shape(0) != id.shape(0) || quantity.shape(0) != id.shape(0)) {
+            throw std::invalid_argument("ids, prices and quantities must be the same length");
+        }
+        py::array_t<bool> out(id.shape(0));
+        auto result = out.mutable_unchecked<1>();
+        {
+            py::gil_scoped_release release;
+            for (py::ssize_t i = 0; i < id.shape(0); ++i) {
+                result(i) = engine_.modify_order(std::to_string(id(i)), price(i), quantity(i));
+            }
+        }
+        return out;
+    }
+
+    py::tuple depth(const std::string& symbol, size_t levels) const {
+        std::vector<LevelRecord> bids, asks;
+        for (const auto& level : engine_.get_bid_levels(symbol, levels)) bids.push_back({level.price, level.total_quantity});
+        for (const auto& level : engine_.get_ask_levels(symbol, levels)) asks.push_back({level.price, level.total_quantity});
+        return py::make_tuple(to_array(bids), to_array(asks));
+    }
+
+    void set_time_ns(int64_t ns) {
+        clock_.set(Clock::time_point(std::chrono::nanoseconds(ns)));
+    }
+
+    void cancel_expired() {
+        py::gil_scoped_release release;
+        engine_.cancel_expired_orders();
+    }
+
+    MatchingEngine& engine() { return engine_; }
+
+private:
+    VirtualClock clock_;        // Declared first: the engine may hold a pointer to it
+    MatchingEngine engine_;
+};
+
+} // namespace
+
+PYBIND11_MODULE(veloxbook, m) {
+    m.doc() = "VeloxBook matching engine with batch NumPy order entry";
+
+    PYBIND11_NUMPY_DTYPE(OrderRecord, id, side, type, price, quantity, user, expiry);
+    PYBIND11_NUMPY_DTYPE(FillRecord, row, buy_id, sell_id, price, quantity, ts_ns);
+    PYBIND11_NUMPY_DTYPE(LevelRecord, price, quantity);
+    m.attr("order_dtype") = py::dtype::of<OrderRecord>();
+    m.attr("fill_dtype") = py::dtype::of<FillRecord>();
+    m.attr("level_dtype") = py::dtype::of<LevelRecord>();
+    m.attr("BUY") = 0;
+    m.attr("SELL") = 1;
+    m.attr("LIMIT") = 0;
+    m.attr("MARKET") = 1;
+    m.attr("core_version") = py::make_tuple(core_version_major, core_version_minor);
+
+    py::class_<PyEngine>(m, "Engine")
+        .def(py::init<bool>(), py::arg("virtual_time") = false)
+        .def("submit", &PyEngine::submit, py::arg("symbol"), py::arg("orders"),
+             "Enter a batch of orders (order_dtype) on one symbol, in row order; returns their fills (fill_dtype)")
+        .def("cancel", &PyEngine::cancel, py::arg("ids"),
+             "Cancel orders by ID; returns a bool array, True where the order was cancelled")
+        .def("modify", &PyEngine::modify, py::arg("ids"), py::arg("prices"), py::arg("quantities"),
+             "Amend orders by ID; returns a bool array, True where the order was amended")
+        .def("depth", &PyEngine::depth, py::arg("symbol"), py::arg("levels") = 10,
+             "(bids, asks) as level_dtype arrays, best price first")
+        .def("best_bid", [](PyEngine& e, const std::string& s) { return e.engine().get_best_bid(s); }, py::arg("symbol"))
+        .def("best_ask", [](PyEngine& e, const std::string& s) { return e.engine().get_best_ask(s); }, py::arg("symbol"))
+        .def("set_time_ns", &PyEngine::set_time_ns, py::arg("ns"),
+             "Move the virtual clock forward (virtual_time engines only; never goes back)")
+        .def("cancel_expired", &PyEngine::cancel_expired, "Cancel orders whose expiry has passed")
+        .def_property_readonly("order_count", [](PyEngine& e) { return e.engine().get_order_count(); })
+        .def_property_readonly("trade_count", [](PyEngine& e) { return e.engine().get_stats().total_trades; });
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <drogon/HttpFilter.h>
+#include <trantor/utils/Date.h>
+#include "admission.hpp"
+
+// Sheds order entry with a 503 before any parsing when the engine is backed up
+// The ticket rides in the request attributes and is released when the response goes out
+// (see release), so a request holds its in-flight slot until it's answered - including
+// while a handler waits on a command lane or a durable ack.
+class AdmissionFilter : public drogon::HttpFilter<AdmissionFilter> {
+public:
+    static constexpr bool isAutoCreation = true;
+    // Set by api_server; nullptr lets everything through
+    static inline orderbook::AdmissionController* controller = nullptr;
+    static constexpr const char* TICKET_KEY = "admission_ticket";
+
+    // Registered as a pre-sending advice - hands the slot back as the response is sent.
+    // If it never runs the ticket still goes when the request is destroyed.
+    static void release(const drogon::HttpRequestPtr &req) {
+        req->attributes()->erase(TICKET_KEY);
+    }
+
+    void doFilter(const drogon::HttpRequestPtr &req,
+                  drogon::FilterCallback &&fcb,
+                  drogon::FilterChainCallback &&fccb) override {
+        if (!controller || req->method() == drogon::HttpMethod::Options) {
+            fccb();
+            return;
+        }
+        // Time since Drogon started reading the request - queueing we can't see otherwise
+        auto age = std::chrono::microseconds(std::max<int64_t>(0,
+            trantor::Date::now().microSecondsSinceEpoch() - req->creationDate().microSecondsSinceEpoch()));
+        auto ticket = controller->admit(req->getPeerAddr().toIp(), age);
+        if (!ticket.admitted()) {
+            Json::Value errJson;
+            errJson["error"] = "Server busy, retry later";
+            errJson["reason"] = orderbook::AdmissionController::reason(ticket.verdict());
+            auto resp = drogon::HttpResponse::newHttpJsonResponse(errJson);
+            resp->setStatusCode(drogon::k503ServiceUnavailable);
+            resp->addHeader("Retry-After", std::to_string(controller->options().retry_after_seconds));
+            resp->addHeader("Access-Control-Allow-Origin", "*");
+            resp->addHeader("Access-Control-Allow-Credentials", "true");
+            fcb(resp);
+            return;
+        }
+        // Attributes need a copyable value, and Ticket is move-only
+        req->attributes()->insert(TICKET_KEY, std::make_shared<orderbook::AdmissionController::Ticket>(std::move(ticket)));
+        fccb();
+    }
+};
@@ -1,5 +1,6 @@
 #include "OrderBookController.h"
 #include "OrderBookWebSocket.h"
+#include "AdmissionFilter.h"
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
 #include <json/json.h>
@@ -8,13 +9,16 @@
 #include <atomic>
 #include <sstream>
 #include <drogon/utils/Utilities.h>
-#include "utils.hpp"
+#include <drogon/utils/coroutine.h>
+#include <trantor/net/EventLoopThreadPool.h>
+#include "security.hpp"
+#include "fast_json.hpp"
+#include "response_stream.hpp"
+#include "compression.hpp"
+#include "sanitize.hpp"
 #include "jwt-cpp/jwt.h"
-#include <future>
 #include <thread>
 #include <mutex>
-#include <condition_variable>
-#include <queue>
 
 // Global pointers to the core system components
 // I keep these static so all controller instances can access the same engine
@@ -24,14 +28,27 @@ std::atomic<size_t>* OrderBookController::g_trade_count = nullptr;
 std::atomic<double>* OrderBookController::g_last_order_latency_ms = nullptr;
 OrderBookWebSocket* OrderBookController::wsController = nullptr;
 drogon::orm::DbClientPtr OrderBookController::dbClient = nullptr;
+AccountLedger* OrderBookController::ledger = nullptr;
+Storage* OrderBookController::storage = nullptr;
+bool OrderBookController::durableAcks = false;
+TradeArchive* OrderBookController::tradeArchive = nullptr;
+CommandDispatcher* OrderBookController::dispatcher = nullptr;
 
 // Demo variables for the async/concurrency demo endpoint
-// These show how to use std::mutex, std::condition_variable, etc.
 std::mutex demo_mutex;
-std::condition_variable demo_cv;
-bool demo_ready = false;
 int demo_shared_value = 0;
 
+// Small pool for CPU-heavy work (bcrypt, the demo's sleep) so coroutine handlers
+// can co_await it instead of stalling an IO loop
+static trantor::EventLoop* workerLoop() {
+    static auto pool = [] {
+        auto p = std::make_unique<trantor::EventLoopThreadPool>(std::max(2u, std::thread::hardware_concurrency() / 2), "controller-worker");
+        p->start();
+        return p;
+    }();
+    return pool->getNextLoop();
+}
+
 void OrderBookController::setEngine(MatchingEngine* eng) {
     engine = eng;
 }
@@ -42,29 +59,103 @@ void OrderBookController::setWebSocketController(OrderBookWebSocket* ws) { wsCon
 void OrderBookController::setDbClient(drogon::orm::DbClientPtr dbClient_) {
     dbClient = dbClient_;
 }
+void OrderBookController::setLedger(AccountLedger* ledger_) { ledger = ledger_; }
+void OrderBookController::setStorage(Storage* storage_, bool durableAcks_) {
+    storage = storage_;
+    durableAcks = storage_ && durableAcks_;
+}
+void OrderBookController::setTradeArchive(TradeArchive* archive) { tradeArchive = archive; }
+void OrderBookController::setDispatcher(CommandDispatcher* dispatcher_) { dispatcher = dispatcher_; }
+
+// Set once at startup, before the server takes requests
+static CompressionOptions compressionOptions;
+void OrderBookController::setCompression(const CompressionOptions& options) { compressionOptions = options; }
 
-// Clean up user input to prevent injection attacks
-// Only allows alphanumeric chars, underscores, and hyphens
-static std::string sanitize(const std::string& s) {
-    std::string out;
-    for (char c : s) if (isalnum(c) || c == '_' || c == '-') out += c;
-    return out;
+// One reader per thread - building a CharReader per request costs a settings tree and a few allocations
+static bool parse_json(std::string_view text, Json::Value& out) {
+    static thread_local std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    std::string errs;
+    return reader->parse(text.data(), text.data() + text.size(), &out, &errs);
 }
 
+// Gives a jsoncpp object the accessors FlatJsonObject has, so one set of
+// validation rules serves both parsers
+class JsonObjectView {
+public:
+    explicit JsonObjectView(const Json::Value& v) : v_(v) {}
+    bool has(std::string_view k) const { return get(k) != nullptr; }
+    bool is_string(std::string_view k) const { auto f = get(k); return f && f->isString(); }
+    bool is_uint64(std::string_view k) const { auto f = get(k); return f && f->isUInt64(); }
+    std::string_view string(std::string_view k) const {
+        const char* b = nullptr;
+        const char* e = nullptr;
+        auto f = get(k);
+        return f && f->getString(&b, &e) ? std::string_view(b, e - b) : std::string_view();
+    }
+    uint64_t uint64(std::string_view k) const { auto f = get(k); return f ? f->asUInt64() : 0; }
+
+private:
+    const Json::Value* get(std::string_view k) const {
+        return v_.isObject() ? v_.find(k.data(), k.data() + k.size()) : nullptr;
+    }
+    const Json::Value& v_;
+};
+
+// An order request after validation, still pointing into the parsed body
+struct OrderFields {
+    std::string_view symbol, user_id, side, type;
+    std::string_view tif = "GTC";
+    Price price = 0, stop_price = 0;
+    Quantity quantity = 0;
+    int64_t expiry = 0;
+};
+
 // Validate that the order JSON has all required fields
 // Returns false and sets error message if validation fails
-static bool validate_order_json(const Json::Value& body, std::string& err) {
-    if (!body.isMember("symbol") || !body["symbol"].isString()) { err = "Missing or invalid 'symbol'"; return false; }
-    if (!body.isMember("side") || !body["side"].isString()) { err = "Missing or invalid 'side'"; return false; }
-    if (!body.isMember("type") || !body["type"].isString()) { err = "Missing or invalid 'type'"; return false; }
-    if (!body.isMember("price") || !body["price"].isUInt64()) { err = "Missing or invalid 'price'"; return false; }
-    if (!body.isMember("quantity") || !body["quantity"].isUInt64()) { err = "Missing or invalid 'quantity'"; return false; }
-    if (!body.isMember("user_id") || !body["user_id"].isString()) { err = "Missing or invalid 'user_id'"; return false; }
-    if (body.isMember("expiry") && !body["expiry"].isUInt64()) { err = "Invalid 'expiry'"; return false; }
-    if (body.isMember("tif") && !body["tif"].isString()) { err = "Invalid 'tif'"; return false; }
+template <typename Object>
+static bool read_order_fields(const Object& body, OrderFields& f, std::string& err) {
+    if (!body.is_string("symbol")) { err = "Missing or invalid 'symbol'"; return false; }
+    if (!body.is_string("side")) { err = "Missing or invalid 'side'"; return false; }
+    if (!body.is_string("type")) { err = "Missing or invalid 'type'"; return false; }
+    if (!body.is_uint64("price")) { err = "Missing or invalid 'price'"; return false; }
+    if (!body.is_uint64("quantity")) { err = "Missing or invalid 'quantity'"; return false; }
+    if (!body.is_string("user_id")) { err = "Missing or invalid 'user_id'"; return false; }
+    if (body.has("expiry") && !body.is_uint64("expiry")) { err = "Invalid 'expiry'"; return false; }
+    if (body.has("tif") && !body.is_string("tif")) { err = "Invalid 'tif'"; return false; }
+    if (body.has("stop_price") && !body.is_uint64("stop_price")) { err = "Invalid 'stop_price'"; return false; }
+    f.symbol = body.string("symbol");
+    f.user_id = body.string("user_id");
+    f.side = body.string("side");
+    f.type = body.string("type");
+    if (body.has("tif")) f.tif = body.string("tif");
+    f.price = body.uint64("price");
+    f.quantity = body.uint64("quantity");
+    f.stop_price = body.has("stop_price") ? body.uint64("stop_price") : 0;
+    f.expiry = body.has("expiry") ? static_cast<int64_t>(body.uint64("expiry")) : 0;
     return true;
 }
 
+static std::shared_ptr<Order> order_from_fields(const OrderFields& f) {
+    // side/type are only compared, so clean input never gets copied
+    std::string side_scratch, type_scratch;
+    auto side = sanitize_view(f.side, side_scratch);
+    auto type = sanitize_view(f.type, type_scratch);
+    return std::make_shared<Order>(
+        std::to_string(now_nanoseconds()),
+        sanitize(f.symbol),
+        side == "buy" ? OrderSide::BUY : OrderSide::SELL,
+        type == "market" ? OrderType::MARKET :
+            (type == "limit" ? OrderType::LIMIT :
+            (type == "stop" ? OrderType::STOP : OrderType::STOP_LIMIT)),
+        f.price,
+        f.quantity,
+        sanitize(f.user_id),
+        f.stop_price,
+        f.expiry,
+        sanitize(f.tif)
+    );
+}
+
 // Add CORS headers so the frontend can talk to the backend
 // Without this, browsers block cross-origin requests
 void add_cors_headers(const drogon::HttpResponsePtr& resp) {
@@ -74,25 +165,436 @@ void add_cors_headers(const drogon::HttpResponsePtr& resp) {
     resp->addHeader("Access-Control-Allow-Credentials", "true");
 }
 
-void OrderBookController::placeOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
-    auto t0 = std::chrono::high_resolution_clock::now();
-    try {
-        Json::Value body;
-        Json::CharReaderBuilder builder;
-       	std::string errs;
-        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-        std::string bodyStr = std::string(req->getBody());
-        if (!reader->parse(bodyStr.c_str(), bodyStr.c_str() + bodyStr.size(), &body, &errs)) {
-            Json::Value errJson;
-            errJson["error"] = "Invalid JSON";
-            auto resp = HttpResponse::newHttpJsonResponse(errJson);
-            resp->setStatusCode(k400BadRequest);
-            add_cors_headers(resp);
+// Reply with JSON text built by JsonWriter - a single copy into the response body
+static HttpResponsePtr json_text_response(std::string_view body) {
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    resp->setBody(std::string(body));
+    add_cors_headers(resp);
+    return resp;
+}
+
+static HttpResponsePtr errorResponse(const char* message, HttpStatusCode code) {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", message}}));
+    resp->setStatusCode(code);
+    add_cors_headers(resp);
+    return resp;
+}
+
+// String forms used in API responses (storage.cpp has the same for the database)
+static const char* side_str(OrderSide side) {
+    return side == OrderSide::BUY ? "buy" : "sell";
+}
+
+// Every timestamp the API hands out (orders and trades alike) is milliseconds since the epoch
+static int64_t timestamp_ms(std::chrono::high_resolution_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count();
+}
+static int64_t timestamp_ms(int64_t ts_us) { return ts_us / 1000; }
+
+static const char* status_str(OrderStatus status) {
+    return status == OrderStatus::FILLED ? "filled" :
+           status == OrderStatus::PARTIAL ? "partial" :
+           status == OrderStatus::CANCELLED ? "cancelled" :
+           status == OrderStatus::REJECTED ? "rejected" : "open";
+}
+
+// --- Streamed history ---
+// Per-user trade and order listings go out as chunked responses, read from the
+// engine STREAM_CHUNK records at a time, so a user with a huge history costs a
+// chunk of memory rather than the whole list. JSON by default (same shape as
+// before), or NDJSON - one record per line - with ?format=ndjson or
+// Accept: application/x-ndjson.
+static constexpr size_t STREAM_CHUNK = 256;
+
+static bool wants_ndjson(const HttpRequestPtr& req) {
+    return req->getParameter("format") == "ndjson" ||
+           req->getHeader("Accept").find("application/x-ndjson") != std::string::npos;
+}
+
+// --- Response compression ---
+// Depth and the history listings are the big, often-polled bodies. They go out
+// in the best coding the client accepts; anything under min_bytes goes as is.
+static ContentEncoding accepted_encoding(const HttpRequestPtr& req) {
+    if (!compressionOptions.enabled) return ContentEncoding::Identity;
+    return negotiate_encoding(req->getHeader("Accept-Encoding"));
+}
+
+static void add_encoding_headers(const HttpResponsePtr& resp, ContentEncoding encoding) {
+    if (!compressionOptions.enabled) return;
+    resp->addHeader("Vary", "Accept-Encoding");
+    if (encoding != ContentEncoding::Identity) resp->addHeader("Content-Encoding", content_encoding_name(encoding));
+}
+
+// A whole body, already in the given coding
+static HttpResponsePtr encoded_response(std::string body, ContentEncoding encoding, const char* content_type) {
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setContentTypeCodeAndCustomString(CT_CUSTOM, content_type);
+    resp->setBody(std::move(body));
+    add_encoding_headers(resp, encoding);
+    add_cors_headers(resp);
+    return resp;
+}
+
+// A whole body in plain text - compressed here when it's big enough
+static HttpResponsePtr compressed_response(std::string body, ContentEncoding encoding, const char* content_type) {
+    if (encoding != ContentEncoding::Identity && body.size() >= compressionOptions.min_bytes) {
+        std::string packed;
+        if (compress_body(encoding, body, packed, compressionOptions)) return encoded_response(std::move(packed), encoding, content_type);
+    }
+    return encoded_response(std::move(body), ContentEncoding::Identity, content_type);
+}
+
+// Streams the producer's output. The first min_bytes or so are produced up
+// front: a listing that's done by then goes out as one ordinary response
+// (compressed or not by size), so small ones skip chunking altogether.
+// Longer ones are compressed chunk by chunk as they're read.
+static HttpResponsePtr stream_response(const HttpRequestPtr& req, ResponseStream::Producer producer, bool ndjson) {
+    const char* content_type = ndjson ? "application/x-ndjson" : "application/json";
+    auto encoding = accepted_encoding(req);
+    std::string head;
+    bool more = true;
+    while (more && head.size() < std::max<size_t>(compressionOptions.min_bytes, 1)) more = producer(head);
+    if (!more) return compressed_response(std::move(head), encoding, content_type);
+
+    if (encoding != ContentEncoding::Identity) {
+        auto compressor = std::make_shared<StreamCompressor>(encoding, compressionOptions);
+        producer = [compressor, inner = std::move(producer), plain = std::move(head)](std::string& out) mutable {
+            // plain starts out holding the head produced above
+            bool more = plain.empty() ? inner(plain) : true;
+            bool ok = compressor->write(plain, out, !more);
+            plain.clear();
+            return more && ok;
+        };
+    } else {
+        producer = [inner = std::move(producer), head = std::move(head)](std::string& out) mutable {
+            if (head.empty()) return inner(out);
+            out.swap(head);
+            head.clear();
+            return true;
+        };
+    }
+    auto stream = std::make_shared<ResponseStream>(std::move(producer));
+    auto resp = HttpResponse::newStreamResponse([stream](char* buf, std::size_t len) -> std::size_t {
+        if (!buf) return 0;  // Connection gone; the stream is dropped with the callback
+        return stream->read(buf, len);
+    }, "", CT_CUSTOM, content_type);
+    add_encoding_headers(resp, encoding);
+    add_cors_headers(resp);
+    return resp;
+}
+
+// Separators between records: commas inside a JSON array, newlines for NDJSON
+static void begin_record(std::string& out, bool ndjson, bool& first) {
+    if (!ndjson && !first) out += ',';
+    first = false;
+}
+
+static void end_record(std::string& out, bool ndjson) {
+    if (ndjson) out += '\n';
+}
+
+static void append_trade_json(std::string& out, const Trade& trade) {
+    JsonWriter w(std::pmr::new_delete_resource());
+    w.begin_object()
+        .field("symbol", trade.symbol)
+        .field("buy_order_id", trade.buy_order_id)
+        .field("sell_order_id", trade.sell_order_id)
+        .field("price", trade.price)
+        .field("quantity", trade.quantity)
+        .field("timestamp", timestamp_ms(trade.timestamp))
+        .end_object();
+    out += w.view();
+}
+
+static void append_order_json(std::string& out, const Order& order) {
+    const char* type_str = order.type == OrderType::MARKET ? "market" :
+                           order.type == OrderType::LIMIT ? "limit" :
+                           order.type == OrderType::STOP ? "stop" : "stop_limit";
+    JsonWriter w(std::pmr::new_delete_resource());
+    w.begin_object()
+        .field("id", order.id)
+        .field("symbol", order.symbol)
+        .field("side", side_str(order.side))
+        .field("type", type_str)
+        .field("price", order.price)
+        .field("quantity", order.quantity)
+        .field("filled", order.filled_quantity)
+        .field("status", status_str(order.status))
+        .field("timestamp", timestamp_ms(order.timestamp))
+        .field("expiry", order.expiry)
+        .field("tif", order.tif)
+        .end_object();
+    out += w.view();
+}
+
+std::shared_ptr<Order> OrderBookController::orderFromJson(const Json::Value& body, std::string& err) {
+    OrderFields fields;
+    if (!read_order_fields(JsonObjectView(body), fields, err)) return nullptr;
+    return order_from_fields(fields);
+}
+
+std::vector<Trade> OrderBookController::submitOrder(const std::shared_ptr<Order>& order) {
+    auto trades = engine->add_order(order);
+    // Handle Time-in-Force orders (IOC = Immediate or Cancel, FOK = Fill or Kill)
+    if (order->tif == "IOC" && order->filled_quantity < order->quantity) engine->cancel_order(order->id);
+    if (order->tif == "FOK" && order->filled_quantity < order->quantity) engine->cancel_order(order->id);
+    if (g_order_count) (*g_order_count)++;
+    if (g_trade_count) (*g_trade_count) += trades.size();
+    // Save the order to the database asynchronously
+    persistOrder(*order);
+    persistAction("add", order->id, order->price, order->quantity);
+    // Let the owners of both sides know about their fills, wherever the order came from
+    if (wsController && !trades.empty()) wsController->sendExecutionReports(trades);
+    return trades;
+}
+
+bool OrderBookController::submitCancel(const std::string& orderId, std::string* symbol) {
+    auto existing = engine->get_order(orderId);
+    bool success = engine->cancel_order(orderId);
+    // Log the cancellation in the database
+    if (success) persistAction("cancel", orderId);
+    if (success && symbol && existing) *symbol = existing->symbol;
+    return success;
+}
+
+bool OrderBookController::submitModify(const std::string& orderId, Price newPrice, Quantity newQuantity, std::string* symbol) {
+    bool success = engine->modify_order(orderId, newPrice, newQuantity);
+    // Insert modify action into PostgreSQL
+    if (success) persistAction("modify", orderId, newPrice, newQuantity);
+    if (success && symbol) {
+        auto order = engine->get_order(orderId);
+        if (order) *symbol = order->symbol;
+    }
+    return success;
+}
+
+std::vector<OrderId> OrderBookController::submitMassCancel(const std::vector<OrderId>& orderIds, std::set<std::string>* symbols) {
+    auto cancelled = engine->mass_cancel(orderIds, symbols);
+    for (const auto& orderId : cancelled) persistAction("cancel", orderId);
+    return cancelled;
+}
+
+// Limits on one mass quote so a single request can't hold the engine for long
+static constexpr Json::ArrayIndex MAX_QUOTE_SYMBOLS = 20;
+static constexpr Json::ArrayIndex MAX_QUOTE_LEVELS = 50;
+
+bool OrderBookController::quoteSetsFromJson(const Json::Value& body, const std::string& userId, QuoteSets& sets, std::string& err) {
+    if (!body.isMember("quotes") || !body["quotes"].isArray() || body["quotes"].size() > MAX_QUOTE_SYMBOLS) {
+        err = "Missing or invalid 'quotes' (at most 20 symbols)";
+        return false;
+    }
+    // Quote IDs share one timestamp and get a per-request sequence number
+    std::string base_id = std::to_string(now_nanoseconds());
+    size_t seq = 0;
+    for (const auto& entry : body["quotes"]) {
+        if (!entry.isObject() || !entry["symbol"].isString()) { err = "Each quote set needs a 'symbol'"; return false; }
+        std::string symbol = sanitize(entry["symbol"].asString());
+        std::vector<std::shared_ptr<Order>> quotes;
+        for (const char* sideKey : {"bids", "asks"}) {
+            const auto& levels = entry[sideKey];
+            if (levels.isNull()) continue;
+            if (!levels.isArray() || levels.size() > MAX_QUOTE_LEVELS) {
+                err = std::string("Invalid '") + sideKey + "' (at most 50 levels)";
+                return false;
+            }
+            for (const auto& level : levels) {
+                if (!level["price"].isUInt64() || !level["quantity"].isUInt64()) {
+                    err = std::string("Missing or invalid price/quantity in '") + sideKey + "'";
+                    return false;
+                }
+                quotes.push_back(std::make_shared<Order>(
+                    base_id + "-" + std::to_string(seq++),
+                    symbol,
+                    std::string(sideKey) == "bids" ? OrderSide::BUY : OrderSide::SELL,
+                    OrderType::LIMIT,
+                    static_cast<Price>(level["price"].asUInt64()),
+                    static_cast<Quantity>(level["quantity"].asUInt64()),
+                    userId
+                ));
+            }
+        }
+        sets.emplace_back(symbol, std::move(quotes));
+    }
+    return true;
+}
+
+std::vector<MassQuoteResult> OrderBookController::submitMassQuote(const std::string& userId, const QuoteSets& sets) {
+    auto results = engine->mass_quote(userId, sets);
+    size_t trade_count = 0;
+    for (const auto& result : results) {
+        for (const auto& orderId : result.cancelled) persistAction("cancel", orderId);
+        for (const auto& order : result.placed) {
+            persistOrder(*order);
+            persistAction("add", order->id, order->price, order->quantity);
+        }
+        trade_count += result.trades.size();
+        if (wsController && !result.trades.empty()) wsController->sendExecutionReports(result.trades);
+    }
+    if (g_order_count) (*g_order_count)++;
+    if (g_trade_count) (*g_trade_count) += trade_count;
+    return results;
+}
+
+Json::Value OrderBookController::massQuoteResultJson(const std::vector<MassQuoteResult>& results) {
+    Json::Value books(Json::arrayValue);
+    for (const auto& result : results) {
+        Json::Value book;
+        book["symbol"] = result.symbol;
+        book["cancelled"] = static_cast<Json::UInt64>(result.cancelled.size());
+        book["orders"] = Json::Value(Json::arrayValue);
+        for (const auto& order : result.placed) {
+            Json::Value o;
+            o["order_id"] = order->id;
+            o["side"] = side_str(order->side);
+            o["price"] = order->price;
+            o["quantity"] = order->quantity;
+            o["filled"] = order->filled_quantity;
+            o["status"] = status_str(order->status);
+            book["orders"].append(o);
+        }
+        book["trades"] = Json::Value(Json::arrayValue);
+        for (const auto& trade : result.trades) {
+            Json::Value t;
+            t["buy_order_id"] = trade.buy_order_id;
+            t["sell_order_id"] = trade.sell_order_id;
+            t["price"] = trade.price;
+            t["quantity"] = trade.quantity;
+            book["trades"].append(t);
+        }
+        books.append(book);
+    }
+    return books;
+}
+
+bool OrderBookController::mmpConfigFromJson(const Json::Value& body, std::string& symbol, MmpConfig& config, std::string& err) {
+    if (!body["symbol"].isString()) { err = "Missing or invalid 'symbol'"; return false; }
+    if (!body["window_ms"].isUInt64() || body["window_ms"].asUInt64() == 0) { err = "Missing or invalid 'window_ms'"; return false; }
+    if (body.isMember("max_quantity") && !body["max_quantity"].isUInt64()) { err = "Invalid 'max_quantity'"; return false; }
+    if (body.isMember("max_fills") && !body["max_fills"].isUInt64()) { err = "Invalid 'max_fills'"; return false; }
+    symbol = sanitize(body["symbol"].asString());
+    config.window = std::chrono::milliseconds(body["window_ms"].asUInt64());
+    config.max_quantity = body.get("max_quantity", 0).asUInt64();
+    config.max_fills = body.get("max_fills", 0).asUInt64();
+    return true;
+}
+
+void OrderBookController::whenDurable(std::function<void(bool)> fn) {
+    if (durableAcks && storage) {
+        storage->when_durable(std::move(fn));
+    } else {
+        fn(true);
+    }
+}
+
+void OrderBookController::ackWhenDurable(const HttpResponsePtr& resp, std::function<void (const HttpResponsePtr &)>&& callback) {
+    // Drogon is fine with the callback running on the storage thread
+    whenDurable([resp, callback = std::move(callback)](bool ok) {
+        if (ok) {
             callback(resp);
             return;
         }
+        // The engine took the request but we can't promise it survives a restart
+        Json::Value errJson;
+        errJson["error"] = "Accepted but not persisted";
+        auto err = HttpResponse::newHttpJsonResponse(errJson);
+        err->setStatusCode(k500InternalServerError);
+        add_cors_headers(err);
+        callback(err);
+    });
+}
+
+bool OrderBookController::runInLane(CommandDispatcher::Lane lane, CommandDispatcher::Command&& work, std::string_view order_id) {
+    if (!dispatcher) {
+        work();
+        return true;
+    }
+    return dispatcher->submit(lane, std::move(work), order_id);
+}
+
+bool OrderBookController::runInLane(CommandDispatcher::Lane lane, CommandDispatcher::Command&& work, std::vector<std::string> order_ids) {
+    if (!dispatcher) {
+        work();
+        return true;
+    }
+    return dispatcher->submit(lane, std::move(work), std::move(order_ids));
+}
+
+void OrderBookController::dispatchOrderEntry(CommandDispatcher::Lane lane, std::function<void (const HttpResponsePtr &)>&& callback,
+                                             std::function<HttpResponsePtr()> work, std::string_view order_id) {
+    // Shared so the callback is still ours to answer with if the lane turns the work down
+    auto cb = std::make_shared<std::function<void (const HttpResponsePtr &)>>(std::move(callback));
+    bool queued = runInLane(lane, [cb, work = std::move(work)] {
+        HttpResponsePtr resp;
+        try {
+            resp = work();
+        } catch (const std::exception&) {
+            resp = errorResponse("Invalid request format", k400BadRequest);
+        }
+        if (resp->statusCode() == k200OK) {
+            ackWhenDurable(resp, std::move(*cb));
+        } else {
+            (*cb)(resp);
+        }
+    }, order_id);
+    if (queued) return;
+    Json::Value errJson;
+    errJson["error"] = "Server busy, retry later";
+    errJson["reason"] = std::string(CommandDispatcher::name(lane)) + "_queue_full";
+    auto resp = HttpResponse::newHttpJsonResponse(errJson);
+    resp->setStatusCode(k503ServiceUnavailable);
+    resp->addHeader("Retry-After", "1");
+    add_cors_headers(resp);
+    (*cb)(resp);
+}
+
+void OrderBookController::persistOrder(const Order& order) {
+    if (storage) storage->write(StorageRecord::order(order));
+}
+
+void OrderBookController::persistOrderStatus(const Order& order) {
+    // A brand new order isn't stored yet - persistOrder writes it with the same status right after
+    if (storage) storage->write(StorageRecord::order_status(order));
+}
+
+void OrderBookController::persistTrade(const Trade& trade) {
+    if (storage) storage->write(StorageRecord::trade(trade));
+}
+
+void OrderBookController::persistAction(const std::string& action, const OrderId& orderId) {
+    if (storage) storage->write(StorageRecord::action(action, orderId));
+}
+
+void OrderBookController::persistAction(const std::string& action, const OrderId& orderId, Price price, Quantity quantity) {
+    if (storage) storage->write(StorageRecord::action(action, orderId, price, quantity));
+}
+
+void OrderBookController::placeOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    // Parsed fields and reply text live in this thread's arena until we return
+    RequestArena::Scope arena;
+    try {
         std::string err;
-        if (!validate_order_json(body, err)) {
+        std::shared_ptr<Order> order;
+        // Plain order bodies are read in place; anything unusual goes through jsoncpp
+        FlatJsonObject flat;
+        if (flat.parse(req->getBody())) {
+            OrderFields fields;
+            if (read_order_fields(flat, fields, err)) order = order_from_fields(fields);
+        } else {
+            Json::Value body;
+            if (!parse_json(req->getBody(), body)) {
+                Json::Value errJson;
+                errJson["error"] = "Invalid JSON";
+                auto resp = HttpResponse::newHttpJsonResponse(errJson);
+                resp->setStatusCode(k400BadRequest);
+                add_cors_headers(resp);
+                callback(resp);
+                return;
+            }
+            order = orderFromJson(body, err);
+        }
+        if (!order) {
             Json::Value errJson;
             errJson["error"] = err;
             auto resp = HttpResponse::newHttpJsonResponse(errJson);
@@ -101,89 +603,47 @@ void OrderBookController::placeOrder(const HttpRequestPtr& req, std::function<vo
             callback(resp);
             return;
         }
-        std::string symbol = sanitize(body["symbol"].asString());
-        std::string user_id = sanitize(body["user_id"].asString());
-        std::string side = sanitize(body["side"].asString());
-        std::string type = sanitize(body["type"].asString());
-        int64_t expiry = 0;
-        std::string tif = "GTC";
-        if (body.isMember("expiry")) expiry = body["expiry"].asInt64();
-        if (body.isMember("tif")) tif = sanitize(body["tif"].asString());
-        auto order = std::make_shared<Order>(
-            std::to_string(now_nanoseconds()),
-            symbol,
-            side == "buy" ? OrderSide::BUY : OrderSide::SELL,
-            type == "market" ? OrderType::MARKET :
-                (type == "limit" ? OrderType::LIMIT :
-                (type == "stop" ? OrderType::STOP : OrderType::STOP_LIMIT)),
-            static_cast<Price>(body["price"].asUInt64()),
-            static_cast<Quantity>(body["quantity"].asUInt64()),
-            user_id,
-            body.isMember("stop_price") ? static_cast<Price>(body["stop_price"].asUInt64()) : 0,
-            expiry,
-            tif
-        );
-        auto trades = engine->add_order(order);
-        // Handle Time-in-Force orders (IOC = Immediate or Cancel, FOK = Fill or Kill)
-        if (tif == "IOC" && order->filled_quantity < order->quantity) engine->cancel_order(order->id);
-        if (tif == "FOK" && order->filled_quantity < order->quantity) engine->cancel_order(order->id);
-        if (g_order_count) (*g_order_count)++;
-        if (g_trade_count) (*g_trade_count) += trades.size();
-        auto t1 = std::chrono::high_resolution_clock::now();
-        if (g_last_order_latency_ms) *g_last_order_latency_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
-        // Save the order to the database asynchronously
-        if (dbClient) {
-            dbClient->execSqlAsync(
-                "INSERT INTO orders (id, symbol, side, type, price, quantity, user_id, status) VALUES ($1,$2,$3,$4,$5,$6,$7,$8) ON CONFLICT (id) DO UPDATE SET symbol=EXCLUDED.symbol, side=EXCLUDED.side, type=EXCLUDED.type, price=EXCLUDED.price, quantity=EXCLUDED.quantity, user_id=EXCLUDED.user_id, status=EXCLUDED.status;",
-                [](const drogon::orm::Result& result) { /* Success */ },
-                [](const std::exception_ptr& e) { /* Error */ },
-                std::string(order->id), std::string(symbol), std::string(side), std::string(type), order->price, order->quantity, std::string(user_id),
-                order->status == OrderStatus::FILLED ? std::string("filled") :
-                order->status == OrderStatus::PARTIAL ? std::string("partial") :
-                order->status == OrderStatus::REJECTED ? std::string("rejected") : std::string("open")
-            );
-            dbClient->execSqlAsync(
-                "INSERT INTO actions (action, order_id, price, quantity) VALUES ($1,$2,$3,$4);",
-                [](const drogon::orm::Result& result) { /* Success */ },
-                [](const std::exception_ptr& e) { /* Error */ },
-                std::string("add"), std::string(order->id), order->price, order->quantity
-            );
-        }
-        // Send real-time updates via WebSocket
-        if (wsController) {
-            wsController->broadcastOrderBook(symbol);
+        // The order owns its strings, so it can outlive this arena scope; the engine half
+        // runs on the New lane and builds its reply in the engine thread's own arena
+        dispatchOrderEntry(CommandDispatcher::Lane::New, std::move(callback), [order, t0] {
+            RequestArena::Scope arena;
+            auto trades = submitOrder(order);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            if (g_last_order_latency_ms) *g_last_order_latency_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            // Send real-time updates via WebSocket
+            if (wsController) {
+                wsController->broadcastOrderBook(order->symbol);
+                for (const auto& trade : trades) {
+                    JsonWriter tradeMsg;
+                    tradeMsg.begin_object()
+                        .field("type", "trade")
+                        .field("symbol", trade.symbol)
+                        .field("buy_order_id", trade.buy_order_id)
+                        .field("sell_order_id", trade.sell_order_id)
+                        .field("price", trade.price)
+                        .field("quantity", trade.quantity)
+                        .end_object();
+                    wsController->broadcastTrade(order->symbol, tradeMsg.str());
+                }
+            }
+            // Build the response with order status and any trades that happened
+            JsonWriter out;
+            out.begin_object()
+                .field("status", status_str(order->status))
+                .field("order_id", order->id)
+                .key("trades").begin_array();
             for (const auto& trade : trades) {
-                Json::Value tradeMsg;
-                tradeMsg["type"] = "trade";
-                tradeMsg["symbol"] = trade.symbol;
-                tradeMsg["buy_order_id"] = trade.buy_order_id;
-                tradeMsg["sell_order_id"] = trade.sell_order_id;
-                tradeMsg["price"] = trade.price;
-                tradeMsg["quantity"] = trade.quantity;
-                Json::StreamWriterBuilder wbuilder;
-                std::string payload = Json::writeString(wbuilder, tradeMsg);
-                wsController->broadcastTrade(symbol, payload);
+                out.begin_object()
+                    .field("buy_order_id", trade.buy_order_id)
+                    .field("sell_order_id", trade.sell_order_id)
+                    .field("price", trade.price)
+                    .field("quantity", trade.quantity)
+                    .field("symbol", trade.symbol)
+                    .end_object();
             }
-        }
-        // Build the response with order status and any trades that happened
-        Json::Value resj;
-        resj["status"] = order->status == OrderStatus::FILLED ? "filled" :
-                          order->status == OrderStatus::PARTIAL ? "partial" :
-                          order->status == OrderStatus::REJECTED ? "rejected" : "open";
-        resj["order_id"] = order->id;
-        resj["trades"] = Json::Value(Json::arrayValue);
-        for (const auto& trade : trades) {
-            Json::Value t;
-            t["buy_order_id"] = trade.buy_order_id;
-            t["sell_order_id"] = trade.sell_order_id;
-            t["price"] = trade.price;
-            t["quantity"] = trade.quantity;
-            t["symbol"] = trade.symbol;
-            resj["trades"].append(t);
-        }
-        auto resp = HttpResponse::newHttpJsonResponse(resj);
-        add_cors_headers(resp);
-        callback(resp);
+            out.end_array().end_object();
+            return json_text_response(out.view());
+        }, order->id);
     } catch (const std::exception& e) {
         Json::Value errJson;
         errJson["error"] = "Invalid request format";
@@ -196,55 +656,47 @@ void OrderBookController::placeOrder(const HttpRequestPtr& req, std::function<vo
 
 void OrderBookController::cancelOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string orderId) {
     orderId = sanitize(orderId);
-    bool success = engine->cancel_order(orderId);
-    // Log the cancellation in the database
-    if (dbClient && success) {
-        dbClient->execSqlAsync(
-            "INSERT INTO actions (action, order_id) VALUES ($1,$2);",
-            [](const drogon::orm::Result& result) { /* Success */ },
-            [](const std::exception_ptr& e) { /* Error */ },
-            std::string("cancel"), std::string(orderId)
-        );
-    }
-    if (!success) {
-        Json::Value errJson;
-        errJson["error"] = "Order not found or already filled/cancelled";
-        auto resp = HttpResponse::newHttpJsonResponse(errJson);
-        resp->setStatusCode(k404NotFound);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
-    }
-    
-    // Broadcast order book updates after successful cancellation
-    if (wsController) {
-        // Get all symbols that might have been affected
-        auto all_orders = engine->get_all_orders();
-        std::set<std::string> affected_symbols;
-        for (const auto& order : all_orders) {
-            affected_symbols.insert(order->symbol);
-        }
-        // Broadcast updates for all symbols (or implement symbol lookup for cancelled order)
-        for (const auto& symbol : affected_symbols) {
+    // Cancels ride the top lane - they take load off the book, so they never wait behind new orders
+    // (unless the order itself is still queued on the New lane - then the cancel waits behind it)
+    dispatchOrderEntry(CommandDispatcher::Lane::Cancel, std::move(callback), [orderId] {
+        std::string symbol;
+        bool success = submitCancel(orderId, &symbol);
+        if (!success) return errorResponse("Order not found or already filled/cancelled", k404NotFound);
+
+        // Broadcast the book the cancelled order was resting in
+        if (wsController && !symbol.empty()) {
             wsController->broadcastOrderBook(symbol);
         }
-    }
-    
-    Json::Value resJson;
-    resJson["result"] = "Cancelled";
-    auto resp = HttpResponse::newHttpJsonResponse(resJson);
-    add_cors_headers(resp);
-    callback(resp);
+
+        Json::Value resJson;
+        resJson["result"] = "Cancelled";
+        auto resp = HttpResponse::newHttpJsonResponse(resJson);
+        add_cors_headers(resp);
+        return resp;
+    }, orderId);
 }
 
 void OrderBookController::modifyOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
+    RequestArena::Scope arena;
     try {
+        std::string_view raw_id;
+        Price price = 0;
+        Quantity quantity = 0;
+        auto read = [&](const auto& body) {
+            if (!body.is_string("order_id") || !body.is_uint64("price") || !body.is_uint64("quantity")) return false;
+            raw_id = body.string("order_id");
+            price = body.uint64("price");
+            quantity = body.uint64("quantity");
+            return true;
+        };
+        FlatJsonObject flat;
         Json::Value body;
-        Json::CharReaderBuilder builder;
-        std::string errs;
-        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-        std::string bodyStr = std::string(req->getBody());
-        if (!reader->parse(bodyStr.c_str(), bodyStr.c_str() + bodyStr.size(), &body, &errs)) {
+        bool valid;
+        if (flat.parse(req->getBody())) {
+            valid = read(flat);
+        } else if (parse_json(req->getBody(), body)) {
+            valid = read(JsonObjectView(body));
+        } else {
             Json::Value errJson;
             errJson["error"] = "Invalid JSON";
             auto resp = HttpResponse::newHttpJsonResponse(errJson);
@@ -253,9 +705,7 @@ void OrderBookController::modifyOrder(const HttpRequestPtr& req, std::function<v
             callback(resp);
             return;
         }
-        if (!body.isMember("order_id") || !body["order_id"].isString() ||
-            !body.isMember("price") || !body["price"].isUInt64() ||
-            !body.isMember("quantity") || !body["quantity"].isUInt64()) {
+        if (!valid) {
             Json::Value errJson;
             errJson["error"] = "Missing or invalid fields";
             auto resp = HttpResponse::newHttpJsonResponse(errJson);
@@ -264,44 +714,73 @@ void OrderBookController::modifyOrder(const HttpRequestPtr& req, std::function<v
             callback(resp);
             return;
         }
-        std::string order_id = sanitize(body["order_id"].asString());
-        bool success = engine->modify_order(
-            order_id,
-            static_cast<Price>(body["price"].asUInt64()),
-            static_cast<Quantity>(body["quantity"].asUInt64())
-        );
-        // Insert modify action into PostgreSQL
-        if (dbClient && success) {
-            dbClient->execSqlAsync(
-                "INSERT INTO actions (action, order_id, price, quantity) VALUES ($1,$2,$3,$4);",
-                [](const drogon::orm::Result& result) { /* Success */ },
-                [](const std::exception_ptr& e) { /* Error */ },
-                std::string("modify"), std::string(order_id), static_cast<Price>(body["price"].asUInt64()), static_cast<Quantity>(body["quantity"].asUInt64())
-            );
-        }
-        // --- WebSocket broadcast ---
-        if (success && wsController) {
-            // Get all symbols that might have been affected
-            auto all_orders = engine->get_all_orders();
-            std::set<std::string> affected_symbols;
-            for (const auto& order : all_orders) {
-                affected_symbols.insert(order->symbol);
-            }
-            // Broadcast updates for all symbols (or implement symbol lookup for modified order)
-            for (const auto& symbol : affected_symbols) {
+        // raw_id points into the arena or the body - the lane gets its own copy
+        std::string order_id = sanitize(raw_id);
+        dispatchOrderEntry(CommandDispatcher::Lane::Modify, std::move(callback), [order_id, price, quantity] {
+            std::string symbol;
+            bool success = submitModify(order_id, price, quantity, &symbol);
+            // --- WebSocket broadcast ---
+            if (success && wsController && !symbol.empty()) {
                 wsController->broadcastOrderBook(symbol);
             }
+            if (!success) return errorResponse("Order not found or not modifiable", k404NotFound);
+            auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"result", "Modified"}}));
+            add_cors_headers(resp);
+            return resp;
+        }, order_id);
+    } catch (...) {
+        auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Invalid request format"}}));
+        resp->setStatusCode(k400BadRequest);
+        add_cors_headers(resp);
+        callback(resp);
+    }
+}
+
+void OrderBookController::massQuote(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
+    try {
+        Json::Value body;
+        Json::CharReaderBuilder builder;
+        std::string errs;
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        std::string bodyStr = std::string(req->getBody());
+        if (!reader->parse(bodyStr.c_str(), bodyStr.c_str() + bodyStr.size(), &body, &errs)) {
+            auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Invalid JSON"}}));
+            resp->setStatusCode(k400BadRequest);
+            add_cors_headers(resp);
+            callback(resp);
+            return;
         }
-        if (!success) {
-            auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Order not found or not modifiable"}}));
-            resp->setStatusCode(k404NotFound);
+        std::string err;
+        QuoteSets sets;
+        if (!body.isMember("user_id") || !body["user_id"].isString()) {
+            err = "Missing or invalid 'user_id'";
+        } else {
+            quoteSetsFromJson(body, sanitize(body["user_id"].asString()), sets, err);
+        }
+        if (!err.empty()) {
+            Json::Value errJson;
+            errJson["error"] = err;
+            auto resp = HttpResponse::newHttpJsonResponse(errJson);
+            resp->setStatusCode(k400BadRequest);
             add_cors_headers(resp);
             callback(resp);
             return;
         }
-        auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"result", "Modified"}}));
-        add_cors_headers(resp);
-        callback(resp);
+        // A quote replacement adds resting orders, so it queues with new orders
+        dispatchOrderEntry(CommandDispatcher::Lane::New, std::move(callback),
+                           [userId = sanitize(body["user_id"].asString()), sets = std::move(sets)] {
+            auto results = submitMassQuote(userId, sets);
+            // One coalesced depth update per book, not one per quote
+            if (wsController) {
+                for (const auto& result : results) wsController->broadcastOrderBook(result.symbol);
+            }
+            Json::Value resj;
+            resj["result"] = "Quoted";
+            resj["books"] = massQuoteResultJson(results);
+            auto resp = HttpResponse::newHttpJsonResponse(resj);
+            add_cors_headers(resp);
+            return resp;
+        });
     } catch (...) {
         auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Invalid request format"}}));
         resp->setStatusCode(k400BadRequest);
@@ -310,6 +789,34 @@ void OrderBookController::modifyOrder(const HttpRequestPtr& req, std::function<v
     }
 }
 
+void OrderBookController::setMmp(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
+    auto json = req->getJsonObject();
+    std::string err, symbol;
+    MmpConfig config;
+    if (!json) {
+        err = "Invalid JSON";
+    } else if (!(*json)["user_id"].isString()) {
+        err = "Missing or invalid 'user_id'";
+    } else {
+        mmpConfigFromJson(*json, symbol, config, err);
+    }
+    if (!err.empty()) {
+        Json::Value errJson;
+        errJson["error"] = err;
+        auto resp = HttpResponse::newHttpJsonResponse(errJson);
+        resp->setStatusCode(k400BadRequest);
+        add_cors_headers(resp);
+        callback(resp);
+        return;
+    }
+    engine->set_mmp(symbol, sanitize((*json)["user_id"].asString()), config);
+    Json::Value resj;
+    resj["result"] = (config.max_quantity || config.max_fills) ? "Armed" : "Disarmed";
+    auto resp = HttpResponse::newHttpJsonResponse(resj);
+    add_cors_headers(resp);
+    callback(resp);
+}
+
 void OrderBookController::getOrderById(const HttpRequestPtr& req, std::function<void(const HttpResponsePtr&)>&& callback, std::string orderId) {
     orderId = sanitize(orderId);
     auto user_orders = engine->get_all_orders(); // You may need to implement this in your engine
@@ -322,7 +829,6 @@ void OrderBookController::getOrderById(const HttpRequestPtr& req, std::function<
                                      order->status == OrderStatus::PARTIAL ? "partial" :
                                      order->status == OrderStatus::CANCELLED ? "cancelled" :
                                      order->status == OrderStatus::REJECTED ? "rejected" : "open";
-            auto ts = std::chrono::duration_cast<std::chrono::seconds>(order->timestamp.time_since_epoch()).count();
             Json::Value resj;
             resj["id"] = order->id;
             resj["symbol"] = order->symbol;
@@ -332,7 +838,7 @@ void OrderBookController::getOrderById(const HttpRequestPtr& req, std::function<
             resj["quantity"] = order->quantity;
             resj["filled"] = order->filled_quantity;
             resj["status"] = status_str;
-            resj["timestamp"] = ts;
+            resj["timestamp"] = Json::Int64(timestamp_ms(order->timestamp));
             resj["expiry"] = order->expiry;
             resj["tif"] = order->tif;
             auto resp = HttpResponse::newHttpJsonResponse(resj);
@@ -347,29 +853,297 @@ void OrderBookController::getOrderById(const HttpRequestPtr& req, std::function<
     callback(resp);
 }
 
-void OrderBookController::getTradeHistory(const HttpRequestPtr& req, std::function<void(const HttpResponsePtr&)>&& callback, std::string userId) {
+void OrderBookController::getAccount(const HttpRequestPtr& req, std::function<void(const HttpResponsePtr&)>&& callback, std::string userId) {
     userId = sanitize(userId);
-    // You may need to implement engine->get_user_trades(userId)
-    auto trades = engine->get_user_trades(userId);
-    Json::Value resj = Json::arrayValue;
-    for (const auto& trade : trades) {
-        Json::Value t;
-        t["symbol"] = trade.symbol;
-        t["buy_order_id"] = trade.buy_order_id;
-        t["sell_order_id"] = trade.sell_order_id;
-        t["price"] = trade.price;
-        t["quantity"] = trade.quantity;
-        // Convert time_point to timestamp (milliseconds since epoch)
-        auto timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(trade.timestamp.time_since_epoch()).count();
-        t["timestamp"] = timestamp_ms;
-        resj.append(t);
+    if (!ledger) {
+        auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Account ledger not available"}}));
+        resp->setStatusCode(k503ServiceUnavailable);
+        add_cors_headers(resp);
+        callback(resp);
+        return;
     }
+    auto account = ledger->get_account(userId);
+    // A user who never traded simply has an empty account
+    Json::Value resj;
+    resj["user_id"] = userId;
+    resj["cash"] = Json::Int64(account ? account->cash : 0);
+    resj["volume"] = Json::UInt64(account ? account->volume : 0);
+    resj["trade_count"] = Json::UInt64(account ? account->trade_count : 0);
+    Json::Value positions = Json::arrayValue;
+    int64_t realized = 0;
+    if (account) {
+        for (const auto& p : account->positions) {
+            Json::Value pj;
+            pj["symbol"] = p.symbol;
+            pj["quantity"] = Json::Int64(p.quantity);
+            pj["cost_basis"] = Json::Int64(p.cost_basis);
+            pj["avg_price"] = p.quantity != 0 ? static_cast<double>(p.cost_basis) / static_cast<double>(p.quantity) : 0.0;
+            pj["realized_pnl"] = Json::Int64(p.realized_pnl);
+            realized += p.realized_pnl;
+            positions.append(pj);
+        }
+    }
+    resj["positions"] = positions;
+    resj["realized_pnl"] = Json::Int64(realized);
     auto resp = HttpResponse::newHttpJsonResponse(resj);
     add_cors_headers(resp);
     callback(resp);
 }
 
-void OrderBookController::getOrders(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string userId) {
+// Widest from/to an archive query may span - each request reads up to this many day segments
+static constexpr int64_t MAX_ARCHIVE_SPAN_DAYS = 31;
+
+// Shared by the archive endpoints: archive present, from/to given, in order and not too far apart
+static bool archive_range(const HttpRequestPtr& req, TradeArchive* archive, int64_t& from, int64_t& to,
+                          std::function<void (const HttpResponsePtr &)>& callback) {
+    std::string err;
+    auto q = req->getParameters();
+    if (!archive) {
+        err = "Trade archive not configured";
+    } else if (q.find("from") == q.end() || q.find("to") == q.end()) {
+        err = "Missing 'from' or 'to'";
+    } else {
+        from = std::strtoll(q["from"].c_str(), nullptr, 10);
+        to = std::strtoll(q["to"].c_str(), nullptr, 10);
+        if (to <= from) {
+            err = "'to' must be after 'from'";
+        } else if (to - from > MAX_ARCHIVE_SPAN_DAYS * 86400LL * 1000000) {
+            err = "'from' to 'to' can span at most " + std::to_string(MAX_ARCHIVE_SPAN_DAYS) + " days";
+        }
+    }
+    if (err.empty()) return true;
+    Json::Value errJson;
+    errJson["error"] = err;
+    auto resp = HttpResponse::newHttpJsonResponse(errJson);
+    resp->setStatusCode(archive ? k400BadRequest : k503ServiceUnavailable);
+    add_cors_headers(resp);
+    callback(resp);
+    return false;
+}
+
+void OrderBookController::getArchivedTrades(const HttpRequestPtr& req, std::function<void(const HttpResponsePtr&)>&& callback, std::string symbol) {
+    symbol = sanitize(symbol);
+    int64_t from = 0, to = 0;
+    if (!archive_range(req, tradeArchive, from, to, callback)) return;
+    auto q = req->getParameters();
+    size_t limit = 10000;
+    if (q.find("limit") != q.end()) limit = static_cast<size_t>(std::max(1, std::min(100000, std::atoi(q["limit"].c_str()))));
+    // Segments are read and decoded on a worker loop, not the IO thread
+    workerLoop()->queueInLoop([callback = std::move(callback), symbol, from, to, limit] {
+        Json::Value trades = Json::arrayValue;
+        for (const auto& t : tradeArchive->trades(symbol, from, to, limit)) {
+            Json::Value tj;
+            tj["ts_us"] = Json::Int64(t.ts_us);
+            tj["price"] = Json::UInt64(t.price);
+            tj["quantity"] = Json::UInt64(t.quantity);
+            trades.append(tj);
+        }
+        Json::Value resj;
+        resj["symbol"] = symbol;
+        resj["trades"] = trades;
+        auto resp = HttpResponse::newHttpJsonResponse(resj);
+        add_cors_headers(resp);
+        callback(resp);
+    });
+}
+
+void OrderBookController::getArchivedVwap(const HttpRequestPtr& req, std::function<void(const HttpResponsePtr&)>&& callback, std::string symbol) {
+    symbol = sanitize(symbol);
+    int64_t from = 0, to = 0;
+    if (!archive_range(req, tradeArchive, from, to, callback)) return;
+    workerLoop()->queueInLoop([callback = std::move(callback), symbol, from, to] {
+        Json::Value bars = Json::arrayValue;
+        for (const auto& bar : tradeArchive->vwap_per_minute(symbol, from, to)) {
+            Json::Value bj;
+            bj["minute_us"] = Json::Int64(bar.minute_us);
+            bj["vwap"] = bar.vwap;
+            bj["volume"] = Json::UInt64(bar.volume);
+            bj["trades"] = Json::UInt64(bar.trades);
+            bars.append(bj);
+        }
+        Json::Value resj;
+        resj["symbol"] = symbol;
+        resj["bars"] = bars;
+        auto resp = HttpResponse::newHttpJsonResponse(resj);
+        add_cors_headers(resp);
+        callback(resp);
+    });
+}
+
+// History cursors are "<ts in microseconds>_<id>" of the last row on the previous page
+// Postgres compares (ts, id) against it, so the next page starts right where the last one ended
+static bool parseCursor(const std::string& cursor, int64_t& ts_us, std::string& id) {
+    ts_us = 0;
+    id.clear();
+    if (cursor.empty()) return true;
+    auto sep = cursor.find('_');
+    if (sep == std::string::npos || sep == 0) return false;
+    try {
+        ts_us = std::stoll(cursor.substr(0, sep));
+    } catch (...) {
+        return false;
+    }
+    id = cursor.substr(sep + 1);
+    return ts_us > 0 && !id.empty();
+}
+
+// Exact microseconds since epoch (EXTRACT(EPOCH ...) alone can round)
+#define TS_MICROS_SQL "(EXTRACT(EPOCH FROM date_trunc('second', ts))::bigint * 1000000 + EXTRACT(MICROSECONDS FROM ts)::bigint % 1000000)"
+// Rows strictly older than the cursor; the first page (no cursor) compares against infinity
+#define BEFORE_CURSOR_SQL(TS, ID) "(ts, id) < (CASE WHEN " TS "::bigint = 0 THEN 'infinity'::timestamptz ELSE TIMESTAMPTZ 'epoch' + " TS "::bigint * INTERVAL '1 microsecond' END, " ID ")"
+
+static HttpResponsePtr dbErrorResponse() {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "History query failed"}}));
+    resp->setStatusCode(k500InternalServerError);
+    add_cors_headers(resp);
+    return resp;
+}
+
+static HttpResponsePtr invalidCursorResponse() {
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Invalid cursor"}}));
+    resp->setStatusCode(k400BadRequest);
+    add_cors_headers(resp);
+    return resp;
+}
+
+// Order history filters shared by the page and its total; from_ts/to_ts are ms like every timestamp we report, to_ts inclusive
+#define ORDER_HISTORY_WHERE_SQL "user_id = $1 AND status IN ('filled', 'cancelled') AND ($2::text = '' OR symbol = $2) " \
+    "AND ($3::text = '' OR status = $3) " \
+    "AND ($4::bigint = 0 OR ts >= TIMESTAMPTZ 'epoch' + $4::bigint * INTERVAL '1 millisecond') " \
+    "AND ($5::bigint = 0 OR ts < TIMESTAMPTZ 'epoch' + ($5::bigint + 1) * INTERVAL '1 millisecond')"
+
+drogon::Task<HttpResponsePtr> OrderBookController::queryOrderHistory(std::string userId, std::string symbol, std::string status,
+                                                                    int64_t from_ts, int64_t to_ts, std::string cursor, int limit) {
+    int64_t cursor_ts = 0;
+    std::string cursor_id;
+    if (!parseCursor(cursor, cursor_ts, cursor_id)) co_return invalidCursorResponse();
+    drogon::orm::Result result;
+    int64_t total = 0;
+    try {
+        result = co_await dbClient->execSqlCoro(
+            "SELECT id, symbol, side, type, price, quantity, filled, status, " TS_MICROS_SQL " FROM orders "
+            "WHERE " ORDER_HISTORY_WHERE_SQL " AND " BEFORE_CURSOR_SQL("$6", "$7") " "
+            "ORDER BY ts DESC, id DESC LIMIT $8;",
+            userId, symbol, status, from_ts, to_ts, cursor_ts, cursor_id, static_cast<int64_t>(limit));
+        // The total counts every match, not just what's left after the cursor
+        auto count = co_await dbClient->execSqlCoro(
+            "SELECT count(*) FROM orders WHERE " ORDER_HISTORY_WHERE_SQL ";",
+            userId, symbol, status, from_ts, to_ts);
+        total = count[0][0].as<int64_t>();
+    } catch (const drogon::orm::DrogonDbException&) {
+        co_return dbErrorResponse();
+    }
+    Json::Value orders = Json::arrayValue;
+    std::string next_cursor;
+    for (const auto& row : result) {
+        Json::Value o;
+        o["id"] = row[0].as<std::string>();
+        o["symbol"] = row[1].as<std::string>();
+        o["side"] = row[2].as<std::string>();
+        o["type"] = row[3].as<std::string>();
+        o["price"] = Json::UInt64(row[4].as<uint64_t>());
+        o["quantity"] = Json::UInt64(row[5].as<uint64_t>());
+        o["filled"] = Json::UInt64(row[6].as<uint64_t>());
+        o["status"] = row[7].as<std::string>();
+        auto ts_us = row[8].as<int64_t>();
+        o["timestamp"] = Json::Int64(timestamp_ms(ts_us));
+        orders.append(o);
+        next_cursor = std::to_string(ts_us) + "_" + row[0].as<std::string>();
+    }
+    Json::Value out;
+    out["orders"] = orders;
+    // Keyset paging has no page numbers; page stays 1 so the shape matches the open-orders listing
+    out["page"] = 1;
+    out["page_size"] = limit;
+    out["total"] = Json::Int64(total);
+    // A short page means we reached the end
+    out["next_cursor"] = static_cast<int>(result.size()) == limit ? Json::Value(next_cursor) : Json::Value();
+    auto resp = HttpResponse::newHttpJsonResponse(out);
+    add_cors_headers(resp);
+    co_return resp;
+}
+
+drogon::Task<HttpResponsePtr> OrderBookController::queryTradeHistory(std::string userId, std::string symbol, std::string cursor, int limit) {
+    int64_t cursor_ts = 0;
+    std::string cursor_id;
+    int64_t cursor_trade_id = 0;
+    bool valid = parseCursor(cursor, cursor_ts, cursor_id);
+    if (valid && !cursor_id.empty()) {
+        try { cursor_trade_id = std::stoll(cursor_id); } catch (...) { valid = false; }
+    }
+    if (!valid) co_return invalidCursorResponse();
+    drogon::orm::Result result;
+    try {
+        // One index range scan per side of the trade, merged - an OR across both user columns can't walk an index in order
+        result = co_await dbClient->execSqlCoro(
+            "SELECT id, symbol, buy_order_id, sell_order_id, buy_user_id, sell_user_id, price, quantity, " TS_MICROS_SQL " FROM ("
+            "(SELECT * FROM trades WHERE buy_user_id = $1 AND ($2::text = '' OR symbol = $2) AND " BEFORE_CURSOR_SQL("$3", "$4") " ORDER BY ts DESC, id DESC LIMIT $5) "
+            "UNION "
+            "(SELECT * FROM trades WHERE sell_user_id = $1 AND ($2::text = '' OR symbol = $2) AND " BEFORE_CURSOR_SQL("$3", "$4") " ORDER BY ts DESC, id DESC LIMIT $5)"
+            ") t ORDER BY ts DESC, id DESC LIMIT $5;",
+            userId, symbol, cursor_ts, cursor_trade_id, static_cast<int64_t>(limit));
+    } catch (const drogon::orm::DrogonDbException&) {
+        co_return dbErrorResponse();
+    }
+    Json::Value trades = Json::arrayValue;
+    std::string next_cursor;
+    for (const auto& row : result) {
+        Json::Value t;
+        t["id"] = Json::Int64(row[0].as<int64_t>());
+        t["symbol"] = row[1].as<std::string>();
+        t["buy_order_id"] = row[2].as<std::string>();
+        t["sell_order_id"] = row[3].as<std::string>();
+        t["side"] = !row[4].isNull() && row[4].as<std::string>() == userId ? "buy" : "sell";
+        t["price"] = Json::UInt64(row[6].as<uint64_t>());
+        t["quantity"] = Json::UInt64(row[7].as<uint64_t>());
+        auto ts_us = row[8].as<int64_t>();
+        t["timestamp"] = Json::Int64(timestamp_ms(ts_us));
+        trades.append(t);
+        next_cursor = std::to_string(ts_us) + "_" + std::to_string(row[0].as<int64_t>());
+    }
+    Json::Value out;
+    out["trades"] = trades;
+    out["page_size"] = limit;
+    out["next_cursor"] = static_cast<int>(result.size()) == limit ? Json::Value(next_cursor) : Json::Value();
+    auto resp = HttpResponse::newHttpJsonResponse(out);
+    add_cors_headers(resp);
+    co_return resp;
+}
+
+drogon::Task<HttpResponsePtr> OrderBookController::getTradeHistory(HttpRequestPtr req, std::string userId) {
+    userId = sanitize(userId);
+    // With a database, history comes from the trades table one keyset page at a time
+    if (dbClient) {
+        auto q = req->getParameters();
+        int limit = 100;
+        if (q.find("limit") != q.end()) limit = std::max(1, std::min(500, std::atoi(q["limit"].c_str())));
+        std::string symbol = q.find("symbol") != q.end() ? sanitize(q["symbol"]) : "";
+        std::string cursor = q.find("cursor") != q.end() ? q["cursor"] : "";
+        co_return co_await queryTradeHistory(userId, symbol, cursor, limit);
+    }
+    bool ndjson = wants_ndjson(req);
+    auto* eng = engine;
+    ScanCursor cursor;
+    std::vector<Trade> chunk;
+    bool first = true, opened = false;
+    // Same envelope as the database path; everything the engine holds goes out at once, so there's no next page
+    co_return stream_response(req, [=](std::string& out) mutable {
+        if (!ndjson && !opened) out += "{\"trades\":[";
+        opened = true;
+        chunk.clear();
+        eng->scan_user_trades(userId, cursor, STREAM_CHUNK, chunk);
+        for (const auto& trade : chunk) {
+            begin_record(out, ndjson, first);
+            append_trade_json(out, trade);
+            end_record(out, ndjson);
+        }
+        if (!cursor.done) return true;
+        if (!ndjson) out += "],\"next_cursor\":null}";
+        return false;
+    }, ndjson);
+}
+
+drogon::Task<HttpResponsePtr> OrderBookController::getOrders(HttpRequestPtr req, std::string userId) {
     userId = sanitize(userId);
     int page = 1, page_size = 50;
     std::string status_filter, symbol_filter;
@@ -383,96 +1157,110 @@ void OrderBookController::getOrders(const HttpRequestPtr& req, std::function<voi
     if (q.find("from_ts") != q.end()) from_ts = std::stoll(q["from_ts"]);
     if (q.find("to_ts") != q.end()) to_ts = std::stoll(q["to_ts"]);
     if (q.find("history") != q.end() && (q["history"] == "1" || q["history"] == "true")) history = true;
-    std::vector<std::shared_ptr<Order>> user_orders = engine->get_user_orders(userId);
-    std::vector<std::shared_ptr<Order>> filtered;
-    for (const auto& order : user_orders) {
-        std::string status_str = order->status == OrderStatus::FILLED ? "filled" :
-                                 order->status == OrderStatus::PARTIAL ? "partial" :
-                                 order->status == OrderStatus::CANCELLED ? "cancelled" :
-                                 order->status == OrderStatus::REJECTED ? "rejected" : "open";
-        if (!status_filter.empty() && status_str != status_filter) continue;
-        if (!symbol_filter.empty() && order->symbol != symbol_filter) continue;
-        auto ts = std::chrono::duration_cast<std::chrono::seconds>(order->timestamp.time_since_epoch()).count();
-        if (from_ts > 0 && ts < from_ts) continue;
-        if (to_ts > 0 && ts > to_ts) continue;
-        if (history) {
-            if (status_str != "filled" && status_str != "cancelled") continue;
-        } else {
-            if (status_str == "filled" || status_str == "cancelled") continue;
-        }
-        filtered.push_back(order);
-    }
-    int total = filtered.size();
-    int start = (page - 1) * page_size;
-    int end = std::min(start + page_size, total);
-    Json::Value resj = Json::arrayValue;
-    for (int i = start; i < end; ++i) {
-        const auto& order = filtered[i];
-        std::string type_str = order->type == OrderType::MARKET ? "market" :
-                               order->type == OrderType::LIMIT ? "limit" :
-                               order->type == OrderType::STOP ? "stop" : "stop_limit";
-        std::string status_str = order->status == OrderStatus::FILLED ? "filled" :
-                                 order->status == OrderStatus::PARTIAL ? "partial" :
-                                 order->status == OrderStatus::CANCELLED ? "cancelled" :
-                                 order->status == OrderStatus::REJECTED ? "rejected" : "open";
-        auto ts = std::chrono::duration_cast<std::chrono::seconds>(order->timestamp.time_since_epoch()).count();
-        Json::Value o;
-        o["id"] = order->id;
-        o["symbol"] = order->symbol;
-        o["side"] = order->side == OrderSide::BUY ? "buy" : "sell";
-        o["type"] = type_str;
-        o["price"] = order->price;
-        o["quantity"] = order->quantity;
-        o["filled"] = order->filled_quantity;
-        o["status"] = status_str;
-        o["timestamp"] = ts;
-        o["expiry"] = order->expiry;
-        o["tif"] = order->tif;
-        resj.append(o);
+    // Finished orders drop out of the engine, so history is read from the database with keyset paging
+    if (history && dbClient) {
+        if (page != 1) co_return errorResponse("Order history pages by cursor; pass next_cursor instead of page", k400BadRequest);
+        std::string cursor = q.find("cursor") != q.end() ? q["cursor"] : "";
+        co_return co_await queryOrderHistory(userId, symbol_filter, status_filter, from_ts, to_ts, cursor, page_size);
     }
-    Json::Value out;
-    out["orders"] = resj;
-    out["page"] = page;
-    out["page_size"] = page_size;
-    out["total"] = total;
-    auto resp = HttpResponse::newHttpJsonResponse(out);
-    add_cors_headers(resp);
-    callback(resp);
+    // The engine only holds resting orders, so without the database there's no history to give
+    if (history) co_return errorResponse("Order history needs the database", k501NotImplemented);
+    // JSON pages as before ({"orders":[...],"page","page_size","total"}, counting
+    // every match for total); NDJSON streams every match, no paging
+    bool ndjson = wants_ndjson(req);
+    auto* eng = engine;
+    ScanCursor cursor;
+    std::vector<std::shared_ptr<Order>> chunk;
+    size_t skip = ndjson ? 0 : static_cast<size_t>(page - 1) * page_size;
+    size_t room = ndjson ? SIZE_MAX : static_cast<size_t>(page_size);
+    size_t total = 0;
+    bool first = true, opened = false;
+    co_return stream_response(req, [=](std::string& out) mutable {
+        if (!ndjson && !opened) out += "{\"orders\":[";
+        opened = true;
+        chunk.clear();
+        eng->scan_user_orders(userId, cursor, STREAM_CHUNK, chunk);
+        for (const auto& order : chunk) {
+            std::string status = status_str(order->status);
+            if (!status_filter.empty() && status != status_filter) continue;
+            if (!symbol_filter.empty() && order->symbol != symbol_filter) continue;
+            auto ts = timestamp_ms(order->timestamp);
+            if (from_ts > 0 && ts < from_ts) continue;
+            if (to_ts > 0 && ts > to_ts) continue;
+            if (status == "filled" || status == "cancelled") continue;
+            ++total;
+            if (skip > 0) { --skip; continue; }
+            if (room == 0) continue;
+            --room;
+            begin_record(out, ndjson, first);
+            append_order_json(out, *order);
+            end_record(out, ndjson);
+        }
+        if (!cursor.done) return true;
+        if (!ndjson) {
+            out += "],\"page\":" + std::to_string(page) + ",\"page_size\":" + std::to_string(page_size) +
+                   ",\"total\":" + std::to_string(total) + "}";
+        }
+        return false;
+    }, ndjson);
 }
 
+// Serialized (and compressed) depth pages per book version. A page is built
+// once per change to the book, however many clients are polling it.
+static VersionedBodyCache depthCache;
+
 void OrderBookController::getOrderBook(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string symbol) {
     symbol = sanitize(symbol);
     int page = 1, page_size = 50;
     auto q = req->getParameters();
     if (q.find("page") != q.end()) page = std::max(1, std::stoi(q["page"]));
     if (q.find("page_size") != q.end()) page_size = std::max(1, std::min(500, std::stoi(q["page_size"])));
-    Json::Value resj;
-    auto bids = engine->get_bid_levels(symbol, 1000);
-    auto asks = engine->get_ask_levels(symbol, 1000);
-    int bid_total = bids.size(), ask_total = asks.size();
-    int bid_start = (page - 1) * page_size, bid_end = std::min(bid_start + page_size, bid_total);
-    int ask_start = (page - 1) * page_size, ask_end = std::min(ask_start + page_size, ask_total);
-    resj["bids"] = Json::arrayValue;
-    resj["asks"] = Json::arrayValue;
-    for (int i = bid_start; i < bid_end; ++i) {
-        Json::Value bid;
-        bid["price"] = bids[i].price;
-        bid["quantity"] = bids[i].total_quantity;
-        resj["bids"].append(bid);
-    }
-    for (int i = ask_start; i < ask_end; ++i) {
-        Json::Value ask;
-        ask["price"] = asks[i].price;
-        ask["quantity"] = asks[i].total_quantity;
-        resj["asks"].append(ask);
-    }
-    resj["page"] = page;
-    resj["page_size"] = page_size;
-    resj["bid_total"] = bid_total;
-    resj["ask_total"] = ask_total;
-    auto resp = HttpResponse::newHttpJsonResponse(resj);
-    add_cors_headers(resp);
-    callback(resp);
+    auto encoding = accepted_encoding(req);
+    std::string key = symbol + '|' + std::to_string(page) + '|' + std::to_string(page_size);
+
+    uint64_t version = engine->get_book_version(symbol);
+    if (auto body = depthCache.find(key, version, encoding)) {
+        callback(encoded_response(*body, encoding, "application/json"));
+        return;
+    }
+    auto plain = depthCache.find(key, version, ContentEncoding::Identity);
+    if (!plain) {
+        std::vector<OrderBookLevel> bids, asks;
+        version = engine->get_depth(symbol, 1000, bids, asks);
+        int bid_total = bids.size(), ask_total = asks.size();
+        int bid_start = (page - 1) * page_size, bid_end = std::min(bid_start + page_size, bid_total);
+        int ask_start = (page - 1) * page_size, ask_end = std::min(ask_start + page_size, ask_total);
+        JsonWriter w(std::pmr::new_delete_resource());
+        w.begin_object().key("bids").begin_array();
+        for (int i = bid_start; i < bid_end; ++i) {
+            w.begin_object().field("price", bids[i].price).field("quantity", bids[i].total_quantity).end_object();
+        }
+        w.end_array().key("asks").begin_array();
+        for (int i = ask_start; i < ask_end; ++i) {
+            w.begin_object().field("price", asks[i].price).field("quantity", asks[i].total_quantity).end_object();
+        }
+        w.end_array()
+            .field("page", static_cast<int64_t>(page))
+            .field("page_size", static_cast<int64_t>(page_size))
+            .field("bid_total", static_cast<int64_t>(bid_total))
+            .field("ask_total", static_cast<int64_t>(ask_total))
+            .end_object();
+        plain = std::make_shared<const std::string>(w.view());
+        depthCache.store(key, version, ContentEncoding::Identity, plain);
+    }
+    // Small pages aren't worth compressing; they're cached as plain text only
+    if (encoding == ContentEncoding::Identity || plain->size() < compressionOptions.min_bytes) {
+        callback(encoded_response(*plain, ContentEncoding::Identity, "application/json"));
+        return;
+    }
+    std::string packed;
+    if (!compress_body(encoding, *plain, packed, compressionOptions)) {
+        callback(encoded_response(*plain, ContentEncoding::Identity, "application/json"));
+        return;
+    }
+    auto body = std::make_shared<const std::string>(std::move(packed));
+    depthCache.store(key, version, encoding, body);
+    callback(encoded_response(*body, encoding, "application/json"));
 }
 
 void OrderBookController::health(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
@@ -496,6 +1284,79 @@ void OrderBookController::metrics(const HttpRequestPtr& req, std::function<void
     oss << "# HELP orderbook_last_order_latency Last order processing latency in milliseconds\n";
     oss << "# TYPE orderbook_last_order_latency gauge\n";
     oss << "orderbook_last_order_latency " << (g_last_order_latency_ms ? g_last_order_latency_ms->load() : 0.0) << "\n";
+    if (storage) {
+        auto st = storage->stats();
+        oss << "# HELP orderbook_storage_info Active storage backend\n";
+        oss << "# TYPE orderbook_storage_info gauge\n";
+        oss << "orderbook_storage_info{backend=\"" << storage->name() << "\"} 1\n";
+        oss << "# HELP orderbook_storage_writes_total Records written by the storage backend\n";
+        oss << "# TYPE orderbook_storage_writes_total counter\n";
+        oss << "orderbook_storage_writes_total " << st.written << "\n";
+        oss << "# HELP orderbook_storage_write_failures_total Records the storage backend couldn't write (I/O or connection)\n";
+        oss << "# TYPE orderbook_storage_write_failures_total counter\n";
+        oss << "orderbook_storage_write_failures_total " << st.failed << "\n";
+        oss << "# HELP orderbook_storage_write_rejections_total Records the storage backend refused\n";
+        oss << "# TYPE orderbook_storage_write_rejections_total counter\n";
+        oss << "orderbook_storage_write_rejections_total " << st.rejected << "\n";
+        oss << "# HELP orderbook_storage_write_batches_total Batches written (round trips or file appends)\n";
+        oss << "# TYPE orderbook_storage_write_batches_total counter\n";
+        oss << "orderbook_storage_write_batches_total " << st.batches << "\n";
+        oss << "# HELP orderbook_storage_write_queue Records accepted but not yet written\n";
+        oss << "# TYPE orderbook_storage_write_queue gauge\n";
+        oss << "orderbook_storage_write_queue " << st.queued << "\n";
+    }
+    if (engine) {
+        auto ls = engine->lock_stats();
+        oss << "# HELP orderbook_engine_lock_wait_seconds_total Time spent queued for the engine write lock\n";
+        oss << "# TYPE orderbook_engine_lock_wait_seconds_total counter\n";
+        oss << "orderbook_engine_lock_wait_seconds_total " << ls.wait_ns_total / 1e9 << "\n";
+        oss << "# HELP orderbook_engine_lock_contended_total Engine write locks that had to wait\n";
+        oss << "# TYPE orderbook_engine_lock_contended_total counter\n";
+        oss << "orderbook_engine_lock_contended_total " << ls.contended << "\n";
+        oss << "# HELP orderbook_engine_lock_waiters Callers queued for the engine write lock\n";
+        oss << "# TYPE orderbook_engine_lock_waiters gauge\n";
+        oss << "orderbook_engine_lock_waiters " << ls.waiters << "\n";
+    }
+    if (auto* admission = AdmissionFilter::controller) {
+        auto as = admission->stats();
+        oss << "# HELP orderbook_admission_admitted_total Order entry requests let through\n";
+        oss << "# TYPE orderbook_admission_admitted_total counter\n";
+        oss << "orderbook_admission_admitted_total " << as.admitted << "\n";
+        oss << "# HELP orderbook_admission_shed_total Order entry requests answered 503, by reason\n";
+        oss << "# TYPE orderbook_admission_shed_total counter\n";
+        oss << "orderbook_admission_shed_total{reason=\"depth\"} " << as.shed_depth << "\n";
+        oss << "orderbook_admission_shed_total{reason=\"lock_wait\"} " << as.shed_lock_wait << "\n";
+        oss << "orderbook_admission_shed_total{reason=\"age\"} " << as.shed_age << "\n";
+        oss << "orderbook_admission_shed_total{reason=\"fairness\"} " << as.shed_fairness << "\n";
+        oss << "# HELP orderbook_admission_in_flight Admitted requests not finished yet\n";
+        oss << "# TYPE orderbook_admission_in_flight gauge\n";
+        oss << "orderbook_admission_in_flight " << as.in_flight << "\n";
+    }
+    if (dispatcher) {
+        static constexpr CommandDispatcher::Lane lanes[] = {CommandDispatcher::Lane::Cancel, CommandDispatcher::Lane::Modify, CommandDispatcher::Lane::New};
+        CommandDispatcher::LaneStats ds[CommandDispatcher::LANE_COUNT];
+        for (auto lane : lanes) ds[static_cast<size_t>(lane)] = dispatcher->stats(lane);
+        auto series = [&](const char* name, auto field) {
+            for (auto lane : lanes) {
+                oss << name << "{lane=\"" << CommandDispatcher::name(lane) << "\"} " << field(ds[static_cast<size_t>(lane)]) << "\n";
+            }
+        };
+        oss << "# HELP orderbook_command_queue_depth Order entry commands waiting for the engine, by lane\n";
+        oss << "# TYPE orderbook_command_queue_depth gauge\n";
+        series("orderbook_command_queue_depth", [](const auto& s) { return s.depth; });
+        oss << "# HELP orderbook_command_queue_wait_seconds_total Time commands spent queued before the engine ran them\n";
+        oss << "# TYPE orderbook_command_queue_wait_seconds_total counter\n";
+        series("orderbook_command_queue_wait_seconds_total", [](const auto& s) { return s.wait_ns_total / 1e9; });
+        oss << "# HELP orderbook_command_queue_wait_max_seconds Longest queue wait seen\n";
+        oss << "# TYPE orderbook_command_queue_wait_max_seconds gauge\n";
+        series("orderbook_command_queue_wait_max_seconds", [](const auto& s) { return s.wait_ns_max / 1e9; });
+        oss << "# HELP orderbook_command_executed_total Commands the engine ran, by lane\n";
+        oss << "# TYPE orderbook_command_executed_total counter\n";
+        series("orderbook_command_executed_total", [](const auto& s) { return s.executed; });
+        oss << "# HELP orderbook_command_rejected_total Commands refused because their lane was full\n";
+        oss << "# TYPE orderbook_command_rejected_total counter\n";
+        series("orderbook_command_rejected_total", [](const auto& s) { return s.rejected; });
+    }
     auto resp = HttpResponse::newHttpResponse();
     resp->setContentTypeString("text/plain; version=0.0.4");
     resp->setBody(oss.str());
@@ -503,14 +1364,12 @@ void OrderBookController::metrics(const HttpRequestPtr& req, std::function<void
     callback(resp);
 }
 
-void OrderBookController::registerUser(const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+drogon::Task<HttpResponsePtr> OrderBookController::registerUser(HttpRequestPtr req) {
+    // Users live in Postgres - the file and null backends can run without it
+    if (!dbClient) co_return errorResponse("User accounts need the database", k503ServiceUnavailable);
     auto json = req->getJsonObject();
     if (!json || !(*json).isMember("username") || !(*json).isMember("password")) {
-        auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Missing username or password"}}));
-        resp->setStatusCode(drogon::k400BadRequest);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
+        co_return errorResponse("Missing username or password", k400BadRequest);
     }
     std::string username = (*json)["username"].asString();
     std::string password = (*json)["password"].asString();
@@ -518,19 +1377,11 @@ void OrderBookController::registerUser(const drogon::HttpRequestPtr& req, std::f
     // Username: 3-20 chars, alphanumeric or underscore
     if (username.length() < 3 || username.length() > 20 ||
         !std::all_of(username.begin(), username.end(), [](char c) { return std::isalnum(c) || c == '_'; })) {
-        auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Username must be 3-20 characters, only letters, numbers, and underscores allowed."}}));
-        resp->setStatusCode(drogon::k400BadRequest);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
+        co_return errorResponse("Username must be 3-20 characters, only letters, numbers, and underscores allowed.", k400BadRequest);
     }
     // Password: 6-64 chars, at least one uppercase, one lowercase, one digit, one special
     if (password.length() < 6 || password.length() > 64) {
-        auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Password must be 6-64 characters."}}));
-        resp->setStatusCode(drogon::k400BadRequest);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
+        co_return errorResponse("Password must be 6-64 characters.", k400BadRequest);
     }
     bool has_upper = false, has_lower = false, has_digit = false, has_special = false;
     for (char c : password) {
@@ -540,167 +1391,113 @@ void OrderBookController::registerUser(const drogon::HttpRequestPtr& req, std::f
         else if (std::ispunct(static_cast<unsigned char>(c))) has_special = true;
     }
     if (!has_upper || !has_lower || !has_digit || !has_special) {
-        auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Password must contain at least one uppercase letter, one lowercase letter, one digit, and one special character."}}));
-        resp->setStatusCode(drogon::k400BadRequest);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
+        co_return errorResponse("Password must contain at least one uppercase letter, one lowercase letter, one digit, and one special character.", k400BadRequest);
     }
-    // Hash the password with bcrypt
-    std::string password_hash;
-    try {
-        password_hash = orderbook::bcrypt_hash_password(password);
-    } catch (const std::exception& ex) {
-        auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Failed to hash password securely"}}));
-        resp->setStatusCode(drogon::k500InternalServerError);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
+    // bcrypt is deliberately slow, so hash on a worker loop rather than the IO thread
+    std::string password_hash = co_await drogon::queueInLoopCoro<std::string>(workerLoop(), [password]() {
+        try {
+            return orderbook::bcrypt_hash_password(password);
+        } catch (const std::exception&) {
+            return std::string();
+        }
+    });
+    if (password_hash.empty()) {
+        co_return errorResponse("Failed to hash password securely", k500InternalServerError);
     }
 
-    dbClient->execSqlAsync(
-        "INSERT INTO users (username, password_hash) VALUES ($1, $2);",
-        [callback](const drogon::orm::Result&) {
-            auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"result", "User registered"}}));
-            add_cors_headers(resp);
-            callback(resp);
-        },
-        [callback](const std::exception_ptr&) {
-            auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Username already exists"}}));
-            resp->setStatusCode(drogon::k400BadRequest);
-            add_cors_headers(resp);
-            callback(resp);
-        },
-        username, password_hash
-    );
+    try {
+        co_await dbClient->execSqlCoro("INSERT INTO users (username, password_hash) VALUES ($1, $2);", username, password_hash);
+    } catch (const drogon::orm::DrogonDbException&) {
+        co_return errorResponse("Username already exists", k400BadRequest);
+    }
+    auto resp = HttpResponse::newHttpJsonResponse(Json::Value({{"result", "User registered"}}));
+    add_cors_headers(resp);
+    co_return resp;
 }
 
-void OrderBookController::loginUser(const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback) {
+drogon::Task<HttpResponsePtr> OrderBookController::loginUser(HttpRequestPtr req) {
+    // Users live in Postgres - the file and null backends can run without it
+    if (!dbClient) co_return errorResponse("User accounts need the database", k503ServiceUnavailable);
     auto json = req->getJsonObject();
     if (!json || !(*json).isMember("username") || !(*json).isMember("password")) {
-        auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Missing username or password"}}));
-        resp->setStatusCode(drogon::k400BadRequest);
-        add_cors_headers(resp);
-        callback(resp);
-        return;
+        co_return errorResponse("Missing username or password", k400BadRequest);
     }
     std::string username = (*json)["username"].asString();
     std::string password = (*json)["password"].asString();
 
-    dbClient->execSqlAsync(
-        "SELECT id, password_hash FROM users WHERE username=$1;",
-        [callback, password, username](const drogon::orm::Result& result) {
-            if (result.empty()) {
-                auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Invalid credentials"}}));
-                resp->setStatusCode(drogon::k401Unauthorized);
-                add_cors_headers(resp);
-                callback(resp);
-                return;
-            }
-            std::string hash = result[0]["password_hash"].as<std::string>();
-            int user_id = result[0]["id"].as<int>();
-            // Check the password with bcrypt
-            bool valid = false;
-            try {
-                valid = orderbook::bcrypt_check_password(password, hash);
-            } catch (const std::exception& ex) {
-                valid = false;
-            }
-            if (!valid) {
-                auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Invalid credentials"}}));
-                resp->setStatusCode(drogon::k401Unauthorized);
-                add_cors_headers(resp);
-                callback(resp);
-                return;
-            }
-            // Issue JWT and return user info
-            std::string token = jwt::create()
-                .set_issuer("orderbook")
-                .set_type("JWS")
-                .set_payload_claim("user_id", jwt::claim(std::to_string(user_id)))
-                .set_payload_claim("username", jwt::claim(username))
-                .set_expires_at(std::chrono::system_clock::now() + std::chrono::hours(1))
-                .sign(jwt::algorithm::hs256{orderbook::get_jwt_secret()});
-            Json::Value json;
-            json["token"] = token;
-            Json::Value userJson;
-            userJson["id"] = user_id;
-            userJson["username"] = username;
-            json["user"] = userJson;
-            auto resp = drogon::HttpResponse::newHttpJsonResponse(json);
-            add_cors_headers(resp);
-            callback(resp);
-        },
-        [callback](const std::exception_ptr&) {
-            auto resp = drogon::HttpResponse::newHttpJsonResponse(Json::Value({{"error", "Database error"}}));
-            resp->setStatusCode(drogon::k500InternalServerError);
-            add_cors_headers(resp);
-            callback(resp);
-        },
-        username
-    );
+    drogon::orm::Result result;
+    try {
+        result = co_await dbClient->execSqlCoro("SELECT id, password_hash FROM users WHERE username=$1;", username);
+    } catch (const drogon::orm::DrogonDbException&) {
+        co_return errorResponse("Database error", k500InternalServerError);
+    }
+    if (result.empty()) {
+        co_return errorResponse("Invalid credentials", k401Unauthorized);
+    }
+    std::string hash = result[0]["password_hash"].as<std::string>();
+    int user_id = result[0]["id"].as<int>();
+    // Check the password with bcrypt, off the IO thread for the same reason as in registerUser
+    bool valid = co_await drogon::queueInLoopCoro<bool>(workerLoop(), [password, hash]() {
+        try {
+            return orderbook::bcrypt_check_password(password, hash);
+        } catch (const std::exception&) {
+            return false;
+        }
+    });
+    if (!valid) {
+        co_return errorResponse("Invalid credentials", k401Unauthorized);
+    }
+    // Issue JWT and return user info
+    std::string token = jwt::create()
+        .set_issuer("orderbook")
+        .set_type("JWS")
+        .set_payload_claim("user_id", jwt::claim(std::to_string(user_id)))
+        .set_payload_claim("username", jwt::claim(username))
+        .set_expires_at(std::chrono::system_clock::now() + std::chrono::hours(1))
+        .sign(jwt::algorithm::hs256{orderbook::get_jwt_secret()});
+    Json::Value out;
+    out["token"] = token;
+    Json::Value userJson;
+    userJson["id"] = user_id;
+    userJson["username"] = username;
+    out["user"] = userJson;
+    auto resp = HttpResponse::newHttpJsonResponse(out);
+    add_cors_headers(resp);
+    co_return resp;
 }
 
-void OrderBookController::asyncDemo(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
-    // 1. Launch a background task with std::async
-    auto future = std::async(std::launch::async, []() {
+drogon::Task<HttpResponsePtr> OrderBookController::asyncDemo(HttpRequestPtr req) {
+    // 1. Offload blocking work to the worker pool; the IO thread serves other requests meanwhile
+    int worker_result = co_await drogon::queueInLoopCoro<int>(workerLoop(), []() {
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
         return 42;
     });
 
-    // 2. Launch a thread and use condition_variable for signaling
-    std::thread t([]() {
-        std::unique_lock<std::mutex> lock(demo_mutex);
-        demo_shared_value = 99;
-        demo_ready = true;
-        demo_cv.notify_one();
-    });
-    t.detach();
-
-    // 3. Wait for the signal
-    {
-        std::unique_lock<std::mutex> lock(demo_mutex);
-        demo_cv.wait(lock, []{ return demo_ready; });
-        demo_ready = false;
-    }
-
-    // 4. Use std::lock_guard for thread safety
+    // 2. Use std::lock_guard for thread safety around shared state
     int safe_value;
     {
         std::lock_guard<std::mutex> lock(demo_mutex);
+        demo_shared_value = 99;
         safe_value = demo_shared_value;
     }
 
-    // 5. Async DB access (if dbClient is set)
-    if (dbClient) {
-        dbClient->execSqlAsync(
-            "SELECT 1",
-            [callback, safe_value, future = std::move(future)](const drogon::orm::Result &result) mutable {
-                Json::Value res;
-                res["std_async_result"] = future.get();
-                res["thread_safe_value"] = safe_value;
-                res["db_result"] = result.empty() ? 0 : result[0][0].as<int>();
-                auto resp = HttpResponse::newHttpJsonResponse(res);
-                add_cors_headers(resp);
-                callback(resp);
-            },
-            [callback](const std::exception_ptr &e) {
-                Json::Value res;
-                res["error"] = "DB error";
-                auto resp = HttpResponse::newHttpJsonResponse(res);
-                add_cors_headers(resp);
-                callback(resp);
-            }
-        );
-        return;
-    }
-    // If no DB, just return the async/thread results
     Json::Value res;
-    res["std_async_result"] = future.get();
+    res["std_async_result"] = worker_result;
     res["thread_safe_value"] = safe_value;
+    // 3. Async DB access (if dbClient is set)
+    if (dbClient) {
+        try {
+            auto result = co_await dbClient->execSqlCoro("SELECT 1");
+            res["db_result"] = result.empty() ? 0 : result[0][0].as<int>();
+        } catch (const drogon::orm::DrogonDbException&) {
+            Json::Value err;
+            err["error"] = "DB error";
+            res = err;
+        }
+    }
     auto resp = HttpResponse::newHttpJsonResponse(res);
     add_cors_headers(resp);
-    callback(resp);
+    co_return resp;
 }
 
 // CORS preflight handlers - these respond to OPTIONS requests
@@ -725,10 +1522,16 @@ void OrderBookController::handleOptionsWithParam(const HttpRequestPtr& req, std:
 }
 
 void OrderBookController::clearAllOrders(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback) {
-    try {
-        // Clear all orders from the matching engine
+    // On the cancel lane like any other cancel, so it can't overtake orders still queued for the engine
+    dispatchOrderEntry(CommandDispatcher::Lane::Cancel, std::move(callback), [] {
+        // Cancel everything through the engine first so each order's cancel reaches storage -
+        // otherwise the journal would bring the "cleared" orders back on the next restart
+        std::vector<OrderId> ids;
+        for (const auto& order : engine->get_all_orders()) ids.push_back(order->id);
+        std::set<std::string> symbols;
+        auto cancelled = submitMassCancel(ids, &symbols);
         engine->clear();
-        
+
         // Clear orders from database
         if (dbClient) {
             dbClient->execSqlAsync(
@@ -742,26 +1545,18 @@ void OrderBookController::clearAllOrders(const HttpRequestPtr& req, std::functio
                 [](const std::exception_ptr& e) { /* Error */ }
             );
         }
-        
-        // Broadcast empty order book to all WebSocket clients
+
+        // Broadcast the emptied books to all WebSocket clients
         if (wsController) {
-            wsController->broadcastOrderBook("BTCUSD");
+            for (const auto& symbol : symbols) wsController->broadcastOrderBook(symbol);
         }
-        
+
         Json::Value resj;
         resj["message"] = "All orders cleared successfully";
         resj["cleared"] = true;
-        
+        resj["cancelled"] = static_cast<Json::UInt64>(cancelled.size());
         auto resp = HttpResponse::newHttpJsonResponse(resj);
         add_cors_headers(resp);
-        callback(resp);
-        
-    } catch (const std::exception& e) {
-        Json::Value errJson;
-        errJson["error"] = "Failed to clear orders";
-        auto resp = HttpResponse::newHttpJsonResponse(errJson);
-        resp->setStatusCode(k500InternalServerError);
-        add_cors_headers(resp);
-        callback(resp);
-    }
+        return resp;
+    });
 }
@@ -1,9 +1,18 @@
 #pragma once
 #include <drogon/HttpController.h>
 #include <drogon/orm/DbClient.h>
+#include <drogon/utils/coroutine.h>
+#include <json/json.h>
 #include "matching_engine.hpp"
+#include "account_ledger.hpp"
+#include "storage.hpp"
+#include "trade_archive.hpp"
+#include "command_dispatcher.hpp"
+#include "compression.hpp"
 #include <memory>
 #include <string>
+#include <set>
+#include <vector>
 #include <atomic>
 
 using namespace drogon;
@@ -20,9 +29,12 @@ public:
     // Define all the API endpoints
     // The frontend calls these URLs to interact with the trading system
     METHOD_LIST_BEGIN
-    ADD_METHOD_TO(OrderBookController::placeOrder, "/api/order", Post, Options);
+    // Requests that add work to the engine pass admission control first; cancels are never shed, they take load off
+    ADD_METHOD_TO(OrderBookController::placeOrder, "/api/order", Post, Options, "AdmissionFilter");
     ADD_METHOD_TO(OrderBookController::cancelOrder, "/api/cancel/{1}", Delete, Options);
-    ADD_METHOD_TO(OrderBookController::modifyOrder, "/api/modify", Post, Options);
+    ADD_METHOD_TO(OrderBookController::modifyOrder, "/api/modify", Post, Options, "AdmissionFilter");
+    ADD_METHOD_TO(OrderBookController::massQuote, "/api/mass_quote", Post, Options, "AdmissionFilter");
+    ADD_METHOD_TO(OrderBookController::setMmp, "/api/mmp", Post, Options);
     ADD_METHOD_TO(OrderBookController::getOrders, "/api/orders/{1}", Get, Options);
     ADD_METHOD_TO(OrderBookController::getOrderBook, "/api/orderbook/{1}", Get, Options);
     ADD_METHOD_TO(OrderBookController::health, "/api/health", Get, Options);
@@ -30,6 +42,9 @@ public:
     // User management and additional features
     ADD_METHOD_TO(OrderBookController::getOrderById, "/api/order/{1}", Get, Options);
     ADD_METHOD_TO(OrderBookController::getTradeHistory, "/api/trades/{1}", Get, Options);
+    ADD_METHOD_TO(OrderBookController::getAccount, "/api/account/{1}", Get, Options);
+    ADD_METHOD_TO(OrderBookController::getArchivedTrades, "/api/archive/trades/{1}", Get, Options);
+    ADD_METHOD_TO(OrderBookController::getArchivedVwap, "/api/archive/vwap/{1}", Get, Options);
     ADD_METHOD_TO(OrderBookController::registerUser, "/api/register", Post, Options);
     ADD_METHOD_TO(OrderBookController::loginUser, "/api/login", Post, Options);
     ADD_METHOD_TO(OrderBookController::asyncDemo, "/api/async_demo", Get, Options);
@@ -38,6 +53,8 @@ public:
     // Explicit OPTIONS handlers for CORS
     ADD_METHOD_TO(OrderBookController::handleOptions, "/api/order", Options);
     ADD_METHOD_TO(OrderBookController::handleOptions, "/api/modify", Options);
+    ADD_METHOD_TO(OrderBookController::handleOptions, "/api/mass_quote", Options);
+    ADD_METHOD_TO(OrderBookController::handleOptions, "/api/mmp", Options);
     ADD_METHOD_TO(OrderBookController::handleOptions, "/api/health", Options);
     ADD_METHOD_TO(OrderBookController::handleOptions, "/api/metrics", Options);
     ADD_METHOD_TO(OrderBookController::handleOptions, "/api/register", Options);
@@ -49,22 +66,33 @@ public:
     ADD_METHOD_TO(OrderBookController::handleOptionsWithParam, "/api/orderbook/{1}", Options);
     ADD_METHOD_TO(OrderBookController::handleOptionsWithParam, "/api/order/{1}", Options);
     ADD_METHOD_TO(OrderBookController::handleOptionsWithParam, "/api/trades/{1}", Options);
+    ADD_METHOD_TO(OrderBookController::handleOptionsWithParam, "/api/account/{1}", Options);
+    ADD_METHOD_TO(OrderBookController::handleOptionsWithParam, "/api/archive/trades/{1}", Options);
+    ADD_METHOD_TO(OrderBookController::handleOptionsWithParam, "/api/archive/vwap/{1}", Options);
     METHOD_LIST_END
 
     // Core trading endpoints
     void placeOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
     void cancelOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string orderId);
     void modifyOrder(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
-    void getOrders(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string userId);
+    void massQuote(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
+    void setMmp(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
+    drogon::Task<HttpResponsePtr> getOrders(HttpRequestPtr req, std::string userId);
     void getOrderBook(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string symbol);
     void health(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
     void metrics(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
     // User management and additional features
     void getOrderById(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string orderId);
-    void getTradeHistory(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string userId);
-    void registerUser(const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback);
-    void loginUser(const drogon::HttpRequestPtr& req, std::function<void(const drogon::HttpResponsePtr&)>&& callback);
-    void asyncDemo(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
+    drogon::Task<HttpResponsePtr> getTradeHistory(HttpRequestPtr req, std::string userId);
+    // Balances, positions and realized PnL straight from the ledger - no trade history scan
+    void getAccount(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string userId);
+    // Analytics over the columnar trade archive - ?from=&to= in microseconds since the epoch
+    void getArchivedTrades(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string symbol);
+    void getArchivedVwap(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback, std::string symbol);
+    // Coroutine handlers - they co_await the database and the worker pool, so an IO thread never blocks on them
+    drogon::Task<HttpResponsePtr> registerUser(HttpRequestPtr req);
+    drogon::Task<HttpResponsePtr> loginUser(HttpRequestPtr req);
+    drogon::Task<HttpResponsePtr> asyncDemo(HttpRequestPtr req);
     void clearAllOrders(const HttpRequestPtr& req, std::function<void (const HttpResponsePtr &)> &&callback);
 
     // CORS preflight handlers
@@ -76,7 +104,64 @@ public:
     static void setWebSocketController(OrderBookWebSocket* ws);
     static void setMetrics(std::atomic<size_t>* oc, std::atomic<size_t>* tc, std::atomic<double>* lat);
     static void setDbClient(drogon::orm::DbClientPtr dbClient_);
+    static void setLedger(AccountLedger* ledger_);
+    // Where order/action/trade writes go (Postgres, the file journal or nowhere)
+    // With durableAcks, order entry replies wait until the storage has the writes on disk
+    static void setStorage(Storage* storage_, bool durableAcks_ = false);
+    static void setTradeArchive(TradeArchive* archive);
+    // Priority lanes for order entry; without one, engine work runs on the IO thread
+    static void setDispatcher(CommandDispatcher* dispatcher_);
+    // Content coding for the heavy read endpoints (depth, trade and order listings)
+    static void setCompression(const CompressionOptions& options);
+
+    // Order entry shared by the REST handlers and the WebSocket session path
+    // These talk to the engine and the database but know nothing about HTTP,
+    // so each caller decides how to reply and when to broadcast book updates
+    static std::shared_ptr<Order> orderFromJson(const Json::Value& body, std::string& err);
+    static std::vector<Trade> submitOrder(const std::shared_ptr<Order>& order);
+    static bool submitCancel(const std::string& orderId, std::string* symbol = nullptr);
+    static bool submitModify(const std::string& orderId, Price newPrice, Quantity newQuantity, std::string* symbol = nullptr);
+    static std::vector<OrderId> submitMassCancel(const std::vector<OrderId>& orderIds, std::set<std::string>* symbols = nullptr);
+
+    // Mass quote - market makers replace their whole two-sided quote set per symbol in one call
+    using QuoteSets = std::vector<std::pair<std::string, std::vector<std::shared_ptr<Order>>>>;
+    static bool quoteSetsFromJson(const Json::Value& body, const std::string& userId, QuoteSets& sets, std::string& err);
+    static std::vector<MassQuoteResult> submitMassQuote(const std::string& userId, const QuoteSets& sets);
+    static Json::Value massQuoteResultJson(const std::vector<MassQuoteResult>& results);
+    // Market maker protection - arming again after a trip re-enables quoting
+    static bool mmpConfigFromJson(const Json::Value& body, std::string& symbol, MmpConfig& config, std::string& err);
+
+    // Run work on its priority lane (right here when there's no dispatcher)
+    // Returns false when the lane is full; work is left untouched then. order_id is the order the
+    // work is for, so a cancel/modify can't overtake that order's still-queued placement
+    static bool runInLane(CommandDispatcher::Lane lane, CommandDispatcher::Command&& work, std::string_view order_id = {});
+    // Same for work covering several orders - a WebSocket batch's placements and the orders it cancels or modifies
+    static bool runInLane(CommandDispatcher::Lane lane, CommandDispatcher::Command&& work, std::vector<std::string> order_ids);
+
+    // Run fn once the writes made so far are durable - right away unless durable acks are on
+    static void whenDurable(std::function<void(bool)> fn);
+
+    // Database writes driven by engine callbacks (fills, cancels, expiries)
+    static void persistTrade(const Trade& trade);
+    static void persistOrderStatus(const Order& order);
 private:
+    // Database writes for the order entry helpers above
+    static void persistOrder(const Order& order);
+    static void persistAction(const std::string& action, const OrderId& orderId);
+    static void persistAction(const std::string& action, const OrderId& orderId, Price price, Quantity quantity);
+    // Send an order entry reply, held back until its writes are durable when that's switched on
+    static void ackWhenDurable(const HttpResponsePtr& resp, std::function<void (const HttpResponsePtr &)>&& callback);
+    // Queue the engine half of an order entry request on its lane and reply with what it returns
+    // A 200 goes out through ackWhenDurable; a full lane gets a 503 straight away
+    static void dispatchOrderEntry(CommandDispatcher::Lane lane, std::function<void (const HttpResponsePtr &)>&& callback,
+                                   std::function<HttpResponsePtr()> work, std::string_view order_id = {});
+    // Keyset-paginated history straight from Postgres - pages never skip or rescan rows
+    // Arguments are taken by value: they must outlive the caller's frame across the co_await
+    // from_ts/to_ts of 0 leave that end of the range open
+    static drogon::Task<HttpResponsePtr> queryOrderHistory(std::string userId, std::string symbol, std::string status,
+                                                           int64_t from_ts, int64_t to_ts, std::string cursor, int limit);
+    static drogon::Task<HttpResponsePtr> queryTradeHistory(std::string userId, std::string symbol, std::string cursor, int limit);
+
     // Shared components that all controller instances can access
     static MatchingEngine* engine;
     static OrderBookWebSocket* wsController;
@@ -84,4 +169,9 @@ private:
     static std::atomic<size_t>* g_trade_count;
     static std::atomic<double>* g_last_order_latency_ms;
     static drogon::orm::DbClientPtr dbClient;
+    static AccountLedger* ledger;
+    static Storage* storage;
+    static bool durableAcks;
+    static TradeArchive* tradeArchive;
+    static CommandDispatcher* dispatcher;
 };
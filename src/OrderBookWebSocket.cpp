@@ -1,32 +1,481 @@
 #include "OrderBookWebSocket.h"
+#include "OrderBookController.h"
 #include "matching_engine.hpp"
+#include "security.hpp"
+#include "jwt-cpp/jwt.h"
 #include <json/json.h>
 #include <drogon/WebSocketConnection.h>
 #include <drogon/HttpRequest.h>
+#include <optional>
 #include <sstream>
 
 using namespace orderbook;
 
+// Upper bound on commands in one batch message so a single frame can't hog the engine
+static constexpr Json::ArrayIndex MAX_BATCH_COMMANDS = 100;
+
+static const char* status_str(OrderStatus status) {
+    return status == OrderStatus::FILLED ? "filled" :
+           status == OrderStatus::PARTIAL ? "partial" :
+           status == OrderStatus::CANCELLED ? "cancelled" :
+           status == OrderStatus::REJECTED ? "rejected" : "open";
+}
+
+static void send_json(const drogon::WebSocketConnectionPtr &wsConn, const Json::Value& msg) {
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    if (wsConn->connected()) wsConn->send(Json::writeString(wbuilder, msg));
+}
+
+static Json::Value reject(const Json::Value& msg, const std::string& error) {
+    Json::Value res;
+    res["type"] = "reject";
+    if (msg.isMember("req_id")) res["req_id"] = msg["req_id"];
+    res["error"] = error;
+    return res;
+}
+
+// Which priority lane a command's engine work goes on; none for commands that don't touch the book
+static std::optional<CommandDispatcher::Lane> command_lane(const std::string& msgType) {
+    if (msgType == "cancel") return CommandDispatcher::Lane::Cancel;
+    if (msgType == "modify") return CommandDispatcher::Lane::Modify;
+    if (msgType == "place" || msgType == "mass_quote") return CommandDispatcher::Lane::New;
+    return std::nullopt;
+}
+
+// A batch waits in the lane of its least urgent command, so it can't smuggle new orders past cancels
+static std::optional<CommandDispatcher::Lane> message_lane(const std::string& msgType, const Json::Value& msg) {
+    if (msgType != "batch") return command_lane(msgType);
+    auto lane = CommandDispatcher::Lane::Cancel;
+    for (const auto& cmd : msg["commands"]) {
+        auto cmdLane = cmd.isObject() ? command_lane(cmd.get("type", "").asString()) : std::nullopt;
+        if (cmdLane && *cmdLane > lane) lane = *cmdLane;
+    }
+    return lane;
+}
+
+static Json::Value ack(const Json::Value& msg, const char* op) {
+    Json::Value res;
+    res["type"] = "ack";
+    res["op"] = op;
+    if (msg.isMember("req_id")) res["req_id"] = msg["req_id"];
+    return res;
+}
+
 OrderBookWebSocket::OrderBookWebSocket() : engine_(nullptr) {}
 OrderBookWebSocket::OrderBookWebSocket(orderbook::MatchingEngine* engine)
     : engine_(engine) {}
 
 void OrderBookWebSocket::handleNewConnection(const drogon::HttpRequestPtr &req,
                                              const drogon::WebSocketConnectionPtr &wsConn) {
-    std::lock_guard<std::mutex> lock(clients_mutex_);
-    clients_.insert(wsConn);
+    auto session = std::make_shared<WsSession>();
+    wsConn->setContext(session);
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        clients_.insert(wsConn);
+    }
+    // Browsers can't set headers on a WebSocket handshake, so accept the JWT as a query parameter too
+    std::string token = req->getParameter("token");
+    auto authHeader = req->getHeader("authorization");
+    if (token.empty() && authHeader.find("Bearer ") == 0) token = authHeader.substr(7);
+    if (!token.empty()) authenticate(*session, wsConn, token);
+    session->cancel_on_disconnect = (req->getParameter("cancel_on_disconnect") == "1");
+    // Ping at a third of the timeout so a healthy client always answers in time
+    wsConn->setPingMessage("", std::chrono::duration<double>(heartbeat_timeout_) / 3);
 }
 
 void OrderBookWebSocket::handleConnectionClosed(const drogon::WebSocketConnectionPtr &wsConn) {
-    std::lock_guard<std::mutex> lock(clients_mutex_);
-    clients_.erase(wsConn);
+    auto session = wsConn->getContext<WsSession>();
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        clients_.erase(wsConn);
+        if (session && session->authenticated) {
+            auto it = sessions_by_user_.find(session->user_id);
+            if (it != sessions_by_user_.end()) {
+                it->second.erase(wsConn);
+                if (it->second.empty()) sessions_by_user_.erase(it);
+            }
+        }
+    }
+    if (session && session->cancel_on_disconnect) cancelSessionOrders(session);
+}
+
+void OrderBookWebSocket::cancelSessionOrders(const std::shared_ptr<WsSession>& session) {
+    // On the cancel lane this runs ahead of anything the session still has queued,
+    // and closing makes those queued commands bounce instead of leaving fresh orders behind
+    CommandDispatcher::Command pull = [this, session] {
+        std::vector<OrderId> order_ids;
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->closing = true;
+            order_ids.assign(session->live_orders.begin(), session->live_orders.end());
+            session->live_orders.clear();
+        }
+        if (order_ids.empty()) return;
+        std::set<std::string> symbols;
+        OrderBookController::submitMassCancel(order_ids, &symbols);
+        for (const auto& symbol : symbols) broadcastOrderBook(symbol);
+    };
+    // A full lane doesn't get to keep a dead session's orders in the book
+    if (!OrderBookController::runInLane(CommandDispatcher::Lane::Cancel, std::move(pull))) pull();
+}
+
+void OrderBookWebSocket::checkHeartbeats() {
+    auto deadline = std::chrono::steady_clock::now() - heartbeat_timeout_;
+    std::vector<drogon::WebSocketConnectionPtr> expired;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& c : clients_) {
+            auto session = c->getContext<WsSession>();
+            if (!session || !session->cancel_on_disconnect) continue;
+            std::lock_guard<std::mutex> session_lock(session->mutex);
+            if (session->last_seen < deadline) expired.push_back(c);
+        }
+    }
+    for (const auto& c : expired) {
+        // Cancel first so the orders are gone even if the close takes a while to land
+        cancelSessionOrders(c->getContext<WsSession>());
+        c->forceClose();
+    }
+}
+
+bool OrderBookWebSocket::authenticate(WsSession& session, const drogon::WebSocketConnectionPtr &wsConn, const std::string& token) {
+    try {
+        auto decoded = jwt::decode(token);
+        auto verifier = jwt::verify()
+            .allow_algorithm(jwt::algorithm::hs256{orderbook::get_jwt_secret()})
+            .with_issuer("orderbook");
+        verifier.verify(decoded);
+        // Orders are keyed by username everywhere else (the frontend sends it as user_id)
+        std::string user_id = decoded.get_payload_claim("username").as_string();
+        if (user_id.empty()) return false;
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        if (session.authenticated && session.user_id != user_id) {
+            auto it = sessions_by_user_.find(session.user_id);
+            if (it != sessions_by_user_.end()) it->second.erase(wsConn);
+        }
+        session.user_id = user_id;
+        session.authenticated = true;
+        sessions_by_user_[user_id].insert(wsConn);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
 }
 
 void OrderBookWebSocket::handleNewMessage(const drogon::WebSocketConnectionPtr &wsConn,
                                           std::string &&message,
                                           const drogon::WebSocketMessageType &type) {
-    // For now, just echo or ignore. You can implement subscription/filter logic here.
-    // wsConn->send(message);
+    auto session = wsConn->getContext<WsSession>();
+    if (!session) return;
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        session->last_seen = std::chrono::steady_clock::now();
+    }
+    if (type != drogon::WebSocketMessageType::Text || !engine_) return;
+
+    Json::Value msg;
+    Json::CharReaderBuilder builder;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(message.data(), message.data() + message.size(), &msg, &errs) || !msg.isObject()) {
+        send_json(wsConn, reject(Json::Value(), "Invalid JSON"));
+        return;
+    }
+    std::string msgType = msg.get("type", "").asString();
+    // Market data subscriptions are implicit for now - every client gets every book
+    if (msgType == "subscribe" || msgType == "unsubscribe") return;
+    if (msgType == "heartbeat") {
+        send_json(wsConn, ack(msg, "heartbeat"));
+        return;
+    }
+
+    auto lane = session->authenticated ? message_lane(msgType, msg) : std::nullopt;
+    if (!lane) {
+        runMessage(wsConn, session, msg);
+        return;
+    }
+    // Order entry goes through the engine's priority lanes - the whole message is one
+    // command, so a batch still runs together and in order
+    // A cancel/modify names its order, so it can wait behind that order if it's still queued.
+    // Placements get their IDs here rather than when they run, so they're registered as
+    // queued too (handlePlace takes the ID from "order_id"; whatever the client sent is replaced)
+    std::vector<std::string> orderIds;
+    std::string idBase = std::to_string(now_nanoseconds());
+    size_t seq = 0;
+    auto nameOrders = [&](Json::Value& cmd) {
+        if (!cmd.isObject()) return;
+        std::string cmdType = cmd.get("type", "").asString();
+        if (cmdType == "place") {
+            cmd["order_id"] = msgType == "batch" ? idBase + "-" + std::to_string(seq++) : idBase;
+            orderIds.push_back(cmd["order_id"].asString());
+        } else if ((cmdType == "cancel" || cmdType == "modify") && cmd["order_id"].isString()) {
+            orderIds.push_back(cmd["order_id"].asString());
+        }
+    };
+    if (msgType == "batch") {
+        for (auto& cmd : msg["commands"]) nameOrders(cmd);
+    } else {
+        nameOrders(msg);
+    }
+    auto queued = std::make_shared<Json::Value>(std::move(msg));
+    if (!OrderBookController::runInLane(*lane, [this, wsConn, session, queued] { runMessage(wsConn, session, *queued); }, std::move(orderIds))) {
+        send_json(wsConn, reject(*queued, "Server busy, retry later"));
+    }
+}
+
+void OrderBookWebSocket::runMessage(const drogon::WebSocketConnectionPtr &wsConn, const std::shared_ptr<WsSession>& session, const Json::Value& msg) {
+    std::string msgType = msg.get("type", "").asString();
+    {
+        std::lock_guard<std::mutex> lock(session->mutex);
+        if (session->closing) {
+            send_json(wsConn, reject(msg, "Session closed"));
+            return;
+        }
+    }
+    std::set<std::string> touched;
+    Json::Value reply;
+    if (msgType == "batch") {
+        if (!session->authenticated) {
+            reply = reject(msg, "Not authenticated");
+        } else if (!msg["commands"].isArray() || msg["commands"].size() > MAX_BATCH_COMMANDS) {
+            reply = reject(msg, "Batch needs a 'commands' array of at most 100 entries");
+        } else {
+            reply = ack(msg, "batch");
+            reply["results"] = Json::Value(Json::arrayValue);
+            for (const auto& cmd : msg["commands"]) {
+                if (!cmd.isObject() || cmd.get("type", "").asString() == "batch" || cmd.get("type", "").asString() == "auth") {
+                    reply["results"].append(reject(cmd, "Invalid batch command"));
+                    continue;
+                }
+                reply["results"].append(handleCommand(wsConn, *session, cmd, touched));
+            }
+        }
+    } else {
+        reply = handleCommand(wsConn, *session, msg, touched);
+    }
+    if (touched.empty()) {
+        send_json(wsConn, reply);
+    } else {
+        // Order entry happened - with durable acks on, the reply waits for the journal
+        OrderBookController::whenDurable([wsConn, reply](bool ok) {
+            send_json(wsConn, ok ? reply : reject(reply, "Accepted but not persisted"));
+        });
+    }
+
+    // One book update per touched symbol, however many commands hit it
+    for (const auto& symbol : touched) broadcastOrderBook(symbol);
+}
+
+Json::Value OrderBookWebSocket::handleCommand(const drogon::WebSocketConnectionPtr &wsConn, WsSession& session, const Json::Value& msg, std::set<std::string>& touched) {
+    std::string msgType = msg.get("type", "").asString();
+    if (msgType == "auth") return handleAuth(wsConn, session, msg);
+    if (!session.authenticated) return reject(msg, "Not authenticated");
+    try {
+        if (msgType == "place") return handlePlace(session, msg, touched);
+        if (msgType == "cancel") return handleCancel(session, msg, touched);
+        if (msgType == "modify") return handleModify(session, msg, touched);
+        if (msgType == "mass_quote") return handleMassQuote(session, msg, touched);
+        if (msgType == "mmp") return handleMmp(session, msg);
+    } catch (const std::exception&) {
+        return reject(msg, "Invalid request format");
+    }
+    return reject(msg, "Unknown message type");
+}
+
+Json::Value OrderBookWebSocket::handleAuth(const drogon::WebSocketConnectionPtr &wsConn, WsSession& session, const Json::Value& msg) {
+    if (!msg["token"].isString() || !authenticate(session, wsConn, msg["token"].asString())) {
+        return reject(msg, "Unauthorized: invalid or missing JWT");
+    }
+    if (msg.isMember("cancel_on_disconnect")) session.cancel_on_disconnect = msg["cancel_on_disconnect"].asBool();
+    auto res = ack(msg, "auth");
+    res["user_id"] = session.user_id;
+    res["cancel_on_disconnect"] = session.cancel_on_disconnect;
+    return res;
+}
+
+Json::Value OrderBookWebSocket::handlePlace(WsSession& session, const Json::Value& msg, std::set<std::string>& touched) {
+    // The session decides who the order belongs to, not the message body.
+    // "type" is taken by the message envelope, so the order type travels as "order_type"
+    Json::Value body = msg;
+    body["user_id"] = session.user_id;
+    body["type"] = msg.isMember("order_type") ? msg["order_type"] : Json::Value("limit");
+    std::string err;
+    auto order = OrderBookController::orderFromJson(body, err);
+    if (!order) return reject(msg, err);
+    // Assigned when the message was queued, so it's the ID the dispatcher knows it by
+    if (msg["order_id"].isString()) order->id = msg["order_id"].asString();
+    auto trades = OrderBookController::submitOrder(order);
+    touched.insert(order->symbol);
+    if (order->status == OrderStatus::NEW || order->status == OrderStatus::PARTIAL) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.live_orders.insert(order->id);
+    }
+    for (const auto& trade : trades) {
+        Json::Value tradeMsg;
+        tradeMsg["type"] = "trade";
+        tradeMsg["symbol"] = trade.symbol;
+        tradeMsg["buy_order_id"] = trade.buy_order_id;
+        tradeMsg["sell_order_id"] = trade.sell_order_id;
+        tradeMsg["price"] = trade.price;
+        tradeMsg["quantity"] = trade.quantity;
+        Json::StreamWriterBuilder wbuilder;
+        broadcastTrade(trade.symbol, Json::writeString(wbuilder, tradeMsg));
+    }
+
+    auto res = ack(msg, "place");
+    res["order_id"] = order->id;
+    res["status"] = status_str(order->status);
+    res["filled"] = order->filled_quantity;
+    res["trades"] = Json::Value(Json::arrayValue);
+    for (const auto& trade : trades) {
+        Json::Value t;
+        t["buy_order_id"] = trade.buy_order_id;
+        t["sell_order_id"] = trade.sell_order_id;
+        t["price"] = trade.price;
+        t["quantity"] = trade.quantity;
+        t["symbol"] = trade.symbol;
+        res["trades"].append(t);
+    }
+    return res;
+}
+
+Json::Value OrderBookWebSocket::handleCancel(WsSession& session, const Json::Value& msg, std::set<std::string>& touched) {
+    if (!msg["order_id"].isString()) return reject(msg, "Missing or invalid 'order_id'");
+    std::string order_id = msg["order_id"].asString();
+    auto order = engine_->get_order(order_id);
+    if (!order || order->user_id != session.user_id) return reject(msg, "Order not found");
+    std::string symbol;
+    if (!OrderBookController::submitCancel(order_id, &symbol)) {
+        return reject(msg, "Order not found or already filled/cancelled");
+    }
+    touched.insert(symbol);
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.live_orders.erase(order_id);
+    }
+    auto res = ack(msg, "cancel");
+    res["order_id"] = order_id;
+    res["status"] = "cancelled";
+    return res;
+}
+
+Json::Value OrderBookWebSocket::handleModify(WsSession& session, const Json::Value& msg, std::set<std::string>& touched) {
+    if (!msg["order_id"].isString() || !msg["price"].isUInt64() || !msg["quantity"].isUInt64()) {
+        return reject(msg, "Missing or invalid fields");
+    }
+    std::string order_id = msg["order_id"].asString();
+    auto order = engine_->get_order(order_id);
+    if (!order || order->user_id != session.user_id) return reject(msg, "Order not found");
+    std::string symbol;
+    if (!OrderBookController::submitModify(order_id,
+                                           static_cast<Price>(msg["price"].asUInt64()),
+                                           static_cast<Quantity>(msg["quantity"].asUInt64()),
+                                           &symbol)) {
+        return reject(msg, "Order not found or not modifiable");
+    }
+    touched.insert(symbol);
+    auto res = ack(msg, "modify");
+    res["order_id"] = order_id;
+    return res;
+}
+
+Json::Value OrderBookWebSocket::handleMassQuote(WsSession& session, const Json::Value& msg, std::set<std::string>& touched) {
+    OrderBookController::QuoteSets sets;
+    std::string err;
+    if (!OrderBookController::quoteSetsFromJson(msg, session.user_id, sets, err)) return reject(msg, err);
+    auto results = OrderBookController::submitMassQuote(session.user_id, sets);
+    {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        for (const auto& result : results) {
+            for (const auto& id : result.cancelled) session.live_orders.erase(id);
+            for (const auto& order : result.placed) {
+                if (order->status == OrderStatus::NEW || order->status == OrderStatus::PARTIAL) {
+                    session.live_orders.insert(order->id);
+                }
+            }
+        }
+    }
+    for (const auto& result : results) touched.insert(result.symbol);
+    auto res = ack(msg, "mass_quote");
+    res["books"] = OrderBookController::massQuoteResultJson(results);
+    return res;
+}
+
+Json::Value OrderBookWebSocket::handleMmp(WsSession& session, const Json::Value& msg) {
+    std::string symbol, err;
+    MmpConfig config;
+    if (!OrderBookController::mmpConfigFromJson(msg, symbol, config, err)) return reject(msg, err);
+    engine_->set_mmp(symbol, session.user_id, config);
+    auto res = ack(msg, "mmp");
+    res["symbol"] = symbol;
+    res["armed"] = (config.max_quantity > 0 || config.max_fills > 0);
+    return res;
+}
+
+void OrderBookWebSocket::notifyMmpTrigger(const std::string& symbol, const std::string& user_id, const std::vector<std::string>& pulled) {
+    Json::Value msg;
+    msg["type"] = "mmp_triggered";
+    msg["symbol"] = symbol;
+    msg["pulled"] = Json::Value(Json::arrayValue);
+    for (const auto& id : pulled) msg["pulled"].append(id);
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    std::string payload = Json::writeString(wbuilder, msg);
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = sessions_by_user_.find(user_id);
+    if (it == sessions_by_user_.end()) return;
+    for (const auto& c : it->second) {
+        auto session = c->getContext<WsSession>();
+        {
+            std::lock_guard<std::mutex> session_lock(session->mutex);
+            for (const auto& id : pulled) session->live_orders.erase(id);
+        }
+        if (c->connected()) c->send(payload);
+    }
+}
+
+void OrderBookWebSocket::forgetFinishedOrder(const Order& order) {
+    if (order.status != OrderStatus::FILLED && order.status != OrderStatus::CANCELLED &&
+        order.status != OrderStatus::REJECTED) return;
+    // Keep the cancel-on-disconnect index down to orders that are still live
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = sessions_by_user_.find(order.user_id);
+    if (it == sessions_by_user_.end()) return;
+    for (const auto& c : it->second) {
+        auto session = c->getContext<WsSession>();
+        std::lock_guard<std::mutex> session_lock(session->mutex);
+        session->live_orders.erase(order.id);
+    }
+}
+
+void OrderBookWebSocket::sendExecutionReports(const std::vector<Trade>& trades) {
+    if (!engine_) return;
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    for (const auto& trade : trades) {
+        for (const auto* order_id : {&trade.buy_order_id, &trade.sell_order_id}) {
+            auto order = engine_->get_order(*order_id);
+            if (!order) continue;
+            Json::Value report;
+            report["type"] = "execution_report";
+            report["order_id"] = order->id;
+            report["symbol"] = trade.symbol;
+            report["side"] = order->side == OrderSide::BUY ? "buy" : "sell";
+            report["last_price"] = trade.price;
+            report["last_quantity"] = trade.quantity;
+            report["filled"] = order->filled_quantity;
+            report["quantity"] = order->quantity;
+            report["status"] = status_str(order->status);
+            std::string payload = Json::writeString(wbuilder, report);
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            auto it = sessions_by_user_.find(order->user_id);
+            if (it == sessions_by_user_.end()) continue;
+            for (const auto& c : it->second) {
+                if (c->connected()) c->send(payload);
+            }
+        }
+    }
 }
 
 void OrderBookWebSocket::broadcastOrderBook(const std::string& symbol) {
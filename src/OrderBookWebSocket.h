@@ -1,14 +1,37 @@
 #pragma once
 #include <drogon/WebSocketController.h>
+#include <json/json.h>
 #include "matching_engine.hpp"
 #include <set>
+#include <map>
 #include <mutex>
+#include <chrono>
+#include <unordered_set>
+#include <string>
+#include <vector>
 
-class OrderBookWebSocket : public drogon::WebSocketController<OrderBookWebSocket> 
+// Per-connection state for WebSocket order entry
+// Stored as the connection context so every message can find its session
+// without a lookup. A session can only trade once it has authenticated.
+struct WsSession {
+    std::string user_id;
+    bool authenticated = false;
+    // Cancel-on-disconnect: when set, everything in live_orders is mass-cancelled
+    // as soon as the socket closes or stops answering heartbeats
+    bool cancel_on_disconnect = false;
+    std::unordered_set<std::string> live_orders;
+    // Set once cancel-on-disconnect has pulled the orders - order entry still queued is refused
+    bool closing = false;
+    std::chrono::steady_clock::time_point last_seen = std::chrono::steady_clock::now();
+    // live_orders is also pruned by order updates that arrive on other threads
+    std::mutex mutex;
+};
+
+class OrderBookWebSocket : public drogon::WebSocketController<OrderBookWebSocket>
 {
 public:
     static constexpr bool isAutoCreation = false;
-    
+
     OrderBookWebSocket();
     OrderBookWebSocket(orderbook::MatchingEngine* engine);
     void handleNewMessage(const drogon::WebSocketConnectionPtr &wsConn,
@@ -23,8 +46,40 @@ public:
     // Broadcast helpers
     void broadcastOrderBook(const std::string& symbol);
     void broadcastTrade(const std::string& symbol, const std::string& tradeJson);
+    // Push fills to the sessions of the users on both sides of each trade
+    void sendExecutionReports(const std::vector<Trade>& trades);
+    // Tell a market maker their quotes were pulled by MMP (called from inside the engine - no engine calls here)
+    void notifyMmpTrigger(const std::string& symbol, const std::string& user_id, const std::vector<std::string>& pulled);
+    // Drop a filled, cancelled or rejected order from its owner's live_orders, whichever
+    // path finished it (engine order-update hook - no engine calls here either)
+    void forgetFinishedOrder(const Order& order);
+
+    // Heartbeats - the server pings every session and any frame (including the
+    // pong) counts as a sign of life. Call checkHeartbeats periodically; sessions
+    // with cancel-on-disconnect that went quiet get their orders pulled and closed.
+    void setHeartbeatTimeout(std::chrono::milliseconds timeout) { heartbeat_timeout_ = timeout; }
+    void checkHeartbeats();
 private:
+    // Order entry commands - each returns the reply for one request
+    // Symbols whose book changed are collected so a batch broadcasts each book once
+    Json::Value handleAuth(const drogon::WebSocketConnectionPtr &wsConn, WsSession& session, const Json::Value& msg);
+    Json::Value handlePlace(WsSession& session, const Json::Value& msg, std::set<std::string>& touched);
+    Json::Value handleCancel(WsSession& session, const Json::Value& msg, std::set<std::string>& touched);
+    Json::Value handleModify(WsSession& session, const Json::Value& msg, std::set<std::string>& touched);
+    Json::Value handleMassQuote(WsSession& session, const Json::Value& msg, std::set<std::string>& touched);
+    Json::Value handleMmp(WsSession& session, const Json::Value& msg);
+    Json::Value handleCommand(const drogon::WebSocketConnectionPtr &wsConn, WsSession& session, const Json::Value& msg, std::set<std::string>& touched);
+    // Runs one parsed message and replies - on the engine thread when it was queued on a lane
+    void runMessage(const drogon::WebSocketConnectionPtr &wsConn, const std::shared_ptr<WsSession>& session, const Json::Value& msg);
+    bool authenticate(WsSession& session, const drogon::WebSocketConnectionPtr &wsConn, const std::string& token);
+    // Pull every live order of a session in one engine operation and publish one update per book
+    // Queued on the cancel lane so it overtakes whatever new orders are waiting
+    void cancelSessionOrders(const std::shared_ptr<WsSession>& session);
+
     orderbook::MatchingEngine* engine_;
     std::set<drogon::WebSocketConnectionPtr> clients_;
+    // Authenticated connections by user, used to route execution reports
+    std::map<std::string, std::set<drogon::WebSocketConnectionPtr>> sessions_by_user_;
     std::mutex clients_mutex_;
+    std::chrono::milliseconds heartbeat_timeout_{10000};
 };
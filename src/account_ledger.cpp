@@ -0,0 +1,123 @@
+#include "account_ledger.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+namespace orderbook {
+
+void AccountLedger::apply_trade(const Trade& trade) {
+    // Trades restored from older databases don't know who traded
+    if (trade.buy_user_id.empty() && trade.sell_user_id.empty()) return;
+    std::unique_lock lock(mutex_);
+    if (!trade.buy_user_id.empty()) {
+        apply_fill(account_for(trade.buy_user_id), trade.symbol, true, trade.price, trade.quantity);
+    }
+    if (!trade.sell_user_id.empty()) {
+        apply_fill(account_for(trade.sell_user_id), trade.symbol, false, trade.price, trade.quantity);
+    }
+}
+
+Account& AccountLedger::account_for(const UserId& user_id) {
+    auto [it, inserted] = index_.try_emplace(user_id, accounts_.size());
+    if (inserted) {
+        accounts_.emplace_back();
+        accounts_.back().user_id = user_id;
+        is_dirty_.push_back(false);
+    }
+    size_t slot = it->second;
+    if (!is_dirty_[slot]) {
+        is_dirty_[slot] = true;
+        dirty_.push_back(slot);
+    }
+    return accounts_[slot];
+}
+
+void AccountLedger::apply_fill(Account& account, const std::string& symbol, bool is_buy, Price price, Quantity quantity) {
+    int64_t notional = static_cast<int64_t>(price) * static_cast<int64_t>(quantity);
+    account.cash += is_buy ? -notional : notional;
+    account.volume += quantity;
+    account.trade_count++;
+
+    Position* position = nullptr;
+    for (auto& p : account.positions) {
+        if (p.symbol == symbol) { position = &p; break; }
+    }
+    if (!position) {
+        account.positions.push_back(Position{symbol});
+        position = &account.positions.back();
+    }
+
+    int64_t signed_qty = is_buy ? static_cast<int64_t>(quantity) : -static_cast<int64_t>(quantity);
+    int64_t remaining = static_cast<int64_t>(quantity);
+    // Reducing (or flipping) an open position realizes PnL against the average cost
+    if (position->quantity != 0 && (position->quantity > 0) != is_buy) {
+        int64_t open = std::llabs(position->quantity);
+        int64_t closing = std::min(open, remaining);
+        int64_t direction = position->quantity > 0 ? 1 : -1;
+        auto cost_removed = static_cast<int64_t>(static_cast<__int128>(position->cost_basis) * closing / open);
+        position->realized_pnl += direction * closing * static_cast<int64_t>(price) - cost_removed;
+        position->cost_basis -= cost_removed;
+        position->quantity -= direction * closing;
+        remaining -= closing;
+        if (position->quantity == 0) position->cost_basis = 0;
+    }
+    // Whatever is left opens or adds to a position in the trade's direction
+    if (remaining > 0) {
+        int64_t direction = signed_qty > 0 ? 1 : -1;
+        position->quantity += direction * remaining;
+        position->cost_basis += direction * remaining * static_cast<int64_t>(price);
+    }
+}
+
+std::optional<Account> AccountLedger::get_account(const UserId& user_id) const {
+    std::shared_lock lock(mutex_);
+    auto it = index_.find(user_id);
+    if (it == index_.end()) return std::nullopt;
+    return accounts_[it->second];
+}
+
+std::vector<Account> AccountLedger::take_dirty() {
+    std::unique_lock lock(mutex_);
+    std::vector<Account> result;
+    result.reserve(dirty_.size());
+    for (size_t slot : dirty_) {
+        result.push_back(accounts_[slot]);
+        is_dirty_[slot] = false;
+    }
+    dirty_.clear();
+    return result;
+}
+
+void AccountLedger::mark_dirty(const UserId& user_id) {
+    std::unique_lock lock(mutex_);
+    auto it = index_.find(user_id);
+    if (it == index_.end() || is_dirty_[it->second]) return;
+    is_dirty_[it->second] = true;
+    dirty_.push_back(it->second);
+}
+
+void AccountLedger::load_account(const Account& account) {
+    std::unique_lock lock(mutex_);
+    auto [it, inserted] = index_.try_emplace(account.user_id, accounts_.size());
+    if (inserted) {
+        accounts_.push_back(account);
+        is_dirty_.push_back(false);
+    } else {
+        accounts_[it->second] = account;
+    }
+}
+
+size_t AccountLedger::size() const {
+    std::shared_lock lock(mutex_);
+    return accounts_.size();
+}
+
+void AccountLedger::clear() {
+    std::unique_lock lock(mutex_);
+    accounts_.clear();
+    index_.clear();
+    dirty_.clear();
+    is_dirty_.clear();
+}
+
+} // namespace orderbook
@@ -0,0 +1,80 @@
+#ifndef ORDERBOOK_ACCOUNT_LEDGER_HPP
+#define ORDERBOOK_ACCOUNT_LEDGER_HPP
+
+#include "order.hpp"
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace orderbook {
+
+// A user's holding in one symbol
+// quantity is signed (long > 0, short < 0) and cost_basis carries the same sign,
+// so the average entry price is always cost_basis / quantity.
+struct Position {
+    std::string symbol;
+    int64_t quantity = 0;
+    int64_t cost_basis = 0;     // What the open quantity cost, in quote currency
+    int64_t realized_pnl = 0;   // Locked in by reducing or flipping the position
+};
+
+// Everything the ledger knows about one user
+// Positions live in a small flat vector - users trade a handful of symbols,
+// and a linear scan over a few adjacent records beats hashing.
+struct Account {
+    UserId user_id;
+    int64_t cash = 0;           // Net quote currency from trading (sells add, buys subtract)
+    uint64_t volume = 0;        // Total quantity traded
+    uint64_t trade_count = 0;
+    std::vector<Position> positions;
+
+    const Position* find_position(const std::string& symbol) const {
+        for (const auto& p : positions) if (p.symbol == symbol) return &p;
+        return nullptr;
+    }
+};
+
+/**
+ * In-memory account ledger
+ *
+ * Consumes the trade stream and keeps balances, positions and realized PnL
+ * per user up to date, so nobody has to rebuild them from trade history.
+ * Accounts sit in one contiguous vector with a user -> slot index, which
+ * makes both updates and lookups O(1). Accounts touched since the last
+ * flush are tracked so they can be written to the database in batches.
+ */
+class AccountLedger {
+public:
+    // Apply both sides of a trade (average-cost accounting)
+    void apply_trade(const Trade& trade);
+
+    // Copy of the account, or nothing if the user never traded
+    std::optional<Account> get_account(const UserId& user_id) const;
+
+    // Accounts changed since the last call - hand these to the persistence batch
+    std::vector<Account> take_dirty();
+    // Queue an account for the next flush again (e.g. after a failed write)
+    void mark_dirty(const UserId& user_id);
+
+    // Restore an account loaded from storage (replaces any existing record)
+    void load_account(const Account& account);
+
+    size_t size() const;
+    void clear();
+
+private:
+    Account& account_for(const UserId& user_id);
+    static void apply_fill(Account& account, const std::string& symbol, bool is_buy, Price price, Quantity quantity);
+
+    mutable std::shared_mutex mutex_;
+    std::vector<Account> accounts_;
+    std::unordered_map<UserId, size_t> index_;
+    std::vector<size_t> dirty_;
+    std::vector<bool> is_dirty_;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_ACCOUNT_LEDGER_HPP
@@ -0,0 +1,117 @@
+#include "admission.hpp"
+#include <algorithm>
+
+namespace orderbook {
+
+AdmissionController::Ticket::Ticket(Ticket&& other) noexcept
+    : owner_(other.owner_), verdict_(other.verdict_) {
+    other.owner_ = nullptr;
+}
+
+AdmissionController::Ticket& AdmissionController::Ticket::operator=(Ticket&& other) noexcept {
+    if (this != &other) {
+        if (owner_) owner_->release();
+        owner_ = other.owner_;
+        verdict_ = other.verdict_;
+        other.owner_ = nullptr;
+    }
+    return *this;
+}
+
+AdmissionController::Ticket::~Ticket() {
+    if (owner_) owner_->release();
+}
+
+AdmissionController::AdmissionController(Options options, const MatchingEngine* engine)
+    : options_(options), engine_(engine), window_start_(std::chrono::steady_clock::now()) {}
+
+AdmissionController::Ticket AdmissionController::admit(std::string_view client, std::chrono::microseconds request_age) {
+    uint64_t in_flight = in_flight_.load(std::memory_order_relaxed);
+    if (backlog_) in_flight += backlog_();
+    uint64_t lock_wait_us = 0;
+    bool engine_queued = in_flight > 0;
+    if (engine_) {
+        auto ls = engine_->lock_stats();
+        lock_wait_us = ls.wait_ewma_ns / 1000;
+        engine_queued = engine_queued || ls.waiters > 0;
+    }
+    // The wait average only moves when someone takes the lock, so it only counts
+    // while there's a queue - otherwise shedding everyone would keep it high forever
+    if (!engine_queued) lock_wait_us = 0;
+
+    auto max_wait = static_cast<uint64_t>(options_.max_lock_wait.count());
+    auto max_age = options_.max_request_age.count();
+    Verdict verdict = Verdict::Admit;
+    if (in_flight >= options_.max_in_flight) {
+        verdict = Verdict::Depth;
+    } else if (lock_wait_us >= max_wait) {
+        verdict = Verdict::LockWait;
+    } else if (request_age.count() >= max_age) {
+        verdict = Verdict::Age;
+    } else {
+        bool congested = in_flight * 2 >= options_.max_in_flight || lock_wait_us * 2 >= max_wait ||
+                         request_age.count() * 2 >= max_age;
+        if (fair_share_exceeded(client, congested)) verdict = Verdict::Fairness;
+    }
+
+    switch (verdict) {
+        case Verdict::Admit:
+            in_flight_.fetch_add(1, std::memory_order_relaxed);
+            admitted_.fetch_add(1, std::memory_order_relaxed);
+            return Ticket(this, verdict);
+        case Verdict::Depth: shed_depth_.fetch_add(1, std::memory_order_relaxed); break;
+        case Verdict::LockWait: shed_lock_wait_.fetch_add(1, std::memory_order_relaxed); break;
+        case Verdict::Age: shed_age_.fetch_add(1, std::memory_order_relaxed); break;
+        case Verdict::Fairness: shed_fairness_.fetch_add(1, std::memory_order_relaxed); break;
+    }
+    return Ticket(nullptr, verdict);
+}
+
+bool AdmissionController::fair_share_exceeded(std::string_view client, bool congested) {
+    std::lock_guard<std::mutex> lock(window_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (now - window_start_ >= options_.fairness_window) {
+        window_start_ = now;
+        window_counts_.clear();
+        window_total_ = 0;
+    }
+    auto it = window_counts_.find(client);
+    uint32_t mine = it == window_counts_.end() ? 0 : it->second;
+    if (congested) {
+        // Half again the average per active client, and never below the floor
+        size_t active = std::max<size_t>(1, window_counts_.size() + (mine == 0 ? 1 : 0));
+        uint64_t share = std::max<uint64_t>(options_.min_client_share, 3 * window_total_ / (2 * active));
+        if (mine >= share) return true;
+    }
+    if (it == window_counts_.end()) {
+        window_counts_.emplace(std::string(client), 1);
+    } else {
+        ++it->second;
+    }
+    ++window_total_;
+    return false;
+}
+
+AdmissionController::Stats AdmissionController::stats() const {
+    Stats s;
+    s.admitted = admitted_.load(std::memory_order_relaxed);
+    s.shed_depth = shed_depth_.load(std::memory_order_relaxed);
+    s.shed_lock_wait = shed_lock_wait_.load(std::memory_order_relaxed);
+    s.shed_age = shed_age_.load(std::memory_order_relaxed);
+    s.shed_fairness = shed_fairness_.load(std::memory_order_relaxed);
+    s.in_flight = in_flight_.load(std::memory_order_relaxed);
+    return s;
+}
+
+const char* AdmissionController::reason(Verdict verdict) {
+    switch (verdict) {
+        case Verdict::Admit: return "admitted";
+        case Verdict::Depth: return "depth";
+        case Verdict::LockWait: return "lock_wait";
+        case Verdict::Age: return "age";
+        case Verdict::Fairness: return "fairness";
+    }
+    return "unknown";
+}
+
+} // namespace orderbook
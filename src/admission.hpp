@@ -0,0 +1,116 @@
+#ifndef ORDERBOOK_ADMISSION_HPP
+#define ORDERBOOK_ADMISSION_HPP
+
+#include "matching_engine.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace orderbook {
+
+/**
+ * Admission control for order entry
+ *
+ * Decides, before the request body is even parsed, whether the engine will get
+ * to a request soon enough to be worth taking. Any one of three signals sheds:
+ *  - depth: requests admitted and not answered yet, plus whatever is queued on
+ *    the command lanes (see set_backlog). An HTTP request waiting on a lane shows
+ *    up in both, so depth errs towards shedding a little early.
+ *  - lock wait: the engine's recent average write-lock wait, while anyone is queued
+ *  - age: how long the request sat in the server before it reached us
+ * A shed request gets a 503 with Retry-After right away, rather than an ack
+ * that arrives too late to be useful.
+ *
+ * Fairness: once the engine is congested (any signal past half its limit),
+ * each client is held to a fair share of the admissions in the current
+ * window, so one flooding client is shed before everybody else is.
+ */
+class AdmissionController {
+public:
+    struct Options {
+        uint32_t max_in_flight = 64;
+        std::chrono::microseconds max_lock_wait{2000};
+        std::chrono::microseconds max_request_age{50000};
+        std::chrono::milliseconds fairness_window{100};
+        uint32_t min_client_share = 8;      // Admissions per window any client gets regardless
+        uint32_t retry_after_seconds = 1;
+    };
+
+    enum class Verdict { Admit, Depth, LockWait, Age, Fairness };
+
+    // Holds an in-flight slot until the request is done
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&& other) noexcept;
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        ~Ticket();
+
+        bool admitted() const { return verdict_ == Verdict::Admit; }
+        Verdict verdict() const { return verdict_; }
+
+    private:
+        friend class AdmissionController;
+        Ticket(AdmissionController* owner, Verdict verdict) : owner_(owner), verdict_(verdict) {}
+        AdmissionController* owner_ = nullptr;
+        Verdict verdict_ = Verdict::Depth;
+    };
+
+    struct Stats {
+        uint64_t admitted = 0;
+        uint64_t shed_depth = 0;
+        uint64_t shed_lock_wait = 0;
+        uint64_t shed_age = 0;
+        uint64_t shed_fairness = 0;
+        uint64_t in_flight = 0;
+    };
+
+    explicit AdmissionController(Options options, const MatchingEngine* engine = nullptr);
+
+    // client is whatever identifies the caller before parsing (the peer address)
+    Ticket admit(std::string_view client, std::chrono::microseconds request_age = std::chrono::microseconds{0});
+
+    // Work handed off past the filter but not run yet (the dispatcher's lanes);
+    // set before serving starts. It counts against max_in_flight like in-flight requests
+    void set_backlog(std::function<uint64_t()> backlog) { backlog_ = std::move(backlog); }
+
+    Stats stats() const;
+    const Options& options() const { return options_; }
+    static const char* reason(Verdict verdict);
+
+private:
+    bool fair_share_exceeded(std::string_view client, bool congested);
+    void release() { in_flight_.fetch_sub(1, std::memory_order_relaxed); }
+
+    Options options_;
+    const MatchingEngine* engine_;
+    std::function<uint64_t()> backlog_;
+    std::atomic<uint64_t> in_flight_{0};
+
+    std::mutex window_mutex_;
+    std::chrono::steady_clock::time_point window_start_;
+    // Transparent lookup so checking a client doesn't build a string
+    struct ClientHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    std::unordered_map<std::string, uint32_t, ClientHash, std::equal_to<>> window_counts_;
+    uint64_t window_total_ = 0;
+
+    std::atomic<uint64_t> admitted_{0};
+    std::atomic<uint64_t> shed_depth_{0};
+    std::atomic<uint64_t> shed_lock_wait_{0};
+    std::atomic<uint64_t> shed_age_{0};
+    std::atomic<uint64_t> shed_fairness_{0};
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_ADMISSION_HPP
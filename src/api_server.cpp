@@ -4,15 +4,29 @@
 #include <json/json.h>
 #include "matching_engine.hpp"
 #include "order.hpp"
-#include "utils.hpp"
+#include "security.hpp"
 #include "OrderBookController.h"
 #include "OrderBookWebSocket.h"
+#include "AdmissionFilter.h"
+#include "account_ledger.hpp"
+#include "db_schema.hpp"
+#include "pg_pipeline.hpp"
+#include "pg_copy.hpp"
+#include "storage.hpp"
+#include "trade_archive.hpp"
+#include "journal.hpp"
+#include "command_dispatcher.hpp"
+#include "warmup.hpp"
+#include "compression.hpp"
+#include "tls.hpp"
+#include <libpq-fe.h>
 #include <memory>
 #include <iostream>
-#include <fstream>
 #include <chrono>
 #include <atomic>
 #include <thread>
+#include <future>
+#include <sstream>
 #include <drogon/utils/Utilities.h>
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
@@ -42,6 +56,240 @@ const std::string get_log_file() {
     return "orderbook.log"; // Default log file
 }
 
+// How long a WebSocket session with cancel-on-disconnect may stay silent
+// before its orders are pulled. Market makers usually want this tight.
+std::chrono::milliseconds get_ws_heartbeat_timeout() {
+    const char* env_timeout = std::getenv("ORDERBOOK_WS_HEARTBEAT_TIMEOUT_MS");
+    if (env_timeout) {
+        return std::chrono::milliseconds(std::max(100L, std::atol(env_timeout)));
+    }
+    return std::chrono::milliseconds(10000);
+}
+
+// Postgres array literals for the batched ledger upsert
+// One statement with unnest() writes a whole batch instead of one round trip per account
+static std::string pg_text_array(const std::vector<std::string>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i) out += ',';
+        out += '"';
+        for (char c : values[i]) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        out += '"';
+    }
+    out += '}';
+    return out;
+}
+
+template <typename T>
+static std::string pg_int_array(const std::vector<T>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i) out += ',';
+        out += std::to_string(values[i]);
+    }
+    out += '}';
+    return out;
+}
+
+// Write every account the ledger touched since the last flush
+void flush_ledger(AccountLedger& ledger, const drogon::orm::DbClientPtr& dbClient) {
+    auto dirty = ledger.take_dirty();
+    if (dirty.empty()) return;
+    std::vector<std::string> users, pos_users, pos_symbols;
+    std::vector<int64_t> cash, pos_qty, pos_cost, pos_pnl;
+    std::vector<uint64_t> volume, trade_count;
+    for (const auto& account : dirty) {
+        users.push_back(account.user_id);
+        cash.push_back(account.cash);
+        volume.push_back(account.volume);
+        trade_count.push_back(account.trade_count);
+        for (const auto& p : account.positions) {
+            pos_users.push_back(account.user_id);
+            pos_symbols.push_back(p.symbol);
+            pos_qty.push_back(p.quantity);
+            pos_cost.push_back(p.cost_basis);
+            pos_pnl.push_back(p.realized_pnl);
+        }
+    }
+    // Accounts and positions go in one transaction, so a failure halfway can't leave
+    // balances from this flush next to positions from the last one
+    auto requeue = [&ledger, users](const char* what) {
+        // Mark the batch dirty again so the next flush retries it with the latest state
+        std::cerr << "[DB ERROR] Ledger flush failed: " << what << std::endl;
+        for (const auto& user : users) ledger.mark_dirty(user);
+    };
+    try {
+        // Commits when the last reference goes, at the end of this block
+        auto trans = dbClient->newTransaction([requeue](bool committed) {
+            if (!committed) requeue("commit failed");
+        });
+        try {
+            trans->execSqlSync(
+                "INSERT INTO accounts (user_id, cash, volume, trade_count) "
+                "SELECT * FROM unnest($1::text[], $2::bigint[], $3::bigint[], $4::bigint[]) "
+                "ON CONFLICT (user_id) DO UPDATE SET cash = EXCLUDED.cash, volume = EXCLUDED.volume, trade_count = EXCLUDED.trade_count;",
+                pg_text_array(users), pg_int_array(cash), pg_int_array(volume), pg_int_array(trade_count));
+            if (!pos_users.empty()) {
+                trans->execSqlSync(
+                    "INSERT INTO positions (user_id, symbol, quantity, cost_basis, realized_pnl) "
+                    "SELECT * FROM unnest($1::text[], $2::text[], $3::bigint[], $4::bigint[], $5::bigint[]) "
+                    "ON CONFLICT (user_id, symbol) DO UPDATE SET quantity = EXCLUDED.quantity, "
+                    "cost_basis = EXCLUDED.cost_basis, realized_pnl = EXCLUDED.realized_pnl;",
+                    pg_text_array(pos_users), pg_text_array(pos_symbols),
+                    pg_int_array(pos_qty), pg_int_array(pos_cost), pg_int_array(pos_pnl));
+            }
+        } catch (...) {
+            trans->rollback();
+            throw;
+        }
+    } catch (const std::exception& e) {
+        requeue(e.what());
+    }
+}
+
+// Postgres connection string - set ORDERBOOK_DB_CONNINFO outside development
+const std::string get_db_conninfo() {
+    const char* env_conninfo = std::getenv("ORDERBOOK_DB_CONNINFO");
+    if (env_conninfo) {
+        return std::string(env_conninfo);
+    }
+    return "host=127.0.0.1 port=5432 dbname=orderbookdb user=rahulorderbook password=SRK2905boss?!"; // Development default
+}
+
+// Connections for the pipelined order/trade writer
+size_t get_db_writer_connections() {
+    const char* env_conns = std::getenv("ORDERBOOK_DB_WRITER_CONNECTIONS");
+    if (env_conns) {
+        return static_cast<size_t>(std::max(1L, std::atol(env_conns)));
+    }
+    return 4;
+}
+
+// Where orders, actions and trades are written:
+//   postgres - straight to the database (default)
+//   file     - local append-only journal, replicated to Postgres in the background
+//   null     - nowhere (benchmarks, throwaway environments)
+const std::string get_storage_backend() {
+    const char* env_backend = std::getenv("ORDERBOOK_STORAGE");
+    if (env_backend) {
+        return std::string(env_backend);
+    }
+    return "postgres";
+}
+
+// Group commit for the file journal: hold order entry replies until their batch is fdatasync'ed.
+// A batch goes out when it has max_batch records or its oldest record has waited max_wait_us.
+bool get_durable_acks() {
+    const char* env = std::getenv("ORDERBOOK_DURABLE_ACKS");
+    return env && std::string(env) != "0";
+}
+
+size_t get_group_commit_max_batch() {
+    const char* env = std::getenv("ORDERBOOK_GROUP_COMMIT_MAX_BATCH");
+    return env ? static_cast<size_t>(std::max(1L, std::atol(env))) : 256;
+}
+
+std::chrono::microseconds get_group_commit_max_wait() {
+    const char* env = std::getenv("ORDERBOOK_GROUP_COMMIT_MAX_WAIT_US");
+    return std::chrono::microseconds(env ? std::max(1L, std::atol(env)) : 2000);
+}
+
+// Admission control for order entry - see AdmissionController. ORDERBOOK_ADMISSION=0 turns it off.
+bool get_admission_enabled() {
+    const char* env = std::getenv("ORDERBOOK_ADMISSION");
+    return !env || std::string(env) != "0";
+}
+
+AdmissionController::Options get_admission_options() {
+    AdmissionController::Options options;
+    if (const char* env = std::getenv("ORDERBOOK_ADMISSION_MAX_IN_FLIGHT")) {
+        options.max_in_flight = static_cast<uint32_t>(std::max(1L, std::atol(env)));
+    }
+    if (const char* env = std::getenv("ORDERBOOK_ADMISSION_MAX_LOCK_WAIT_US")) {
+        options.max_lock_wait = std::chrono::microseconds(std::max(1L, std::atol(env)));
+    }
+    if (const char* env = std::getenv("ORDERBOOK_ADMISSION_MAX_AGE_MS")) {
+        options.max_request_age = std::chrono::milliseconds(std::max(1L, std::atol(env)));
+    }
+    return options;
+}
+
+// Priority lanes in front of the engine - see CommandDispatcher. ORDERBOOK_COMMAND_LANES=0 runs
+// order entry straight on the IO threads again
+bool get_command_lanes_enabled() {
+    const char* env = std::getenv("ORDERBOOK_COMMAND_LANES");
+    return !env || std::string(env) != "0";
+}
+
+CommandDispatcher::Options get_command_lane_options() {
+    CommandDispatcher::Options options;
+    const char* capacity_env[] = {"ORDERBOOK_LANE_CAPACITY_CANCEL", "ORDERBOOK_LANE_CAPACITY_MODIFY", "ORDERBOOK_LANE_CAPACITY_NEW"};
+    for (size_t i = 0; i < CommandDispatcher::LANE_COUNT; ++i) {
+        if (const char* env = std::getenv(capacity_env[i])) options.capacity[i] = static_cast<size_t>(std::max(1L, std::atol(env)));
+    }
+    if (const char* env = std::getenv("ORDERBOOK_LANE_MAX_BURST")) {
+        options.max_burst = static_cast<uint32_t>(std::max(1L, std::atol(env)));
+    }
+    return options;
+}
+
+// Compression for depth and the history listings - see negotiate_encoding().
+// ORDERBOOK_COMPRESSION=0 sends everything as is
+CompressionOptions get_compression_options() {
+    CompressionOptions options;
+    if (const char* env = std::getenv("ORDERBOOK_COMPRESSION")) options.enabled = std::string(env) != "0";
+    if (const char* env = std::getenv("ORDERBOOK_COMPRESSION_MIN_BYTES")) {
+        options.min_bytes = static_cast<size_t>(std::max(0L, std::atol(env)));
+    }
+    return options;
+}
+
+// HTTPS/WSS listener - see TlsOptions. Opens when the cert and key exist; ORDERBOOK_TLS=0 keeps it closed.
+// ORDERBOOK_KTLS=1 asks OpenSSL to offload record encryption to the kernel
+TlsOptions get_tls_options() {
+    TlsOptions options;
+    if (const char* env = std::getenv("ORDERBOOK_TLS")) options.enabled = std::string(env) != "0";
+    if (const char* env = std::getenv("ORDERBOOK_TLS_PORT")) options.port = static_cast<uint16_t>(std::atoi(env));
+    if (const char* env = std::getenv("ORDERBOOK_TLS_CERT")) options.cert_file = env;
+    if (const char* env = std::getenv("ORDERBOOK_TLS_KEY")) options.key_file = env;
+    if (const char* env = std::getenv("ORDERBOOK_KTLS")) options.ktls = std::string(env) == "1";
+    return options;
+}
+
+// Start-up warm-up - see warm_up(). ORDERBOOK_WARMUP=0 skips it
+bool get_warmup_enabled() {
+    const char* env = std::getenv("ORDERBOOK_WARMUP");
+    return !env || std::string(env) != "0";
+}
+
+WarmupOptions get_warmup_options() {
+    WarmupOptions options;
+    // Comma-separated, e.g. ORDERBOOK_WARMUP_SYMBOLS=BTC-USD,ETH-USD,SOL-USD
+    if (const char* env = std::getenv("ORDERBOOK_WARMUP_SYMBOLS")) {
+        options.symbols.clear();
+        std::stringstream list(env);
+        std::string symbol;
+        while (std::getline(list, symbol, ',')) {
+            if (!symbol.empty()) options.symbols.push_back(symbol);
+        }
+    }
+    if (const char* env = std::getenv("ORDERBOOK_WARMUP_ROUNDS")) {
+        options.rounds = static_cast<size_t>(std::max(0L, std::atol(env)));
+    }
+    return options;
+}
+
+const std::string get_storage_path() {
+    const char* env_path = std::getenv("ORDERBOOK_STORAGE_PATH");
+    if (env_path) {
+        return std::string(env_path);
+    }
+    return "orderbook.journal";
+}
+
 // Global metrics that track system performance
 // These get updated in real-time as orders and trades happen
 std::atomic<size_t> g_order_count{0};
@@ -53,16 +301,6 @@ std::atomic<double> g_last_order_latency_ms{0.0};
 std::unordered_map<std::string, std::chrono::steady_clock::time_point> rate_limit_map;
 std::mutex rate_limit_mutex;
 
-// Clean user input to prevent injection attacks
-// Only allows safe characters (alphanumeric, underscore, hyphen)
-std::string sanitize(const std::string& s) {
-    std::string out;
-    for (char c : s) {
-        if (isalnum(c) || c == '_' || c == '-') out += c;
-    }
-    return out;
-}
-
 // Rate limiting filter to prevent API abuse
 // Limits each IP to 10 requests per second
 class RateLimitFilter : public drogon::HttpFilter<RateLimitFilter> {
@@ -92,14 +330,35 @@ public:
 };
 
 // Write JSON entries to the log file
-// Useful for debugging and audit trails
+// Useful for debugging and audit trails - one compact line per entry. The journal
+// only copies the line here; its own thread does the writing and syncing.
+SegmentJournal* audit_journal = nullptr;
+
 void append_log(const Json::Value& entry) {
-    std::ofstream ofs(get_log_file(), std::ios::app);
-    Json::StreamWriterBuilder wbuilder;
-    wbuilder["indentation"] = "  ";
-    std::unique_ptr<Json::StreamWriter> writer(wbuilder.newStreamWriter());
-    writer->write(entry, &ofs);
-    ofs << std::endl;
+    if (!audit_journal) return;
+    static thread_local Json::StreamWriterBuilder wbuilder = [] {
+        Json::StreamWriterBuilder b;
+        b["indentation"] = "";
+        return b;
+    }();
+    std::string line = Json::writeString(wbuilder, entry);
+    line += '\n';
+    audit_journal->append(line);
+}
+
+// Audit log of trades and MMP trips, off unless ORDERBOOK_AUDIT_LOG=1
+// Segments are "<ORDERBOOK_LOG_FILE>.000001" and so on
+bool get_audit_log_enabled() {
+    const char* env = std::getenv("ORDERBOOK_AUDIT_LOG");
+    return env && std::string(env) != "0";
+}
+
+SegmentJournal::Options get_audit_journal_options() {
+    SegmentJournal::Options options;
+    options.path = get_log_file();
+    if (const char* mb = std::getenv("ORDERBOOK_AUDIT_SEGMENT_MB")) options.segment_bytes = std::max(1L, std::atol(mb)) * (1ull << 20);
+    if (const char* direct = std::getenv("ORDERBOOK_AUDIT_DIRECT")) options.direct = std::string(direct) != "0";
+    return options;
 }
 
 // JWT authentication filter
@@ -139,6 +398,165 @@ public:
     }
 };
 
+// Stream open orders and trade history out of Postgres into the engine
+// Orders are stored with their current status and fill (and their stop price, TIF,
+// expiry, quote flag and arrival time), so restoring the open ones oldest first
+// rebuilds the books without replaying actions.
+void restore_engine_state(const std::string& conninfo, MatchingEngine& engine) {
+    PGconn* conn = PQconnectdb(conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::cerr << "[DB] Restore failed: " << PQerrorMessage(conn) << " — continuing with fresh state" << std::endl;
+        PQfinish(conn);
+        return;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        // Columns come out as text in UpsertOrder field order, so the journal's decoding applies as is
+        PgCopyReader orders(conn, "COPY (SELECT id, symbol, side, type, price::text, quantity::text, user_id, status, filled::text, "
+                                  "stop_price::text, tif, expiry::text, CASE WHEN is_quote THEN '1' ELSE '0' END, "
+                                  "(EXTRACT(EPOCH FROM date_trunc('second', ts))::bigint * 1000000 + EXTRACT(MICROSECONDS FROM ts)::bigint % 1000000)::text "
+                                  "FROM orders WHERE status IN ('open', 'partial') ORDER BY ts, id) TO STDOUT (FORMAT binary)");
+        StorageRecord record{RecordType::UpsertOrder, {}};
+        while (orders.next()) {
+            const auto& row = orders.row();
+            for (size_t i = 0; i < record.values.size(); ++i) record.values[i] = row.text(i);
+            engine.add_order(record.to_order());
+        }
+        if (!orders.ok()) std::cerr << "[DB] Order restore failed: " << orders.error() << std::endl;
+        std::cout << "[DB] Restored " << orders.rows() << " open orders" << std::endl;
+    }
+    {
+        PgCopyReader trades(conn, "COPY (SELECT symbol, buy_order_id, sell_order_id, buy_user_id, sell_user_id, price, quantity, "
+                                  "(EXTRACT(EPOCH FROM date_trunc('second', ts))::bigint * 1000000 + EXTRACT(MICROSECONDS FROM ts)::bigint % 1000000) "
+                                  "FROM trades ORDER BY ts, id) TO STDOUT (FORMAT binary)");
+        while (trades.next()) {
+            const auto& row = trades.row();
+            Trade trade;
+            trade.symbol = row.text(0);
+            trade.buy_order_id = row.text(1);
+            trade.sell_order_id = row.text(2);
+            trade.buy_user_id = row.text(3);
+            trade.sell_user_id = row.text(4);
+            trade.price = static_cast<Price>(row.int64(5));
+            trade.quantity = static_cast<Quantity>(row.int64(6));
+            trade.timestamp = std::chrono::high_resolution_clock::time_point(
+                std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::microseconds(row.int64(7))));
+            engine.restore_trade(trade);
+        }
+        if (!trades.ok()) std::cerr << "[DB] Trade restore failed: " << trades.error() << std::endl;
+        std::cout << "[DB] Restored " << trades.rows() << " trades" << std::endl;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[DB] Database state restored in " << ms << " ms" << std::endl;
+    PQfinish(conn);
+}
+
+// Same as restore_engine_state, but from the local journal when it's the primary store
+void restore_from_journal(const std::string& path, MatchingEngine& engine) {
+    auto t0 = std::chrono::steady_clock::now();
+    size_t trades = 0;
+    size_t restored = FileStorage::restore(path,
+        [&](std::shared_ptr<Order> order) { engine.add_order(order); },
+        [&](const Trade& trade) { engine.restore_trade(trade); trades++; });
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "[STORAGE] Restored " << restored << " open orders and " << trades << " trades from "
+              << path << " in " << ms << " ms" << std::endl;
+}
+
+// Move trades older than the retention window into an archive database
+// The rows are piped COPY-to-COPY without decoding, and only deleted from the
+// live table once the archive has committed them.
+void archive_old_trades(const std::string& conninfo, const std::string& archive_conninfo, int retention_days) {
+    PGconn* live = PQconnectdb(conninfo.c_str());
+    PGconn* archive = PQconnectdb(archive_conninfo.c_str());
+    auto run = [](PGconn* conn, const std::string& sql) {
+        PGresult* res = PQexec(conn, sql.c_str());
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) std::cerr << "[DB ERROR] Archive: " << PQresultErrorMessage(res);
+        PQclear(res);
+        return ok;
+    };
+    // Trades are keyed by their live id in the archive. If the delete below fails after the archive
+    // has committed, the next run copies the same rows again and the insert skips them.
+    if (PQstatus(live) == CONNECTION_OK && PQstatus(archive) == CONNECTION_OK &&
+        run(archive, "CREATE TABLE IF NOT EXISTS trades_archive (symbol TEXT NOT NULL, buy_order_id TEXT, sell_order_id TEXT, "
+                     "buy_user_id TEXT, sell_user_id TEXT, price BIGINT NOT NULL, quantity BIGINT NOT NULL, ts TIMESTAMPTZ NOT NULL);") &&
+        run(archive, "ALTER TABLE trades_archive ADD COLUMN IF NOT EXISTS id BIGINT;") &&
+        run(archive, "CREATE UNIQUE INDEX IF NOT EXISTS trades_archive_id_idx ON trades_archive (id);") &&
+        run(live, "BEGIN ISOLATION LEVEL REPEATABLE READ;")) {
+        std::string cutoff = "date_trunc('day', NOW()) - INTERVAL '" + std::to_string(retention_days) + " days'";
+        const std::string columns = "id, symbol, buy_order_id, sell_order_id, buy_user_id, sell_user_id, price, quantity, ts";
+        std::string error;
+        int64_t moved = -1;
+        // Land the rows in a staging table, then move the ones the archive doesn't have yet
+        if (run(archive, "BEGIN;") &&
+            run(archive, "CREATE TEMP TABLE trades_archive_load (LIKE trades_archive) ON COMMIT DROP;")) {
+            moved = pg_copy_between(
+                live, "COPY (SELECT " + columns + " FROM trades WHERE ts < " + cutoff + ") TO STDOUT (FORMAT binary)",
+                archive, "COPY trades_archive_load (" + columns + ") FROM STDIN (FORMAT binary)",
+                error);
+            if (moved < 0 ||
+                !run(archive, "INSERT INTO trades_archive (" + columns + ") SELECT " + columns +
+                              " FROM trades_archive_load ON CONFLICT (id) DO NOTHING;") ||
+                !run(archive, "COMMIT;")) {
+                if (moved >= 0) error = "archive insert failed";
+                moved = -1;
+                run(archive, "ROLLBACK;");
+            }
+        }
+        if (moved < 0) {
+            std::cerr << "[DB ERROR] Archive copy failed: " << error << std::endl;
+            run(live, "ROLLBACK;");
+        } else if (run(live, "DELETE FROM trades WHERE ts < " + cutoff + ";") && run(live, "COMMIT;")) {
+            if (moved > 0) std::cout << "[DB] Archived " << moved << " trades" << std::endl;
+        } else {
+            run(live, "ROLLBACK;");
+        }
+    } else {
+        std::cerr << "[DB ERROR] Archive connection failed: " << PQerrorMessage(PQstatus(live) != CONNECTION_OK ? live : archive);
+    }
+    PQfinish(archive);
+    PQfinish(live);
+}
+
+// Write one UTC day of trades from Postgres into the columnar archive, one segment per symbol
+void export_trade_segments(const std::string& conninfo, TradeArchive& archive, int64_t day) {
+    PGconn* conn = PQconnectdb(conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::cerr << "[ARCHIVE] Export failed: " << PQerrorMessage(conn);
+        PQfinish(conn);
+        return;
+    }
+    std::string from = std::to_string(day * 86400), to = std::to_string((day + 1) * 86400);
+    PgCopyReader rows(conn, "COPY (SELECT symbol, (EXTRACT(EPOCH FROM date_trunc('second', ts))::bigint * 1000000 + "
+                            "EXTRACT(MICROSECONDS FROM ts)::bigint % 1000000), price, quantity FROM trades "
+                            "WHERE ts >= to_timestamp(" + from + ") AND ts < to_timestamp(" + to + ") "
+                            "ORDER BY symbol, ts, id) TO STDOUT (FORMAT binary)");
+    std::string symbol;
+    std::vector<ArchivedTrade> trades;
+    size_t segments = 0;
+    auto write_out = [&] {
+        if (trades.empty()) return;
+        if (archive.write_segment(symbol, std::move(trades))) segments++;
+        trades.clear();
+    };
+    while (rows.next()) {
+        const auto& row = rows.row();
+        if (row.text(0) != symbol) {
+            write_out();
+            symbol = row.text(0);
+        }
+        trades.push_back(ArchivedTrade{row.int64(1), static_cast<Price>(row.int64(2)), static_cast<Quantity>(row.int64(3))});
+    }
+    if (rows.ok()) {
+        write_out();
+        std::cout << "[ARCHIVE] Exported " << rows.rows() << " trades into " << segments << " segments" << std::endl;
+    } else {
+        std::cerr << "[ARCHIVE] Export failed: " << rows.error() << std::endl;
+    }
+    PQfinish(conn);
+}
+
 int main() {
     std::cout << "== ORDERBOOK SERVER STARTING ==" << std::endl;
     std::cout << "Drogon version: " << drogon::getVersion() << std::endl;
@@ -161,116 +579,190 @@ int main() {
     // drogon::app().setDocumentRoot("../../frontend/dist");
     // If your frontend build output is in a different folder, adjust the path above.
 
+    // Hot-path writes (orders, actions, trades) go through a storage backend. The Postgres one uses
+    // prepared statements in pipeline mode on its own connections, so it doesn't queue behind reads
+    // in the pool below. The file backend journals locally and replicates to it in the background.
+    const std::string backend = get_storage_backend();
+    if (backend != "postgres" && backend != "file" && backend != "null") {
+        std::cerr << "[STORAGE] Unknown ORDERBOOK_STORAGE '" << backend << "' — expected postgres, file or null" << std::endl;
+        return 1;
+    }
+
     // Connect to PostgreSQL database
-    // The connection pool size of 5 is good for most workloads
+    // The connection pool size of 5 is good for most workloads. Postgres is required for the
+    // postgres backend; the file backend uses it when it's there (replication, ledger, users)
+    // and carries on from the journal when it isn't, and the null backend never touches it.
     using namespace drogon::orm;
-    auto dbClient = DbClient::newPgClient("host=127.0.0.1 port=5432 dbname=orderbookdb user=rahulorderbook password=SRK2905boss?!", 5);
-    if (!dbClient) {
-        std::cerr << "[DB FATAL] Please check:" << std::endl;
-        std::cerr << "  - PostgreSQL server is running" << std::endl;
-        std::cerr << "  - Database credentials are correct" << std::endl;
-        std::cerr << "  - Network connectivity" << std::endl;
-        return 1;
+    DbClientPtr dbClient;
+    if (backend != "null") {
+        dbClient = DbClient::newPgClient(get_db_conninfo(), 5);
+        if (!dbClient && backend == "postgres") {
+            std::cerr << "[DB FATAL] Please check:" << std::endl;
+            std::cerr << "  - PostgreSQL server is running" << std::endl;
+            std::cerr << "  - Database credentials are correct" << std::endl;
+            std::cerr << "  - Network connectivity" << std::endl;
+            return 1;
+        }
     }
 
-    // Create the database tables if they don't exist
-    // This ensures the database is ready to store orders and trades
-    try {
-        std::cout << "[DB] Creating database tables..." << std::endl;
-        
-        // Create orders table - stores all order information
-        dbClient->execSqlSync(
-            "CREATE TABLE IF NOT EXISTS orders (id TEXT PRIMARY KEY, symbol TEXT, side TEXT, type TEXT, price BIGINT, quantity BIGINT, user_id TEXT, status TEXT);"
-        );
-        std::cout << "[DB] Orders table ready" << std::endl;
-        
-        // Create actions table - audit trail of all order actions
-        dbClient->execSqlSync(
-            "CREATE TABLE IF NOT EXISTS actions (action TEXT, order_id TEXT, price BIGINT, quantity BIGINT, ts TIMESTAMPTZ DEFAULT NOW());"
-        );
-        std::cout << "[DB] Actions table ready" << std::endl;
-        
-        // Create trades table - stores executed trades
-        dbClient->execSqlSync(
-            "CREATE TABLE IF NOT EXISTS trades (symbol TEXT, buy_order_id TEXT, sell_order_id TEXT, price BIGINT, quantity BIGINT, ts TIMESTAMPTZ DEFAULT NOW());"
-        );
-        std::cout << "[DB] Trades table ready" << std::endl;
-        
-        // Create users table - stores user authentication data
-        dbClient->execSqlSync(
-            "CREATE TABLE IF NOT EXISTS users (id SERIAL PRIMARY KEY, username TEXT UNIQUE NOT NULL, password_hash TEXT NOT NULL, created_at TIMESTAMPTZ DEFAULT NOW());"
-        );
-        std::cout << "[DB] Users table ready" << std::endl;
-        
-        std::cout << "[DB] All tables created successfully" << std::endl;
-    } catch (const std::exception &e) {
-        std::cerr << "[DB ERROR] Failed to create tables: " << e.what() << std::endl;
-        return 1;
+    // Bring the schema up to date (creates the tables on a fresh database)
+    // Trades and actions are partitioned by month, so make sure the coming months exist
+    if (dbClient) {
+        try {
+            std::cout << "[DB] Running schema migrations..." << std::endl;
+            migrate_schema(dbClient);
+            ensure_partitions(dbClient);
+            std::cout << "[DB] Schema is up to date" << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << "[DB ERROR] Schema migration failed: " << e.what() << std::endl;
+            if (backend == "postgres") return 1;
+            std::cerr << "[DB] Running without Postgres — the journal is the only store" << std::endl;
+            dbClient = nullptr;
+        }
     }
 
+    PgPipelineWriter pgWriter(PgPipelineWriter::Options{get_db_conninfo(), get_db_writer_connections()});
+    bool pgWriterUp = dbClient && pgWriter.start();
+    FileStorage::Options fileOptions;
+    fileOptions.path = get_storage_path();
+    fileOptions.replicate_to = pgWriterUp ? &pgWriter : nullptr;
+    const bool durableAcks = get_durable_acks();
+    if (durableAcks) {
+        fileOptions.sync = true;
+        fileOptions.max_batch = get_group_commit_max_batch();
+        fileOptions.flush_interval = get_group_commit_max_wait();
+    }
+    FileStorage fileStorage(fileOptions);
+    NullStorage nullStorage;
+    if (durableAcks && backend != "file") {
+        std::cerr << "[STORAGE] ORDERBOOK_DURABLE_ACKS needs ORDERBOOK_STORAGE=file — acking without waiting" << std::endl;
+    }
+    if (backend == "file") {
+        if (!fileStorage.start()) return 1;
+        if (!pgWriterUp) std::cerr << "[STORAGE] Postgres writer unavailable — journal is not being replicated" << std::endl;
+        OrderBookController::setStorage(&fileStorage, durableAcks);
+        if (durableAcks) {
+            std::cout << "[STORAGE] Group commit on: batches of up to " << fileOptions.max_batch << " records, "
+                      << fileOptions.flush_interval.count() << " us max wait" << std::endl;
+        }
+    } else if (backend == "null") {
+        OrderBookController::setStorage(&nullStorage);
+    } else if (pgWriterUp) {
+        OrderBookController::setStorage(&pgWriter);
+    } else {
+        std::cerr << "[DB] Pipeline writer unavailable — orders and trades won't be persisted" << std::endl;
+    }
+    std::cout << "[STORAGE] Using " << backend << " storage" << std::endl;
+
     // Create the matching engine - this is the heart of the trading system
     MatchingEngine engine;
 
-    // Replay any existing orders from the database
-    // This ensures the matching engine state matches what's stored
-    try {
-        std::cout << "[DB] Replaying database state..." << std::endl;
-        
-        auto actionsResult = dbClient->execSqlSync("SELECT action, order_id, price, quantity FROM actions ORDER BY ts ASC;");
-        std::cout << "[DB] Found " << actionsResult.size() << " actions to replay" << std::endl;
-        
-        for (const auto &row : actionsResult) {
-            std::string action = row[0].as<std::string>();
-            std::string order_id = row[1].as<std::string>();
-            Price price = row[2].as<Price>();
-            Quantity quantity = row[3].as<Quantity>();
-            if (action == "cancel") engine.cancel_order(order_id);
-            else if (action == "modify") engine.modify_order(order_id, price, quantity);
-        }
-
-        auto openOrders = dbClient->execSqlSync("SELECT id, symbol, side, type, price, quantity, user_id FROM orders WHERE status='open' OR status='partial';");
-        std::cout << "[DB] Found " << openOrders.size() << " open orders to restore" << std::endl;
-        
-        for (const auto &row : openOrders) {
-            auto order = std::make_shared<Order>(
-                row[0].as<std::string>(),
-                row[1].as<std::string>(),
-                row[2].as<std::string>() == "buy" ? OrderSide::BUY : OrderSide::SELL,
-                row[3].as<std::string>() == "market" ? OrderType::MARKET :
-                    (row[3].as<std::string>() == "limit" ? OrderType::LIMIT :
-                    (row[3].as<std::string>() == "stop" ? OrderType::STOP : OrderType::STOP_LIMIT)),
-                row[4].as<Price>(),
-                row[5].as<Quantity>(),
-                row[6].as<std::string>()
-            );
-            engine.add_order(order);
-        }
+    // Restore open orders and trade history from wherever they're written first
+    // From Postgres, rows stream out of binary COPY and go straight into the engine - nothing is buffered
+    if (backend == "file") {
+        restore_from_journal(fileOptions.path, engine);
+    } else if (backend != "null") {
+        restore_engine_state(get_db_conninfo(), engine);
+    }
 
-        auto tradesResult = dbClient->execSqlSync("SELECT symbol, buy_order_id, sell_order_id, price, quantity, ts FROM trades ORDER BY ts ASC;");
-        std::cout << "[DB] Found " << tradesResult.size() << " trades to restore" << std::endl;
-        
-        for (const auto &row : tradesResult) {
-            Trade trade;
-            trade.symbol = row[0].as<std::string>();
-            trade.buy_order_id = row[1].as<std::string>();
-            trade.sell_order_id = row[2].as<std::string>();
-            trade.price = row[3].as<Price>();
-            trade.quantity = row[4].as<Quantity>();
-            engine.add_trade_history(trade);
+    // Load balances and positions, then keep them current from the live trade stream
+    // The hooks go in after the replay so restored state isn't counted or written twice
+    AccountLedger ledger;
+    if (dbClient) {
+        try {
+            std::unordered_map<std::string, Account> accounts;
+            for (const auto &row : dbClient->execSqlSync("SELECT user_id, cash, volume, trade_count FROM accounts;")) {
+                auto& account = accounts[row[0].as<std::string>()];
+                account.user_id = row[0].as<std::string>();
+                account.cash = row[1].as<int64_t>();
+                account.volume = row[2].as<uint64_t>();
+                account.trade_count = row[3].as<uint64_t>();
+            }
+            for (const auto &row : dbClient->execSqlSync("SELECT user_id, symbol, quantity, cost_basis, realized_pnl FROM positions;")) {
+                auto it = accounts.find(row[0].as<std::string>());
+                if (it == accounts.end()) continue;
+                it->second.positions.push_back(Position{row[1].as<std::string>(), row[2].as<int64_t>(),
+                                                        row[3].as<int64_t>(), row[4].as<int64_t>()});
+            }
+            for (const auto& [user, account] : accounts) ledger.load_account(account);
+            std::cout << "[DB] Loaded " << ledger.size() << " accounts into the ledger" << std::endl;
+        } catch (const std::exception &e) {
+            std::cerr << "[DB] Ledger load failed: " << e.what() << " — starting with empty accounts" << std::endl;
         }
-        
-        std::cout << "[DB] Database state replay completed successfully" << std::endl;
-    } catch (const std::exception &e) {
-        std::cerr << "[DB] Replay failed: " << e.what() << " — continuing with fresh state" << std::endl;
     }
-
+    SegmentJournal auditJournal(get_audit_journal_options());
+    if (get_audit_log_enabled() && auditJournal.start()) {
+        audit_journal = &auditJournal;
+        std::cout << "[JOURNAL] Audit log at " << get_log_file() << ".* ("
+                  << (auditJournal.stats().io_uring ? "io_uring" : "pwrite") << ")" << std::endl;
+    }
+    engine.on_trade = [&ledger](const Trade& trade) {
+        ledger.apply_trade(trade);
+        OrderBookController::persistTrade(trade);
+        if (audit_journal) {
+            Json::Value entry;
+            entry["event"] = "trade";
+            entry["symbol"] = trade.symbol;
+            entry["buy_order_id"] = trade.buy_order_id;
+            entry["sell_order_id"] = trade.sell_order_id;
+            entry["price"] = Json::UInt64(trade.price);
+            entry["quantity"] = Json::UInt64(trade.quantity);
+            append_log(entry);
+        }
+    };
     // Attach engine to controller
     OrderBookController::setEngine(&engine);
     OrderBookController::setDbClient(dbClient);
+    OrderBookController::setLedger(&ledger);
+
+    // Columnar trade archive for analytics - filled from Postgres a day at a time
+    std::unique_ptr<TradeArchive> tradeArchive;
+    if (const char* dir = std::getenv("ORDERBOOK_TRADE_ARCHIVE_DIR")) {
+        tradeArchive = std::make_unique<TradeArchive>(dir);
+        OrderBookController::setTradeArchive(tradeArchive.get());
+    }
     OrderBookController::setMetrics(&g_order_count, &g_trade_count, &g_last_order_latency_ms);
+    OrderBookController::setCompression(get_compression_options());
+
+    // Cancels, then modifies, then new orders - one engine thread drains the lanes
+    std::unique_ptr<CommandDispatcher> dispatcher;
+    if (get_command_lanes_enabled()) {
+        dispatcher = std::make_unique<CommandDispatcher>(get_command_lane_options());
+        dispatcher->start();
+        OrderBookController::setDispatcher(dispatcher.get());
+    }
+
+    // Shed order entry early when the engine is backed up
+    std::unique_ptr<AdmissionController> admission;
+    if (get_admission_enabled()) {
+        admission = std::make_unique<AdmissionController>(get_admission_options(), &engine);
+        if (dispatcher) admission->set_backlog([d = dispatcher.get()] { return d->depth(); });
+        AdmissionFilter::controller = admission.get();
+        drogon::app().registerPreSendingAdvice([](const drogon::HttpRequestPtr& req, const drogon::HttpResponsePtr&) {
+            AdmissionFilter::release(req);
+        });
+    }
 
     // Create and register WebSocket controller
     auto wsController = std::make_shared<OrderBookWebSocket>(&engine);
+    wsController->setHeartbeatTimeout(get_ws_heartbeat_timeout());
+    engine.on_mmp_trigger = [ws = wsController.get()](const std::string& symbol, const UserId& user_id, const std::vector<OrderId>& pulled) {
+        ws->notifyMmpTrigger(symbol, user_id, pulled);
+        if (audit_journal) {
+            Json::Value entry;
+            entry["event"] = "mmp_trigger";
+            entry["symbol"] = symbol;
+            entry["user_id"] = user_id;
+            entry["pulled"] = Json::UInt64(pulled.size());
+            append_log(entry);
+        }
+    };
+    // Fills and cancels change orders that are already stored, so keep their status current,
+    // and finished orders drop out of their owner's cancel-on-disconnect list however they finished
+    engine.on_order_update = [ws = wsController.get()](const Order& order) {
+        OrderBookController::persistOrderStatus(order);
+        ws->forgetFinishedOrder(order);
+    };
     OrderBookController::setWebSocketController(wsController.get());
 
     // Register controllers with Drogon
@@ -293,18 +785,94 @@ int main() {
     std::cout << "[ROUTES] Test route /test registered" << std::endl;
 
     // Start background expiry thread
+    // The sweep cancels, so it queues on the cancel lane like any other; a full lane just waits for the next tick
     std::thread([](MatchingEngine *eng) {
         while (true) {
             std::this_thread::sleep_for(std::chrono::seconds(5));
-            eng->cancel_expired_orders();
+            OrderBookController::runInLane(CommandDispatcher::Lane::Cancel, [eng] { eng->cancel_expired_orders(); });
         }
     }, &engine).detach();
 
+    // Create next months' trade/action partitions ahead of time, and archive old trades
+    if (dbClient) std::thread([](drogon::orm::DbClientPtr db, TradeArchive *tradeArchive) {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::hours(24));
+            try {
+                ensure_partitions(db);
+            } catch (const std::exception &e) {
+                std::cerr << "[DB ERROR] Partition maintenance failed: " << e.what() << std::endl;
+            }
+            // Yesterday is complete now - add it to the columnar archive before anything moves it
+            if (tradeArchive) {
+                auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                export_trade_segments(get_db_conninfo(), *tradeArchive, TradeArchive::day_of(now_us) - 1);
+            }
+            // Optional: keep the live trades table short by moving old trades elsewhere
+            if (const char* archive = std::getenv("ORDERBOOK_ARCHIVE_CONNINFO")) {
+                const char* days = std::getenv("ORDERBOOK_ARCHIVE_AFTER_DAYS");
+                archive_old_trades(get_db_conninfo(), archive, days ? std::max(1, std::atoi(days)) : 90);
+            }
+        }
+    }, dbClient, tradeArchive.get()).detach();
+
+    // Flush ledger changes to Postgres once a second, one batched upsert per table
+    // Without a database the ledger lives in memory only
+    if (dbClient) std::thread([](AccountLedger *led, drogon::orm::DbClientPtr db) {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            flush_ledger(*led, db);
+        }
+    }, &ledger, dbClient).detach();
+
+    // Start heartbeat watchdog for WebSocket sessions with cancel-on-disconnect
+    std::thread([](std::shared_ptr<OrderBookWebSocket> ws) {
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            ws->checkHeartbeats();
+        }
+    }, wsController).detach();
+
+    // Take the cold-start costs now rather than on the first real orders. It runs on the
+    // engine thread when there is one - the arena and allocator caches it warms are per thread
+    if (get_warmup_enabled()) {
+        auto options = get_warmup_options();
+        WarmupReport report;
+        std::promise<void> done;
+        CommandDispatcher::Command run = [&] {
+            report = warm_up(engine, options);
+            done.set_value();
+        };
+        if (!dispatcher || !dispatcher->submit(CommandDispatcher::Lane::New, std::move(run))) run();
+        done.get_future().wait();
+        std::cout << "[WARMUP] " << report.books << " books ready, " << report.orders << " synthetic orders ("
+                  << report.trades << " trades) in " << report.elapsed.count() / 1000 << " ms" << std::endl;
+    }
+
     // Start server
     drogon::app().addListener("0.0.0.0", 18080);
     std::cout << "[SERVER] Drogon running at http://localhost:18080\n";
+    auto tls = get_tls_options();
+    if (tls.enabled && tls_files_present(tls)) {
+        drogon::app().addListener("0.0.0.0", tls.port, true, tls.cert_file, tls.key_file, false, tls_conf_commands(tls));
+        std::cout << "[SERVER] HTTPS/WSS at https://localhost:" << tls.port << "\n";
+        if (tls.ktls) std::cout << "[TLS] " << probe_ktls().detail << std::endl;
+    } else if (tls.enabled) {
+        std::cout << "[TLS] No certificate at " << tls.cert_file << " / " << tls.key_file << ", HTTPS listener not opened\n";
+    }
 
     drogon::app().run();
+
+    AdmissionFilter::controller = nullptr;
+    // Run what's still on the lanes - its writes have to reach storage below
+    OrderBookController::setDispatcher(nullptr);
+    if (dispatcher) dispatcher->stop();
+    // Get queued writes out before exiting - the journal first, since it feeds the database
+    OrderBookController::setStorage(nullptr);
+    fileStorage.stop();
+    pgWriter.stop();
+    audit_journal = nullptr;
+    auditJournal.stop();
     return 0;
 }
 
@@ -0,0 +1,169 @@
+#include "backtest.hpp"
+#include <charconv>
+#include <memory>
+
+namespace orderbook {
+
+namespace {
+
+// Splits on ',' without allocating; fields are views into the line
+std::vector<std::string_view> split_fields(std::string_view line) {
+    std::vector<std::string_view> fields;
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(line.substr(start, comma == std::string_view::npos ? std::string_view::npos : comma - start));
+        if (comma == std::string_view::npos) break;
+        start = comma + 1;
+    }
+    return fields;
+}
+
+template <typename T>
+bool parse_number(std::string_view s, T& out) {
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size() && !s.empty();
+}
+
+// Nearest boundary of interval strictly after ts
+int64_t next_boundary(int64_t ts_ns, int64_t interval_ns) {
+    return (ts_ns / interval_ns + 1) * interval_ns;
+}
+
+// Latest boundary at or before ts
+int64_t last_boundary(int64_t ts_ns, int64_t interval_ns) {
+    return ts_ns / interval_ns * interval_ns;
+}
+
+} // namespace
+
+bool parse_backtest_event(std::string_view line, BacktestEvent& out, std::string& err) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    auto f = split_fields(line);
+    if (f.size() < 3) { err = "expected at least <ts>,<action>,<id>"; return false; }
+    if (!parse_number(f[0], out.ts_ns)) { err = "bad timestamp"; return false; }
+    if (f[2].empty()) { err = "empty order id"; return false; }
+    out.id.assign(f[2]);
+
+    if (f[1] == "cancel") {
+        out.action = BacktestEvent::Action::Cancel;
+        return true;
+    }
+    if (f[1] == "modify") {
+        out.action = BacktestEvent::Action::Modify;
+        if (f.size() < 5 || !parse_number(f[3], out.price) || !parse_number(f[4], out.quantity)) {
+            err = "modify wants <price>,<qty>";
+            return false;
+        }
+        return true;
+    }
+    if (f[1] != "new") { err = "unknown action"; return false; }
+
+    out.action = BacktestEvent::Action::New;
+    if (f.size() < 9) { err = "new wants <symbol>,<side>,<type>,<price>,<qty>,<user>"; return false; }
+    if (f[3].empty()) { err = "empty symbol"; return false; }
+    out.symbol.assign(f[3]);
+    if (f[4] == "buy") out.side = OrderSide::BUY;
+    else if (f[4] == "sell") out.side = OrderSide::SELL;
+    else { err = "bad side"; return false; }
+    if (f[5] == "limit") out.type = OrderType::LIMIT;
+    else if (f[5] == "market") out.type = OrderType::MARKET;
+    else { err = "bad type"; return false; }
+    if (!parse_number(f[6], out.price) || !parse_number(f[7], out.quantity) || out.quantity == 0) {
+        err = "bad price or quantity";
+        return false;
+    }
+    out.user_id.assign(f[8]);
+    out.expiry = 0;
+    if (f.size() > 9 && !f[9].empty() && !parse_number(f[9], out.expiry)) { err = "bad expiry"; return false; }
+    out.tif = f.size() > 10 && !f[10].empty() ? std::string(f[10]) : "GTC";
+    return true;
+}
+
+Backtester::Backtester(BacktestOptions options) : options_(options) {
+    engine_.set_clock(&clock_);
+    engine_.on_trade = [this](const Trade& t) {
+        report_.trades++;
+        report_.volume += t.quantity;
+        if (on_fill) on_fill(t);
+    };
+}
+
+void Backtester::advance_to(int64_t ts_ns) {
+    if (!started_) {
+        started_ = true;
+        report_.first_ts_ns = ts_ns;
+        if (options_.expiry_interval.count() > 0) next_expiry_ns_ = next_boundary(ts_ns, options_.expiry_interval.count());
+        if (options_.snapshot_interval.count() > 0) next_snapshot_ns_ = next_boundary(ts_ns, options_.snapshot_interval.count());
+    }
+    // Timers due at or before this event fire first, at the latest boundary
+    // they missed. Expiry first, so a snapshot on the same boundary shows the
+    // book after the sweep.
+    if (options_.expiry_interval.count() > 0 && next_expiry_ns_ <= ts_ns) {
+        clock_.set(Clock::time_point(std::chrono::nanoseconds(last_boundary(ts_ns, options_.expiry_interval.count()))));
+        engine_.cancel_expired_orders();
+        next_expiry_ns_ = next_boundary(ts_ns, options_.expiry_interval.count());
+    }
+    if (options_.snapshot_interval.count() > 0 && next_snapshot_ns_ <= ts_ns) {
+        int64_t due = last_boundary(ts_ns, options_.snapshot_interval.count());
+        clock_.set(Clock::time_point(std::chrono::nanoseconds(due)));
+        take_snapshots(due);
+        next_snapshot_ns_ = next_boundary(ts_ns, options_.snapshot_interval.count());
+    }
+    clock_.set(Clock::time_point(std::chrono::nanoseconds(ts_ns)));
+    if (ts_ns > report_.last_ts_ns) report_.last_ts_ns = ts_ns;
+}
+
+void Backtester::apply(const BacktestEvent& event) {
+    advance_to(event.ts_ns);
+    report_.events++;
+    switch (event.action) {
+        case BacktestEvent::Action::New: {
+            symbols_.insert(event.symbol);
+            engine_.add_order(std::make_shared<Order>(event.id, event.symbol, event.side, event.type, event.price,
+                                                      event.quantity, event.user_id, 0, event.expiry, event.tif));
+            break;
+        }
+        case BacktestEvent::Action::Cancel:
+            if (!engine_.cancel_order(event.id)) report_.misses++;
+            break;
+        case BacktestEvent::Action::Modify:
+            if (!engine_.modify_order(event.id, event.price, event.quantity)) report_.misses++;
+            break;
+    }
+}
+
+void Backtester::take_snapshots(int64_t ts_ns) {
+    if (!on_snapshot) return;
+    for (const auto& symbol : symbols_) {
+        BookSnapshot snap;
+        snap.ts_ns = ts_ns;
+        snap.symbol = symbol;
+        for (const auto& level : engine_.get_bid_levels(symbol, options_.snapshot_depth)) snap.bids.emplace_back(level.price, level.total_quantity);
+        for (const auto& level : engine_.get_ask_levels(symbol, options_.snapshot_depth)) snap.asks.emplace_back(level.price, level.total_quantity);
+        report_.snapshots++;
+        on_snapshot(snap);
+    }
+}
+
+void Backtester::snapshot_now() {
+    take_snapshots(report_.last_ts_ns);
+}
+
+BacktestReport Backtester::run(std::istream& in) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::string line, err;
+    BacktestEvent event;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#' || line.compare(0, 3, "ts,") == 0) continue;
+        if (!parse_backtest_event(line, event, err)) {
+            report_.bad_lines++;
+            continue;
+        }
+        apply(event);
+    }
+    report_.elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0);
+    return report_;
+}
+
+} // namespace orderbook
@@ -0,0 +1,130 @@
+#ifndef ORDERBOOK_BACKTEST_HPP
+#define ORDERBOOK_BACKTEST_HPP
+
+#include "clock.hpp"
+#include "matching_engine.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace orderbook {
+
+/**
+ * Offline replay of historical order flow on virtual time
+ *
+ * Each event carries its own timestamp. The backtester moves a VirtualClock
+ * to it and applies the event to a private MatchingEngine, so nothing waits
+ * on the wall: a day of flow runs as fast as the engine can match it. Fills
+ * and trade timestamps, expiry and MMP windows all follow the virtual clock.
+ *
+ * The periodic work the server does on timers happens here whenever virtual
+ * time crosses the next boundary (before the event that crossed it):
+ *  - expiry sweeps every expiry_interval, like the server's 5 s thread
+ *  - book snapshots (top snapshot_depth levels per symbol) every
+ *    snapshot_interval
+ * A quiet stretch spanning several boundaries runs each job once, at the
+ * last boundary it spans.
+ *
+ * Event lines are CSV, timestamps in nanoseconds since the unix epoch:
+ *   <ts>,new,<id>,<symbol>,<buy|sell>,<limit|market>,<price>,<qty>,<user>[,<expiry>[,<tif>]]
+ *   <ts>,cancel,<id>
+ *   <ts>,modify,<id>,<price>,<qty>
+ * Blank lines, lines starting with '#' and a "ts,..." header are skipped.
+ */
+struct BacktestOptions {
+    std::chrono::nanoseconds expiry_interval = std::chrono::seconds(5);
+    std::chrono::nanoseconds snapshot_interval = std::chrono::seconds(1);  // 0 = no snapshots
+    size_t snapshot_depth = 5;
+};
+
+struct BacktestEvent {
+    enum class Action { New, Cancel, Modify };
+
+    int64_t ts_ns = 0;
+    Action action = Action::New;
+    OrderId id;
+    std::string symbol;
+    OrderSide side = OrderSide::BUY;
+    OrderType type = OrderType::LIMIT;
+    Price price = 0;
+    Quantity quantity = 0;
+    UserId user_id;
+    int64_t expiry = 0;         // Unix seconds, 0 = never
+    std::string tif = "GTC";
+};
+
+// Parse one event line; false (with err set) for anything malformed
+bool parse_backtest_event(std::string_view line, BacktestEvent& out, std::string& err);
+
+struct BookSnapshot {
+    int64_t ts_ns = 0;
+    std::string symbol;
+    std::vector<std::pair<Price, Quantity>> bids;   // Best first
+    std::vector<std::pair<Price, Quantity>> asks;
+};
+
+struct BacktestReport {
+    uint64_t events = 0;        // Applied to the engine
+    uint64_t bad_lines = 0;     // Skipped, didn't parse
+    uint64_t misses = 0;        // Cancels/modifies of orders that weren't live
+    uint64_t trades = 0;
+    Quantity volume = 0;
+    uint64_t snapshots = 0;
+    int64_t first_ts_ns = 0;
+    int64_t last_ts_ns = 0;
+    std::chrono::nanoseconds elapsed{0};   // Wall time spent
+
+    // Virtual time covered per unit of wall time
+    double speedup() const {
+        return elapsed.count() > 0 ? static_cast<double>(last_ts_ns - first_ts_ns) / elapsed.count() : 0.0;
+    }
+};
+
+class Backtester {
+public:
+    explicit Backtester(BacktestOptions options = {});
+    Backtester(const Backtester&) = delete;
+    Backtester& operator=(const Backtester&) = delete;
+
+    // Every fill, stamped with virtual time
+    std::function<void(const Trade&)> on_fill;
+    // Periodic book state, one call per symbol per snapshot
+    std::function<void(const BookSnapshot&)> on_snapshot;
+
+    // Replay a whole stream; malformed lines are counted and skipped
+    BacktestReport run(std::istream& in);
+
+    // Or drive it an event at a time. Events should come in timestamp order;
+    // a late one is applied at the current virtual time.
+    void apply(const BacktestEvent& event);
+
+    // Final snapshot of every book at the last event's time
+    void snapshot_now();
+
+    const BacktestReport& report() const { return report_; }
+    MatchingEngine& engine() { return engine_; }
+    const VirtualClock& clock() const { return clock_; }
+
+private:
+    void advance_to(int64_t ts_ns);
+    void take_snapshots(int64_t ts_ns);
+
+    BacktestOptions options_;
+    VirtualClock clock_;
+    MatchingEngine engine_;
+    std::set<std::string> symbols_;
+    BacktestReport report_;
+    int64_t next_expiry_ns_ = 0;
+    int64_t next_snapshot_ns_ = 0;
+    bool started_ = false;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_BACKTEST_HPP
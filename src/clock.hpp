@@ -0,0 +1,68 @@
+#ifndef ORDERBOOK_CLOCK_HPP
+#define ORDERBOOK_CLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace orderbook {
+
+/**
+ * Where the engine gets the time
+ *
+ * Books and the engine read the time for three things: trade and order
+ * timestamps, order expiry (unix seconds) and the MMP fill windows (which want
+ * something monotonic). With no clock set they read the system clocks
+ * directly, as they always have. A backtest sets a VirtualClock instead, so
+ * time moves with the replayed events rather than the wall.
+ */
+class Clock {
+public:
+    using time_point = std::chrono::high_resolution_clock::time_point;
+
+    virtual ~Clock() = default;
+
+    // Order and trade timestamps
+    virtual time_point now() const = 0;
+    // Order expiry is compared against this
+    virtual int64_t unix_seconds() const = 0;
+    // MMP windows; only differences matter
+    virtual std::chrono::steady_clock::time_point monotonic() const = 0;
+};
+
+// Time that only moves when it's told to. The epoch is the unix epoch, like
+// the timestamps in historical order flow.
+class VirtualClock final : public Clock {
+public:
+    explicit VirtualClock(time_point start = time_point{}) : ticks_(start.time_since_epoch().count()) {}
+
+    time_point now() const override {
+        return time_point(time_point::duration(ticks_.load(std::memory_order_relaxed)));
+    }
+
+    int64_t unix_seconds() const override {
+        return std::chrono::duration_cast<std::chrono::seconds>(now().time_since_epoch()).count();
+    }
+
+    std::chrono::steady_clock::time_point monotonic() const override {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(now().time_since_epoch()));
+    }
+
+    // Never goes backwards - an out-of-order event keeps the current time
+    void set(time_point t) {
+        auto ticks = t.time_since_epoch().count();
+        if (ticks > ticks_.load(std::memory_order_relaxed)) ticks_.store(ticks, std::memory_order_relaxed);
+    }
+
+    void advance(time_point::duration d) {
+        if (d.count() > 0) ticks_.fetch_add(d.count(), std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<time_point::rep> ticks_;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_CLOCK_HPP
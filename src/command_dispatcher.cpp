@@ -0,0 +1,166 @@
+#include "command_dispatcher.hpp"
+#include <exception>
+#include <iostream>
+
+namespace orderbook {
+
+CommandDispatcher::CommandDispatcher(Options options) : options_(options) {}
+
+CommandDispatcher::~CommandDispatcher() {
+    stop();
+}
+
+void CommandDispatcher::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (worker_.joinable()) return;
+    stopping_ = false;
+    worker_ = std::thread([this] { worker_loop(); });
+}
+
+void CommandDispatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) worker_.join();
+    // Anything submitted after the worker left still gets its reply
+    while (run_one()) {}
+}
+
+bool CommandDispatcher::submit(Lane lane, Command&& fn, std::string_view order_id) {
+    std::vector<std::string> keys;
+    if (!order_id.empty()) keys.emplace_back(order_id);
+    return submit(lane, std::move(fn), std::move(keys));
+}
+
+bool CommandDispatcher::submit(Lane lane, Command&& fn, std::vector<std::string> order_ids) {
+    std::erase(order_ids, std::string());
+    LaneState* state;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Its order is still waiting on the New lane - jumping ahead would only find nothing to cancel
+        if (lane != Lane::New) {
+            for (const auto& key : order_ids) {
+                if (pending_new_.count(key)) { lane = Lane::New; break; }
+            }
+        }
+        state = &lanes_[static_cast<size_t>(lane)];
+        if (state->queue.size() >= options_.capacity[static_cast<size_t>(lane)]) {
+            state->rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Entry entry{std::move(fn), std::chrono::steady_clock::now(), {}};
+        // A cancel/modify that was moved here counts too, so whatever comes after it for the order waits as well
+        if (lane == Lane::New) {
+            for (const auto& key : order_ids) pending_new_[key]++;
+            entry.new_order_ids = std::move(order_ids);
+        }
+        state->queue.push_back(std::move(entry));
+        state->depth.store(state->queue.size(), std::memory_order_relaxed);
+        total_depth_.fetch_add(1, std::memory_order_relaxed);
+    }
+    state->submitted.fetch_add(1, std::memory_order_relaxed);
+    cv_.notify_one();
+    return true;
+}
+
+size_t CommandDispatcher::pick_lane() {
+    size_t pick = LANE_COUNT;
+    for (size_t i = 0; i < LANE_COUNT; ++i) {
+        if (lanes_[i].queue.empty()) continue;
+        if (pick == LANE_COUNT) {
+            pick = i;
+        } else if (lanes_[i].passed_over >= options_.max_burst) {
+            // Starvation guard - this lane has waited long enough, it goes before the higher ones once
+            pick = i;
+            break;
+        }
+    }
+    for (size_t i = pick + 1; i < LANE_COUNT; ++i) {
+        if (!lanes_[i].queue.empty()) ++lanes_[i].passed_over;
+    }
+    lanes_[pick].passed_over = 0;
+    return pick;
+}
+
+bool CommandDispatcher::pop_next(Entry& out, size_t& lane) {
+    if (total_depth_.load(std::memory_order_relaxed) == 0) return false;
+    lane = pick_lane();
+    auto& state = lanes_[lane];
+    out = std::move(state.queue.front());
+    state.queue.pop_front();
+    // The orders reach the engine now, so cancels and modifies for them can take their own lanes again
+    for (const auto& key : out.new_order_ids) {
+        auto it = pending_new_.find(key);
+        if (it != pending_new_.end() && --it->second == 0) pending_new_.erase(it);
+    }
+    state.depth.store(state.queue.size(), std::memory_order_relaxed);
+    total_depth_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+void CommandDispatcher::run_entry(Entry& entry, size_t lane) {
+    auto& state = lanes_[lane];
+    auto waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - entry.enqueued).count());
+    state.wait_ns_total.fetch_add(waited, std::memory_order_relaxed);
+    // Only this thread (or a test draining by hand) runs commands, so a plain compare is enough
+    if (waited > state.wait_ns_max.load(std::memory_order_relaxed)) state.wait_ns_max.store(waited, std::memory_order_relaxed);
+    try {
+        entry.fn();
+    } catch (const std::exception& e) {
+        std::cerr << "[DISPATCH] " << name(static_cast<Lane>(lane)) << " command threw: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "[DISPATCH] " << name(static_cast<Lane>(lane)) << " command threw" << std::endl;
+    }
+    state.executed.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CommandDispatcher::run_one() {
+    Entry entry;
+    size_t lane = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!pop_next(entry, lane)) return false;
+    }
+    run_entry(entry, lane);
+    return true;
+}
+
+void CommandDispatcher::worker_loop() {
+    for (;;) {
+        Entry entry;
+        size_t lane = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || total_depth_.load(std::memory_order_relaxed) > 0; });
+            // Drain before leaving so nobody is left without a reply
+            if (!pop_next(entry, lane)) return;
+        }
+        run_entry(entry, lane);
+    }
+}
+
+CommandDispatcher::LaneStats CommandDispatcher::stats(Lane lane) const {
+    const auto& state = lanes_[static_cast<size_t>(lane)];
+    LaneStats s;
+    s.depth = state.depth.load(std::memory_order_relaxed);
+    s.submitted = state.submitted.load(std::memory_order_relaxed);
+    s.rejected = state.rejected.load(std::memory_order_relaxed);
+    s.executed = state.executed.load(std::memory_order_relaxed);
+    s.wait_ns_total = state.wait_ns_total.load(std::memory_order_relaxed);
+    s.wait_ns_max = state.wait_ns_max.load(std::memory_order_relaxed);
+    return s;
+}
+
+const char* CommandDispatcher::name(Lane lane) {
+    switch (lane) {
+        case Lane::Cancel: return "cancel";
+        case Lane::Modify: return "modify";
+        case Lane::New: return "new";
+    }
+    return "unknown";
+}
+
+} // namespace orderbook
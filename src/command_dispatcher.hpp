@@ -0,0 +1,126 @@
+#ifndef ORDERBOOK_COMMAND_DISPATCHER_HPP
+#define ORDERBOOK_COMMAND_DISPATCHER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace orderbook {
+
+/**
+ * Priority lanes in front of the matching engine
+ *
+ * Order entry is queued by class instead of racing for the engine lock in
+ * arrival order, so a market maker's cancels don't sit behind a flood of
+ * aggressive new orders. One engine thread drains the lanes:
+ *  - Cancel: cancels and mass cancels (cancel-on-disconnect included)
+ *  - Modify: price/quantity amendments
+ *  - New:    new orders and mass quotes
+ * A higher lane always goes first, except that a lower lane which has been
+ * passed over max_burst times in a row gets the next slot - so new orders
+ * still get at least 1 in (max_burst + 1) of the engine when cancels flood.
+ *
+ * Each lane is bounded; submit() refuses work when its lane is full and the
+ * caller answers "busy" straight away. Commands run in FIFO order within a lane.
+ *
+ * The one exception to lane priority: a cancel or modify for an order whose
+ * new order command hasn't run yet queues behind it on the New lane, rather
+ * than overtaking it and finding nothing to act on.
+ */
+class CommandDispatcher {
+public:
+    enum class Lane : uint8_t { Cancel = 0, Modify = 1, New = 2 };
+    static constexpr size_t LANE_COUNT = 3;
+
+    using Command = std::function<void()>;
+
+    struct Options {
+        std::array<size_t, LANE_COUNT> capacity{4096, 2048, 1024};   // Indexed by Lane
+        uint32_t max_burst = 32;
+    };
+
+    struct LaneStats {
+        uint64_t depth = 0;
+        uint64_t submitted = 0;
+        uint64_t rejected = 0;          // Lane was full
+        uint64_t executed = 0;
+        uint64_t wait_ns_total = 0;     // Time commands spent queued before running
+        uint64_t wait_ns_max = 0;
+    };
+
+    explicit CommandDispatcher(Options options);
+    CommandDispatcher() : CommandDispatcher(Options{}) {}
+    ~CommandDispatcher();
+
+    CommandDispatcher(const CommandDispatcher&) = delete;
+    CommandDispatcher& operator=(const CommandDispatcher&) = delete;
+
+    // Starts the engine thread. Until then commands only queue up (tests drain by hand)
+    void start();
+    // Runs whatever is still queued, then joins the engine thread
+    void stop();
+
+    // Queues fn on its lane. fn is only moved from when this returns true
+    // order_id names the order a New, Cancel or Modify command is for (empty if none) -
+    // that's how a cancel/modify finds out its order is still queued
+    bool submit(Lane lane, Command&& fn, std::string_view order_id = {});
+    // Same for a command that covers several orders (a WebSocket batch): it waits
+    // on the New lane if any of them is still queued, and registers all of them there
+    bool submit(Lane lane, Command&& fn, std::vector<std::string> order_ids);
+
+    // Runs the next command by lane priority on the calling thread; false if all lanes are empty
+    bool run_one();
+
+    LaneStats stats(Lane lane) const;
+    // Commands queued across all lanes
+    uint64_t depth() const { return total_depth_.load(std::memory_order_relaxed); }
+    const Options& options() const { return options_; }
+    static const char* name(Lane lane);
+
+private:
+    struct Entry {
+        Command fn;
+        std::chrono::steady_clock::time_point enqueued;
+        std::vector<std::string> new_order_ids;   // Set on New lane commands for orders, so pending_new_ can forget them when they run
+    };
+    struct LaneState {
+        std::deque<Entry> queue;
+        uint32_t passed_over = 0;   // Higher-lane commands run while this lane was waiting
+        std::atomic<uint64_t> depth{0};
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> wait_ns_total{0};
+        std::atomic<uint64_t> wait_ns_max{0};
+    };
+
+    // Picks the lane to serve next; caller holds mutex_ and at least one lane is non-empty
+    size_t pick_lane();
+    bool pop_next(Entry& out, size_t& lane);
+    void run_entry(Entry& entry, size_t lane);
+    void worker_loop();
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::array<LaneState, LANE_COUNT> lanes_;
+    std::unordered_map<std::string, uint32_t> pending_new_;    // Queued new orders by id (guarded by mutex_)
+    std::atomic<uint64_t> total_depth_{0};
+    bool stopping_ = false;
+    std::thread worker_;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_COMMAND_DISPATCHER_HPP
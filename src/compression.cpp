@@ -0,0 +1,260 @@
+#include "compression.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <mutex>
+#include <zlib.h>
+
+// CMake defines these when it finds the libraries (see src/CMakeLists.txt)
+#ifdef ORDERBOOK_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef ORDERBOOK_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace orderbook {
+
+const char* content_encoding_name(ContentEncoding encoding) {
+    switch (encoding) {
+        case ContentEncoding::Gzip: return "gzip";
+        case ContentEncoding::Brotli: return "br";
+        case ContentEncoding::Zstd: return "zstd";
+        default: return "identity";
+    }
+}
+
+bool content_encoding_available(ContentEncoding encoding) {
+    switch (encoding) {
+#ifdef ORDERBOOK_WITH_BROTLI
+        case ContentEncoding::Brotli: return true;
+#endif
+#ifdef ORDERBOOK_WITH_ZSTD
+        case ContentEncoding::Zstd: return true;
+#endif
+        case ContentEncoding::Identity:
+        case ContentEncoding::Gzip: return true;
+        default: return false;
+    }
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+static bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+ContentEncoding negotiate_encoding(std::string_view accept_encoding) {
+    // Ties go to the earlier entry
+    constexpr ContentEncoding preference[] = {ContentEncoding::Zstd, ContentEncoding::Brotli, ContentEncoding::Gzip};
+    double q[CONTENT_ENCODING_COUNT] = {};
+    bool listed[CONTENT_ENCODING_COUNT] = {};
+    double wildcard = -1;  // -1: no "*" in the header
+
+    while (!accept_encoding.empty()) {
+        auto comma = accept_encoding.find(',');
+        auto item = accept_encoding.substr(0, comma);
+        accept_encoding.remove_prefix(comma == std::string_view::npos ? accept_encoding.size() : comma + 1);
+
+        auto semi = item.find(';');
+        auto coding = trim(item.substr(0, semi));
+        double weight = 1.0;
+        if (semi != std::string_view::npos) {
+            auto param = trim(item.substr(semi + 1));
+            if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                weight = std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+            }
+        }
+        if (coding == "*") {
+            wildcard = weight;
+            continue;
+        }
+        for (auto e : preference) {
+            if (iequals(coding, content_encoding_name(e)) || (e == ContentEncoding::Gzip && iequals(coding, "x-gzip"))) {
+                q[static_cast<size_t>(e)] = weight;
+                listed[static_cast<size_t>(e)] = true;
+            }
+        }
+    }
+
+    ContentEncoding best = ContentEncoding::Identity;
+    double best_q = 0;
+    for (auto e : preference) {
+        auto i = static_cast<size_t>(e);
+        double weight = listed[i] ? q[i] : std::max(wildcard, 0.0);
+        if (content_encoding_available(e) && weight > best_q) {
+            best = e;
+            best_q = weight;
+        }
+    }
+    return best;
+}
+
+bool compress_body(ContentEncoding encoding, std::string_view in, std::string& out, const CompressionOptions& options) {
+    StreamCompressor compressor(encoding, options);
+    return compressor.write(in, out, true);
+}
+
+// --- StreamCompressor ---
+// Only the state for the codec in use gets set up
+
+struct StreamCompressor::State {
+    bool ok = true;
+    bool zlib_ready = false;
+    z_stream zlib{};
+#ifdef ORDERBOOK_WITH_BROTLI
+    BrotliEncoderState* brotli = nullptr;
+#endif
+#ifdef ORDERBOOK_WITH_ZSTD
+    ZSTD_CCtx* zstd = nullptr;
+#endif
+
+    ~State() {
+        if (zlib_ready) deflateEnd(&zlib);
+#ifdef ORDERBOOK_WITH_BROTLI
+        if (brotli) BrotliEncoderDestroyInstance(brotli);
+#endif
+#ifdef ORDERBOOK_WITH_ZSTD
+        if (zstd) ZSTD_freeCCtx(zstd);
+#endif
+    }
+};
+
+StreamCompressor::StreamCompressor(ContentEncoding encoding, const CompressionOptions& options)
+    : encoding_(encoding), state_(std::make_unique<State>()) {
+    auto& s = *state_;
+    switch (encoding) {
+        case ContentEncoding::Gzip:
+            // 15 window bits, +16 for the gzip wrapper rather than raw zlib
+            s.zlib_ready = deflateInit2(&s.zlib, options.gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            s.ok = s.zlib_ready;
+            break;
+#ifdef ORDERBOOK_WITH_BROTLI
+        case ContentEncoding::Brotli:
+            s.brotli = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+            s.ok = s.brotli && BrotliEncoderSetParameter(s.brotli, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(options.brotli_quality));
+            break;
+#endif
+#ifdef ORDERBOOK_WITH_ZSTD
+        case ContentEncoding::Zstd:
+            s.zstd = ZSTD_createCCtx();
+            s.ok = s.zstd && !ZSTD_isError(ZSTD_CCtx_setParameter(s.zstd, ZSTD_c_compressionLevel, options.zstd_level));
+            break;
+#endif
+        case ContentEncoding::Identity:
+            break;
+        default:
+            s.ok = false;  // Not built in
+    }
+}
+
+StreamCompressor::~StreamCompressor() = default;
+
+bool StreamCompressor::write(std::string_view in, std::string& out, bool finish) {
+    auto& s = *state_;
+    if (!s.ok) return false;
+    // Grows out a block at a time; whatever the codec doesn't fill is trimmed off
+    constexpr size_t BLOCK = 16 * 1024;
+
+    switch (encoding_) {
+        case ContentEncoding::Identity:
+            out.append(in);
+            return true;
+
+        case ContentEncoding::Gzip: {
+            s.zlib.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+            s.zlib.avail_in = static_cast<uInt>(in.size());
+            int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+            int rc;
+            do {
+                size_t used = out.size();
+                out.resize(used + BLOCK);
+                s.zlib.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+                s.zlib.avail_out = BLOCK;
+                rc = deflate(&s.zlib, flush);
+                out.resize(used + BLOCK - s.zlib.avail_out);
+                if (rc == Z_STREAM_ERROR) return s.ok = false;
+            } while (s.zlib.avail_out == 0 || (finish && rc != Z_STREAM_END));
+            return true;
+        }
+
+#ifdef ORDERBOOK_WITH_BROTLI
+        case ContentEncoding::Brotli: {
+            size_t avail_in = in.size();
+            auto next_in = reinterpret_cast<const uint8_t*>(in.data());
+            auto op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+            do {
+                size_t used = out.size();
+                out.resize(used + BLOCK);
+                size_t avail_out = BLOCK;
+                auto next_out = reinterpret_cast<uint8_t*>(out.data() + used);
+                if (!BrotliEncoderCompressStream(s.brotli, op, &avail_in, &next_in, &avail_out, &next_out, nullptr)) {
+                    out.resize(used);
+                    return s.ok = false;
+                }
+                out.resize(used + BLOCK - avail_out);
+            } while (avail_in > 0 || BrotliEncoderHasMoreOutput(s.brotli) || (finish && !BrotliEncoderIsFinished(s.brotli)));
+            return true;
+        }
+#endif
+
+#ifdef ORDERBOOK_WITH_ZSTD
+        case ContentEncoding::Zstd: {
+            ZSTD_inBuffer input{in.data(), in.size(), 0};
+            auto mode = finish ? ZSTD_e_end : ZSTD_e_continue;
+            size_t remaining;
+            do {
+                size_t used = out.size();
+                out.resize(used + BLOCK);
+                ZSTD_outBuffer output{out.data() + used, BLOCK, 0};
+                remaining = ZSTD_compressStream2(s.zstd, &output, &input, mode);
+                out.resize(used + output.pos);
+                if (ZSTD_isError(remaining)) return s.ok = false;
+            } while (finish ? remaining != 0 : input.pos < input.size);
+            return true;
+        }
+#endif
+
+        default:
+            return false;
+    }
+}
+
+// --- VersionedBodyCache ---
+
+VersionedBodyCache::Body VersionedBodyCache::find(const std::string& key, uint64_t version, ContentEncoding encoding) const {
+    std::shared_lock lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.version != version) return nullptr;
+    return it->second.bodies[static_cast<size_t>(encoding)];
+}
+
+void VersionedBodyCache::store(const std::string& key, uint64_t version, ContentEncoding encoding, Body body) {
+    std::unique_lock lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        if (entries_.size() >= max_keys_) entries_.erase(entries_.begin());
+        it = entries_.emplace(key, Entry{}).first;
+        it->second.version = version;
+    }
+    auto& entry = it->second;
+    if (version < entry.version) return;  // A slower request finishing late
+    if (version > entry.version) {
+        entry.version = version;
+        entry.bodies = {};
+    }
+    entry.bodies[static_cast<size_t>(encoding)] = std::move(body);
+}
+
+size_t VersionedBodyCache::size() const {
+    std::shared_lock lock(mutex_);
+    return entries_.size();
+}
+
+} // namespace orderbook
@@ -0,0 +1,106 @@
+#ifndef ORDERBOOK_COMPRESSION_HPP
+#define ORDERBOOK_COMPRESSION_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace orderbook {
+
+// Content codings we can send. gzip is always built in (zlib comes with
+// Drogon); zstd and brotli only when their libraries were found at build time.
+enum class ContentEncoding : uint8_t { Identity, Gzip, Brotli, Zstd };
+constexpr size_t CONTENT_ENCODING_COUNT = 4;
+
+// The Content-Encoding token ("gzip", "br", "zstd"; "identity" for none)
+const char* content_encoding_name(ContentEncoding encoding);
+bool content_encoding_available(ContentEncoding encoding);
+
+struct CompressionOptions {
+    bool enabled = true;
+    // Bodies smaller than this go out as they are - under a packet or two the
+    // codec costs more than the bytes it saves
+    size_t min_bytes = 1024;
+    // Middling levels: these run on the IO threads for whatever isn't cached
+    int gzip_level = 6;
+    int brotli_quality = 5;
+    int zstd_level = 3;
+};
+
+/**
+ * Pick a coding for a response from the request's Accept-Encoding
+ *
+ * Honours q-values (q=0 rules a coding out) and "*". When several codings
+ * tie for the highest q, zstd wins over br over gzip. Identity when nothing
+ * acceptable is available, including when the header is empty.
+ */
+ContentEncoding negotiate_encoding(std::string_view accept_encoding);
+
+// Whole-body compression. Appends to out; false if the codec failed or isn't built in.
+bool compress_body(ContentEncoding encoding, std::string_view in, std::string& out,
+                   const CompressionOptions& options = {});
+
+/**
+ * Incremental compressor for chunked responses
+ *
+ * Feed it the body a piece at a time; each write appends whatever compressed
+ * output is ready (possibly nothing) and the write with finish set ends the
+ * stream. Memory stays at the codec's window however long the body is.
+ */
+class StreamCompressor {
+public:
+    StreamCompressor(ContentEncoding encoding, const CompressionOptions& options = {});
+    ~StreamCompressor();
+    StreamCompressor(const StreamCompressor&) = delete;
+    StreamCompressor& operator=(const StreamCompressor&) = delete;
+
+    // False once the codec has failed; nothing more should be sent then
+    bool write(std::string_view in, std::string& out, bool finish);
+    ContentEncoding encoding() const { return encoding_; }
+
+private:
+    struct State;
+    ContentEncoding encoding_;
+    std::unique_ptr<State> state_;
+};
+
+/**
+ * Response bodies keyed by request, valid for one version of their source
+ *
+ * For read endpoints that are polled far more often than what they show
+ * changes (book depth): the first request at a version serializes and
+ * compresses, everyone after it at the same version gets the stored bytes.
+ * Each key holds the bodies for a single version - storing a newer one drops
+ * the rest. Capped at max_keys; past that, an arbitrary key is evicted.
+ */
+class VersionedBodyCache {
+public:
+    using Body = std::shared_ptr<const std::string>;
+
+    explicit VersionedBodyCache(size_t max_keys = 1024) : max_keys_(max_keys) {}
+
+    // The body stored for key in this encoding at exactly this version, or null
+    Body find(const std::string& key, uint64_t version, ContentEncoding encoding) const;
+    // Older versions are ignored; a newer one replaces whatever the key held
+    void store(const std::string& key, uint64_t version, ContentEncoding encoding, Body body);
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        uint64_t version = 0;
+        std::array<Body, CONTENT_ENCODING_COUNT> bodies;
+    };
+    size_t max_keys_;
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_COMPRESSION_HPP
@@ -0,0 +1,114 @@
+#include "db_schema.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace orderbook {
+
+namespace {
+
+struct Migration {
+    int version;
+    const char* description;
+    std::vector<std::string> statements;
+};
+
+// Append-only: never edit a step that has shipped, add a new one instead
+const std::vector<Migration>& migrations() {
+    static const std::vector<Migration> steps = {
+        {1, "baseline tables", {
+            "CREATE TABLE IF NOT EXISTS orders (id TEXT PRIMARY KEY, symbol TEXT, side TEXT, type TEXT, price BIGINT, quantity BIGINT, user_id TEXT, status TEXT);",
+            "CREATE TABLE IF NOT EXISTS actions (action TEXT, order_id TEXT, price BIGINT, quantity BIGINT, ts TIMESTAMPTZ DEFAULT NOW());",
+            "CREATE TABLE IF NOT EXISTS trades (symbol TEXT, buy_order_id TEXT, sell_order_id TEXT, price BIGINT, quantity BIGINT, ts TIMESTAMPTZ DEFAULT NOW());",
+            "CREATE TABLE IF NOT EXISTS users (id SERIAL PRIMARY KEY, username TEXT UNIQUE NOT NULL, password_hash TEXT NOT NULL, created_at TIMESTAMPTZ DEFAULT NOW());",
+            "CREATE TABLE IF NOT EXISTS accounts (user_id TEXT PRIMARY KEY, cash BIGINT NOT NULL DEFAULT 0, volume BIGINT NOT NULL DEFAULT 0, trade_count BIGINT NOT NULL DEFAULT 0);",
+            "CREATE TABLE IF NOT EXISTS positions (user_id TEXT NOT NULL, symbol TEXT NOT NULL, quantity BIGINT NOT NULL DEFAULT 0, cost_basis BIGINT NOT NULL DEFAULT 0, realized_pnl BIGINT NOT NULL DEFAULT 0, PRIMARY KEY (user_id, symbol));"
+        }},
+        {2, "time-partitioned trades/actions, history indexes, trade participants", {
+            // Orders get timestamps so history can be paged by (ts, id)
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS filled BIGINT NOT NULL DEFAULT 0;",
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS ts TIMESTAMPTZ NOT NULL DEFAULT NOW();",
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS updated_at TIMESTAMPTZ NOT NULL DEFAULT NOW();",
+            "CREATE INDEX IF NOT EXISTS orders_user_ts_idx ON orders (user_id, ts DESC, id DESC);",
+            "CREATE INDEX IF NOT EXISTS orders_symbol_ts_idx ON orders (symbol, ts DESC, id DESC);",
+
+            // One partition per UTC month, named <table>_YYYYMM
+            "CREATE OR REPLACE FUNCTION create_monthly_partitions(parent TEXT, from_ts TIMESTAMPTZ, to_ts TIMESTAMPTZ) RETURNS void AS $$ "
+            "DECLARE m TIMESTAMPTZ := date_trunc('month', from_ts AT TIME ZONE 'UTC') AT TIME ZONE 'UTC'; "
+            "BEGIN "
+            "  WHILE m <= to_ts LOOP "
+            "    EXECUTE format('CREATE TABLE IF NOT EXISTS %I PARTITION OF %I FOR VALUES FROM (%L) TO (%L)', "
+            "                   parent || '_' || to_char(m AT TIME ZONE 'UTC', 'YYYYMM'), parent, m, m + INTERVAL '1 month'); "
+            "    m := m + INTERVAL '1 month'; "
+            "  END LOOP; "
+            "END $$ LANGUAGE plpgsql;",
+
+            // Trades: rebuild as a partitioned table that also records who traded
+            "ALTER TABLE trades RENAME TO trades_unpartitioned;",
+            "CREATE TABLE trades (id BIGINT GENERATED ALWAYS AS IDENTITY, symbol TEXT NOT NULL, buy_order_id TEXT, sell_order_id TEXT, "
+            "buy_user_id TEXT, sell_user_id TEXT, price BIGINT NOT NULL, quantity BIGINT NOT NULL, ts TIMESTAMPTZ NOT NULL DEFAULT NOW()) PARTITION BY RANGE (ts);",
+            "CREATE TABLE trades_default PARTITION OF trades DEFAULT;",
+            "SELECT create_monthly_partitions('trades', COALESCE((SELECT MIN(ts) FROM trades_unpartitioned), NOW()), NOW() + INTERVAL '3 months');",
+            "INSERT INTO trades (symbol, buy_order_id, sell_order_id, price, quantity, ts) "
+            "SELECT symbol, buy_order_id, sell_order_id, price, quantity, COALESCE(ts, NOW()) FROM trades_unpartitioned ORDER BY ts;",
+            "DROP TABLE trades_unpartitioned;",
+            "CREATE INDEX trades_buy_user_ts_idx ON trades (buy_user_id, ts DESC, id DESC);",
+            "CREATE INDEX trades_sell_user_ts_idx ON trades (sell_user_id, ts DESC, id DESC);",
+            "CREATE INDEX trades_symbol_ts_idx ON trades (symbol, ts DESC, id DESC);",
+
+            // Actions: same treatment, replay reads them in (ts, id) order
+            "ALTER TABLE actions RENAME TO actions_unpartitioned;",
+            "CREATE TABLE actions (id BIGINT GENERATED ALWAYS AS IDENTITY, action TEXT NOT NULL, order_id TEXT NOT NULL, price BIGINT, quantity BIGINT, "
+            "ts TIMESTAMPTZ NOT NULL DEFAULT NOW()) PARTITION BY RANGE (ts);",
+            "CREATE TABLE actions_default PARTITION OF actions DEFAULT;",
+            "SELECT create_monthly_partitions('actions', COALESCE((SELECT MIN(ts) FROM actions_unpartitioned), NOW()), NOW() + INTERVAL '3 months');",
+            "INSERT INTO actions (action, order_id, price, quantity, ts) "
+            "SELECT action, order_id, price, quantity, COALESCE(ts, NOW()) FROM actions_unpartitioned ORDER BY ts;",
+            "DROP TABLE actions_unpartitioned;",
+            "CREATE INDEX actions_ts_idx ON actions (ts, id);",
+            "CREATE INDEX actions_order_idx ON actions (order_id);"
+        }},
+        {3, "write ids on trades/actions so retried inserts are skipped", {
+            // Unique indexes on a partitioned table have to include the partition key, so the writer
+            // sends ts along with write_id and a retry lands on the same (write_id, ts)
+            "ALTER TABLE trades ADD COLUMN IF NOT EXISTS write_id TEXT;",
+            "CREATE UNIQUE INDEX IF NOT EXISTS trades_write_id_idx ON trades (write_id, ts);",
+            "ALTER TABLE actions ADD COLUMN IF NOT EXISTS write_id TEXT;",
+            "CREATE UNIQUE INDEX IF NOT EXISTS actions_write_id_idx ON actions (write_id, ts);"
+        }},
+        {4, "everything restore needs to put an order back as it was", {
+            // orders.ts (migration 2) now carries the order's own arrival time
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS stop_price BIGINT NOT NULL DEFAULT 0;",
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS tif TEXT NOT NULL DEFAULT 'GTC';",
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS expiry BIGINT NOT NULL DEFAULT 0;",
+            "ALTER TABLE orders ADD COLUMN IF NOT EXISTS is_quote BOOLEAN NOT NULL DEFAULT false;"
+        }},
+    };
+    return steps;
+}
+
+} // namespace
+
+void migrate_schema(const drogon::orm::DbClientPtr& db) {
+    db->execSqlSync("CREATE TABLE IF NOT EXISTS schema_version (version INT PRIMARY KEY, description TEXT, applied_at TIMESTAMPTZ DEFAULT NOW());");
+    for (const auto& step : migrations()) {
+        auto tx = db->newTransaction();
+        // Serialize servers starting at the same time, then re-check under the lock
+        tx->execSqlSync("SELECT pg_advisory_xact_lock(7244001);");
+        auto applied = tx->execSqlSync("SELECT 1 FROM schema_version WHERE version = $1;", step.version);
+        if (!applied.empty()) continue;
+        std::cout << "[DB] Applying migration " << step.version << ": " << step.description << std::endl;
+        for (const auto& sql : step.statements) tx->execSqlSync(sql);
+        tx->execSqlSync("INSERT INTO schema_version (version, description) VALUES ($1, $2);", step.version, std::string(step.description));
+        // The transaction commits when tx goes out of scope; an exception above rolls it back
+    }
+}
+
+void ensure_partitions(const drogon::orm::DbClientPtr& db, int months_ahead) {
+    std::string horizon = std::to_string(months_ahead) + " months";
+    for (const char* table : {"trades", "actions"}) {
+        db->execSqlSync("SELECT create_monthly_partitions($1, NOW(), NOW() + $2::interval);", std::string(table), horizon);
+    }
+}
+
+} // namespace orderbook
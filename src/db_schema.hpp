@@ -0,0 +1,21 @@
+#ifndef ORDERBOOK_DB_SCHEMA_HPP
+#define ORDERBOOK_DB_SCHEMA_HPP
+
+#include <drogon/orm/DbClient.h>
+
+namespace orderbook {
+
+// Versioned schema migrations
+//
+// Each step runs once, in its own transaction, and is recorded in the
+// schema_version table - so a fresh database and one created by an older
+// build both end up on the same schema. Throws if a step fails.
+void migrate_schema(const drogon::orm::DbClientPtr& db);
+
+// Make sure trades and actions have monthly partitions from the current month
+// through months_ahead months out. Anything outside lands in the default partition.
+void ensure_partitions(const drogon::orm::DbClientPtr& db, int months_ahead = 3);
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_DB_SCHEMA_HPP
@@ -0,0 +1,214 @@
+#include "fast_json.hpp"
+#include <charconv>
+
+namespace orderbook {
+
+namespace {
+
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+    bool eat(char c) {
+        skip_ws();
+        if (p < end && *p == c) { ++p; return true; }
+        return false;
+    }
+    // A string with no escapes or control characters; anything else is left to jsoncpp
+    bool string(std::string_view& out) {
+        if (!eat('"')) return false;
+        const char* start = p;
+        while (p < end && *p != '"') {
+            auto c = static_cast<unsigned char>(*p);
+            if (c == '\\' || c < 0x20) return false;
+            ++p;
+        }
+        if (p == end) return false;
+        out = std::string_view(start, p - start);
+        ++p;
+        return true;
+    }
+    bool literal(std::string_view word) {
+        if (static_cast<size_t>(end - p) < word.size() || std::string_view(p, word.size()) != word) return false;
+        p += word.size();
+        return true;
+    }
+};
+
+bool parse_uint64(std::string_view text, uint64_t& v) {
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), v);
+    return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+} // namespace
+
+FlatJsonObject::FlatJsonObject(std::pmr::memory_resource* mr) : fields_(mr) {
+    fields_.reserve(16);
+}
+
+bool FlatJsonObject::parse(std::string_view json) {
+    fields_.clear();
+    Cursor c{json.data(), json.data() + json.size()};
+    if (!c.eat('{')) return false;
+    if (c.eat('}')) {
+        c.skip_ws();
+        return c.p == c.end;
+    }
+    do {
+        Field f;
+        if (!c.string(f.key) || !c.eat(':')) return false;
+        c.skip_ws();
+        if (c.p == c.end) return false;
+        char first = *c.p;
+        if (first == '"') {
+            if (!c.string(f.text)) return false;
+            f.kind = Kind::String;
+        } else if (first >= '0' && first <= '9') {
+            // Whole, non-negative and in range only - jsoncpp decides the rest
+            const char* start = c.p;
+            while (c.p < c.end && *c.p >= '0' && *c.p <= '9') ++c.p;
+            f.text = std::string_view(start, c.p - start);
+            uint64_t ignored;
+            if ((f.text.size() > 1 && first == '0') || !parse_uint64(f.text, ignored)) return false;
+            if (c.p < c.end && (*c.p == '.' || *c.p == 'e' || *c.p == 'E')) return false;
+            f.kind = Kind::Number;
+        } else if (first == 't' || first == 'f') {
+            const char* start = c.p;
+            if (!c.literal(first == 't' ? "true" : "false")) return false;
+            f.text = std::string_view(start, c.p - start);
+            f.kind = Kind::Bool;
+        } else if (c.literal("null")) {
+            f.text = "null";
+            f.kind = Kind::Null;
+        } else {
+            return false;
+        }
+        fields_.push_back(f);
+    } while (c.eat(','));
+    if (!c.eat('}')) return false;
+    c.skip_ws();
+    return c.p == c.end;
+}
+
+const FlatJsonObject::Field* FlatJsonObject::find(std::string_view key) const {
+    for (auto it = fields_.rbegin(); it != fields_.rend(); ++it) {
+        if (it->key == key) return &*it;
+    }
+    return nullptr;
+}
+
+bool FlatJsonObject::is_string(std::string_view key) const {
+    auto f = find(key);
+    return f && f->kind == Kind::String;
+}
+
+bool FlatJsonObject::is_uint64(std::string_view key) const {
+    auto f = find(key);
+    return f && f->kind == Kind::Number;
+}
+
+std::string_view FlatJsonObject::string(std::string_view key) const {
+    auto f = find(key);
+    return f && f->kind == Kind::String ? f->text : std::string_view();
+}
+
+uint64_t FlatJsonObject::uint64(std::string_view key) const {
+    auto f = find(key);
+    uint64_t v = 0;
+    if (f && f->kind == Kind::Number) parse_uint64(f->text, v);
+    return v;
+}
+
+JsonWriter::JsonWriter(std::pmr::memory_resource* mr) : out_(mr) {
+    out_.reserve(512);
+}
+
+void JsonWriter::separate() {
+    if (need_comma_) out_ += ',';
+    need_comma_ = false;
+}
+
+JsonWriter& JsonWriter::begin_object() {
+    separate();
+    out_ += '{';
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_object() {
+    out_ += '}';
+    need_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::begin_array() {
+    separate();
+    out_ += '[';
+    return *this;
+}
+
+JsonWriter& JsonWriter::end_array() {
+    out_ += ']';
+    need_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view k) {
+    separate();
+    append_escaped(k);
+    out_ += ':';
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view s) {
+    separate();
+    append_escaped(s);
+    need_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(uint64_t v) {
+    separate();
+    char buf[24];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+    out_.append(buf, ptr);
+    need_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int64_t v) {
+    separate();
+    char buf[24];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+    out_.append(buf, ptr);
+    need_comma_ = true;
+    return *this;
+}
+
+void JsonWriter::append_escaped(std::string_view s) {
+    static constexpr char HEX[] = "0123456789abcdef";
+    out_ += '"';
+    for (char ch : s) {
+        auto c = static_cast<unsigned char>(ch);
+        switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out_ += "\\u00";
+                    out_ += HEX[c >> 4];
+                    out_ += HEX[c & 0xf];
+                } else {
+                    out_ += ch;
+                }
+        }
+    }
+    out_ += '"';
+}
+
+} // namespace orderbook
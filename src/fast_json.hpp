@@ -0,0 +1,85 @@
+#ifndef ORDERBOOK_FAST_JSON_HPP
+#define ORDERBOOK_FAST_JSON_HPP
+
+#include "request_arena.hpp"
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace orderbook {
+
+/**
+ * Allocation-free reader for flat JSON objects
+ *
+ * Order entry bodies are one object of strings and whole numbers, so there's
+ * no need for a full DOM: parse() records each field as a view into the
+ * request body. Anything outside that shape - nesting, escape sequences,
+ * fractions or exponents, comments - makes parse() return false, and the
+ * caller goes through jsoncpp instead. That keeps the answers identical to
+ * the jsoncpp path for every body this reader accepts.
+ */
+class FlatJsonObject {
+public:
+    enum class Kind { String, Number, Bool, Null };
+
+    struct Field {
+        std::string_view key;
+        std::string_view text;      // String contents without the quotes, or the literal
+        Kind kind;
+    };
+
+    explicit FlatJsonObject(std::pmr::memory_resource* mr = RequestArena::resource());
+
+    bool parse(std::string_view json);
+
+    // Later duplicates win, as in jsoncpp
+    const Field* find(std::string_view key) const;
+    bool has(std::string_view key) const { return find(key) != nullptr; }
+    bool is_string(std::string_view key) const;
+    bool is_uint64(std::string_view key) const;
+    std::string_view string(std::string_view key) const;
+    uint64_t uint64(std::string_view key) const;
+
+private:
+    std::pmr::vector<Field> fields_;
+};
+
+/**
+ * Appends compact JSON to an arena string
+ *
+ * The response side of the fast path - commas are placed automatically, so
+ * callers just nest begin/end calls around key/value pairs.
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::pmr::memory_resource* mr = RequestArena::resource());
+
+    JsonWriter& begin_object();
+    JsonWriter& end_object();
+    JsonWriter& begin_array();
+    JsonWriter& end_array();
+    JsonWriter& key(std::string_view k);
+    JsonWriter& value(std::string_view s);
+    JsonWriter& value(const char* s) { return value(std::string_view(s)); }
+    JsonWriter& value(uint64_t v);
+    JsonWriter& value(int64_t v);
+
+    template <typename T>
+    JsonWriter& field(std::string_view k, const T& v) { return key(k).value(v); }
+
+    std::string_view view() const { return out_; }
+    std::string str() const { return std::string(out_); }
+
+private:
+    void separate();
+    void append_escaped(std::string_view s);
+
+    std::pmr::string out_;
+    bool need_comma_ = false;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_FAST_JSON_HPP
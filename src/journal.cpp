@@ -0,0 +1,482 @@
+#include "journal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define ORDERBOOK_JOURNAL_IO_URING 1
+#endif
+
+namespace orderbook {
+
+namespace {
+
+constexpr size_t BLOCK = 4096;                  // O_DIRECT alignment
+constexpr size_t STAGING_BYTES = 1 << 20;       // Registered buffer size
+
+size_t round_up(size_t n) { return (n + BLOCK - 1) / BLOCK * BLOCK; }
+
+// Thin wrappers so the rest of the file doesn't care which OS it's on
+int open_segment_file(const std::string& path, bool direct) {
+#ifdef _WIN32
+    (void)direct;
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+    if (direct) flags |= O_DIRECT;
+#else
+    (void)direct;
+#endif
+    return ::open(path.c_str(), flags, 0644);
+#endif
+}
+
+bool write_at(int fd, const char* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+#ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        int n = _write(fd, data, static_cast<unsigned>(std::min<size_t>(len, 1 << 30)));
+#else
+        ssize_t n = ::pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool sync_fd(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#elif defined(__APPLE__)
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+void truncate_fd(int fd, uint64_t size) {
+#ifdef _WIN32
+    _chsize_s(fd, static_cast<__int64>(size));
+#else
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) std::perror("[JOURNAL] ftruncate");
+#endif
+}
+
+void close_fd(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Reserve disk blocks up front without changing the visible file size
+void preallocate(int fd, uint64_t bytes) {
+#ifdef __linux__
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(bytes)) != 0 && errno != EOPNOTSUPP) {
+        std::perror("[JOURNAL] fallocate");
+    }
+#else
+    (void)fd;
+    (void)bytes;
+#endif
+}
+
+} // namespace
+
+// ---- Backends ----
+
+// Moves the staging buffer to disk; the buffer is block aligned so it works with O_DIRECT
+class SegmentJournal::Backend {
+public:
+    Backend() : buffer_(static_cast<char*>(aligned_alloc_block(STAGING_BYTES))) {}
+    virtual ~Backend() { aligned_free_block(buffer_); }
+    // Write buffer()[0, len) at offset, then fdatasync if asked
+    virtual bool write(int fd, size_t len, uint64_t offset, bool sync) {
+        return write_at(fd, buffer_, len, offset) && (!sync || sync_fd(fd));
+    }
+    virtual bool is_io_uring() const { return false; }
+    char* buffer() { return buffer_; }
+    size_t capacity() const { return STAGING_BYTES; }
+
+private:
+    static void* aligned_alloc_block(size_t bytes) {
+#ifdef _WIN32
+        return _aligned_malloc(bytes, BLOCK);
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, BLOCK, bytes) == 0 ? p : nullptr;
+#endif
+    }
+    static void aligned_free_block(void* p) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+
+protected:
+    char* buffer_;
+};
+
+#ifdef ORDERBOOK_JOURNAL_IO_URING
+
+namespace {
+
+// Minimal io_uring driver straight on the kernel ABI - one writer thread, a handful of entries
+class IoUringBackend : public SegmentJournal::Backend {
+public:
+    ~IoUringBackend() override {
+        if (sqes_) munmap(sqes_, sqes_len_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_len_);
+        if (sq_ptr_) munmap(sq_ptr_, sq_len_);
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+    }
+
+    // False if the kernel (or a sandbox) won't give us a ring - use the plain backend then
+    bool init() {
+        if (!buffer_) return false;
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, 8, &p));
+        if (ring_fd_ < 0) return false;
+
+        sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+        sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) { sq_ptr_ = nullptr; return false; }
+        cq_ptr_ = single ? sq_ptr_ : mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) { cq_ptr_ = nullptr; return false; }
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto sq = static_cast<char*>(sq_ptr_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        auto cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        // Pin the staging buffer once so the kernel doesn't map it on every write
+        iovec iov{buffer_, capacity()};
+        return syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+    }
+
+    bool write(int fd, size_t len, uint64_t offset, bool sync) override {
+        size_t done = 0;
+        while (done < len) {
+            // The fdatasync rides behind the write as a linked entry - one syscall for both
+            io_uring_sqe* w = next_sqe();
+            w->opcode = IORING_OP_WRITE_FIXED;
+            w->fd = fd;
+            w->addr = reinterpret_cast<uint64_t>(buffer_ + done);
+            w->len = static_cast<uint32_t>(len - done);
+            w->off = offset + done;
+            w->buf_index = 0;
+            w->user_data = WRITE;
+            unsigned submitted = 1;
+            if (sync) {
+                w->flags = IOSQE_IO_LINK;
+                io_uring_sqe* f = next_sqe();
+                f->opcode = IORING_OP_FSYNC;
+                f->fd = fd;
+                f->fsync_flags = IORING_FSYNC_DATASYNC;
+                f->user_data = FSYNC;
+                submitted = 2;
+            }
+            int written = -1, synced = 0;
+            if (!submit_and_wait(submitted, [&](uint64_t tag, int res) {
+                    if (tag == WRITE) written = res; else synced = res;
+                })) {
+                return false;
+            }
+            if (written <= 0) {
+                errno = written < 0 ? -written : EIO;
+                return false;
+            }
+            done += static_cast<size_t>(written);
+            // A short write cancels the linked fsync - loop and send the rest with a fresh one
+            if (done == len && synced < 0) {
+                errno = -synced;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool is_io_uring() const override { return true; }
+
+private:
+    enum : uint64_t { WRITE = 1, FSYNC = 2 };
+
+    io_uring_sqe* next_sqe() {
+        unsigned tail = *sq_tail_ + pending_;
+        unsigned index = tail & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        pending_++;
+        return sqe;
+    }
+
+    template <typename Fn>
+    bool submit_and_wait(unsigned count, Fn&& on_complete) {
+        __atomic_store_n(sq_tail_, *sq_tail_ + pending_, __ATOMIC_RELEASE);
+        unsigned to_submit = pending_;
+        pending_ = 0;
+        unsigned reaped = 0;
+        while (reaped < count) {
+            long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, count - reaped, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(ret));
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                on_complete(cqe.user_data, cqe.res);
+                head++;
+                reaped++;
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+    int ring_fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_len_ = 0;
+    size_t cq_len_ = 0;
+    size_t sqes_len_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    unsigned pending_ = 0;
+};
+
+} // namespace
+
+#endif // ORDERBOOK_JOURNAL_IO_URING
+
+// ---- SegmentJournal ----
+
+SegmentJournal::SegmentJournal(Options options) : options_(std::move(options)) {}
+
+SegmentJournal::~SegmentJournal() {
+    stop();
+}
+
+std::string SegmentJournal::segment_name(const std::string& path, uint64_t index) {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".%06llu", static_cast<unsigned long long>(index));
+    return path + suffix;
+}
+
+bool SegmentJournal::start() {
+#ifdef ORDERBOOK_JOURNAL_IO_URING
+    if (options_.use_io_uring) {
+        auto uring = std::make_unique<IoUringBackend>();
+        if (uring->init()) {
+            backend_ = std::move(uring);
+        } else {
+            std::cerr << "[JOURNAL] io_uring unavailable (" << std::strerror(errno) << ") — using pwrite" << std::endl;
+        }
+    }
+#endif
+    if (!backend_) backend_ = std::make_unique<Backend>();
+    if (!backend_->buffer()) return false;
+
+    // Never append to an old segment - carry on after the highest one on disk
+    while (std::filesystem::exists(segment_name(options_.path, segment_index_ + 1))) segment_index_++;
+    if (!open_segment()) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+        stopping_ = false;
+    }
+    writer_ = std::thread(&SegmentJournal::writer_loop, this);
+    return true;
+}
+
+void SegmentJournal::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_ || stopping_) return;
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+    close_segment();
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+}
+
+bool SegmentJournal::open_segment() {
+    segment_index_++;
+    std::string name = segment_name(options_.path, segment_index_);
+    fd_ = open_segment_file(name, options_.direct);
+    if (fd_ < 0 && options_.direct) {
+        // Some filesystems (tmpfs) refuse O_DIRECT
+        std::cerr << "[JOURNAL] O_DIRECT not supported for " << name << " — using buffered writes" << std::endl;
+        options_.direct = false;
+        fd_ = open_segment_file(name, false);
+    }
+    if (fd_ < 0) {
+        std::cerr << "[JOURNAL] Can't open " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    preallocate(fd_, options_.segment_bytes);
+    segment_size_ = 0;
+    segments_++;
+    return true;
+}
+
+void SegmentJournal::close_segment() {
+    if (fd_ < 0) return;
+    // O_DIRECT writes pad the last block - cut the file back to what was appended
+    if (options_.direct) truncate_fd(fd_, segment_size_);
+    sync_fd(fd_);
+    close_fd(fd_);
+    fd_ = -1;
+}
+
+void SegmentJournal::append(std::string_view data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.append(data.data(), data.size());
+    appended_bytes_ += data.size();
+    if (pending_.size() >= STAGING_BYTES) work_cv_.notify_one();
+}
+
+bool SegmentJournal::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = appended_bytes_;
+    flush_requested_ = true;
+    work_cv_.notify_one();
+    done_cv_.wait(lock, [&] { return std::max(durable_bytes_, failed_bytes_) >= target || !running_; });
+    // Nothing appended yet means nothing to lose
+    return target == 0 || (durable_bytes_ >= target && failed_bytes_ < target);
+}
+
+SegmentJournal::Stats SegmentJournal::stats() const {
+    Stats s;
+    s.bytes = bytes_.load();
+    s.batches = batches_.load();
+    s.segments = segments_.load();
+    s.errors = errors_.load();
+    s.io_uring = backend_ && backend_->is_io_uring();
+    return s;
+}
+
+bool SegmentJournal::write_batch(const std::string& batch) {
+    if (fd_ < 0) return false;
+    char* buf = backend_->buffer();
+    size_t pos = 0;
+    while (pos < batch.size()) {
+        // With O_DIRECT the staging buffer starts at the last block boundary, so the
+        // partial block left over from the previous write goes out again with the new bytes
+        size_t tail = options_.direct ? segment_size_ % BLOCK : 0;
+        size_t n = std::min(batch.size() - pos, backend_->capacity() - BLOCK - tail);
+        std::memcpy(buf + tail, batch.data() + pos, n);
+        size_t len = tail + n;
+        size_t io_len = len;
+        if (options_.direct) {
+            io_len = round_up(len);
+            std::memset(buf + len, 0, io_len - len);
+        }
+        bool last = pos + n == batch.size();
+        if (!backend_->write(fd_, io_len, segment_size_ - tail, options_.sync && last)) {
+            std::cerr << "[JOURNAL] Write to segment " << segment_index_ << " failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        segment_size_ += n;
+        pos += n;
+        if (options_.direct) {
+            size_t keep = segment_size_ % BLOCK;
+            std::memmove(buf, buf + len - keep, keep);
+        }
+    }
+    return true;
+}
+
+void SegmentJournal::writer_loop() {
+    std::string batch;
+    while (true) {
+        uint64_t upto;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cv_.wait_for(lock, options_.flush_interval, [&] {
+                return stopping_ || flush_requested_ || pending_.size() >= STAGING_BYTES;
+            });
+            flush_requested_ = false;
+            stopping = stopping_;
+            batch.swap(pending_);
+            upto = appended_bytes_;
+        }
+        bool ok = true;
+        if (!batch.empty()) {
+            ok = write_batch(batch);
+            if (ok) {
+                bytes_ += batch.size();
+            } else {
+                errors_++;
+            }
+            batches_++;
+            batch.clear();
+            // Rotate between batches so a record never straddles two segments
+            if (segment_size_ >= options_.segment_bytes) {
+                close_segment();
+                if (!open_segment()) errors_++;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (ok) {
+                durable_bytes_ = upto;
+            } else {
+                failed_bytes_ = upto;
+            }
+        }
+        done_cv_.notify_all();
+        if (stopping) break;
+    }
+}
+
+} // namespace orderbook
@@ -0,0 +1,101 @@
+#ifndef ORDERBOOK_JOURNAL_HPP
+#define ORDERBOOK_JOURNAL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace orderbook {
+
+/**
+ * Segmented append-only journal for audit and event logs
+ *
+ * append() only copies the bytes into a memory buffer; a background thread
+ * moves them to disk. On Linux that thread drives an io_uring: the data is
+ * written from a registered buffer, and the fdatasync is linked behind the
+ * write so a whole batch costs one io_uring_enter. Where io_uring isn't
+ * available (old kernel, seccomp, other OS) it falls back to pwrite + fdatasync.
+ *
+ * Files are "<path>.000001", "<path>.000002", ... A new segment starts once the
+ * current one passes segment_bytes; segments are preallocated so appends don't
+ * have to extend the file's block map. With direct on, writes bypass the page
+ * cache (O_DIRECT) and the partial last block is rewritten by the next batch.
+ */
+class SegmentJournal {
+public:
+    struct Options {
+        std::string path = "orderbook.log";
+        uint64_t segment_bytes = 64ull << 20;
+        std::chrono::microseconds flush_interval{1000};
+        bool sync = true;               // fdatasync every batch
+        bool direct = false;            // O_DIRECT segments (Linux)
+        bool use_io_uring = true;       // Set false to force the pwrite path
+    };
+
+    struct Stats {
+        uint64_t bytes = 0;
+        uint64_t batches = 0;
+        uint64_t segments = 0;
+        uint64_t errors = 0;
+        bool io_uring = false;          // Which path the writer ended up on
+    };
+
+    explicit SegmentJournal(Options options);
+    ~SegmentJournal();
+
+    SegmentJournal(const SegmentJournal&) = delete;
+    SegmentJournal& operator=(const SegmentJournal&) = delete;
+
+    // Open the next free segment and start the writer
+    bool start();
+    // Write out whatever is buffered and close the segment
+    void stop();
+
+    void append(std::string_view data);
+    // Block until everything appended so far is on disk; false if the batch it was in failed
+    bool flush();
+
+    Stats stats() const;
+    static std::string segment_name(const std::string& path, uint64_t index);
+
+    class Backend;
+
+private:
+    void writer_loop();
+    bool open_segment();
+    void close_segment();
+    bool write_batch(const std::string& batch);
+
+    Options options_;
+    std::unique_ptr<Backend> backend_;
+    int fd_ = -1;
+    uint64_t segment_index_ = 0;
+    uint64_t segment_size_ = 0;         // Logical bytes in the current segment
+    std::thread writer_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::string pending_;
+    uint64_t appended_bytes_ = 0;
+    uint64_t durable_bytes_ = 0;        // Only advances when a batch's write and fdatasync both succeed
+    uint64_t failed_bytes_ = 0;         // End of the newest batch that didn't make it to disk
+    bool flush_requested_ = false;
+    bool stopping_ = false;
+    bool running_ = false;
+
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> segments_{0};
+    std::atomic<uint64_t> errors_{0};
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_JOURNAL_HPP
@@ -1,25 +1,90 @@
 #include "matching_engine.hpp"
-#include <iostream> // For logging
+#include <chrono>
 
 namespace orderbook {
 
 MatchingEngine::MatchingEngine() {}
 
-std::vector<Trade> MatchingEngine::add_order(std::shared_ptr<Order> order) 
+OrderBook& MatchingEngine::get_or_create_book(const std::string& symbol)
 {
-    std::unique_lock<std::shared_mutex> lock(engine_mutex_);
-    auto [it, inserted] = order_books_.try_emplace(order->symbol, order->symbol);
+    auto [it, inserted] = order_books_.try_emplace(symbol, symbol);
     auto& book = it->second;
-    // Set up callbacks for engine-wide events
-    book.set_trade_callback([this](const Trade& t) {
-        stats_.total_trades++;
-        stats_.total_volume += t.quantity;
-        add_trade_history(t); // Store trade in history
-        if (on_trade) on_trade(t);
-    });
-    book.set_order_update_callback([this](const Order& o) {
-        if (on_order_update) on_order_update(o);
-    });
+    if (inserted) {
+        // Set up callbacks for engine-wide events
+        book.set_trade_callback([this](const Trade& t) {
+            stats_.total_trades++;
+            stats_.total_volume += t.quantity;
+            add_trade_history(t); // Store trade in history
+            if (on_trade) on_trade(t);
+        });
+        book.set_order_update_callback([this](const Order& o) {
+            if (on_order_update) on_order_update(o);
+        });
+        // MMP pulls happen inside the book, so the engine catches up its own index here
+        book.set_clock(clock_);
+        book.set_mmp_callback([this, symbol](const UserId& user_id, const std::vector<OrderId>& pulled) {
+            for (const auto& id : pulled) {
+                order_id_to_symbol_.erase(id);
+                if (stats_.total_orders > 0) stats_.total_orders--;
+            }
+            if (on_mmp_trigger) on_mmp_trigger(symbol, user_id, pulled);
+        });
+    }
+    return book;
+}
+
+std::unique_lock<std::shared_mutex> MatchingEngine::write_lock() const {
+    std::unique_lock<std::shared_mutex> lock(engine_mutex_, std::try_to_lock);
+    uint64_t waited = 0;
+    // The uncontended path stays clock-free
+    if (!lock.owns_lock()) {
+        lock_waiters_.fetch_add(1, std::memory_order_relaxed);
+        auto t0 = std::chrono::steady_clock::now();
+        lock.lock();
+        waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+        lock_waiters_.fetch_sub(1, std::memory_order_relaxed);
+        lock_contended_.fetch_add(1, std::memory_order_relaxed);
+        lock_wait_ns_.fetch_add(waited, std::memory_order_relaxed);
+    }
+    lock_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+    // We hold the lock, so this read-modify-write can't race another writer
+    uint64_t ewma = lock_wait_ewma_ns_.load(std::memory_order_relaxed);
+    lock_wait_ewma_ns_.store(ewma - ewma / 16 + waited / 16, std::memory_order_relaxed);
+    return lock;
+}
+
+void MatchingEngine::ensure_book(const std::string& symbol) {
+    auto lock = write_lock();
+    get_or_create_book(symbol);
+}
+
+void MatchingEngine::reserve(size_t orders, size_t trades) {
+    auto lock = write_lock();
+    order_id_to_symbol_.reserve(orders);
+    trade_history_.reserve(trades);
+}
+
+void MatchingEngine::set_clock(const Clock* clock) {
+    auto lock = write_lock();
+    clock_ = clock;
+    for (auto& [_, book] : order_books_) book.set_clock(clock);
+}
+
+EngineLockStats MatchingEngine::lock_stats() const {
+    EngineLockStats s;
+    s.acquisitions = lock_acquisitions_.load(std::memory_order_relaxed);
+    s.contended = lock_contended_.load(std::memory_order_relaxed);
+    s.wait_ns_total = lock_wait_ns_.load(std::memory_order_relaxed);
+    s.wait_ewma_ns = lock_wait_ewma_ns_.load(std::memory_order_relaxed);
+    s.waiters = lock_waiters_.load(std::memory_order_relaxed);
+    return s;
+}
+
+std::vector<Trade> MatchingEngine::add_order(std::shared_ptr<Order> order) 
+{
+    auto lock = write_lock();
+    if (clock_) order->timestamp = clock_->now();
+    auto& book = get_or_create_book(order->symbol);
     auto trades = book.add_order(order);
     order_id_to_symbol_[order->id] = order->symbol;
     // Maintaining total_orders as a counter to avoid deadlock
@@ -29,11 +94,9 @@ std::vector<Trade> MatchingEngine::add_order(std::shared_ptr<Order> order)
 
 bool MatchingEngine::cancel_order(OrderId order_id) 
 {
-    std::cout << "[LOG] MatchingEngine::cancel_order ENTER id=" << order_id << std::endl;
-    std::unique_lock<std::shared_mutex> lock(engine_mutex_);
+    auto lock = write_lock();
     auto it = order_id_to_symbol_.find(order_id);
     if (it == order_id_to_symbol_.end()) {
-        std::cout << "[LOG] MatchingEngine::cancel_order NOT FOUND id=" << order_id << std::endl;
         return false;
     }
     auto [book_it, inserted] = order_books_.try_emplace(it->second, it->second);
@@ -44,12 +107,62 @@ bool MatchingEngine::cancel_order(OrderId order_id)
         order_id_to_symbol_.erase(it);
         if (stats_.total_orders > 0) stats_.total_orders--; // Decrement counter
     }
-    std::cout << "[LOG] MatchingEngine::cancel_order EXIT id=" << order_id << std::endl;
     return result;
 }
 
+std::vector<OrderId> MatchingEngine::mass_cancel(const std::vector<OrderId>& order_ids, std::set<std::string>* symbols)
+{
+    auto lock = write_lock();
+    std::vector<OrderId> cancelled;
+    cancelled.reserve(order_ids.size());
+    for (const auto& order_id : order_ids) {
+        auto it = order_id_to_symbol_.find(order_id);
+        if (it == order_id_to_symbol_.end()) continue;
+        auto book_it = order_books_.find(it->second);
+        if (book_it == order_books_.end() || !book_it->second.cancel_order(order_id)) continue;
+        if (symbols) symbols->insert(it->second);
+        order_id_to_symbol_.erase(it);
+        if (stats_.total_orders > 0) stats_.total_orders--;
+        cancelled.push_back(order_id);
+    }
+    return cancelled;
+}
+
+std::vector<MassQuoteResult> MatchingEngine::mass_quote(const UserId& user_id,
+                                                        const std::vector<std::pair<std::string, std::vector<std::shared_ptr<Order>>>>& quote_sets)
+{
+    auto lock = write_lock();
+    std::vector<MassQuoteResult> results;
+    results.reserve(quote_sets.size());
+    for (const auto& [symbol, quotes] : quote_sets) {
+        auto& book = get_or_create_book(symbol);
+        if (clock_) {
+            for (const auto& quote : quotes) quote->timestamp = clock_->now();
+        }
+        auto result = book.mass_quote(user_id, quotes);
+        for (const auto& id : result.cancelled) {
+            order_id_to_symbol_.erase(id);
+            if (stats_.total_orders > 0) stats_.total_orders--;
+        }
+        for (const auto& order : result.placed) {
+            if (order->status == OrderStatus::REJECTED) continue;
+            order_id_to_symbol_[order->id] = symbol;
+            stats_.total_orders++;
+        }
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+void MatchingEngine::set_mmp(const std::string& symbol, const UserId& user_id, const MmpConfig& config)
+{
+    auto lock = write_lock();
+    get_or_create_book(symbol).set_mmp(user_id, config);
+}
+
 bool MatchingEngine::modify_order(OrderId order_id, Price new_price, Quantity new_quantity) {
-    std::shared_lock<std::shared_mutex> lock(engine_mutex_);
+    // Exclusive - a modify can re-enter the order and trade, which updates engine state
+    auto lock = write_lock();
     auto it = order_id_to_symbol_.find(order_id);
     if (it == order_id_to_symbol_.end()) return false;
     auto [book_it, inserted] = order_books_.try_emplace(it->second, it->second);
@@ -95,6 +208,19 @@ std::vector<OrderBookLevel> MatchingEngine::get_ask_levels(const std::string& sy
     return (it != order_books_.end()) ? it->second.get_ask_levels(depth) : std::vector<OrderBookLevel>{};
 }
 
+uint64_t MatchingEngine::get_depth(const std::string& symbol, size_t depth, std::vector<OrderBookLevel>& bids,
+                                   std::vector<OrderBookLevel>& asks) const {
+    std::shared_lock<std::shared_mutex> lock(engine_mutex_);
+    auto it = order_books_.find(symbol);
+    return (it != order_books_.end()) ? it->second.get_depth(depth, bids, asks) : 0;
+}
+
+uint64_t MatchingEngine::get_book_version(const std::string& symbol) const {
+    std::shared_lock<std::shared_mutex> lock(engine_mutex_);
+    auto it = order_books_.find(symbol);
+    return (it != order_books_.end()) ? it->second.version() : 0;
+}
+
 size_t MatchingEngine::get_order_count() const {
     // Use the counter instead of recalculating
     return stats_.total_orders;
@@ -122,21 +248,10 @@ std::vector<std::shared_ptr<Order>> MatchingEngine::get_user_orders(const std::s
     std::shared_lock<std::shared_mutex> lock(engine_mutex_);
     std::vector<std::shared_ptr<Order>> user_orders;
 
+    // Each book keeps an index of resting orders per user, so no level scan here
     for (const auto& [_, book] : order_books_) {
-        for (const auto& level : book.get_bid_levels(1000)) {
-            for (const auto& order : level.orders) {
-                if (order->user_id == user_id) {
-                    user_orders.push_back(order);
-                }
-            }
-        }
-        for (const auto& level : book.get_ask_levels(1000)) {
-            for (const auto& order : level.orders) {
-                if (order->user_id == user_id) {
-                    user_orders.push_back(order);
-                }
-            }
-        }
+        auto book_orders = book.get_user_orders(user_id);
+        user_orders.insert(user_orders.end(), book_orders.begin(), book_orders.end());
     }
 
     return user_orders;
@@ -152,13 +267,46 @@ std::vector<Trade> MatchingEngine::get_user_trades(const std::string& user_id) c
     return trades;
 }
 
+void MatchingEngine::scan_user_trades(const std::string& user_id, ScanCursor& cursor, size_t max, std::vector<Trade>& out) const {
+    if (cursor.done || max == 0) return;
+    std::shared_lock<std::shared_mutex> lock(engine_mutex_);
+    for (auto it = order_books_.lower_bound(cursor.symbol); it != order_books_.end(); ++it) {
+        size_t from = it->first == cursor.symbol ? cursor.position : 0;
+        size_t next = it->second.scan_user_trades(user_id, from, max, out);
+        max -= next - from;
+        if (max == 0) {
+            cursor.symbol = it->first;
+            cursor.position = next;
+            return;
+        }
+    }
+    cursor.done = true;
+}
+
+void MatchingEngine::scan_user_orders(const std::string& user_id, ScanCursor& cursor, size_t max,
+                                      std::vector<std::shared_ptr<Order>>& out) const {
+    if (cursor.done || max == 0) return;
+    std::shared_lock<std::shared_mutex> lock(engine_mutex_);
+    for (auto it = order_books_.lower_bound(cursor.symbol); it != order_books_.end(); ++it) {
+        const OrderId& after = it->first == cursor.symbol ? cursor.last_id : OrderId();
+        size_t taken = it->second.scan_user_orders(user_id, after, max, out);
+        max -= taken;
+        if (max == 0) {
+            cursor.symbol = it->first;
+            cursor.last_id = out.back()->id;
+            return;
+        }
+    }
+    cursor.done = true;
+}
+
 EngineStats MatchingEngine::get_stats() const {
     std::shared_lock<std::shared_mutex> lock(engine_mutex_);
     return stats_;
 }
 
 void MatchingEngine::clear() {
-    std::unique_lock<std::shared_mutex> lock(engine_mutex_);
+    auto lock = write_lock();
     for (auto& [_, book] : order_books_) {
         book.clear();
     }
@@ -167,7 +315,7 @@ void MatchingEngine::clear() {
 }
 
 void MatchingEngine::cancel_expired_orders() {
-    std::unique_lock<std::shared_mutex> lock(engine_mutex_);
+    auto lock = write_lock();
     for (auto& [_, book] : order_books_) {
         book.cancel_expired_orders();
     }
@@ -177,4 +325,10 @@ void MatchingEngine::add_trade_history(const Trade& trade) {
     trade_history_.push_back(trade);
 }
 
+void MatchingEngine::restore_trade(const Trade& trade) {
+    auto lock = write_lock();
+    get_or_create_book(trade.symbol).restore_trade(trade);
+    trade_history_.push_back(trade);
+}
+
 } // namespace orderbook
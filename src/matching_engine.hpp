@@ -3,7 +3,9 @@
 
 #include "order.hpp"
 #include "order_book.hpp"
+#include <atomic>
 #include <map>
+#include <set>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
@@ -22,6 +24,24 @@ struct EngineStats {
     Quantity total_volume = 0;
 };
 
+// Where a chunked scan of one user's trades or orders has got to.
+// Start from a default one; keep passing it back until done.
+struct ScanCursor {
+    std::string symbol;     // Book being read
+    size_t position = 0;    // Trade history position within it
+    OrderId last_id;        // Last order ID handed out from it
+    bool done = false;
+};
+
+// How contended the engine's write lock is - admission control sheds load on this
+struct EngineLockStats {
+    uint64_t acquisitions = 0;      // Write locks taken
+    uint64_t contended = 0;         // ... that had to wait
+    uint64_t wait_ns_total = 0;
+    uint64_t wait_ewma_ns = 0;      // Recent wait per acquisition (1/16 smoothing)
+    uint64_t waiters = 0;           // Callers queued for the lock right now
+};
+
 /**
  * The heart of the trading platform - the matching engine
  * 
@@ -67,6 +87,48 @@ public:
      */
     bool cancel_order(OrderId order_id);
 
+    /**
+     * Cancel a group of orders in one engine operation
+     * 
+     * All the cancels happen under a single engine lock, so nothing can
+     * trade against the group halfway through. Orders that are unknown or
+     * already done are skipped. Used for cancel-on-disconnect.
+     * 
+     * @param order_ids The orders to cancel
+     * @param symbols If set, receives the symbols whose books changed
+     * @return IDs of the orders that were actually cancelled
+     */
+    std::vector<OrderId> mass_cancel(const std::vector<OrderId>& order_ids, std::set<std::string>* symbols = nullptr);
+
+    /**
+     * Replace a user's quotes on one or more symbols
+     * 
+     * For each symbol, the user's resting quotes (orders that came from an
+     * earlier mass quote) are pulled and the new set is entered in their
+     * place. The whole request runs under one engine lock, so nobody can
+     * trade against a half-updated quote set. An empty set just pulls.
+     * 
+     * @param user_id Whose quotes to replace
+     * @param quote_sets New quotes grouped by symbol (order IDs already assigned)
+     * @return One result per symbol, in request order
+     */
+    std::vector<MassQuoteResult> mass_quote(const UserId& user_id,
+                                            const std::vector<std::pair<std::string, std::vector<std::shared_ptr<Order>>>>& quote_sets);
+
+    /**
+     * Arm market maker protection for a user on a symbol
+     * 
+     * Fills on the user's quotes are counted over a sliding window right on
+     * the matching path. Once a limit is reached, all of the user's quotes on
+     * that book are pulled inside the same match, and further mass quotes are
+     * refused until this is called again. A config with no limits disarms it.
+     * 
+     * @param symbol The trading symbol
+     * @param user_id The market maker
+     * @param config Window and limits
+     */
+    void set_mmp(const std::string& symbol, const UserId& user_id, const MmpConfig& config);
+
     /**
      * Modify an existing order's price and quantity
      * 
@@ -147,6 +209,23 @@ public:
      */
     std::vector<OrderBookLevel> get_ask_levels(const std::string& symbol, size_t depth) const;
 
+    /**
+     * Get both sides of a book and the version they were read at
+     * 
+     * The version moves on with every change to the book's levels, so
+     * anything built from this snapshot (a serialized depth response, say)
+     * is still current while get_book_version() returns the same number.
+     * Versions are never reused, even when a book is cleared and recreated.
+     * 
+     * @param symbol The trading symbol
+     * @param depth How many levels per side
+     * @param bids Filled with the bid levels, best first
+     * @param asks Filled with the ask levels, best first
+     * @return The book version, 0 if there's no book for the symbol
+     */
+    uint64_t get_depth(const std::string& symbol, size_t depth, std::vector<OrderBookLevel>& bids, std::vector<OrderBookLevel>& asks) const;
+    uint64_t get_book_version(const std::string& symbol) const;
+
     /**
      * Get the total number of active orders
      * 
@@ -187,6 +266,27 @@ public:
      */
     std::vector<Trade> get_user_trades(const std::string& user_id) const;
 
+    /**
+     * Read a user's trades or resting orders a chunk at a time
+     * 
+     * The get_user_* calls above build the whole list in one go. These work
+     * through at most max entries per call and leave the cursor where they
+     * stopped, so a caller streaming a large history holds one chunk at a
+     * time and only takes the engine lock for as long as a chunk takes. Books
+     * are visited in symbol order, orders in ID order within a book. Changes
+     * made between calls may or may not show up, but nothing is returned twice.
+     * 
+     * For trades max counts history entries looked at, everyone's included,
+     * so a call can append nothing and still not be done.
+     * 
+     * @param user_id The user
+     * @param cursor Where the previous call stopped; done is set at the end
+     * @param max Most entries to append (orders) or look at (trades) this call
+     * @param out Entries are appended here
+     */
+    void scan_user_trades(const std::string& user_id, ScanCursor& cursor, size_t max, std::vector<Trade>& out) const;
+    void scan_user_orders(const std::string& user_id, ScanCursor& cursor, size_t max, std::vector<std::shared_ptr<Order>>& out) const;
+
     /**
      * Clear all order books
      * 
@@ -220,14 +320,73 @@ public:
      */
     void add_trade_history(const Trade& trade);
 
+    /**
+     * Put a trade from before a restart back into the history
+     * 
+     * Unlike add_trade_history this also files it under its book, so
+     * per-user scans and get_user_trades see it.
+     * 
+     * @param trade The restored trade
+     */
+    void restore_trade(const Trade& trade);
+
+    /**
+     * Create the book for a symbol ahead of its first order
+     * 
+     * Books are otherwise created lazily by the first order on a symbol, which
+     * then pays for it inside the engine lock. Does nothing if the book exists.
+     * 
+     * @param symbol The trading symbol
+     */
+    void ensure_book(const std::string& symbol);
+
+    /**
+     * Size the order index and trade history up front
+     * 
+     * Saves the rehash / regrow (and the copy that comes with it) that would
+     * otherwise land on whichever order happens to cross the threshold.
+     * 
+     * @param orders Live orders expected
+     * @param trades Trades expected in history
+     */
+    void reserve(size_t orders, size_t trades);
+
+    // Readable from any thread without taking the engine lock
+    EngineLockStats lock_stats() const;
+
+    /**
+     * Take the time from a clock instead of the system clocks
+     * 
+     * Applies to every book, existing and future: trade timestamps, expiry
+     * and MMP windows all follow it, and accepted orders are stamped with it.
+     * This is how a backtest replays history on virtual time. nullptr goes
+     * back to the system clocks. The clock has to outlive the engine.
+     * 
+     * @param clock The clock to use, or nullptr
+     */
+    void set_clock(const Clock* clock);
+
     // Callbacks for real-time updates
     // Set these to get notified when trades happen or orders change
     std::function<void(const Trade&)> on_trade;
     std::function<void(const Order&)> on_order_update;
+    // Fired from inside the engine lock when MMP pulls a user's quotes - don't call back into the engine
+    std::function<void(const std::string& symbol, const UserId&, const std::vector<OrderId>&)> on_mmp_trigger;
 
 private:
+    // Find the book for a symbol, creating it (and hooking up the engine callbacks) on first use
+    OrderBook& get_or_create_book(const std::string& symbol);
+
+    // Exclusive engine lock; waits are timed (only when contended) for lock_stats()
+    std::unique_lock<std::shared_mutex> write_lock() const;
+
     // Thread safety - multiple readers, single writer
     mutable std::shared_mutex engine_mutex_;
+    mutable std::atomic<uint64_t> lock_acquisitions_{0};
+    mutable std::atomic<uint64_t> lock_contended_{0};
+    mutable std::atomic<uint64_t> lock_wait_ns_{0};
+    mutable std::atomic<uint64_t> lock_wait_ewma_ns_{0};
+    mutable std::atomic<uint64_t> lock_waiters_{0};
     
     // One order book per trading symbol
     std::map<std::string, OrderBook> order_books_;
@@ -240,6 +399,9 @@ private:
     
     // History of all trades (for user queries)
     std::vector<Trade> trade_history_;
+
+    // Injected time source; nullptr means the system clocks
+    const Clock* clock_ = nullptr;
 };
 
 } // namespace orderbook
@@ -0,0 +1,102 @@
+#ifndef ORDERBOOK_MMP_HPP
+#define ORDERBOOK_MMP_HPP
+
+#include "types.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace orderbook {
+
+// Market maker protection (MMP) settings for one user on one book
+//
+// When fills on the user's quotes reach max_quantity, or reach max_fills,
+// within the window, every quote they have on the book is pulled on the spot.
+// A limit of 0 means "no limit" for that counter.
+struct MmpConfig {
+    std::chrono::milliseconds window{1000};
+    Quantity max_quantity = 0;
+    uint64_t max_fills = 0;
+};
+
+// Sliding-window fill counter with O(1) updates
+//
+// The window is split into a fixed ring of buckets. Adding a fill only clears
+// the buckets that fell out of the window since the last fill (never more than
+// the ring size) and keeps running totals, so there's no per-fill history to
+// walk. Expiry is accurate to window / BUCKETS.
+class MmpCounter {
+public:
+    static constexpr size_t BUCKETS = 16;
+    using Clock = std::chrono::steady_clock;
+
+    explicit MmpCounter(std::chrono::milliseconds window = std::chrono::milliseconds(1000))
+        : bucket_ns_(std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::nanoseconds>(window).count() / BUCKETS)) {}
+
+    void add(Clock::time_point now, Quantity quantity) {
+        advance(now);
+        auto slot = static_cast<size_t>(head_ % BUCKETS);
+        quantities_[slot] += quantity;
+        fills_[slot] += 1;
+        total_quantity_ += quantity;
+        total_fills_ += 1;
+    }
+
+    Quantity quantity() const { return total_quantity_; }
+    uint64_t fills() const { return total_fills_; }
+
+    void reset() {
+        quantities_.fill(0);
+        fills_.fill(0);
+        total_quantity_ = 0;
+        total_fills_ = 0;
+    }
+
+private:
+    void advance(Clock::time_point now) {
+        int64_t index = now.time_since_epoch().count() / bucket_ns_;
+        if (index <= head_) return;
+        if (index - head_ >= static_cast<int64_t>(BUCKETS)) {
+            reset();
+        } else {
+            for (int64_t i = head_ + 1; i <= index; ++i) {
+                auto slot = static_cast<size_t>(i % BUCKETS);
+                total_quantity_ -= quantities_[slot];
+                total_fills_ -= fills_[slot];
+                quantities_[slot] = 0;
+                fills_[slot] = 0;
+            }
+        }
+        head_ = index;
+    }
+
+    int64_t bucket_ns_;
+    int64_t head_ = 0;
+    std::array<Quantity, BUCKETS> quantities_{};
+    std::array<uint64_t, BUCKETS> fills_{};
+    Quantity total_quantity_ = 0;
+    uint64_t total_fills_ = 0;
+};
+
+// Per-user MMP state kept by each order book
+struct MmpState {
+    MmpConfig config;
+    MmpCounter counter;
+    bool tripped = false;   // Quotes were pulled; new quotes are refused until re-armed
+
+    explicit MmpState(const MmpConfig& cfg) : config(cfg), counter(cfg.window) {}
+
+    // Record a fill on one of the user's quotes; returns true if this fill trips MMP
+    bool on_fill(MmpCounter::Clock::time_point now, Quantity quantity) {
+        if (tripped) return false;
+        counter.add(now, quantity);
+        tripped = (config.max_quantity > 0 && counter.quantity() >= config.max_quantity) ||
+                  (config.max_fills > 0 && counter.fills() >= config.max_fills);
+        return tripped;
+    }
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_MMP_HPP
@@ -1,7 +1,7 @@
 #ifndef ORDERBOOK_ORDER_HPP
 #define ORDERBOOK_ORDER_HPP
 
-#include "utils.hpp"
+#include "types.hpp"
 #include <string>
 #include <chrono>
 #include <memory>
@@ -54,6 +54,7 @@ struct Order
     // Time-in-Force and expiry settings
     int64_t expiry = 0;             // When this order expires (Unix timestamp, 0 = never)
     std::string tif = "GTC";        // Time-in-Force: GTC (Good Till Cancelled), IOC (Immediate or Cancel), FOK (Fill or Kill)
+    bool is_quote = false;          // Placed by a mass quote - replaced as a set on the next one
 
     // Constructor - creates a new order
     // 
@@ -93,6 +94,8 @@ struct Trade
 {
     orderbook::OrderId buy_order_id;   // ID of the buy order
     orderbook::OrderId sell_order_id;  // ID of the sell order
+    orderbook::UserId buy_user_id;     // Who bought
+    orderbook::UserId sell_user_id;    // Who sold
     std::string symbol;                // What was traded
     orderbook::Price price;            // Price the trade happened at
     orderbook::Quantity quantity;      // How much was traded
@@ -2,6 +2,9 @@
 #define ORDERBOOK_ORDER_BOOK_HPP
 
 #include "order.hpp"
+#include "clock.hpp"
+#include "mmp.hpp"
+#include "order_book_policies.hpp"
 #include <map>
 #include <deque>
 #include <functional>
@@ -9,29 +12,90 @@
 #include <shared_mutex>
 #include <atomic>
 #include <vector>
+#include <set>
+#include <unordered_map>
 
 namespace orderbook 
 {
 
 // Level in the order book (single price point)
-struct OrderBookLevel {
-    Price price;
-    std::deque<std::shared_ptr<Order>> orders;
+// The queue type comes from the book's policy; snapshots handed out are always OrderBookLevel
+template <typename Queue>
+struct BasicOrderBookLevel {
+    using allocator_type = typename Queue::allocator_type;
+
+    Price price = 0;
+    Queue orders;
     Quantity total_quantity = 0;
 
-    OrderBookLevel() = default;
-    explicit OrderBookLevel(Price price_) : price(price_) {}
+    BasicOrderBookLevel() = default;
+    explicit BasicOrderBookLevel(Price price_) : price(price_) {}
+    // Allocator-aware forms, so a pooled level store passes its pool down to the queue
+    explicit BasicOrderBookLevel(const allocator_type& alloc) : orders(alloc) {}
+    BasicOrderBookLevel(const BasicOrderBookLevel& other, const allocator_type& alloc)
+        : price(other.price), orders(other.orders, alloc), total_quantity(other.total_quantity) {}
+    BasicOrderBookLevel(BasicOrderBookLevel&& other, const allocator_type& alloc)
+        : price(other.price), orders(std::move(other.orders), alloc), total_quantity(other.total_quantity) {}
+};
+
+using OrderBookLevel = BasicOrderBookLevel<std::deque<std::shared_ptr<Order>>>;
+
+// Outcome of replacing one user's quotes on one book
+struct MassQuoteResult {
+    std::string symbol;
+    std::vector<OrderId> cancelled;              // Quotes that were pulled
+    std::vector<std::shared_ptr<Order>> placed;  // New quotes, with their status after matching
+    std::vector<Trade> trades;                   // Anything the new quotes traded on entry
 };
 
-// Order book class
-class OrderBook {
+/**
+ * Order book for one symbol, built from policies (see order_book_policies.hpp)
+ *
+ * The policy picks the level store, the per-level order queue, the ID index,
+ * the allocator and the locking; the matching logic is the same for all of
+ * them. OrderBook below is the reference build that the engine uses. Other
+ * combinations include order_book_impl.hpp to get the member definitions,
+ * which is how the benchmarks compare layouts on the same workload.
+ */
+namespace detail {
+// Each book numbers its versions from its own starting point, so a book that's
+// dropped and made again never hands out a version an older one already did
+inline uint64_t next_book_epoch() {
+    static std::atomic<uint64_t> epochs{0};
+    return (epochs.fetch_add(1, std::memory_order_relaxed) + 1) << 32;
+}
+} // namespace detail
+
+template <typename Policy = ReferenceBookPolicy>
+class BasicOrderBook {
+    using Allocation = typename Policy::allocation;
+    template <typename T>
+    using Alloc = typename Allocation::template allocator<T>;
+    using OrderPtr = std::shared_ptr<Order>;
+    using Queue = typename Policy::queue::template type<OrderPtr, Alloc<OrderPtr>>;
+    using Level = BasicOrderBookLevel<Queue>;
+    using BidLevels = typename Policy::levels::template type<Level, std::greater<>, Alloc<std::pair<const Price, Level>>>;
+    using AskLevels = typename Policy::levels::template type<Level, std::less<Price>, Alloc<std::pair<const Price, Level>>>;
+    using IdIndex = typename Policy::index::template type<OrderPtr, Alloc<std::pair<const OrderId, OrderPtr>>>;
+    using Mutex = typename Policy::locking::mutex;
+
 public:
-    explicit OrderBook(const std::string& symbol);
+    using policy_type = Policy;
+
+    explicit BasicOrderBook(const std::string& symbol);
 
     std::vector<Trade> add_order(std::shared_ptr<Order> order);
     bool cancel_order(OrderId order_id);
     bool modify_order(OrderId order_id, Price new_price, Quantity new_quantity);
 
+    // Pull the user's resting quotes and enter the new set in their place
+    MassQuoteResult mass_quote(const UserId& user_id, const std::vector<std::shared_ptr<Order>>& quotes);
+
+    // --- Market maker protection ---
+    // Arms (or re-arms after a trip) MMP for a user; a config with no limits turns it off
+    void set_mmp(const UserId& user_id, const MmpConfig& config);
+    bool is_mmp_tripped(const UserId& user_id) const;
+
     Price get_best_bid() const;
     Price get_best_ask() const;
     Price get_spread() const;
@@ -42,7 +106,15 @@ public:
     std::vector<OrderBookLevel> get_bid_levels(size_t depth) const;
     std::vector<OrderBookLevel> get_ask_levels(size_t depth) const;
 
+    // Both sides in one go, taken under the same lock as the version returned.
+    // Whoever caches something built from the levels can tell it's current
+    // while version() still returns that number.
+    uint64_t get_depth(size_t depth, std::vector<OrderBookLevel>& bids, std::vector<OrderBookLevel>& asks) const;
+    // Moves on with every change to the price levels (never goes back)
+    uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
     std::shared_ptr<Order> get_order(OrderId order_id) const;
+    std::vector<std::shared_ptr<Order>> get_user_orders(const UserId& user_id) const;
     void clear();
     bool is_empty() const;
     size_t get_order_count() const;
@@ -55,6 +127,11 @@ public:
         trade_callback_ = std::move(cb);
     }
 
+    // Called with the pulled order IDs when a user's MMP trips (from inside matching)
+    void set_mmp_callback(std::function<void(const UserId&, const std::vector<OrderId>&)> cb) {
+        mmp_callback_ = std::move(cb);
+    }
+
     // --- Metrics ---
     double average_spread(size_t depth = 10) const;
     double order_to_trade_ratio() const;
@@ -62,45 +139,81 @@ public:
 
     // --- Expiry and TIF ---
     void cancel_expired_orders();
+    // Orders the expiry sweep is still tracking
+    size_t expiring_count() const;
+
+    // --- Time ---
+    // nullptr (the default) reads the system clocks; the clock has to outlive the book
+    void set_clock(const Clock* clock) { clock_ = clock; }
 
     // --- Trade history ---
     const std::vector<Trade>& get_trade_history() const { return trade_history_; }
     std::vector<Trade> get_user_trades(const std::string& user_id) const {
         std::vector<Trade> result;
-        for (const auto& t : trade_history_) {
-            // Check if user is buyer or seller
-            if (orders_by_id_.count(t.buy_order_id) && orders_by_id_.at(t.buy_order_id)->user_id == user_id)
-                result.push_back(t);
-            else if (orders_by_id_.count(t.sell_order_id) && orders_by_id_.at(t.sell_order_id)->user_id == user_id)
-                result.push_back(t);
-        }
+        scan_user_trades(user_id, 0, SIZE_MAX, result);
         return result;
     }
+    // Looks at up to max history entries from position `from` on and appends the user's.
+    // Returns the position to carry on from (the history size once it's all read).
+    size_t scan_user_trades(const std::string& user_id, size_t from, size_t max, std::vector<Trade>& out) const;
+    // Puts a trade from before a restart back into the history, so per-user scans see it
+    void restore_trade(const Trade& trade) { trade_history_.push_back(trade); }
+    // Appends up to max of the user's resting orders with IDs after `after`, in ID
+    // order ("" starts at the beginning). Returns how many it appended.
+    size_t scan_user_orders(const UserId& user_id, const OrderId& after, size_t max, std::vector<std::shared_ptr<Order>>& out) const;
 private:
     std::string symbol_;
+    // Declared ahead of the containers that allocate from it
+    [[no_unique_address]] typename Allocation::resource resource_;
 
     // Buy orders sorted descending (highest price first)
-    std::map<Price, OrderBookLevel, std::greater<>> buy_orders_;
+    BidLevels buy_orders_;
     // Sell orders sorted ascending (lowest price first)
-    std::map<Price, OrderBookLevel> sell_orders_;
-    std::map<OrderId, std::shared_ptr<Order>> orders_by_id_;
-    mutable std::shared_mutex order_book_mutex_;
-    mutable std::shared_mutex orders_mutex_;
+    AskLevels sell_orders_;
+    IdIndex orders_by_id_;
+    // Expiry (unix seconds) -> order ID for orders that have one, so the sweep
+    // only looks at what's due. An entry goes when its order leaves the book or
+    // comes due, whichever is first (guarded by orders_mutex_)
+    std::multimap<int64_t, OrderId> expiring_;
+    void forget_expiry(const Order& order);     // Caller holds orders_mutex_ exclusively
+    // Resting orders per user, kept in step with the price levels (guarded by order_book_mutex_)
+    std::unordered_map<UserId, std::set<OrderId>> resting_by_user_;
+    mutable Mutex order_book_mutex_;
+    mutable Mutex orders_mutex_;
     std::atomic<size_t> total_orders_{0};
     std::atomic<size_t> total_trades_{0};
     std::atomic<Quantity> total_volume_{0};
+    // Bumped every time the levels change, after the change is made
+    std::atomic<uint64_t> version_{detail::next_book_epoch()};
+    void bump_version() { version_.fetch_add(1, std::memory_order_release); }
     std::function<void(const Order&)> order_update_callback_;
     std::function<void(const Trade&)> trade_callback_;
+    std::function<void(const UserId&, const std::vector<OrderId>&)> mmp_callback_;
+    // MMP state per user (guarded by order_book_mutex_, updated on the fill path)
+    std::unordered_map<UserId, MmpState> mmp_;
+    const Clock* clock_ = nullptr;
+    Clock::time_point now() const {
+        return clock_ ? clock_->now() : std::chrono::high_resolution_clock::now();
+    }
+    bool record_mmp_fill(const Order& quote, Quantity quantity);
+    std::vector<OrderId> pull_quotes_locked(const UserId& user_id);
     std::vector<Trade> match_orders(std::shared_ptr<Order> order);
     void add_order_to_level(std::shared_ptr<Order> order);
+    void unindex_resting(const Order& order);
     void remove_order_from_level(std::shared_ptr<Order> order);
     void process_market_order(std::shared_ptr<Order> order);
     void process_limit_order(std::shared_ptr<Order> order);
     void process_stop_order(std::shared_ptr<Order> order);
     void process_stop_limit_order(std::shared_ptr<Order> order);
+    // Depth snapshots are plain OrderBookLevels whatever the queue type
+    static OrderBookLevel snapshot(const Level& level);
     std::vector<Trade> trade_history_;
 };
 
+// The engine's book. Its members are compiled once, in order_book.cpp
+using OrderBook = BasicOrderBook<ReferenceBookPolicy>;
+extern template class BasicOrderBook<ReferenceBookPolicy>;
+
 } // namespace orderbook
 
 #endif // ORDERBOOK_ORDER_BOOK_HPP
@@ -0,0 +1,742 @@
+#ifndef ORDERBOOK_ORDER_BOOK_IMPL_HPP
+#define ORDERBOOK_ORDER_BOOK_IMPL_HPP
+
+// Member definitions for BasicOrderBook. Only needed to instantiate a book
+// with a policy other than the reference one - order_book.cpp has that one.
+
+#include "order_book.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+#include <type_traits>
+
+namespace orderbook 
+{
+
+template <typename Policy>
+BasicOrderBook<Policy>::BasicOrderBook(const std::string& symbol)
+    : symbol_(symbol),
+      buy_orders_(Allocation::template make<std::pair<const Price, Level>>(resource_)),
+      sell_orders_(Allocation::template make<std::pair<const Price, Level>>(resource_)),
+      orders_by_id_(Allocation::template make<std::pair<const OrderId, OrderPtr>>(resource_)) {}
+
+template <typename Policy>
+std::vector<Trade> BasicOrderBook<Policy>::add_order(std::shared_ptr<Order> order) {
+    std::vector<Trade> trades;
+
+    // Validate order
+    if (order->quantity == 0 || order->quantity > MAX_ORDER_QUANTITY ||
+        (order->type == OrderType::LIMIT && (order->price == 0 || order->price > MAX_ORDER_PRICE))) {
+        order->status = OrderStatus::REJECTED;
+        return trades;
+    }
+
+    {
+        std::unique_lock lock(orders_mutex_);
+        orders_by_id_[order->id] = order;
+        if (order->expiry > 0) expiring_.emplace(order->expiry, order->id);
+    }
+
+    total_orders_++;
+
+    switch (order->type) {
+        case OrderType::MARKET:
+            process_market_order(order);
+            break;
+        case OrderType::LIMIT:
+            trades = match_orders(order);
+            if (order->quantity > order->filled_quantity) {
+                process_limit_order(order);
+            }
+            break;
+        case OrderType::STOP:
+            process_stop_order(order);
+            break;
+        case OrderType::STOP_LIMIT:
+            process_stop_limit_order(order);
+            break;
+    }
+
+    if (order->filled_quantity == order->quantity) {
+        order->status = OrderStatus::FILLED;
+        if (order->expiry > 0) {
+            std::unique_lock lock(orders_mutex_);
+            forget_expiry(*order);
+        }
+    } else if (order->filled_quantity > 0) {
+        order->status = OrderStatus::PARTIAL;
+    }
+
+    if (order_update_callback_) {
+        order_update_callback_(*order);
+    }
+
+    // Store trades in trade_history_
+    trade_history_.insert(trade_history_.end(), trades.begin(), trades.end());
+
+    return trades;
+}
+
+template <typename Policy>
+std::vector<Trade> BasicOrderBook<Policy>::match_orders(std::shared_ptr<Order> order) {
+    std::vector<Trade> trades;
+    std::vector<UserId> mmp_tripped;
+    std::unique_lock lock(order_book_mutex_);
+
+    bool is_buy = (order->side == OrderSide::BUY);
+    if (is_buy) {
+        // Match against sell orders
+        while (order->filled_quantity < order->quantity && !sell_orders_.empty()) {
+            auto it = sell_orders_.begin();
+            auto price = it->first;
+            auto& level = it->second;
+
+            bool match = false;
+            if (order->type == OrderType::MARKET) {
+                match = true;
+            } else {
+                match = (price <= order->price);
+            }
+            if (!match) break;
+
+            for (auto order_it = level.orders.begin(); order_it != level.orders.end();) {
+                // Hold our own reference - the slot goes away if the order fills
+                auto counter_order = *order_it;
+                Quantity trade_qty = std::min(
+                    order->quantity - order->filled_quantity,
+                    counter_order->quantity - counter_order->filled_quantity
+                );
+                if (trade_qty == 0) {
+                    ++order_it;
+                    continue;
+                }
+                Trade trade;
+                trade.buy_order_id = order->id;
+                trade.sell_order_id = counter_order->id;
+                trade.buy_user_id = order->user_id;
+                trade.sell_user_id = counter_order->user_id;
+                trade.price = price;
+                trade.quantity = trade_qty;
+                trade.timestamp = now();
+                trade.symbol = symbol_;
+                trades.push_back(trade);
+
+                order->filled_quantity += trade_qty;
+                counter_order->filled_quantity += trade_qty;
+                level.total_quantity -= trade_qty;
+
+                total_trades_++;
+                total_volume_ += trade_qty;
+
+                if (trade_callback_) trade_callback_(trade);
+
+                if (counter_order->filled_quantity == counter_order->quantity) {
+                    counter_order->status = OrderStatus::FILLED;
+                    unindex_resting(*counter_order);
+                    if (counter_order->expiry > 0) {
+                        std::unique_lock lock(orders_mutex_);
+                        forget_expiry(*counter_order);
+                    }
+                    order_it = level.orders.erase(order_it);
+                } else {
+                    counter_order->status = OrderStatus::PARTIAL;
+                    ++order_it;
+                }
+
+                if (order_update_callback_) order_update_callback_(*counter_order);
+
+                // MMP trip: stop here, the rest of this level may hold their quotes
+                if (counter_order->is_quote && record_mmp_fill(*counter_order, trade_qty)) {
+                    mmp_tripped.push_back(counter_order->user_id);
+                    break;
+                }
+
+                if (order->filled_quantity == order->quantity) break;
+            }
+            if (level.orders.empty()) {
+                sell_orders_.erase(price);
+            }
+            for (const auto& user_id : mmp_tripped) pull_quotes_locked(user_id);
+            mmp_tripped.clear();
+        }
+    } else {
+        // Match against buy orders
+        while (order->filled_quantity < order->quantity && !buy_orders_.empty()) {
+            auto it = buy_orders_.begin();
+            auto price = it->first;
+            auto& level = it->second;
+
+            bool match = false;
+            if (order->type == OrderType::MARKET) {
+                match = true;
+            } else {
+                match = (price >= order->price);
+            }
+            if (!match) break;
+
+            for (auto order_it = level.orders.begin(); order_it != level.orders.end();) {
+                // Hold our own reference - the slot goes away if the order fills
+                auto counter_order = *order_it;
+                Quantity trade_qty = std::min(
+                    order->quantity - order->filled_quantity,
+                    counter_order->quantity - counter_order->filled_quantity
+                );
+                if (trade_qty == 0) {
+                    ++order_it;
+                    continue;
+                }
+                Trade trade;
+                trade.buy_order_id = counter_order->id;
+                trade.sell_order_id = order->id;
+                trade.buy_user_id = counter_order->user_id;
+                trade.sell_user_id = order->user_id;
+                trade.price = price;
+                trade.quantity = trade_qty;
+                trade.timestamp = now();
+                trade.symbol = symbol_;
+                trades.push_back(trade);
+
+                order->filled_quantity += trade_qty;
+                counter_order->filled_quantity += trade_qty;
+                level.total_quantity -= trade_qty;
+
+                total_trades_++;
+                total_volume_ += trade_qty;
+
+                if (trade_callback_) trade_callback_(trade);
+
+                if (counter_order->filled_quantity == counter_order->quantity) {
+                    counter_order->status = OrderStatus::FILLED;
+                    unindex_resting(*counter_order);
+                    if (counter_order->expiry > 0) {
+                        std::unique_lock lock(orders_mutex_);
+                        forget_expiry(*counter_order);
+                    }
+                    order_it = level.orders.erase(order_it);
+                } else {
+                    counter_order->status = OrderStatus::PARTIAL;
+                    ++order_it;
+                }
+
+                if (order_update_callback_) order_update_callback_(*counter_order);
+
+                // MMP trip: stop here, the rest of this level may hold their quotes
+                if (counter_order->is_quote && record_mmp_fill(*counter_order, trade_qty)) {
+                    mmp_tripped.push_back(counter_order->user_id);
+                    break;
+                }
+
+                if (order->filled_quantity == order->quantity) break;
+            }
+            if (level.orders.empty()) {
+                buy_orders_.erase(price);
+            }
+            for (const auto& user_id : mmp_tripped) pull_quotes_locked(user_id);
+            mmp_tripped.clear();
+        }
+    }
+    if (!trades.empty()) bump_version();
+    return trades;
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::process_market_order(std::shared_ptr<Order> order) {
+    auto trades = match_orders(order);
+    if (order->filled_quantity < order->quantity) {
+        order->status = OrderStatus::REJECTED;
+    }
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::process_limit_order(std::shared_ptr<Order> order) {
+    std::unique_lock lock(order_book_mutex_);
+    add_order_to_level(order);
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::process_stop_order(std::shared_ptr<Order> order) {
+    Price market_price = (order->side == OrderSide::BUY) ? get_best_ask() : get_best_bid();
+    if (market_price == 0) {
+        order->status = OrderStatus::REJECTED;
+        return;
+    }
+
+    bool triggered = (order->side == OrderSide::BUY) ? (market_price >= order->stop_price)
+                                                     : (market_price <= order->stop_price);
+
+    if (triggered) {
+        order->type = OrderType::MARKET;
+        process_market_order(order);
+    }
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::process_stop_limit_order(std::shared_ptr<Order> order) {
+    Price market_price = (order->side == OrderSide::BUY) ? get_best_ask() : get_best_bid();
+    if (market_price == 0) {
+        order->status = OrderStatus::REJECTED;
+        return;
+    }
+
+    bool triggered = (order->side == OrderSide::BUY) ? (market_price >= order->stop_price)
+                                                     : (market_price <= order->stop_price);
+
+    if (triggered) {
+        order->type = OrderType::LIMIT;
+        auto trades = match_orders(order);
+        if (order->quantity > order->filled_quantity) {
+            process_limit_order(order);
+        }
+    }
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::unindex_resting(const Order& order) {
+    auto it = resting_by_user_.find(order.user_id);
+    if (it == resting_by_user_.end()) return;
+    it->second.erase(order.id);
+    if (it->second.empty()) resting_by_user_.erase(it);
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::add_order_to_level(std::shared_ptr<Order> order) {
+    bump_version();
+    resting_by_user_[order->user_id].insert(order->id);
+    if (order->side == OrderSide::BUY) {
+        auto& level = buy_orders_[order->price];
+        if (level.price == 0) level.price = order->price;
+        level.orders.push_back(order);
+        level.total_quantity += (order->quantity - order->filled_quantity);
+    } else {
+        auto& level = sell_orders_[order->price];
+        if (level.price == 0) level.price = order->price;
+        level.orders.push_back(order);
+        level.total_quantity += (order->quantity - order->filled_quantity);
+    }
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::remove_order_from_level(std::shared_ptr<Order> order) {
+    bump_version();
+    unindex_resting(*order);
+    if (order->side == OrderSide::BUY) {
+        auto it = buy_orders_.find(order->price);
+        if (it == buy_orders_.end()) return;
+        auto& level = it->second;
+        auto pos = std::find(level.orders.begin(), level.orders.end(), order);
+        if (pos != level.orders.end()) {
+            level.total_quantity -= ((*pos)->quantity - (*pos)->filled_quantity);
+            level.orders.erase(pos);
+        }
+        if (level.orders.empty()) {
+            buy_orders_.erase(it);
+        }
+    } else {
+        auto it = sell_orders_.find(order->price);
+        if (it == sell_orders_.end()) return;
+        auto& level = it->second;
+        auto pos = std::find(level.orders.begin(), level.orders.end(), order);
+        if (pos != level.orders.end()) {
+            level.total_quantity -= ((*pos)->quantity - (*pos)->filled_quantity);
+            level.orders.erase(pos);
+        }
+        if (level.orders.empty()) {
+            sell_orders_.erase(it);
+        }
+    }
+}
+
+template <typename Policy>
+bool BasicOrderBook<Policy>::cancel_order(OrderId order_id) {
+    std::shared_ptr<Order> order;
+    {
+        std::shared_lock lock(orders_mutex_);
+        auto it = orders_by_id_.find(order_id);
+        if (it == orders_by_id_.end()) {
+            return false;
+        }
+        order = it->second;
+    }
+
+    if (order->status == OrderStatus::FILLED || order->status == OrderStatus::CANCELLED) {
+        return false;
+    }
+
+    order->status = OrderStatus::CANCELLED;
+
+    if (order->type == OrderType::LIMIT) {
+        std::unique_lock lock(order_book_mutex_);
+        remove_order_from_level(order);
+    }
+
+    // Remove from orders_by_id_ so get_order returns nullptr
+    {
+        std::unique_lock lock(orders_mutex_);
+        orders_by_id_.erase(order_id);
+        forget_expiry(*order);
+    }
+
+    if (order_update_callback_) order_update_callback_(*order);
+    return true;
+}
+
+template <typename Policy>
+bool BasicOrderBook<Policy>::modify_order(OrderId order_id, Price new_price, Quantity new_quantity) {
+    std::shared_ptr<Order> order;
+    {
+        std::shared_lock lock(orders_mutex_);
+        auto it = orders_by_id_.find(order_id);
+        if (it == orders_by_id_.end()) return false;
+        order = it->second;
+    }
+    if (order->status == OrderStatus::FILLED || order->status == OrderStatus::CANCELLED) return false;
+    if (order->filled_quantity >= order->quantity) return false;
+
+    // In-place modify if reducing price/quantity
+    bool can_modify_in_place = (new_quantity <= order->quantity && new_price == order->price);
+    if (can_modify_in_place) {
+        order->quantity = new_quantity;
+        bump_version();
+        if (order_update_callback_) order_update_callback_(*order);
+        return true;
+    }
+    // If price or quantity increases, cancel and re-add
+    cancel_order(order_id);
+    // Same order, new terms - it stays in its quote set and keeps its TIF and expiry
+    auto new_order = std::make_shared<Order>(
+        order->id, order->symbol, order->side, order->type,
+        new_price, new_quantity, order->user_id,
+        order->stop_price, order->expiry, order->tif
+    );
+    new_order->is_quote = order->is_quote;
+    add_order(new_order);
+    return true;
+}
+
+template <typename Policy>
+MassQuoteResult BasicOrderBook<Policy>::mass_quote(const UserId& user_id, const std::vector<std::shared_ptr<Order>>& quotes) {
+    MassQuoteResult result;
+    result.symbol = symbol_;
+    // Collect the old quote set first - cancelling edits the index we'd be walking
+    std::vector<OrderId> old_quotes;
+    {
+        std::shared_lock book_lock(order_book_mutex_);
+        auto it = resting_by_user_.find(user_id);
+        if (it != resting_by_user_.end()) {
+            std::shared_lock lock(orders_mutex_);
+            for (const auto& id : it->second) {
+                auto order_it = orders_by_id_.find(id);
+                if (order_it != orders_by_id_.end() && order_it->second->is_quote) old_quotes.push_back(id);
+            }
+        }
+    }
+    for (const auto& id : old_quotes) {
+        if (cancel_order(id)) result.cancelled.push_back(id);
+    }
+    // After an MMP trip the old quotes still go, but nothing new goes in until re-armed
+    bool tripped = is_mmp_tripped(user_id);
+    for (const auto& quote : quotes) {
+        quote->is_quote = true;
+        if (tripped) {
+            quote->status = OrderStatus::REJECTED;
+            result.placed.push_back(quote);
+            continue;
+        }
+        auto trades = add_order(quote);
+        result.trades.insert(result.trades.end(), trades.begin(), trades.end());
+        result.placed.push_back(quote);
+    }
+    return result;
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::set_mmp(const UserId& user_id, const MmpConfig& config) {
+    std::unique_lock lock(order_book_mutex_);
+    if (config.max_quantity == 0 && config.max_fills == 0) {
+        mmp_.erase(user_id);
+        return;
+    }
+    mmp_.insert_or_assign(user_id, MmpState(config));
+}
+
+template <typename Policy>
+bool BasicOrderBook<Policy>::is_mmp_tripped(const UserId& user_id) const {
+    std::shared_lock lock(order_book_mutex_);
+    auto it = mmp_.find(user_id);
+    return it != mmp_.end() && it->second.tripped;
+}
+
+template <typename Policy>
+bool BasicOrderBook<Policy>::record_mmp_fill(const Order& quote, Quantity quantity) {
+    auto it = mmp_.find(quote.user_id);
+    if (it == mmp_.end()) return false;
+    return it->second.on_fill(clock_ ? clock_->monotonic() : MmpCounter::Clock::now(), quantity);
+}
+
+// Caller holds order_book_mutex_ exclusively (we're inside matching)
+template <typename Policy>
+std::vector<OrderId> BasicOrderBook<Policy>::pull_quotes_locked(const UserId& user_id) {
+    std::vector<OrderId> pulled;
+    auto it = resting_by_user_.find(user_id);
+    if (it == resting_by_user_.end()) return pulled;
+    // Copy the IDs - removing from the levels edits the index
+    std::vector<OrderId> ids(it->second.begin(), it->second.end());
+    for (const auto& id : ids) {
+        std::shared_ptr<Order> quote;
+        {
+            std::unique_lock lock(orders_mutex_);
+            auto order_it = orders_by_id_.find(id);
+            if (order_it == orders_by_id_.end() || !order_it->second->is_quote) continue;
+            quote = order_it->second;
+            orders_by_id_.erase(order_it);
+            forget_expiry(*quote);
+        }
+        quote->status = OrderStatus::CANCELLED;
+        remove_order_from_level(quote);
+        pulled.push_back(id);
+        if (order_update_callback_) order_update_callback_(*quote);
+    }
+    if (mmp_callback_) mmp_callback_(user_id, pulled);
+    return pulled;
+}
+
+// --- Metrics ---
+template <typename Policy>
+double BasicOrderBook<Policy>::average_spread(size_t depth) const {
+    std::shared_lock lock(order_book_mutex_);
+    double total_spread = 0;
+    size_t count = 0;
+    auto bids = get_bid_levels(depth);
+    auto asks = get_ask_levels(depth);
+    size_t n = std::min(bids.size(), asks.size());
+    for (size_t i = 0; i < n; ++i) {
+        total_spread += static_cast<double>(asks[i].price) - static_cast<double>(bids[i].price);
+        ++count;
+    }
+    return count ? total_spread / count : 0.0;
+}
+
+template <typename Policy>
+double BasicOrderBook<Policy>::order_to_trade_ratio() const {
+    std::shared_lock lock(order_book_mutex_);
+    return total_trades_ ? static_cast<double>(total_orders_) / total_trades_ : 0.0;
+}
+
+template <typename Policy>
+double BasicOrderBook<Policy>::cancellation_rate() const {
+    std::shared_lock lock(order_book_mutex_);
+    // This is a simple estimate: cancelled orders / total orders
+    return total_orders_ ? static_cast<double>(total_orders_ - get_order_count()) / total_orders_ : 0.0;
+}
+
+template <typename Policy>
+Price BasicOrderBook<Policy>::get_best_bid() const {
+    std::shared_lock lock(order_book_mutex_);
+    return buy_orders_.empty() ? 0 : buy_orders_.begin()->first;
+}
+
+template <typename Policy>
+Price BasicOrderBook<Policy>::get_best_ask() const {
+    std::shared_lock lock(order_book_mutex_);
+    return sell_orders_.empty() ? 0 : sell_orders_.begin()->first;
+}
+
+template <typename Policy>
+Price BasicOrderBook<Policy>::get_spread() const {
+    Price bid = get_best_bid();
+    Price ask = get_best_ask();
+    return (bid == 0 || ask == 0) ? 0 : ask - bid;
+}
+
+template <typename Policy>
+Quantity BasicOrderBook<Policy>::get_bid_depth(Price price) const {
+    std::shared_lock lock(order_book_mutex_);
+    Quantity total = 0;
+    for (const auto& [p, level] : buy_orders_) {
+        if (p >= price) total += level.total_quantity;
+    }
+    return total;
+}
+
+template <typename Policy>
+Quantity BasicOrderBook<Policy>::get_ask_depth(Price price) const {
+    std::shared_lock lock(order_book_mutex_);
+    Quantity total = 0;
+    for (const auto& [p, level] : sell_orders_) {
+        if (p <= price) total += level.total_quantity;
+    }
+    return total;
+}
+
+template <typename Policy>
+std::vector<OrderBookLevel> BasicOrderBook<Policy>::get_bid_levels(size_t depth) const {
+    std::shared_lock lock(order_book_mutex_);
+    std::vector<OrderBookLevel> result;
+    for (const auto& [_, level] : buy_orders_) {
+        if (result.size() >= depth) break;
+        result.push_back(snapshot(level));
+    }
+    return result;
+}
+
+template <typename Policy>
+std::vector<OrderBookLevel> BasicOrderBook<Policy>::get_ask_levels(size_t depth) const {
+    std::shared_lock lock(order_book_mutex_);
+    std::vector<OrderBookLevel> result;
+    for (const auto& [_, level] : sell_orders_) {
+        if (result.size() >= depth) break;
+        result.push_back(snapshot(level));
+    }
+    return result;
+}
+
+template <typename Policy>
+uint64_t BasicOrderBook<Policy>::get_depth(size_t depth, std::vector<OrderBookLevel>& bids, std::vector<OrderBookLevel>& asks) const {
+    std::shared_lock lock(order_book_mutex_);
+    for (const auto& [_, level] : buy_orders_) {
+        if (bids.size() >= depth) break;
+        bids.push_back(snapshot(level));
+    }
+    for (const auto& [_, level] : sell_orders_) {
+        if (asks.size() >= depth) break;
+        asks.push_back(snapshot(level));
+    }
+    return version();
+}
+
+template <typename Policy>
+std::shared_ptr<Order> BasicOrderBook<Policy>::get_order(OrderId order_id) const {
+    std::shared_lock lock(orders_mutex_);
+    auto it = orders_by_id_.find(order_id);
+    return (it != orders_by_id_.end()) ? it->second : nullptr;
+}
+
+template <typename Policy>
+std::vector<std::shared_ptr<Order>> BasicOrderBook<Policy>::get_user_orders(const UserId& user_id) const {
+    std::vector<std::shared_ptr<Order>> result;
+    std::shared_lock book_lock(order_book_mutex_);
+    auto it = resting_by_user_.find(user_id);
+    if (it == resting_by_user_.end()) return result;
+    std::shared_lock lock(orders_mutex_);
+    result.reserve(it->second.size());
+    for (const auto& id : it->second) {
+        auto order_it = orders_by_id_.find(id);
+        if (order_it != orders_by_id_.end()) result.push_back(order_it->second);
+    }
+    return result;
+}
+
+template <typename Policy>
+size_t BasicOrderBook<Policy>::scan_user_trades(const std::string& user_id, size_t from, size_t max, std::vector<Trade>& out) const {
+    // Bounded by entries looked at, not matches - a user with few trades in a long
+    // history mustn't turn one call into a walk over all of it
+    size_t end = trade_history_.size();
+    if (from >= end) return from;
+    if (max < end - from) end = from + max;
+    for (size_t pos = from; pos < end; ++pos) {
+        const auto& t = trade_history_[pos];
+        // The trade carries both users, so orders that have since been
+        // cancelled or pulled still count
+        if (t.buy_user_id == user_id || t.sell_user_id == user_id) out.push_back(t);
+    }
+    return end;
+}
+
+template <typename Policy>
+size_t BasicOrderBook<Policy>::scan_user_orders(const UserId& user_id, const OrderId& after, size_t max,
+                                                std::vector<std::shared_ptr<Order>>& out) const {
+    std::shared_lock book_lock(order_book_mutex_);
+    auto it = resting_by_user_.find(user_id);
+    if (it == resting_by_user_.end()) return 0;
+    std::shared_lock lock(orders_mutex_);
+    size_t taken = 0;
+    for (auto id = it->second.upper_bound(after); id != it->second.end() && taken < max; ++id) {
+        auto order_it = orders_by_id_.find(*id);
+        if (order_it == orders_by_id_.end()) continue;
+        out.push_back(order_it->second);
+        ++taken;
+    }
+    return taken;
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::clear() {
+    std::unique_lock lock1(order_book_mutex_);
+    std::unique_lock lock2(orders_mutex_);
+    buy_orders_.clear();
+    sell_orders_.clear();
+    orders_by_id_.clear();
+    expiring_.clear();
+    resting_by_user_.clear();
+    total_orders_ = total_trades_ = 0;
+    total_volume_ = 0;
+    bump_version();
+}
+
+template <typename Policy>
+bool BasicOrderBook<Policy>::is_empty() const {
+    std::shared_lock lock(order_book_mutex_);
+    return buy_orders_.empty() && sell_orders_.empty();
+}
+
+template <typename Policy>
+size_t BasicOrderBook<Policy>::get_order_count() const {
+    std::shared_lock lock(orders_mutex_);
+    return orders_by_id_.size();
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::forget_expiry(const Order& order) {
+    if (order.expiry <= 0) return;
+    auto [first, last] = expiring_.equal_range(order.expiry);
+    for (auto e = first; e != last; ++e) {
+        if (e->second == order.id) {
+            expiring_.erase(e);
+            return;
+        }
+    }
+}
+
+template <typename Policy>
+size_t BasicOrderBook<Policy>::expiring_count() const {
+    std::shared_lock lock(orders_mutex_);
+    return expiring_.size();
+}
+
+template <typename Policy>
+void BasicOrderBook<Policy>::cancel_expired_orders() {
+    int64_t now = clock_ ? clock_->unix_seconds() : std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::vector<OrderId> to_cancel;
+    {
+        // Every entry that has come due goes. Orders still NEW are cancelled;
+        // a part-filled order doesn't expire (it never has), and nothing brings
+        // it back to NEW except a modify that re-adds it, which files a new entry.
+        std::unique_lock lock(orders_mutex_);
+        auto due_end = expiring_.upper_bound(now);
+        for (auto e = expiring_.begin(); e != due_end; e = expiring_.erase(e)) {
+            auto it = orders_by_id_.find(e->second);
+            if (it != orders_by_id_.end() && it->second->expiry == e->first && it->second->status == OrderStatus::NEW) {
+                to_cancel.push_back(e->second);
+            }
+        }
+    }
+    for (const auto& id : to_cancel) {
+        cancel_order(id);
+    }
+}
+
+template <typename Policy>
+OrderBookLevel BasicOrderBook<Policy>::snapshot(const Level& level) {
+    if constexpr (std::is_same_v<Level, OrderBookLevel>) {
+        return level;
+    } else {
+        OrderBookLevel copy(level.price);
+        copy.orders.assign(level.orders.begin(), level.orders.end());
+        copy.total_quantity = level.total_quantity;
+        return copy;
+    }
+}
+
+}  // namespace orderbook
+
+#endif // ORDERBOOK_ORDER_BOOK_IMPL_HPP
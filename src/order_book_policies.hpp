@@ -0,0 +1,191 @@
+#ifndef ORDERBOOK_ORDER_BOOK_POLICIES_HPP
+#define ORDERBOOK_ORDER_BOOK_POLICIES_HPP
+
+#include "order.hpp"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <shared_mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace orderbook {
+
+/**
+ * Policies for BasicOrderBook
+ *
+ * A book is put together from five independent choices, each a small struct
+ * with a member template (or alias) the book instantiates:
+ *  - level store: price -> level, iterated best price first
+ *  - order queue: the FIFO of orders resting at one price
+ *  - ID index:    order ID -> order
+ *  - allocation:  where the containers above get their memory
+ *  - locking:     the book's own reader/writer locks
+ * BookPolicy<> with no arguments is exactly the original OrderBook.
+ */
+
+/**
+ * Sorted-vector map for price levels
+ *
+ * Stored worst price first, so the best level - where nearly all inserts
+ * and erases happen - sits at the back and moves nothing. Iteration still
+ * runs best price first, like std::map. Unlike std::map, adding or removing
+ * a level invalidates iterators and references to the other levels.
+ */
+template <typename Key, typename T, typename Compare, typename Alloc>
+class SortedVectorMap {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+    using storage_type = std::vector<value_type, allocator_type>;
+    using iterator = typename storage_type::reverse_iterator;
+    using const_iterator = typename storage_type::const_reverse_iterator;
+
+    SortedVectorMap() = default;
+    explicit SortedVectorMap(const Alloc& alloc) : data_(allocator_type(alloc)) {}
+
+    iterator begin() { return data_.rbegin(); }
+    iterator end() { return data_.rend(); }
+    const_iterator begin() const { return data_.rbegin(); }
+    const_iterator end() const { return data_.rend(); }
+    bool empty() const { return data_.empty(); }
+    size_t size() const { return data_.size(); }
+    void clear() { data_.clear(); }
+
+    iterator find(const Key& key) {
+        auto pos = lower(data_.begin(), data_.end(), key);
+        return matches(pos, key) ? iterator(std::next(pos)) : end();
+    }
+    const_iterator find(const Key& key) const {
+        auto pos = lower(data_.begin(), data_.end(), key);
+        return matches(pos, key) ? const_iterator(std::next(pos)) : end();
+    }
+
+    T& operator[](const Key& key) {
+        auto pos = lower(data_.begin(), data_.end(), key);
+        if (!matches(pos, key)) {
+            pos = data_.emplace(pos, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple());
+        }
+        return pos->second;
+    }
+
+    iterator erase(iterator it) {
+        return iterator(data_.erase(std::next(it).base()));
+    }
+    size_t erase(const Key& key) {
+        auto it = find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+private:
+    // First stored entry that doesn't come after key in iteration order
+    template <typename It>
+    It lower(It first, It last, const Key& key) const {
+        return std::lower_bound(first, last, key, [this](const value_type& v, const Key& k) { return comp_(k, v.first); });
+    }
+    bool matches(typename storage_type::const_iterator pos, const Key& key) const {
+        return pos != data_.end() && !comp_(pos->first, key);
+    }
+
+    storage_type data_;
+    [[no_unique_address]] Compare comp_;
+};
+
+// Lock policy for books whose callers already serialize access (the engine lock does)
+struct NullSharedMutex {
+    void lock() {}
+    bool try_lock() { return true; }
+    void unlock() {}
+    void lock_shared() {}
+    bool try_lock_shared() { return true; }
+    void unlock_shared() {}
+};
+
+// --- Level stores ---
+struct MapLevels {
+    template <typename Level, typename Compare, typename Alloc>
+    using type = std::map<Price, Level, Compare, Alloc>;
+};
+
+struct VectorLevels {
+    template <typename Level, typename Compare, typename Alloc>
+    using type = SortedVectorMap<Price, Level, Compare, Alloc>;
+};
+
+// --- Order queues (time priority within a price) ---
+struct DequeQueue {
+    template <typename T, typename Alloc>
+    using type = std::deque<T, Alloc>;
+};
+
+struct ListQueue {
+    template <typename T, typename Alloc>
+    using type = std::list<T, Alloc>;
+};
+
+// --- Order ID indexes ---
+struct OrderedIdIndex {
+    template <typename V, typename Alloc>
+    using type = std::map<OrderId, V, std::less<OrderId>, Alloc>;
+};
+
+struct HashIdIndex {
+    template <typename V, typename Alloc>
+    using type = std::unordered_map<OrderId, V, std::hash<OrderId>, std::equal_to<OrderId>, Alloc>;
+};
+
+// --- Allocation ---
+struct HeapAllocation {
+    template <typename T>
+    using allocator = std::allocator<T>;
+    struct resource {};
+    template <typename T>
+    static allocator<T> make(resource&) { return {}; }
+};
+
+// One pool per book. The pool isn't thread-safe, so pair it with NoLocking
+// (or the engine lock) - never with concurrent writers on the same book.
+struct PoolAllocation {
+    template <typename T>
+    using allocator = std::pmr::polymorphic_allocator<T>;
+    using resource = std::pmr::unsynchronized_pool_resource;
+    template <typename T>
+    static allocator<T> make(resource& r) { return allocator<T>(&r); }
+};
+
+// --- Locking ---
+struct SharedLocking {
+    using mutex = std::shared_mutex;
+};
+
+struct NoLocking {
+    using mutex = NullSharedMutex;
+};
+
+template <typename Levels = MapLevels, typename Queue = DequeQueue, typename Index = OrderedIdIndex,
+          typename Allocation = HeapAllocation, typename Locking = SharedLocking>
+struct BookPolicy {
+    using levels = Levels;
+    using queue = Queue;
+    using index = Index;
+    using allocation = Allocation;
+    using locking = Locking;
+};
+
+// What OrderBook is: std::map levels, std::deque queues, std::map index, heap, shared_mutex
+using ReferenceBookPolicy = BookPolicy<>;
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_ORDER_BOOK_POLICIES_HPP
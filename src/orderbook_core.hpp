@@ -0,0 +1,36 @@
+#ifndef ORDERBOOK_CORE_HPP
+#define ORDERBOOK_CORE_HPP
+
+/**
+ * Embeddable engine API
+ *
+ * The one header to include when linking orderbook::core into something
+ * other than the server - a backtester, a market simulator, a notebook. It
+ * pulls in the matching engine, the policy-based order book and the types
+ * they share, and nothing that needs Drogon, Postgres or bcrypt.
+ *
+ * What's here is the stable part: MatchingEngine, OrderBook/BasicOrderBook,
+ * Order, Trade and the aliases in types.hpp. The version below only bumps
+ * its major number when one of those changes incompatibly.
+ *
+ * Threading: MatchingEngine takes its own lock on every call, so it can be
+ * shared. For a single-threaded simulation a BasicOrderBook with NoLocking
+ * (and PoolAllocation) skips the locks entirely.
+ */
+
+#include "types.hpp"
+#include "order.hpp"
+#include "order_book_impl.hpp"  // So any BookPolicy instantiates, not just the reference one
+#include "matching_engine.hpp"
+
+#define ORDERBOOK_CORE_VERSION_MAJOR 1
+#define ORDERBOOK_CORE_VERSION_MINOR 0
+
+namespace orderbook {
+
+inline constexpr int core_version_major = ORDERBOOK_CORE_VERSION_MAJOR;
+inline constexpr int core_version_minor = ORDERBOOK_CORE_VERSION_MINOR;
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_CORE_HPP
@@ -0,0 +1,256 @@
+#include "pg_copy.hpp"
+#include <libpq-fe.h>
+#include <cstring>
+
+namespace orderbook {
+
+namespace {
+
+const char SIGNATURE[] = "PGCOPY\n\377\r\n";   // 11 bytes including the trailing NUL
+constexpr size_t SIGNATURE_LEN = 11;
+
+uint32_t read_u32(const char* p) {
+    auto b = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+}
+
+int16_t read_i16(const char* p) {
+    auto b = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<int16_t>((uint16_t(b[0]) << 8) | uint16_t(b[1]));
+}
+
+} // namespace
+
+// ---- PgBinaryRow ----
+
+bool PgBinaryRow::parse(const char* data, size_t len, bool first) {
+    fields_.clear();
+    trailer_ = false;
+    header_only_ = false;
+    const char* p = data;
+    const char* end = data + len;
+    if (first) {
+        // Signature, flags, then a header extension we don't use
+        if (len < SIGNATURE_LEN + 8 || std::memcmp(p, SIGNATURE, SIGNATURE_LEN) != 0) return false;
+        p += SIGNATURE_LEN + 4;
+        uint32_t ext = read_u32(p);
+        p += 4;
+        if (static_cast<size_t>(end - p) < ext) return false;
+        p += ext;
+        if (p == end) {
+            header_only_ = true;
+            return true;
+        }
+    }
+    if (end - p < 2) return false;
+    int16_t count = read_i16(p);
+    p += 2;
+    if (count == -1) {
+        trailer_ = true;
+        return true;
+    }
+    if (count < 0) return false;
+    fields_.reserve(count);
+    for (int16_t i = 0; i < count; ++i) {
+        if (end - p < 4) return false;
+        auto field_len = static_cast<int32_t>(read_u32(p));
+        p += 4;
+        if (field_len == -1) {
+            fields_.emplace_back();
+            continue;
+        }
+        if (field_len < 0 || end - p < field_len) return false;
+        fields_.emplace_back(p, static_cast<size_t>(field_len));
+        p += field_len;
+    }
+    return true;
+}
+
+int64_t PgBinaryRow::int64(size_t i) const {
+    const auto& f = fields_[i];
+    if (f.data() == nullptr || f.size() != 8) return 0;
+    uint64_t hi = read_u32(f.data());
+    uint64_t lo = read_u32(f.data() + 4);
+    return static_cast<int64_t>((hi << 32) | lo);
+}
+
+// ---- PgBinaryEncoder ----
+
+void PgBinaryEncoder::put_int16(int16_t v) {
+    auto u = static_cast<uint16_t>(v);
+    buffer_.push_back(static_cast<char>(u >> 8));
+    buffer_.push_back(static_cast<char>(u & 0xff));
+}
+
+void PgBinaryEncoder::put_int32(int32_t v) {
+    auto u = static_cast<uint32_t>(v);
+    for (int shift = 24; shift >= 0; shift -= 8) buffer_.push_back(static_cast<char>((u >> shift) & 0xff));
+}
+
+void PgBinaryEncoder::header() {
+    buffer_.append(SIGNATURE, SIGNATURE_LEN);
+    put_int32(0);   // flags
+    put_int32(0);   // header extension length
+}
+
+void PgBinaryEncoder::begin_row(int16_t fields) { put_int16(fields); }
+
+void PgBinaryEncoder::add_text(std::string_view value) {
+    put_int32(static_cast<int32_t>(value.size()));
+    buffer_.append(value.data(), value.size());
+}
+
+void PgBinaryEncoder::add_int64(int64_t value) {
+    put_int32(8);
+    auto u = static_cast<uint64_t>(value);
+    for (int shift = 56; shift >= 0; shift -= 8) buffer_.push_back(static_cast<char>((u >> shift) & 0xff));
+}
+
+void PgBinaryEncoder::add_null() { put_int32(-1); }
+
+void PgBinaryEncoder::trailer() { put_int16(-1); }
+
+// ---- PgCopyReader ----
+
+PgCopyReader::PgCopyReader(PGconn* conn, const std::string& copy_sql) : conn_(conn) {
+    PGresult* res = PQexec(conn_, copy_sql.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_OUT) {
+        error_ = PQresultErrorMessage(res);
+        done_ = true;
+    }
+    PQclear(res);
+}
+
+PgCopyReader::~PgCopyReader() {
+    if (buffer_) PQfreemem(buffer_);
+    // Drain the rest so the connection is usable again
+    if (!done_) {
+        while (next()) {}
+    }
+}
+
+bool PgCopyReader::next() {
+    if (done_) return false;
+    if (buffer_) {
+        PQfreemem(buffer_);
+        buffer_ = nullptr;
+    }
+    int len = PQgetCopyData(conn_, &buffer_, 0);
+    if (len == -1) {            // Stream ended without a trailer
+        finish();
+        return false;
+    }
+    if (len < 0) {
+        error_ = PQerrorMessage(conn_);
+        finish();
+        return false;
+    }
+    bool first = !started_;
+    started_ = true;
+    if (!row_.parse(buffer_, static_cast<size_t>(len), first)) {
+        error_ = "malformed COPY data";
+        finish();
+        return false;
+    }
+    if (row_.is_header_only()) return next();
+    if (row_.is_trailer()) {
+        // libpq reports the end of the stream (-1) after the trailer
+        PQfreemem(buffer_);
+        buffer_ = nullptr;
+        while (PQgetCopyData(conn_, &buffer_, 0) > 0) {
+            PQfreemem(buffer_);
+            buffer_ = nullptr;
+        }
+        finish();
+        return false;
+    }
+    rows_++;
+    return true;
+}
+
+void PgCopyReader::finish() {
+    done_ = true;
+    PGresult* res;
+    while ((res = PQgetResult(conn_)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && error_.empty()) error_ = PQresultErrorMessage(res);
+        PQclear(res);
+    }
+}
+
+// ---- PgCopyWriter ----
+
+PgCopyWriter::PgCopyWriter(PGconn* conn, const std::string& copy_sql) : conn_(conn) {
+    PGresult* res = PQexec(conn_, copy_sql.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_IN) error_ = PQresultErrorMessage(res);
+    PQclear(res);
+    encoder_.buffer().reserve(CHUNK_SIZE + 4096);
+    encoder_.header();
+}
+
+PgBinaryEncoder& PgCopyWriter::row(int16_t fields) {
+    if (encoder_.buffer().size() >= CHUNK_SIZE) flush();
+    encoder_.begin_row(fields);
+    rows_++;
+    return encoder_;
+}
+
+bool PgCopyWriter::flush() {
+    auto& buf = encoder_.buffer();
+    if (ok() && !buf.empty() && PQputCopyData(conn_, buf.data(), static_cast<int>(buf.size())) != 1) {
+        error_ = PQerrorMessage(conn_);
+    }
+    buf.clear();
+    return ok();
+}
+
+bool PgCopyWriter::finish() {
+    encoder_.trailer();
+    flush();
+    if (PQputCopyEnd(conn_, ok() ? nullptr : "client error") != 1 && ok()) error_ = PQerrorMessage(conn_);
+    PGresult* res;
+    while ((res = PQgetResult(conn_)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && ok()) error_ = PQresultErrorMessage(res);
+        PQclear(res);
+    }
+    return ok();
+}
+
+// ---- Passthrough ----
+
+int64_t pg_copy_between(PGconn* from, const std::string& copy_out_sql,
+                        PGconn* to, const std::string& copy_in_sql, std::string& error) {
+    PGresult* res = PQexec(from, copy_out_sql.c_str());
+    bool out_ok = PQresultStatus(res) == PGRES_COPY_OUT;
+    if (!out_ok) error = PQresultErrorMessage(res);
+    PQclear(res);
+    if (!out_ok) return -1;
+    res = PQexec(to, copy_in_sql.c_str());
+    bool in_ok = PQresultStatus(res) == PGRES_COPY_IN;
+    if (!in_ok) error = PQresultErrorMessage(res);
+    PQclear(res);
+
+    // Each CopyData message is one row (the first also carries the header, the last is the trailer)
+    int64_t messages = 0;
+    char* buf = nullptr;
+    int len;
+    while ((len = PQgetCopyData(from, &buf, 0)) > 0) {
+        if (in_ok && error.empty() && PQputCopyData(to, buf, len) != 1) error = PQerrorMessage(to);
+        PQfreemem(buf);
+        messages++;
+    }
+    if (len == -2 && error.empty()) error = PQerrorMessage(from);
+    while ((res = PQgetResult(from)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && error.empty()) error = PQresultErrorMessage(res);
+        PQclear(res);
+    }
+    if (!in_ok) return -1;
+    PQputCopyEnd(to, error.empty() ? nullptr : "source failed");
+    while ((res = PQgetResult(to)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK && error.empty()) error = PQresultErrorMessage(res);
+        PQclear(res);
+    }
+    if (!error.empty()) return -1;
+    return messages > 0 ? messages - 1 : 0;   // Don't count the trailer
+}
+
+} // namespace orderbook
@@ -0,0 +1,112 @@
+#ifndef ORDERBOOK_PG_COPY_HPP
+#define ORDERBOOK_PG_COPY_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef struct pg_conn PGconn;
+
+namespace orderbook {
+
+// One row of a binary COPY stream, decoded in place
+// Field views point into the buffer libpq handed us and are only valid until the next row.
+class PgBinaryRow {
+public:
+    // Parse one CopyData message; returns false on malformed data.
+    // The very first message of a stream also carries the file header, which is skipped.
+    bool parse(const char* data, size_t len, bool first);
+    bool is_trailer() const { return trailer_; }
+    bool is_header_only() const { return header_only_; }     // Header arrived in a message of its own
+
+    size_t size() const { return fields_.size(); }
+    bool is_null(size_t i) const { return fields_[i].data() == nullptr; }
+    std::string_view text(size_t i) const { return fields_[i]; }
+    int64_t int64(size_t i) const;     // bigint column (0 if NULL)
+
+private:
+    std::vector<std::string_view> fields_;
+    bool trailer_ = false;
+    bool header_only_ = false;
+};
+
+// Builds binary COPY data: header, rows, trailer
+class PgBinaryEncoder {
+public:
+    void header();
+    void begin_row(int16_t fields);
+    void add_text(std::string_view value);
+    void add_int64(int64_t value);
+    void add_null();
+    void trailer();
+
+    std::string& buffer() { return buffer_; }
+
+private:
+    void put_int16(int16_t v);
+    void put_int32(int32_t v);
+    std::string buffer_;
+};
+
+// Streams the rows of "COPY (...) TO STDOUT (FORMAT binary)" one at a time
+// Nothing is materialized - each row is decoded straight out of libpq's buffer.
+class PgCopyReader {
+public:
+    PgCopyReader(PGconn* conn, const std::string& copy_sql);
+    ~PgCopyReader();
+
+    PgCopyReader(const PgCopyReader&) = delete;
+    PgCopyReader& operator=(const PgCopyReader&) = delete;
+
+    // Advance to the next row; false at the end of the stream or on error (check ok())
+    bool next();
+    const PgBinaryRow& row() const { return row_; }
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+    uint64_t rows() const { return rows_; }
+
+private:
+    void finish();
+
+    PGconn* conn_;
+    char* buffer_ = nullptr;
+    PgBinaryRow row_;
+    bool started_ = false;
+    bool done_ = false;
+    uint64_t rows_ = 0;
+    std::string error_;
+};
+
+// Feeds rows into "COPY table (...) FROM STDIN (FORMAT binary)"
+// Rows are encoded into a local buffer and shipped in large chunks.
+class PgCopyWriter {
+public:
+    PgCopyWriter(PGconn* conn, const std::string& copy_sql);
+
+    PgBinaryEncoder& row(int16_t fields);   // Start a row, then add exactly `fields` values
+    bool finish();                          // Send the trailer and wait for the server's verdict
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+    uint64_t rows() const { return rows_; }
+
+private:
+    bool flush();
+
+    PGconn* conn_;
+    PgBinaryEncoder encoder_;
+    uint64_t rows_ = 0;
+    std::string error_;
+    static constexpr size_t CHUNK_SIZE = 256 * 1024;
+};
+
+// Pipe a COPY TO stream from one connection into a COPY FROM on another without decoding it
+// Both statements must use the same column list and FORMAT binary. Returns rows moved, or -1 on error.
+int64_t pg_copy_between(PGconn* from, const std::string& copy_out_sql,
+                        PGconn* to, const std::string& copy_in_sql, std::string& error);
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_PG_COPY_HPP
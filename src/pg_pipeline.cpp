@@ -0,0 +1,250 @@
+#include "pg_pipeline.hpp"
+#include <libpq-fe.h>
+#include <chrono>
+#include <iostream>
+
+namespace orderbook {
+
+namespace {
+
+struct StatementDef {
+    const char* name;
+    const char* sql;
+    int params;
+};
+
+const StatementDef STATEMENTS[] = {
+    // Orders journaled before stop_price..ts_us existed send those as NULL, so they fall back to the defaults
+    {"ob_upsert_order",
+     "INSERT INTO orders (id, symbol, side, type, price, quantity, user_id, status, filled, stop_price, tif, expiry, is_quote, ts) "
+     "VALUES ($1,$2,$3,$4,$5,$6,$7,$8,$9,COALESCE($10::bigint, 0),COALESCE($11, 'GTC'),COALESCE($12::bigint, 0),"
+     "COALESCE($13::boolean, false),COALESCE(to_timestamp($14::double precision / 1000000), NOW())) "
+     "ON CONFLICT (id) DO UPDATE SET symbol=EXCLUDED.symbol, side=EXCLUDED.side, type=EXCLUDED.type, price=EXCLUDED.price, "
+     "quantity=EXCLUDED.quantity, user_id=EXCLUDED.user_id, status=EXCLUDED.status, filled=EXCLUDED.filled, "
+     "stop_price=EXCLUDED.stop_price, tif=EXCLUDED.tif, expiry=EXCLUDED.expiry, is_quote=EXCLUDED.is_quote, updated_at=NOW()",
+     14},
+    {"ob_update_order_status",
+     "UPDATE orders SET status=$2, filled=$3, quantity=$4, price=$5, updated_at=NOW() WHERE id=$1",
+     5},
+    // Inserts are keyed by (write_id, ts) so a batch resent after a lost connection doesn't add rows twice
+    {"ob_insert_action",
+     "INSERT INTO actions (action, order_id, price, quantity, write_id, ts) "
+     "VALUES ($1,$2,$3,$4,$5,COALESCE(to_timestamp($6::double precision / 1000000), NOW())) "
+     "ON CONFLICT (write_id, ts) DO NOTHING",
+     6},
+    {"ob_insert_trade",
+     "INSERT INTO trades (symbol, buy_order_id, sell_order_id, buy_user_id, sell_user_id, price, quantity, write_id, ts) "
+     "VALUES ($1,$2,$3,$4,$5,$6,$7,$8,COALESCE(to_timestamp($9::double precision / 1000000), NOW())) "
+     "ON CONFLICT (write_id, ts) DO NOTHING",
+     9},
+};
+
+// Indexed by RecordType
+const StatementDef& def(RecordType type) {
+    return STATEMENTS[static_cast<size_t>(type)];
+}
+
+// Prepare every statement and switch the connection into pipeline mode
+bool prepare_connection(PGconn* conn) {
+    for (const auto& stmt : STATEMENTS) {
+        PGresult* res = PQprepare(conn, stmt.name, stmt.sql, stmt.params, nullptr);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) std::cerr << "[DB ERROR] Prepare " << stmt.name << " failed: " << PQresultErrorMessage(res);
+        PQclear(res);
+        if (!ok) return false;
+    }
+    return PQenterPipelineMode(conn) == 1;
+}
+
+} // namespace
+
+const char* PgPipelineWriter::sql(RecordType type) { return def(type).sql; }
+
+PgPipelineWriter::PgPipelineWriter(Options options) : options_(std::move(options)) {
+    if (options_.connections == 0) options_.connections = 1;
+    if (options_.max_batch == 0) options_.max_batch = 1;
+    work_cvs_ = std::vector<std::condition_variable>(options_.connections);
+    queues_.resize(options_.connections);
+}
+
+PgPipelineWriter::~PgPipelineWriter() {
+    stop();
+}
+
+PGconn* PgPipelineWriter::connect() const {
+    PGconn* conn = PQconnectdb(options_.conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::cerr << "[DB ERROR] Writer connection failed: " << PQerrorMessage(conn);
+        PQfinish(conn);
+        return nullptr;
+    }
+    if (!prepare_connection(conn)) {
+        PQfinish(conn);
+        return nullptr;
+    }
+    return conn;
+}
+
+bool PgPipelineWriter::start() {
+    std::vector<PGconn*> conns;
+    size_t opened = 0;
+    for (size_t i = 0; i < options_.connections; ++i) {
+        conns.push_back(connect());
+        if (conns.back()) opened++;
+    }
+    if (opened == 0) return false;
+    // Every queue needs its worker - one whose connection didn't open keeps trying to connect
+    for (size_t i = 0; i < conns.size(); ++i) workers_.emplace_back(&PgPipelineWriter::worker_loop, this, i, conns[i]);
+    std::cout << "[DB] Pipeline writer running on " << opened << " of " << conns.size() << " connections" << std::endl;
+    return true;
+}
+
+void PgPipelineWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    for (auto& cv : work_cvs_) cv.notify_all();
+    for (auto& worker : workers_) worker.join();
+    workers_.clear();
+}
+
+size_t PgPipelineWriter::lane_for(const StorageRecord& record) const {
+    // Orders and status updates lead with the order id, actions and trades have it second
+    const std::string& key = record.type == RecordType::UpsertOrder || record.type == RecordType::UpdateOrderStatus
+        ? record.values[0] : record.values[1];
+    return std::hash<std::string>{}(key) % queues_.size();
+}
+
+void PgPipelineWriter::write(StorageRecord&& record) {
+    size_t lane = lane_for(record);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queues_[lane].push_back(std::move(record));
+        queued_++;
+    }
+    work_cvs_[lane].notify_one();
+}
+
+void PgPipelineWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_cv_.wait(lock, [this] { return (queued_ == 0 && in_flight_ == 0) || workers_.empty(); });
+}
+
+StorageStats PgPipelineWriter::stats() const {
+    StorageStats s;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.queued = queued_ + in_flight_;
+    }
+    s.written = written_.load();
+    s.failed = failed_.load();
+    s.rejected = rejected_.load();
+    s.batches = batches_.load();
+    return s;
+}
+
+void PgPipelineWriter::finish_writes(size_t count) {
+    if (count == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_ -= count;
+    if (queued_ == 0 && in_flight_ == 0) idle_cv_.notify_all();
+}
+
+void PgPipelineWriter::worker_loop(size_t lane, PGconn* conn) {
+    std::vector<StorageRecord> batch;
+    batch.reserve(options_.max_batch);
+    auto& queue = queues_[lane];
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_cvs_[lane].wait(lock, [&] { return stopping_ || !queue.empty() || !batch.empty(); });
+            if (stopping_ && queue.empty() && batch.empty()) break;
+            // Top the batch up (it may still hold writes being retried - those stay in front)
+            while (batch.size() < options_.max_batch && !queue.empty()) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+                queued_--;
+                in_flight_++;
+            }
+        }
+        if (!conn) conn = connect();
+        if (conn) {
+            if (run_batch(conn, batch)) continue;
+            std::cerr << "[DB ERROR] Writer lost its connection: " << PQerrorMessage(conn);
+            PQfinish(conn);
+            conn = nullptr;
+        }
+        // Can't reach the database - during shutdown give up, otherwise back off and retry
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping = stopping_;
+        }
+        if (stopping) {
+            std::cerr << "[DB ERROR] Dropping " << batch.size() << " unwritten writes at shutdown" << std::endl;
+            failed_ += batch.size();
+            finish_writes(batch.size());
+            batch.clear();
+        } else {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+    if (conn) PQfinish(conn);
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_cv_.notify_all();
+}
+
+bool PgPipelineWriter::run_batch(PGconn* conn, std::vector<StorageRecord>& batch) {
+    const char* values[std::tuple_size_v<decltype(StorageRecord::values)>];
+    for (const auto& record : batch) {
+        const auto& stmt = def(record.type);
+        for (int i = 0; i < stmt.params; ++i) {
+            values[i] = (record.null_mask & (1u << i)) ? nullptr : record.values[i].c_str();
+        }
+        if (!PQsendQueryPrepared(conn, stmt.name, stmt.params, values, nullptr, nullptr, 0)) return false;
+    }
+    if (!PQpipelineSync(conn)) return false;
+    batches_++;
+
+    // One result (plus a NULL separator) per statement, then the sync
+    std::vector<bool> failed(batch.size(), false);
+    size_t failures = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        PGresult* res = PQgetResult(conn);
+        if (!res) return false;
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_FATAL_ERROR) {
+            std::cerr << "[DB ERROR] " << def(batch[i].type).name << ": " << PQresultErrorMessage(res);
+            failed[i] = true;
+            failures++;
+        }
+        PQclear(res);
+        PGresult* separator = PQgetResult(conn);
+        if (separator) PQclear(separator);
+    }
+    PGresult* sync = PQgetResult(conn);
+    if (!sync) return false;
+    bool synced = PQresultStatus(sync) == PGRES_PIPELINE_SYNC;
+    PQclear(sync);
+    if (!synced) return false;
+
+    if (failures == 0) {
+        written_ += batch.size();
+        finish_writes(batch.size());
+        batch.clear();
+        return true;
+    }
+    // The batch was one transaction, so nothing in it stuck - drop the bad writes and resend the rest
+    rejected_ += failures;
+    std::vector<StorageRecord> retry;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (!failed[i]) retry.push_back(std::move(batch[i]));
+    }
+    batch.swap(retry);
+    finish_writes(failures);
+    return true;
+}
+
+} // namespace orderbook
@@ -0,0 +1,89 @@
+#ifndef ORDERBOOK_PG_PIPELINE_HPP
+#define ORDERBOOK_PG_PIPELINE_HPP
+
+#include "storage.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct pg_conn PGconn;
+
+namespace orderbook {
+
+/**
+ * Database writer using prepared statements and libpq pipeline mode
+ *
+ * Every connection prepares the write statements once, then ships queued
+ * writes in batches: up to max_batch statements go out back to back,
+ * followed by a single sync, so a whole batch costs one round trip instead
+ * of one per statement and no SQL text is parsed or planned per write.
+ *
+ * Each connection has its own queue and a record goes to the one its order
+ * id hashes to, so every write for an order goes down one connection in the
+ * order it was made - an old status update can't land after a newer one.
+ *
+ * A batch runs as one implicit transaction. If a statement fails it is
+ * logged and dropped and the rest of the batch is sent again; if the
+ * connection drops, the batch is retried after reconnecting (at-least-once).
+ * Retried action/trade inserts are skipped by their write_id.
+ */
+class PgPipelineWriter : public Storage {
+public:
+    struct Options {
+        std::string conninfo;
+        size_t connections = 4;
+        size_t max_batch = 512;     // Keep modest - results are only read after the whole batch is sent
+    };
+
+    explicit PgPipelineWriter(Options options);
+    ~PgPipelineWriter() override;
+
+    PgPipelineWriter(const PgPipelineWriter&) = delete;
+    PgPipelineWriter& operator=(const PgPipelineWriter&) = delete;
+
+    // Open the connections and prepare the statements; false if none could be opened
+    bool start();
+    // Write out whatever is queued, then close the connections
+    void stop();
+
+    void write(StorageRecord&& record) override;
+    // Block until everything queued so far has been written (or given up on)
+    void flush() override;
+    StorageStats stats() const override;
+    const char* name() const override { return "postgres"; }
+
+    // SQL text behind each record type (shared with the benchmark's baseline)
+    static const char* sql(RecordType type);
+
+private:
+    void worker_loop(size_t lane, PGconn* conn);
+    PGconn* connect() const;
+    // Which connection's queue a record goes to
+    size_t lane_for(const StorageRecord& record) const;
+    // False if the connection broke - the batch is left intact for a retry
+    bool run_batch(PGconn* conn, std::vector<StorageRecord>& batch);
+    void finish_writes(size_t count);
+
+    Options options_;
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::vector<std::condition_variable> work_cvs_;    // One per connection
+    std::condition_variable idle_cv_;
+    std::vector<std::deque<StorageRecord>> queues_;     // One per connection
+    size_t queued_ = 0;         // Across all queues
+    size_t in_flight_ = 0;
+    bool stopping_ = false;
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> failed_{0};       // Dropped unwritten at shutdown
+    std::atomic<uint64_t> rejected_{0};     // Statements the database refused
+    std::atomic<uint64_t> batches_{0};
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_PG_PIPELINE_HPP
@@ -0,0 +1,65 @@
+#include "request_arena.hpp"
+#include <cstring>
+#include <memory>
+
+namespace orderbook {
+
+namespace {
+
+// Heap upstream that counts how often the block wasn't enough
+class CountingResource : public std::pmr::memory_resource {
+public:
+    uint64_t allocations = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+struct ArenaState {
+    std::unique_ptr<std::byte[]> block{new std::byte[RequestArena::BLOCK_BYTES]};
+    CountingResource upstream;
+    std::pmr::monotonic_buffer_resource arena{block.get(), RequestArena::BLOCK_BYTES, &upstream};
+    int depth = 0;
+};
+
+ArenaState& state() {
+    static thread_local ArenaState s;
+    return s;
+}
+
+} // namespace
+
+RequestArena::Scope::Scope() {
+    ++state().depth;
+}
+
+RequestArena::Scope::~Scope() {
+    auto& s = state();
+    // Nested scopes (a helper opening its own) leave the memory to the outer one
+    if (--s.depth == 0) s.arena.release();
+}
+
+std::pmr::memory_resource* RequestArena::resource() {
+    return &state().arena;
+}
+
+void RequestArena::prefault() {
+    auto& s = state();
+    // Inside a scope the block holds live data
+    if (s.depth == 0) std::memset(s.block.get(), 0, BLOCK_BYTES);
+}
+
+uint64_t RequestArena::heap_fallbacks() {
+    return state().upstream.allocations;
+}
+
+} // namespace orderbook
@@ -0,0 +1,46 @@
+#ifndef ORDERBOOK_REQUEST_ARENA_HPP
+#define ORDERBOOK_REQUEST_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace orderbook {
+
+/**
+ * Per-request scratch memory
+ *
+ * Each thread owns one monotonic arena over a fixed 64KB block. A handler opens
+ * a Scope, puts its temporaries (parsed fields, the response text) on
+ * RequestArena::resource(), and all of it is dropped in one go when the
+ * outermost Scope closes: no per-object frees, and once the block is warm no
+ * trips to malloc at all. Anything that outlives the request (Orders, storage
+ * records, the body handed to Drogon) still lives on the normal heap.
+ *
+ * A Scope must not be held across a co_await - another request on the same
+ * thread would reset the arena under it.
+ */
+class RequestArena {
+public:
+    static constexpr size_t BLOCK_BYTES = 64 * 1024;
+
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // This thread's arena
+    static std::pmr::memory_resource* resource();
+    // Touch every page of this thread's block so the first request doesn't take the page faults
+    // (outside any Scope; a no-op inside one)
+    static void prefault();
+    // Times this thread's arena outgrew its block and went to the heap
+    static uint64_t heap_fallbacks();
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_REQUEST_ARENA_HPP
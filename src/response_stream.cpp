@@ -0,0 +1,23 @@
+#include "response_stream.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace orderbook {
+
+size_t ResponseStream::read(char* buf, size_t len) {
+    if (len == 0) return 0;
+    while (offset_ == pending_.size()) {
+        if (finished_) return 0;
+        // Reuses the buffer, so its capacity stays at about one chunk
+        pending_.clear();
+        offset_ = 0;
+        finished_ = !producer_(pending_);
+    }
+    size_t n = std::min(len, pending_.size() - offset_);
+    std::memcpy(buf, pending_.data() + offset_, n);
+    offset_ += n;
+    sent_ += n;
+    return n;
+}
+
+} // namespace orderbook
@@ -0,0 +1,44 @@
+#ifndef ORDERBOOK_RESPONSE_STREAM_HPP
+#define ORDERBOOK_RESPONSE_STREAM_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace orderbook {
+
+/**
+ * Pull-based body for chunked HTTP responses
+ *
+ * Drogon's stream responses ask for the body a buffer at a time. This sits
+ * between that and a producer that serializes the next handful of records:
+ * it only calls the producer once everything it made last time has been
+ * handed out, so a response of any size holds one chunk in memory.
+ *
+ * The producer appends text to the string it's given and returns false once
+ * it has nothing more (what it appended on that last call is still sent).
+ * Appending nothing and returning true is fine - it's just called again.
+ */
+class ResponseStream {
+public:
+    using Producer = std::function<bool(std::string& out)>;
+
+    explicit ResponseStream(Producer producer) : producer_(std::move(producer)) {}
+
+    // Fills buf with up to len bytes; 0 means the body is complete
+    size_t read(char* buf, size_t len);
+
+    size_t bytes_sent() const { return sent_; }
+
+private:
+    Producer producer_;
+    std::string pending_;
+    size_t offset_ = 0;
+    size_t sent_ = 0;
+    bool finished_ = false;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_RESPONSE_STREAM_HPP
@@ -0,0 +1,131 @@
+#include "sanitize.hpp"
+#include <cstdint>
+
+// Vector paths need GCC/Clang builtins (ctz, cpu_supports, target attributes)
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define ORDERBOOK_SANITIZE_X86 1
+#endif
+
+namespace orderbook {
+
+namespace {
+
+constexpr bool allowed(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+size_t first_invalid_scalar(const char* p, size_t n, size_t i) {
+    for (; i < n; ++i) {
+        if (!allowed(static_cast<unsigned char>(p[i]))) return i;
+    }
+    return n;
+}
+
+#ifdef ORDERBOOK_SANITIZE_X86
+
+// Per-lane mask of allowed bytes: (c | 0x20) in a..z, c in 0..9, '_' or '-'
+// Range checks are done unsigned: x - lo <= hi - lo  <=>  min(x - lo, hi - lo) == x - lo
+__attribute__((always_inline))
+inline __m128i allowed_mask(__m128i c) {
+    auto in_range = [](__m128i x, char lo, char hi) {
+        __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(static_cast<char>(hi - lo))), d);
+    };
+    __m128i letter = in_range(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i digit = in_range(c, '0', '9');
+    __m128i extra = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('_')), _mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+    return _mm_or_si128(_mm_or_si128(letter, digit), extra);
+}
+
+// Reading 16 bytes from p is safe as long as they stay within p's page
+__attribute__((always_inline))
+inline bool same_page_16(const char* p) {
+    return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - 16;
+}
+
+// 16 bytes a step from i, then the tail. Always inlined so that inside the AVX2
+// version it comes out VEX-encoded - calling legacy SSE code with dirty upper
+// ymm state costs a transition stall far bigger than the check itself.
+__attribute__((always_inline, no_sanitize_address))
+inline size_t first_invalid_128(const char* p, size_t n, size_t i) {
+    for (; i + 16 <= n; i += 16) {
+        unsigned bad = ~_mm_movemask_epi8(allowed_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)))) & 0xFFFF;
+        if (bad) return i + __builtin_ctz(bad);
+    }
+    if (i == n) return n;
+    // Tail (and most whole identifiers, which are shorter than 16): one load, extra lanes masked off
+    if (same_page_16(p + i)) {
+        unsigned live = (1u << (n - i)) - 1;
+        unsigned bad = ~_mm_movemask_epi8(allowed_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)))) & live;
+        return bad ? i + __builtin_ctz(bad) : n;
+    }
+    return first_invalid_scalar(p, n, i);
+}
+
+__attribute__((no_sanitize_address))
+size_t first_invalid_sse2(const char* p, size_t n) {
+    return first_invalid_128(p, n, 0);
+}
+
+__attribute__((target("avx2")))
+inline __m256i in_range_avx2(__m256i x, char lo, char hi) {
+    __m256i d = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(static_cast<char>(hi - lo))), d);
+}
+
+__attribute__((target("avx2")))
+inline __m256i allowed_mask_avx2(__m256i c) {
+    __m256i letter = in_range_avx2(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i digit = in_range_avx2(c, '0', '9');
+    __m256i extra = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')));
+    return _mm256_or_si256(_mm256_or_si256(letter, digit), extra);
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+size_t first_invalid_avx2(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned bad = ~static_cast<unsigned>(_mm256_movemask_epi8(allowed_mask_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)))));
+        if (bad) return i + __builtin_ctz(bad);
+    }
+    // Under 32 bytes left
+    return first_invalid_128(p, n, i);
+}
+
+bool has_avx2() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // ORDERBOOK_SANITIZE_X86
+
+} // namespace
+
+size_t first_invalid_char(std::string_view s) {
+#ifdef ORDERBOOK_SANITIZE_X86
+    // Typical identifiers are under 32 bytes, where the ymm setup only costs time
+    static const bool avx2 = has_avx2();
+    if (avx2 && s.size() >= 64) return first_invalid_avx2(s.data(), s.size());
+    return first_invalid_sse2(s.data(), s.size());
+#else
+    return first_invalid_scalar(s.data(), s.size(), 0);
+#endif
+}
+
+std::string_view sanitize_view(std::string_view s, std::string& scratch) {
+    size_t bad = first_invalid_char(s);
+    if (bad == s.size()) return s;
+    // Dirty input: copy the clean runs between rejected bytes, still finding each run a vector at a time
+    scratch.clear();
+    scratch.reserve(s.size());
+    while (bad < s.size()) {
+        scratch.append(s.data(), bad);
+        s.remove_prefix(bad + 1);
+        bad = first_invalid_char(s);
+    }
+    scratch.append(s.data(), s.size());
+    return scratch;
+}
+
+} // namespace orderbook
@@ -0,0 +1,38 @@
+#ifndef ORDERBOOK_SANITIZE_HPP
+#define ORDERBOOK_SANITIZE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace orderbook {
+
+/**
+ * Input cleaning for identifiers (symbols, user ids, order ids, side/type/tif)
+ *
+ * The allowed set is ASCII letters, digits, '_' and '-'. Checking runs 16
+ * bytes per step with SSE2 (32 with AVX2 for long inputs when the CPU has
+ * it; a plain loop on other targets), and short inputs take a single vector
+ * load. Clean input - nearly all of it - is handed back as a view, no copy.
+ */
+
+// Index of the first byte outside the allowed set, or s.size() if there is none
+size_t first_invalid_char(std::string_view s);
+
+inline bool is_clean_identifier(std::string_view s) {
+    return first_invalid_char(s) == s.size();
+}
+
+// s itself when it's clean, otherwise the allowed bytes copied into scratch
+std::string_view sanitize_view(std::string_view s, std::string& scratch);
+
+// Owning version for when the result has to be kept
+inline std::string sanitize(std::string_view s) {
+    std::string scratch;
+    auto clean = sanitize_view(s, scratch);
+    return clean.data() == scratch.data() ? std::move(scratch) : std::string(clean);
+}
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_SANITIZE_HPP
@@ -1,4 +1,4 @@
-#include "utils.hpp"
+#include "security.hpp"
 #include <stdexcept>
 #include <cstring>
 #include <cstdlib>
@@ -7,6 +7,10 @@
 #include <iomanip>
 #include <chrono>
 
+extern "C" {
+#include "my_bcrypt.h"
+}
+
 namespace orderbook {
 
 std::string bcrypt_hash_password(const std::string& password, int workfactor) {
@@ -0,0 +1,20 @@
+#ifndef ORDERBOOK_SECURITY_HPP
+#define ORDERBOOK_SECURITY_HPP
+
+#include <string>
+
+// Password hashing and JWT signing for the server. Kept out of the engine
+// headers so orderbook_core doesn't need bcrypt.
+
+namespace orderbook {
+
+// Bcrypt password hashing utilities
+std::string bcrypt_hash_password(const std::string& password, int workfactor = 12);
+bool bcrypt_check_password(const std::string& password, const std::string& hash);
+
+// JWT secret utility
+std::string get_jwt_secret();
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_SECURITY_HPP
@@ -0,0 +1,521 @@
+#include "storage.hpp"
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace orderbook {
+
+namespace {
+
+const char* side_str(OrderSide side) { return side == OrderSide::BUY ? "buy" : "sell"; }
+
+const char* type_str(OrderType type) {
+    return type == OrderType::MARKET ? "market" :
+           type == OrderType::LIMIT ? "limit" :
+           type == OrderType::STOP ? "stop" : "stop_limit";
+}
+
+const char* status_str(OrderStatus status) {
+    return status == OrderStatus::FILLED ? "filled" :
+           status == OrderStatus::PARTIAL ? "partial" :
+           status == OrderStatus::CANCELLED ? "cancelled" :
+           status == OrderStatus::REJECTED ? "rejected" : "open";
+}
+
+// Log record layout (little endian):
+//   u32 body length | u8 type | u16 null mask | per field: u32 length, bytes
+constexpr size_t MAX_RECORD = 256 * 1024;
+
+void put_u16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v & 0xff));
+    out.push_back(static_cast<char>(v >> 8));
+}
+
+void put_u32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+uint32_t get_u32(const char* p) {
+    auto b = reinterpret_cast<const unsigned char*>(p);
+    return uint32_t(b[0]) | (uint32_t(b[1]) << 8) | (uint32_t(b[2]) << 16) | (uint32_t(b[3]) << 24);
+}
+
+void encode(std::string& out, const StorageRecord& record) {
+    size_t start = out.size();
+    put_u32(out, 0);    // Patched below
+    out.push_back(static_cast<char>(record.type));
+    put_u16(out, record.null_mask);
+    int fields = StorageRecord::field_count(record.type);
+    for (int i = 0; i < fields; ++i) {
+        put_u32(out, static_cast<uint32_t>(record.values[i].size()));
+        out.append(record.values[i]);
+    }
+    auto body = static_cast<uint32_t>(out.size() - start - 4);
+    for (int i = 0; i < 4; ++i) out[start + i] = static_cast<char>((body >> (8 * i)) & 0xff);
+}
+
+// Journals written before actions and trades had write_id/ts_us stop two fields short,
+// and orders from before stop_price/tif/expiry/is_quote/ts_us five short
+int legacy_field_count(RecordType type) {
+    int fields = StorageRecord::field_count(type);
+    switch (type) {
+        case RecordType::UpsertOrder: return fields - 5;
+        case RecordType::InsertAction:
+        case RecordType::InsertTrade: return fields - 2;
+        default: return fields;
+    }
+}
+
+OrderSide parse_side(const std::string& side) { return side == "buy" ? OrderSide::BUY : OrderSide::SELL; }
+
+OrderType parse_type(const std::string& type) {
+    return type == "market" ? OrderType::MARKET :
+           type == "limit" ? OrderType::LIMIT :
+           type == "stop" ? OrderType::STOP : OrderType::STOP_LIMIT;
+}
+
+std::chrono::high_resolution_clock::time_point from_us(int64_t ts_us) {
+    return std::chrono::high_resolution_clock::time_point(
+        std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::microseconds(ts_us)));
+}
+
+int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Decode one record body; false if it doesn't hold together
+bool decode(const char* p, size_t len, StorageRecord& record) {
+    if (len < 3 || static_cast<uint8_t>(p[0]) > static_cast<uint8_t>(RecordType::InsertTrade)) return false;
+    record.type = static_cast<RecordType>(p[0]);
+    record.null_mask = static_cast<uint16_t>(static_cast<unsigned char>(p[1]) | (static_cast<unsigned char>(p[2]) << 8));
+    size_t pos = 3;
+    int fields = StorageRecord::field_count(record.type);
+    for (int i = 0; i < fields; ++i) {
+        if (pos == len && i == legacy_field_count(record.type)) {
+            // Old record - the missing fields are NULL
+            for (; i < fields; ++i) {
+                record.values[i].clear();
+                record.null_mask |= static_cast<uint16_t>(1u << i);
+            }
+            break;
+        }
+        if (len - pos < 4) return false;
+        uint32_t n = get_u32(p + pos);
+        pos += 4;
+        if (len - pos < n) return false;
+        record.values[i].assign(p + pos, n);
+        pos += n;
+    }
+    return pos == len;
+}
+
+// Decode as many whole records as buf holds; returns the bytes consumed
+size_t decode_all(const char* buf, size_t len, const std::function<void(const StorageRecord&)>& fn, bool& corrupt) {
+    size_t pos = 0;
+    StorageRecord record{};
+    corrupt = false;
+    while (len - pos >= 4) {
+        uint32_t body = get_u32(buf + pos);
+        if (body > MAX_RECORD) { corrupt = true; break; }
+        if (len - pos - 4 < body) break;
+        if (!decode(buf + pos + 4, body, record)) { corrupt = true; break; }
+        fn(record);
+        pos += 4 + body;
+    }
+    return pos;
+}
+
+int sync_file(std::FILE* f) {
+#ifdef _WIN32
+    return _commit(_fileno(f));
+#else
+    return fdatasync(fileno(f));
+#endif
+}
+
+// Cut the file back to size and carry on appending from there
+int truncate_file(std::FILE* f, uint64_t size) {
+    std::fflush(f);
+    std::clearerr(f);
+#ifdef _WIN32
+    int rc = _chsize_s(_fileno(f), static_cast<__int64>(size)) == 0 ? 0 : -1;
+#else
+    int rc = ftruncate(fileno(f), static_cast<off_t>(size));
+#endif
+    std::fseek(f, 0, SEEK_END);
+    return rc;
+}
+
+} // namespace
+
+// ---- StorageRecord ----
+
+int StorageRecord::field_count(RecordType type) {
+    switch (type) {
+        case RecordType::UpsertOrder: return 14;
+        case RecordType::UpdateOrderStatus: return 5;
+        case RecordType::InsertAction: return 6;
+        case RecordType::InsertTrade: return 9;
+    }
+    return 0;
+}
+
+StorageRecord StorageRecord::order(const Order& order) {
+    // Everything restore needs to put the order back as it was, including when it arrived
+    auto ts_us = std::chrono::duration_cast<std::chrono::microseconds>(order.timestamp.time_since_epoch()).count();
+    return {RecordType::UpsertOrder, {order.id, order.symbol, side_str(order.side), type_str(order.type),
+            std::to_string(order.price), std::to_string(order.quantity), order.user_id, status_str(order.status),
+            std::to_string(order.filled_quantity), std::to_string(order.stop_price), order.tif,
+            std::to_string(order.expiry), order.is_quote ? "1" : "0", std::to_string(ts_us)}};
+}
+
+std::shared_ptr<Order> StorageRecord::to_order() const {
+    const auto& v = values;
+    auto has = [this](int i) { return !(null_mask & (1u << i)); };
+    auto order = std::make_shared<Order>(v[0], v[1], parse_side(v[2]), parse_type(v[3]),
+                                         static_cast<Price>(std::stoull(v[4])), static_cast<Quantity>(std::stoull(v[5])), v[6]);
+    order->filled_quantity = static_cast<Quantity>(std::stoull(v[8]));
+    if (order->filled_quantity > 0) order->status = OrderStatus::PARTIAL;
+    if (has(9)) order->stop_price = static_cast<Price>(std::stoull(v[9]));
+    if (has(10)) order->tif = v[10];
+    if (has(11)) order->expiry = std::stoll(v[11]);
+    if (has(12)) order->is_quote = v[12] == "1";
+    if (has(13)) order->timestamp = from_us(std::stoll(v[13]));
+    return order;
+}
+
+StorageRecord StorageRecord::order_status(const Order& order) {
+    return {RecordType::UpdateOrderStatus, {order.id, status_str(order.status), std::to_string(order.filled_quantity),
+            std::to_string(order.quantity), std::to_string(order.price)}};
+}
+
+std::string StorageRecord::next_write_id() {
+    // Random per-process prefix plus a counter - cheap, and no two processes share a prefix in practice
+    static const std::string prefix = [] {
+        std::random_device rd;
+        uint64_t r = (uint64_t(rd()) << 32) | rd();
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(r));
+        return std::string(buf) + "-";
+    }();
+    static std::atomic<uint64_t> counter{0};
+    return prefix + std::to_string(++counter);
+}
+
+StorageRecord StorageRecord::action(const std::string& action, const OrderId& order_id) {
+    // No price/quantity for this action - values 2 and 3 are NULL
+    return {RecordType::InsertAction, {action, order_id, "", "", next_write_id(), std::to_string(now_us())}, 0b1100};
+}
+
+StorageRecord StorageRecord::action(const std::string& action, const OrderId& order_id, Price price, Quantity quantity) {
+    return {RecordType::InsertAction, {action, order_id, std::to_string(price), std::to_string(quantity),
+            next_write_id(), std::to_string(now_us())}};
+}
+
+StorageRecord StorageRecord::trade(const Trade& trade) {
+    auto ts_us = std::chrono::duration_cast<std::chrono::microseconds>(trade.timestamp.time_since_epoch()).count();
+    if (ts_us == 0) ts_us = now_us();   // Trades built by hand (tests, tools) have no timestamp
+    return {RecordType::InsertTrade, {trade.symbol, trade.buy_order_id, trade.sell_order_id, trade.buy_user_id,
+            trade.sell_user_id, std::to_string(trade.price), std::to_string(trade.quantity),
+            next_write_id(), std::to_string(ts_us)}};
+}
+
+// ---- FileStorage ----
+
+FileStorage::FileStorage(Options options) : options_(std::move(options)) {}
+
+FileStorage::~FileStorage() {
+    stop();
+}
+
+uint64_t FileStorage::replay(const std::string& path, const std::function<void(const StorageRecord&)>& fn) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return 0;
+    std::vector<char> buf(4 << 20);
+    size_t have = 0;
+    uint64_t offset = 0;
+    bool corrupt = false;
+    while (!corrupt) {
+        size_t n = std::fread(buf.data() + have, 1, buf.size() - have, f);
+        if (n == 0) break;
+        have += n;
+        size_t used = decode_all(buf.data(), have, fn, corrupt);
+        offset += used;
+        std::copy(buf.begin() + used, buf.begin() + have, buf.begin());
+        have -= used;
+    }
+    std::fclose(f);
+    return offset;
+}
+
+size_t FileStorage::restore(const std::string& path, const std::function<void(std::shared_ptr<Order>)>& on_order,
+                            const std::function<void(const Trade&)>& on_trade) {
+    // Later status records overwrite earlier ones, so only the last known state of each order is kept
+    std::unordered_map<std::string, StorageRecord> orders;
+    std::vector<std::string> arrival;      // Keep time priority: first-seen order
+    replay(path, [&](const StorageRecord& record) {
+        if (record.type == RecordType::UpsertOrder) {
+            auto [it, inserted] = orders.try_emplace(record.values[0]);
+            if (inserted) arrival.push_back(record.values[0]);
+            it->second = record;
+        } else if (record.type == RecordType::UpdateOrderStatus) {
+            auto it = orders.find(record.values[0]);
+            if (it == orders.end()) return;
+            auto& v = it->second.values;
+            v[7] = record.values[1];
+            v[8] = record.values[2];
+            v[5] = record.values[3];     // Amends change quantity and price
+            v[4] = record.values[4];
+        } else if (record.type == RecordType::InsertTrade) {
+            Trade trade;
+            trade.symbol = record.values[0];
+            trade.buy_order_id = record.values[1];
+            trade.sell_order_id = record.values[2];
+            trade.buy_user_id = record.values[3];
+            trade.sell_user_id = record.values[4];
+            trade.price = std::stoull(record.values[5]);
+            trade.quantity = std::stoull(record.values[6]);
+            if (!(record.null_mask & (1u << 8))) trade.timestamp = from_us(std::stoll(record.values[8]));
+            on_trade(trade);
+        }
+    });
+    size_t restored = 0;
+    for (const auto& id : arrival) {
+        const auto& record = orders[id];
+        if (record.values[7] != "open" && record.values[7] != "partial") continue;
+        on_order(record.to_order());
+        restored++;
+    }
+    return restored;
+}
+
+bool FileStorage::start() {
+    // Cut off anything after the last complete record (a crash mid-append)
+    uint64_t valid = replay(options_.path, [](const StorageRecord&) {});
+    std::error_code ec;
+    if (std::filesystem::exists(options_.path, ec) && std::filesystem::file_size(options_.path, ec) > valid) {
+        std::cerr << "[STORAGE] Truncating torn tail of " << options_.path << " at " << valid << " bytes" << std::endl;
+        std::filesystem::resize_file(options_.path, valid, ec);
+    }
+    file_ = std::fopen(options_.path.c_str(), "ab");
+    if (!file_) {
+        std::cerr << "[STORAGE] Can't open " << options_.path << std::endl;
+        return false;
+    }
+    file_size_ = valid;
+    writer_ = std::thread(&FileStorage::writer_loop, this);
+    if (options_.replicate_to) replicator_ = std::thread(&FileStorage::replicator_loop, this);
+    return true;
+}
+
+void FileStorage::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || !file_) return;
+        stopping_ = true;
+    }
+    work_cv_.notify_all();
+    if (writer_.joinable()) writer_.join();
+    if (replicator_.joinable()) replicator_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+void FileStorage::write(StorageRecord&& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    encode(pending_, record);
+    pending_records_++;
+    appended_seq_++;
+    if (batch_full()) work_cv_.notify_one();
+}
+
+void FileStorage::when_durable(std::function<void(bool)> fn) {
+    bool open;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open = file_ != nullptr;
+        if (open && durable_seq_ < appended_seq_) {
+            waiters_.emplace_back(appended_seq_, std::move(fn));
+            if (batch_full()) work_cv_.notify_one();
+            return;
+        }
+        // Everything is through the writer, but the last of it may not have made it to disk
+        // (nothing has failed yet on a fresh store, where both are still 0)
+        open = open && (failed_seq_ == 0 || appended_seq_ > failed_seq_);
+    }
+    fn(open);
+}
+
+bool FileStorage::batch_full() const {
+    return pending_.size() >= (1 << 20) || (options_.max_batch > 0 && pending_records_ >= options_.max_batch);
+}
+
+void FileStorage::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = appended_seq_;
+    flush_requested_ = true;
+    work_cv_.notify_one();
+    done_cv_.wait(lock, [&] { return durable_seq_ >= target || !file_; });
+}
+
+StorageStats FileStorage::stats() const {
+    StorageStats s;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        s.queued = appended_seq_ - durable_seq_;
+    }
+    s.written = written_.load();
+    s.failed = failed_.load();
+    s.batches = batches_.load();
+    return s;
+}
+
+void FileStorage::writer_loop() {
+    std::string batch;
+    while (true) {
+        uint64_t records;
+        uint64_t seq;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // Wake up early only for a flush request, a full batch or shutdown
+            work_cv_.wait_for(lock, options_.flush_interval, [&] {
+                return stopping_ || flush_requested_ || batch_full();
+            });
+            flush_requested_ = false;
+            stopping = stopping_;
+            batch.swap(pending_);
+            records = pending_records_;
+            pending_records_ = 0;
+            seq = appended_seq_;
+        }
+        bool ok = true;
+        if (!batch.empty()) {
+            ok = std::fwrite(batch.data(), 1, batch.size(), file_) == batch.size() && std::fflush(file_) == 0;
+            if (ok && options_.sync) ok = sync_file(file_) == 0;
+            if (ok) {
+                written_ += records;
+                file_size_ += batch.size();
+            } else {
+                failed_ += records;
+                std::cerr << "[STORAGE] Append to " << options_.path << " failed" << std::endl;
+                // Part of the batch may have made it out - cut it off so the log still ends on
+                // a whole record and nothing we reported as failed gets replayed or replicated
+                if (truncate_file(file_, file_size_) != 0) {
+                    std::cerr << "[STORAGE] Can't truncate " << options_.path << " back to " << file_size_ << " bytes" << std::endl;
+                }
+            }
+            batches_++;
+            batch.clear();
+        }
+        // Release everyone waiting on this batch - outside the lock, callbacks may write again
+        // A waiter at or below failed_seq_ had records in a failed batch
+        std::vector<std::pair<std::function<void(bool)>, bool>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            durable_seq_ = seq;
+            if (!ok) failed_seq_ = seq;
+            while (!waiters_.empty() && waiters_.front().first <= seq) {
+                ready.emplace_back(std::move(waiters_.front().second), waiters_.front().first > failed_seq_);
+                waiters_.pop_front();
+            }
+        }
+        for (auto& [fn, durable] : ready) fn(durable);
+        // After the callbacks, so a flush() returning means they've run
+        done_cv_.notify_all();
+        if (stopping) break;
+    }
+}
+
+uint64_t FileStorage::load_replicated_offset() const {
+    std::FILE* f = std::fopen((options_.path + ".offset").c_str(), "rb");
+    if (!f) return 0;
+    unsigned long long offset = 0;
+    if (std::fscanf(f, "%llu", &offset) != 1) offset = 0;
+    std::fclose(f);
+    return offset;
+}
+
+void FileStorage::save_replicated_offset(uint64_t offset) const {
+    // Write-then-rename so a crash never leaves a half-written offset
+    std::string tmp = options_.path + ".offset.tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    std::fprintf(f, "%llu\n", static_cast<unsigned long long>(offset));
+    std::fclose(f);
+    std::error_code ec;
+    std::filesystem::rename(tmp, options_.path + ".offset", ec);
+}
+
+void FileStorage::replicator_loop() {
+    uint64_t offset = load_replicated_offset();
+    std::FILE* f = std::fopen(options_.path.c_str(), "rb");
+    if (!f) return;
+    std::vector<char> buf(1 << 20);
+    size_t have = 0;
+    uint64_t read_pos = offset;
+    std::fseek(f, static_cast<long>(offset), SEEK_SET);
+    while (true) {
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping = stopping_;
+        }
+        // Only read what the writer has fully appended
+        uint64_t available = file_size_.load();
+        if (read_pos < available && have < buf.size()) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(buf.size() - have, available - read_pos));
+            std::clearerr(f);
+            size_t n = std::fread(buf.data() + have, 1, want, f);
+            have += n;
+            read_pos += n;
+        }
+        bool corrupt = false;
+        auto before = options_.replicate_to->stats();
+        size_t used = decode_all(buf.data(), have, [this](const StorageRecord& r) {
+            options_.replicate_to->write(StorageRecord(r));
+            replicated_++;
+        }, corrupt);
+        if (corrupt) {
+            std::cerr << "[STORAGE] Replication stopped: corrupt record at offset " << offset << std::endl;
+            break;
+        }
+        if (used > 0) {
+            // Only advance the saved offset once the downstream has applied the records
+            options_.replicate_to->flush();
+            auto after = options_.replicate_to->stats();
+            if (after.failed != before.failed) {
+                // Resending is safe - orders are upserts and actions/trades are skipped by write_id
+                std::cerr << "[STORAGE] Replication of " << used << " bytes at offset " << offset
+                          << " had failed writes, sending them again" << std::endl;
+                if (stopping) break;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            if (after.rejected != before.rejected) {
+                // Sending them again would get the same answer and stall everything behind them
+                std::cerr << "[STORAGE] " << options_.replicate_to->name() << " rejected " << after.rejected - before.rejected
+                          << " records between offsets " << offset << " and " << offset + used << ", skipping them" << std::endl;
+            }
+            offset += used;
+            save_replicated_offset(offset);
+            std::copy(buf.begin() + used, buf.begin() + have, buf.begin());
+            have -= used;
+            continue;
+        }
+        if (stopping && read_pos >= file_size_.load()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    std::fclose(f);
+}
+
+} // namespace orderbook
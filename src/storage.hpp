@@ -0,0 +1,168 @@
+#ifndef ORDERBOOK_STORAGE_HPP
+#define ORDERBOOK_STORAGE_HPP
+
+#include "order.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace orderbook {
+
+// Everything the engine persists, as flat records every backend understands
+enum class RecordType : uint8_t {
+    UpsertOrder,        // id, symbol, side, type, price, quantity, user_id, status, filled,
+                        // stop_price, tif, expiry, is_quote, ts_us
+    UpdateOrderStatus,  // id, status, filled, quantity, price
+    InsertAction,       // action, order_id, price, quantity, write_id, ts_us
+    InsertTrade,        // symbol, buy_order_id, sell_order_id, buy_user_id, sell_user_id, price, quantity, write_id, ts_us
+};
+
+// One write - values are text (what Postgres takes as parameters anyway)
+// Actions and trades carry a write_id unique to the record, so a backend that retries
+// (or a journal replicated twice) can skip rows that already made it.
+struct StorageRecord {
+    RecordType type;
+    std::array<std::string, 14> values;
+    uint16_t null_mask = 0;     // Bit i set means value i is NULL
+
+    static StorageRecord order(const Order& order);
+    static StorageRecord order_status(const Order& order);
+    static StorageRecord action(const std::string& action, const OrderId& order_id);
+    static StorageRecord action(const std::string& action, const OrderId& order_id, Price price, Quantity quantity);
+    static StorageRecord trade(const Trade& trade);
+    // The order an UpsertOrder record describes, ready to go back into the engine.
+    // Fields an older record doesn't have (NULL) keep the Order defaults.
+    std::shared_ptr<Order> to_order() const;
+
+    static int field_count(RecordType type);
+    // Fresh write_id - unique across processes and restarts
+    static std::string next_write_id();
+};
+
+struct StorageStats {
+    uint64_t queued = 0;        // Accepted but not yet written
+    uint64_t written = 0;
+    uint64_t failed = 0;        // Didn't get through (I/O, lost connection) - sending again may work
+    uint64_t rejected = 0;      // Refused by the backend for good (bad data) - sending again won't
+    uint64_t batches = 0;       // Round trips / file writes
+};
+
+// Where order, action and trade records go
+// write() never blocks on I/O - backends queue and write in the background.
+class Storage {
+public:
+    virtual ~Storage() = default;
+    virtual void write(StorageRecord&& record) = 0;
+    // Block until everything written so far has reached the backend
+    virtual void flush() {}
+    // Call fn once everything written so far is durable (false if it couldn't be made so)
+    // Backends that don't track durability call it straight away.
+    virtual void when_durable(std::function<void(bool)> fn) { fn(true); }
+    virtual StorageStats stats() const = 0;
+    virtual const char* name() const = 0;
+};
+
+// Drops everything - for tests and for running the engine without persistence
+class NullStorage : public Storage {
+public:
+    void write(StorageRecord&&) override { written_++; }
+    StorageStats stats() const override { StorageStats s; s.written = written_.load(); return s; }
+    const char* name() const override { return "null"; }
+private:
+    std::atomic<uint64_t> written_{0};
+};
+
+/**
+ * Embedded append-only file store
+ *
+ * Records are encoded into a memory buffer and a background thread appends
+ * the buffer to the log file every flush interval (optionally fdatasync'ing),
+ * so write() costs a memcpy. A torn record left by a crash is cut off when the
+ * log is reopened.
+ *
+ * With sync on this is a group commit: everything that arrived during the
+ * interval (or until max_batch records are waiting) goes out in one append and
+ * one fdatasync, and when_durable callbacks fire once their batch is on disk.
+ *
+ * Given a downstream backend (normally Postgres) a second thread tails the log
+ * and forwards records to it, remembering how far it got in "<path>.offset" -
+ * the node writes at disk speed and the database catches up asynchronously.
+ * If the downstream reports failed writes the offset stays put and the same
+ * stretch of log is sent again. Records it rejects outright are logged and
+ * skipped - resending them would only hold up everything behind them.
+ */
+class FileStorage : public Storage {
+public:
+    struct Options {
+        std::string path = "orderbook.journal";
+        std::chrono::microseconds flush_interval{5000};   // Longest a record waits for its batch
+        size_t max_batch = 0;           // Append early once this many records wait (0 = no limit)
+        bool sync = false;              // fdatasync after every append
+        Storage* replicate_to = nullptr;
+    };
+
+    explicit FileStorage(Options options);
+    ~FileStorage() override;
+
+    // Open (creating if needed) the log and start the background threads
+    bool start();
+    void stop();
+
+    void write(StorageRecord&& record) override;
+    void flush() override;
+    void when_durable(std::function<void(bool)> fn) override;
+    StorageStats stats() const override;
+    const char* name() const override { return "file"; }
+    // Records forwarded to the downstream backend since start
+    uint64_t replicated() const { return replicated_.load(); }
+
+    // Read every complete record in a log; returns the byte length of the valid prefix
+    static uint64_t replay(const std::string& path, const std::function<void(const StorageRecord&)>& fn);
+    // Rebuild engine state from a log: every trade in log order, then the orders that
+    // are still open as they were last written, oldest first. Returns the open order count.
+    static size_t restore(const std::string& path, const std::function<void(std::shared_ptr<Order>)>& on_order,
+                          const std::function<void(const Trade&)>& on_trade);
+
+private:
+    void writer_loop();
+    void replicator_loop();
+    bool batch_full() const;       // Call with mutex_ held
+    uint64_t load_replicated_offset() const;
+    void save_replicated_offset(uint64_t offset) const;
+
+    Options options_;
+    std::FILE* file_ = nullptr;
+    std::thread writer_;
+    std::thread replicator_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::string pending_;           // Encoded records not yet handed to the file
+    uint64_t pending_records_ = 0;
+    uint64_t appended_seq_ = 0;     // Records encoded so far
+    uint64_t durable_seq_ = 0;      // Records the writer is done with so far (on disk or failed)
+    uint64_t failed_seq_ = 0;       // Last record of the newest batch that failed to reach the disk
+    std::deque<std::pair<uint64_t, std::function<void(bool)>>> waiters_;   // By sequence, oldest first
+    bool flush_requested_ = false;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> file_size_{0};
+    std::atomic<uint64_t> replicated_{0};
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_STORAGE_HPP
@@ -0,0 +1,47 @@
+#include "tls.hpp"
+#include <fstream>
+#include <sstream>
+#include <openssl/opensslv.h>
+#include <openssl/ssl.h>
+
+namespace orderbook {
+
+KtlsSupport probe_ktls() {
+    KtlsSupport support;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS)
+    support.openssl = true;
+#endif
+#ifdef __linux__
+    // The kernel lists upper layer protocols it can attach to a TCP socket here
+    std::ifstream ulps("/proc/sys/net/ipv4/tcp_available_ulp");
+    std::string ulp;
+    while (ulps >> ulp) {
+        if (ulp == "tls") support.kernel = true;
+    }
+#endif
+
+    std::ostringstream detail;
+    if (support.available()) {
+        detail << "kTLS available (" << OpenSSL_version(OPENSSL_VERSION) << ", kernel tls module loaded)";
+    } else if (!support.openssl) {
+        detail << OpenSSL_version(OPENSSL_VERSION) << " was built without kTLS; records are encrypted in user space";
+    } else {
+        detail << "kernel tls module not loaded (modprobe tls); records are encrypted in user space";
+    }
+    support.detail = detail.str();
+    return support;
+}
+
+bool tls_files_present(const TlsOptions& options) {
+    return std::ifstream(options.cert_file).good() && std::ifstream(options.key_file).good();
+}
+
+std::vector<std::pair<std::string, std::string>> tls_conf_commands(const TlsOptions& options) {
+    std::vector<std::pair<std::string, std::string>> commands;
+    // Same as SSL_OP_ENABLE_KTLS. Takes effect per connection after the
+    // handshake, and only for the ciphers the kernel does (AES-GCM, ChaCha20-Poly1305).
+    if (options.ktls) commands.emplace_back("Options", "KTLS");
+    return commands;
+}
+
+} // namespace orderbook
@@ -0,0 +1,48 @@
+#ifndef ORDERBOOK_TLS_HPP
+#define ORDERBOOK_TLS_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace orderbook {
+
+/**
+ * HTTPS/WSS listener settings
+ *
+ * The TLS listener serves the same routes and WebSocket endpoint as the
+ * plaintext one, on its own port. With ktls set, OpenSSL is asked to hand the
+ * record layer to the kernel (Linux TLS_TX/TLS_RX) once the handshake is
+ * done, so bulk encryption leaves the IO threads and sendfile/splice can go
+ * straight to an encrypted socket. OpenSSL quietly stays in user space when
+ * it can't offload - see probe_ktls() for why it might not.
+ */
+struct TlsOptions {
+    bool enabled = true;                // Only takes effect when the cert and key are there
+    uint16_t port = 18443;
+    std::string cert_file = "../../certs/cert.pem";
+    std::string key_file = "../../certs/key.pem";
+    bool ktls = false;
+};
+
+// What kTLS needs, checked up front so the startup log can say why it won't happen
+struct KtlsSupport {
+    bool openssl = false;       // OpenSSL 3 built with kTLS
+    bool kernel = false;        // The kernel's "tls" ULP is loaded (modprobe tls)
+    std::string detail;         // One line for the log
+
+    bool available() const { return openssl && kernel; }
+};
+
+KtlsSupport probe_ktls();
+
+// Cert and key both readable
+bool tls_files_present(const TlsOptions& options);
+
+// SSL_CONF commands for the listener ("Options KTLS" when asked for)
+std::vector<std::pair<std::string, std::string>> tls_conf_commands(const TlsOptions& options);
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_TLS_HPP
@@ -0,0 +1,406 @@
+#include "trade_archive.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace orderbook {
+
+namespace {
+
+constexpr char MAGIC[8] = {'O', 'B', 'T', 'S', 'E', 'G', '0', '1'};
+constexpr int64_t MICROS_PER_DAY = 86400LL * 1000000;
+constexpr int64_t MICROS_PER_MINUTE = 60LL * 1000000;
+
+// Segments are written in host byte order - every box we run on is little endian
+struct SegmentHeader {
+    char magic[8];
+    uint32_t block_count;
+    uint32_t reserved;
+    uint64_t trade_count;
+};
+
+struct BlockIndex {
+    int64_t first_ts;
+    int64_t last_ts;
+    uint64_t first_price;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t ts_offset;         // Column offsets from the start of the file
+    uint64_t price_offset;
+    uint64_t quantity_offset;
+    uint64_t end_offset;
+};
+
+static_assert(std::is_trivially_copyable<SegmentHeader>::value && std::is_trivially_copyable<BlockIndex>::value,
+              "segment structs are memcpy'd straight to disk");
+
+void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// Bounds-checked; returns false on a truncated or overlong varint
+bool get_varint(const unsigned char*& p, const unsigned char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char b = *p++;
+        v |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// Decoded columns of one block - reused across blocks to avoid reallocating
+struct BlockBuffer {
+    std::vector<int64_t> ts;
+    std::vector<uint64_t> price;
+    std::vector<uint64_t> quantity;
+};
+
+bool decode_block(const char* base, const BlockIndex& block, BlockBuffer& out) {
+    auto p = reinterpret_cast<const unsigned char*>(base);
+    out.ts.resize(block.count);
+    out.price.resize(block.count);
+    out.quantity.resize(block.count);
+    // Each column is decoded in its own tight loop
+    const unsigned char* c = p + block.ts_offset;
+    const unsigned char* end = p + block.price_offset;
+    int64_t ts = block.first_ts;
+    uint64_t v;
+    for (uint32_t i = 0; i < block.count; ++i) {
+        if (i > 0) {
+            if (!get_varint(c, end, v)) return false;
+            ts += static_cast<int64_t>(v);
+        }
+        out.ts[i] = ts;
+    }
+    c = p + block.price_offset;
+    end = p + block.quantity_offset;
+    int64_t price = static_cast<int64_t>(block.first_price);
+    for (uint32_t i = 0; i < block.count; ++i) {
+        if (i > 0) {
+            if (!get_varint(c, end, v)) return false;
+            price += unzigzag(v);
+        }
+        out.price[i] = static_cast<uint64_t>(price);
+    }
+    c = p + block.quantity_offset;
+    end = p + block.end_offset;
+    for (uint32_t i = 0; i < block.count; ++i) {
+        if (!get_varint(c, end, v)) return false;
+        out.quantity[i] = v;
+    }
+    return true;
+}
+
+// Civil date from days since 1970-01-01 (Howard Hinnant's algorithm)
+std::string format_day(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int64_t d = doy - (153 * mp + 2) / 5 + 1;
+    int64_t m = mp < 10 ? mp + 3 : mp - 9;
+    int64_t y = yoe + era * 400 + (m <= 2);
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d", static_cast<int>(y), static_cast<int>(m), static_cast<int>(d));
+    return buf;
+}
+
+// Days since 1970-01-01 from "YYYY-MM-DD" (the inverse of format_day); false if it isn't one
+bool parse_day(const std::string& text, int64_t& days) {
+    int y = 0, m = 0, d = 0;
+    char tail = 0;
+    if (text.size() != 10 || std::sscanf(text.c_str(), "%4d-%2d-%2d%c", &y, &m, &d, &tail) != 3 ||
+        m < 1 || m > 12 || d < 1 || d > 31) {
+        return false;
+    }
+    int64_t yy = y - (m <= 2);
+    int64_t era = (yy >= 0 ? yy : yy - 399) / 400;
+    int64_t yoe = yy - era * 400;
+    int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    days = era * 146097 + doe - 719468;
+    return true;
+}
+
+} // namespace
+
+// ---- TradeSegment ----
+
+TradeSegment::~TradeSegment() {
+    close();
+}
+
+TradeSegment::TradeSegment(TradeSegment&& other) noexcept {
+    *this = std::move(other);
+}
+
+TradeSegment& TradeSegment::operator=(TradeSegment&& other) noexcept {
+    if (this != &other) {
+        close();
+        owned_ = std::move(other.owned_);
+        data_ = other.mapped_ ? other.data_ : owned_.data();
+        size_ = other.size_;
+        mapped_ = other.mapped_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.mapped_ = false;
+    }
+    return *this;
+}
+
+void TradeSegment::close() {
+#ifndef _WIN32
+    if (mapped_ && data_) munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    owned_.clear();
+}
+
+bool TradeSegment::open(const std::string& path) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data_ = static_cast<const char*>(p);
+            size_ = static_cast<size_t>(st.st_size);
+            mapped_ = true;
+            // Scans read front to back
+            madvise(p, size_, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    owned_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    data_ = owned_.data();
+    size_ = owned_.size();
+#endif
+    if (!data_ || size_ < sizeof(SegmentHeader)) {
+        close();
+        return false;
+    }
+    SegmentHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        sizeof(SegmentHeader) + uint64_t(header.block_count) * sizeof(BlockIndex) > size_) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+uint64_t TradeSegment::trade_count() const {
+    if (!data_) return 0;
+    SegmentHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    return header.trade_count;
+}
+
+bool TradeSegment::scan(int64_t t0_us, int64_t t1_us, const std::function<bool(const TradeColumns&)>& fn) const {
+    if (!data_) return true;
+    SegmentHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    const char* index = data_ + sizeof(SegmentHeader);
+    auto block_at = [&](uint32_t i) {
+        BlockIndex b;
+        std::memcpy(&b, index + size_t(i) * sizeof(BlockIndex), sizeof(b));
+        return b;
+    };
+    // Binary search for the first block that could hold t0
+    uint32_t lo = 0, hi = header.block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (block_at(mid).last_ts < t0_us) lo = mid + 1; else hi = mid;
+    }
+    BlockBuffer buf;
+    for (uint32_t i = lo; i < header.block_count; ++i) {
+        BlockIndex block = block_at(i);
+        if (block.first_ts >= t1_us) break;
+        if (block.end_offset > size_ || block.ts_offset > block.price_offset ||
+            block.price_offset > block.quantity_offset || block.quantity_offset > block.end_offset ||
+            !decode_block(data_, block, buf)) {
+            std::cerr << "[ARCHIVE] Corrupt block " << i << " in segment, skipping the rest" << std::endl;
+            return true;
+        }
+        // Trim to [t0, t1) - only the first and last blocks of a range are partial
+        size_t from = std::lower_bound(buf.ts.begin(), buf.ts.end(), t0_us) - buf.ts.begin();
+        size_t to = std::lower_bound(buf.ts.begin() + from, buf.ts.end(), t1_us) - buf.ts.begin();
+        if (from < to && !fn(TradeColumns{buf.ts.data() + from, buf.price.data() + from, buf.quantity.data() + from, to - from})) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---- TradeArchive ----
+
+TradeArchive::TradeArchive(std::string root) : root_(std::move(root)) {}
+
+int64_t TradeArchive::day_of(int64_t ts_us) {
+    return ts_us >= 0 ? ts_us / MICROS_PER_DAY : (ts_us - MICROS_PER_DAY + 1) / MICROS_PER_DAY;
+}
+
+std::string TradeArchive::segment_path(const std::string& symbol, int64_t day) const {
+    return (std::filesystem::path(root_) / symbol / (format_day(day) + ".seg")).string();
+}
+
+bool TradeArchive::write_segment(const std::string& symbol, std::vector<ArchivedTrade> trades) {
+    if (trades.empty()) return true;
+    std::stable_sort(trades.begin(), trades.end(), [](const ArchivedTrade& a, const ArchivedTrade& b) { return a.ts_us < b.ts_us; });
+    int64_t day = day_of(trades.front().ts_us);
+    if (day_of(trades.back().ts_us) != day) {
+        std::cerr << "[ARCHIVE] Segment for " << symbol << " spans more than one day" << std::endl;
+        return false;
+    }
+
+    uint32_t block_count = static_cast<uint32_t>((trades.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    std::vector<BlockIndex> index(block_count);
+    std::string body;
+    uint64_t base = sizeof(SegmentHeader) + uint64_t(block_count) * sizeof(BlockIndex);
+    for (uint32_t b = 0; b < block_count; ++b) {
+        size_t first = size_t(b) * BLOCK_SIZE;
+        size_t last = std::min(trades.size(), first + BLOCK_SIZE);
+        auto& block = index[b];
+        block = BlockIndex{};
+        block.first_ts = trades[first].ts_us;
+        block.last_ts = trades[last - 1].ts_us;
+        block.first_price = trades[first].price;
+        block.count = static_cast<uint32_t>(last - first);
+        block.ts_offset = base + body.size();
+        for (size_t i = first + 1; i < last; ++i) put_varint(body, static_cast<uint64_t>(trades[i].ts_us - trades[i - 1].ts_us));
+        block.price_offset = base + body.size();
+        for (size_t i = first + 1; i < last; ++i) {
+            put_varint(body, zigzag(static_cast<int64_t>(trades[i].price) - static_cast<int64_t>(trades[i - 1].price)));
+        }
+        block.quantity_offset = base + body.size();
+        for (size_t i = first; i < last; ++i) put_varint(body, trades[i].quantity);
+        block.end_offset = base + body.size();
+    }
+
+    SegmentHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.block_count = block_count;
+    header.trade_count = trades.size();
+
+    // Write to a temp file and rename, so readers never map a half-written segment
+    std::string path = segment_path(symbol, day);
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(BlockIndex));
+        out.write(body.data(), body.size());
+        if (!out) {
+            std::cerr << "[ARCHIVE] Can't write " << tmp << std::endl;
+            return false;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "[ARCHIVE] Can't rename " << tmp << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<int64_t> TradeArchive::segment_days(const std::string& symbol) const {
+    std::vector<int64_t> days;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(std::filesystem::path(root_) / symbol, ec), end; !ec && it != end; it.increment(ec)) {
+        const auto& path = it->path();
+        int64_t day;
+        if (path.extension() == ".seg" && parse_day(path.stem().string(), day)) days.push_back(day);
+    }
+    std::sort(days.begin(), days.end());
+    return days;
+}
+
+void TradeArchive::scan(const std::string& symbol, int64_t t0_us, int64_t t1_us,
+                        const std::function<bool(const TradeColumns&)>& fn) const {
+    if (t1_us <= t0_us) return;
+    // Walk the segments on disk rather than every calendar day in the range - a wide
+    // range over a sparse archive would otherwise try to open thousands of missing files
+    int64_t first = day_of(t0_us), last = day_of(t1_us - 1);
+    for (int64_t day : segment_days(symbol)) {
+        if (day < first) continue;
+        if (day > last) break;
+        TradeSegment segment;
+        if (segment.open(segment_path(symbol, day)) && !segment.scan(t0_us, t1_us, fn)) return;
+    }
+}
+
+std::vector<ArchivedTrade> TradeArchive::trades(const std::string& symbol, int64_t t0_us, int64_t t1_us, size_t limit) const {
+    std::vector<ArchivedTrade> out;
+    if (limit == 0) return out;
+    scan(symbol, t0_us, t1_us, [&](const TradeColumns& cols) {
+        size_t n = std::min(cols.size, limit - out.size());
+        for (size_t i = 0; i < n; ++i) out.push_back(ArchivedTrade{cols.ts_us[i], cols.price[i], cols.quantity[i]});
+        return out.size() < limit;
+    });
+    return out;
+}
+
+std::vector<VwapBar> TradeArchive::vwap_per_minute(const std::string& symbol, int64_t t0_us, int64_t t1_us) const {
+    std::vector<VwapBar> bars;
+    std::vector<double> notional;   // Parallel to bars
+    scan(symbol, t0_us, t1_us, [&](const TradeColumns& cols) {
+        size_t i = 0;
+        while (i < cols.size) {
+            int64_t minute = cols.ts_us[i] - (cols.ts_us[i] % MICROS_PER_MINUTE + MICROS_PER_MINUTE) % MICROS_PER_MINUTE;
+            // Timestamps are sorted, so each minute is one contiguous run
+            size_t j = i;
+            while (j < cols.size && cols.ts_us[j] < minute + MICROS_PER_MINUTE) ++j;
+            double value = 0.0;
+            uint64_t volume = 0;
+            for (size_t k = i; k < j; ++k) {
+                value += static_cast<double>(cols.price[k]) * static_cast<double>(cols.quantity[k]);
+                volume += cols.quantity[k];
+            }
+            // A minute can straddle two blocks
+            if (bars.empty() || bars.back().minute_us != minute) {
+                bars.push_back(VwapBar{minute, 0.0, 0, 0});
+                notional.push_back(0.0);
+            }
+            bars.back().volume += volume;
+            bars.back().trades += j - i;
+            notional.back() += value;
+            i = j;
+        }
+        return true;
+    });
+    for (size_t b = 0; b < bars.size(); ++b) {
+        if (bars[b].volume > 0) bars[b].vwap = notional[b] / static_cast<double>(bars[b].volume);
+    }
+    return bars;
+}
+
+} // namespace orderbook
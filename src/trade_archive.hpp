@@ -0,0 +1,103 @@
+#ifndef ORDERBOOK_TRADE_ARCHIVE_HPP
+#define ORDERBOOK_TRADE_ARCHIVE_HPP
+
+#include "types.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace orderbook {
+
+// What the archive keeps per trade - the columns analysts aggregate over
+struct ArchivedTrade {
+    int64_t ts_us = 0;          // Microseconds since the epoch
+    Price price = 0;
+    Quantity quantity = 0;
+};
+
+// A run of decoded trades, column by column
+// Pointers are only valid inside the scan callback.
+struct TradeColumns {
+    const int64_t* ts_us = nullptr;
+    const uint64_t* price = nullptr;
+    const uint64_t* quantity = nullptr;
+    size_t size = 0;
+};
+
+struct VwapBar {
+    int64_t minute_us = 0;      // Start of the minute
+    double vwap = 0.0;
+    uint64_t volume = 0;
+    uint64_t trades = 0;
+};
+
+/**
+ * Read-only view of one segment file (one symbol, one UTC day)
+ *
+ * The file is memory-mapped; the header and block index are read in place
+ * and blocks are only decoded when a scan touches them.
+ */
+class TradeSegment {
+public:
+    TradeSegment() = default;
+    ~TradeSegment();
+    TradeSegment(const TradeSegment&) = delete;
+    TradeSegment& operator=(const TradeSegment&) = delete;
+    TradeSegment(TradeSegment&& other) noexcept;
+    TradeSegment& operator=(TradeSegment&& other) noexcept;
+
+    // False if the file is missing or isn't a valid segment
+    bool open(const std::string& path);
+    uint64_t trade_count() const;
+
+    // Hand every trade with t0 <= ts < t1 to fn, a block at a time, until fn returns false
+    // Returns false if fn stopped it
+    bool scan(int64_t t0_us, int64_t t1_us, const std::function<bool(const TradeColumns&)>& fn) const;
+
+private:
+    void close();
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<char> owned_;   // Fallback where mmap isn't available
+};
+
+/**
+ * Columnar on-disk trade archive
+ *
+ * Layout: <root>/<symbol>/<YYYY-MM-DD>.seg, one file per symbol per UTC day.
+ * Trades are stored in blocks of up to BLOCK_SIZE rows, one column after
+ * another: timestamps as varint deltas, prices as zigzag varint deltas and
+ * quantities as plain varints - a day of trades usually shrinks to 3-5 bytes
+ * a row. A small index at the front holds each block's time range and column
+ * offsets, so a time-range scan jumps straight to the blocks it needs and
+ * the aggregation runs over flat decoded arrays.
+ */
+class TradeArchive {
+public:
+    static constexpr uint32_t BLOCK_SIZE = 4096;
+
+    explicit TradeArchive(std::string root);
+
+    // (Re)write a day's segment; trades must all fall on that day and are sorted by time here
+    bool write_segment(const std::string& symbol, std::vector<ArchivedTrade> trades);
+
+    // Only opens the symbol's segments that exist in the range, oldest first; fn returns false to stop
+    void scan(const std::string& symbol, int64_t t0_us, int64_t t1_us,
+              const std::function<bool(const TradeColumns&)>& fn) const;
+    std::vector<ArchivedTrade> trades(const std::string& symbol, int64_t t0_us, int64_t t1_us, size_t limit = SIZE_MAX) const;
+    std::vector<VwapBar> vwap_per_minute(const std::string& symbol, int64_t t0_us, int64_t t1_us) const;
+
+    std::string segment_path(const std::string& symbol, int64_t day) const;
+    static int64_t day_of(int64_t ts_us);
+    // Days the symbol has segments for, in order
+    std::vector<int64_t> segment_days(const std::string& symbol) const;
+
+private:
+    std::string root_;
+};
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_TRADE_ARCHIVE_HPP
@@ -1,14 +1,10 @@
-#ifndef ORDERBOOK_UTILS_HPP
-#define ORDERBOOK_UTILS_HPP
+#ifndef ORDERBOOK_TYPES_HPP
+#define ORDERBOOK_TYPES_HPP
 
 #include <cstdint>
 #include <string>
 #include <chrono>
 
-extern "C" {
-#include "my_bcrypt.h"
-}
-
 namespace orderbook {
 
 // Common type aliases
@@ -28,13 +24,6 @@ inline uint64_t now_nanoseconds() {
     ).count();
 }
 
-// Bcrypt password hashing utilities
-std::string bcrypt_hash_password(const std::string& password, int workfactor = 12);
-bool bcrypt_check_password(const std::string& password, const std::string& hash);
-
-// JWT secret utility
-std::string get_jwt_secret();
-
 } // namespace orderbook
 
-#endif // ORDERBOOK_UTILS_HPP
+#endif // ORDERBOOK_TYPES_HPP
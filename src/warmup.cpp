@@ -0,0 +1,96 @@
+#include "warmup.hpp"
+#include "fast_json.hpp"
+#include "request_arena.hpp"
+#include "sanitize.hpp"
+#include <json/json.h>
+#include <memory>
+
+namespace orderbook {
+
+WarmupReport warm_up(MatchingEngine& live, const WarmupOptions& options) {
+    auto t0 = std::chrono::steady_clock::now();
+    WarmupReport report;
+
+    // The live engine only gets empty books and bigger tables - nothing synthetic
+    for (const auto& symbol : options.symbols) live.ensure_book(symbol);
+    live.reserve(options.expected_orders, options.expected_trades);
+    report.books = options.symbols.size();
+    RequestArena::prefault();
+    if (options.symbols.empty()) {
+        report.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0);
+        return report;
+    }
+
+    MatchingEngine shadow;
+    std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    for (size_t i = 0; i < options.rounds; ++i) {
+        RequestArena::Scope arena;
+        const auto& symbol = options.symbols[i % options.symbols.size()];
+        bool buy = i % 2 == 0;
+        // Buys and sells overlap around 1000, so a good share of them trade
+        Price price = 1000 + i % 7;
+
+        // The body a client would send, read the way the REST fast path reads it
+        JsonWriter body;
+        body.begin_object()
+            .field("symbol", symbol)
+            .field("side", buy ? "buy" : "sell")
+            .field("type", "limit")
+            .field("price", price)
+            .field("quantity", static_cast<uint64_t>(1 + i % 5))
+            .field("user_id", buy ? "warmup-bid" : "warmup-ask")
+            .field("tif", "GTC")
+            .end_object();
+        FlatJsonObject flat;
+        if (!flat.parse(body.view())) continue;
+        std::string scratch;
+        auto side = sanitize_view(flat.string("side"), scratch);
+        auto order = std::make_shared<Order>(
+            "warmup-" + std::to_string(i),
+            sanitize(flat.string("symbol")),
+            side == "buy" ? OrderSide::BUY : OrderSide::SELL,
+            OrderType::LIMIT,
+            flat.uint64("price"),
+            flat.uint64("quantity"),
+            sanitize(flat.string("user_id")),
+            0, 0,
+            sanitize(flat.string("tif")));
+
+        auto trades = shadow.add_order(order);
+        ++report.orders;
+        report.trades += trades.size();
+        // Some of the resting ones get amended or pulled, like real flow
+        if (i % 4 == 1) shadow.modify_order(order->id, price + 1, order->quantity);
+        if (i % 8 == 3) shadow.cancel_order(order->id);
+
+        // The reply, then the jsoncpp side that WebSocket replies and unusual bodies go through
+        JsonWriter out;
+        out.begin_object()
+            .field("order_id", order->id)
+            .key("trades").begin_array();
+        for (const auto& trade : trades) {
+            out.begin_object()
+                .field("buy_order_id", trade.buy_order_id)
+                .field("sell_order_id", trade.sell_order_id)
+                .field("price", trade.price)
+                .field("quantity", trade.quantity)
+                .end_object();
+        }
+        out.end_array().end_object();
+        Json::Value parsed;
+        std::string errs;
+        if (reader->parse(out.view().data(), out.view().data() + out.view().size(), &parsed, &errs)) {
+            Json::writeString(wbuilder, parsed);
+        }
+        // Depth snapshots, as a book broadcast takes them
+        shadow.get_bid_levels(symbol, 10);
+        shadow.get_ask_levels(symbol, 10);
+    }
+
+    report.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0);
+    return report;
+}
+
+} // namespace orderbook
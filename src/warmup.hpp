@@ -0,0 +1,47 @@
+#ifndef ORDERBOOK_WARMUP_HPP
+#define ORDERBOOK_WARMUP_HPP
+
+#include "matching_engine.hpp"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace orderbook {
+
+/**
+ * Start-up warm-up for the order entry path
+ *
+ * Right after a deploy the first orders pay for everything that happens
+ * lazily: book creation inside add_order, page faults on fresh allocations,
+ * cold caches and branch predictors, jsoncpp's first-use setup. warm_up()
+ * takes those costs before the listener opens:
+ *  - creates the live engine's books for the configured symbols and sizes
+ *    its order index and trade history
+ *  - prefaults this thread's request arena
+ *  - runs synthetic orders through parse -> match -> modify/cancel -> reply
+ *    serialization on a throwaway shadow engine, so nothing synthetic ever
+ *    reaches the live books, storage or subscribers
+ *
+ * Run it on the thread that will do the engine work (the dispatcher's),
+ * since the arena and the allocator caches it warms are per thread.
+ */
+struct WarmupOptions {
+    std::vector<std::string> symbols{"BTC-USD", "ETH-USD"};
+    size_t rounds = 5000;               // Synthetic orders per run, spread over the symbols
+    size_t expected_orders = 1 << 16;   // Live order index size to reserve
+    size_t expected_trades = 1 << 16;   // Trade history size to reserve
+};
+
+struct WarmupReport {
+    size_t books = 0;       // Live books ready
+    size_t orders = 0;      // Synthetic orders through the shadow engine
+    size_t trades = 0;      // ... and the trades they made
+    std::chrono::microseconds elapsed{0};
+};
+
+WarmupReport warm_up(MatchingEngine& live, const WarmupOptions& options);
+
+} // namespace orderbook
+
+#endif // ORDERBOOK_WARMUP_HPP
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "account_ledger.hpp"
+#include "matching_engine.hpp"
+#include "order.hpp"
+#include <memory>
+
+using namespace orderbook;
+
+static Trade make_trade(const std::string& buyer, const std::string& seller, Price price, Quantity quantity) {
+    Trade t;
+    t.symbol = "BTCUSD";
+    t.buy_order_id = "b";
+    t.sell_order_id = "s";
+    t.buy_user_id = buyer;
+    t.sell_user_id = seller;
+    t.price = price;
+    t.quantity = quantity;
+    return t;
+}
+
+TEST(AccountLedgerTest, TracksCashPositionsAndRealizedPnl) {
+    AccountLedger ledger;
+    ledger.apply_trade(make_trade("alice", "bob", 100, 10));
+    ledger.apply_trade(make_trade("alice", "bob", 110, 10));   // alice long 20 @ 105
+    ledger.apply_trade(make_trade("bob", "alice", 120, 15));   // alice sells 15 -> +225 realized
+
+    auto alice = ledger.get_account("alice");
+    ASSERT_TRUE(alice.has_value());
+    EXPECT_EQ(alice->cash, -1000 - 1100 + 1800);
+    EXPECT_EQ(alice->trade_count, 3u);
+    const Position* pos = alice->find_position("BTCUSD");
+    ASSERT_NE(pos, nullptr);
+    EXPECT_EQ(pos->quantity, 5);
+    EXPECT_EQ(pos->cost_basis, 525);
+    EXPECT_EQ(pos->realized_pnl, 225);
+
+    // bob was short 20 @ 105, bought back 15 @ 120 -> lost 225
+    auto bob = ledger.get_account("bob");
+    ASSERT_TRUE(bob.has_value());
+    EXPECT_EQ(bob->find_position("BTCUSD")->quantity, -5);
+    EXPECT_EQ(bob->find_position("BTCUSD")->realized_pnl, -225);
+
+    EXPECT_FALSE(ledger.get_account("carol").has_value());
+}
+
+TEST(AccountLedgerTest, FlipsPositionAndTracksDirtyAccounts) {
+    AccountLedger ledger;
+    ledger.apply_trade(make_trade("alice", "bob", 100, 5));
+    EXPECT_EQ(ledger.take_dirty().size(), 2u);
+    EXPECT_TRUE(ledger.take_dirty().empty());
+
+    // alice sells 8 against a long of 5: closes at +50, then opens a 3 lot short @ 110
+    ledger.apply_trade(make_trade("carol", "alice", 110, 8));
+    auto alice = ledger.get_account("alice");
+    const Position* pos = alice->find_position("BTCUSD");
+    EXPECT_EQ(pos->quantity, -3);
+    EXPECT_EQ(pos->cost_basis, -330);
+    EXPECT_EQ(pos->realized_pnl, 50);
+
+    auto dirty = ledger.take_dirty();
+    EXPECT_EQ(dirty.size(), 2u);   // alice and carol, not bob
+}
+
+TEST(AccountLedgerTest, FollowsEngineTrades) {
+    MatchingEngine engine;
+    AccountLedger ledger;
+    engine.on_trade = [&ledger](const Trade& t) { ledger.apply_trade(t); };
+    engine.add_order(std::make_shared<Order>("s1", "BTCUSD", OrderSide::SELL, OrderType::LIMIT, 100, 4, "bob"));
+    engine.add_order(std::make_shared<Order>("b1", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 100, 4, "alice"));
+    auto alice = ledger.get_account("alice");
+    ASSERT_TRUE(alice.has_value());
+    EXPECT_EQ(alice->find_position("BTCUSD")->quantity, 4);
+    EXPECT_EQ(ledger.get_account("bob")->cash, 400);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "AdmissionFilter.h"
+#include "admission.hpp"
+#include <vector>
+
+using namespace orderbook;
+using namespace std::chrono_literals;
+
+TEST(AdmissionTest, ShedsOnDepthAndAgeAndRecovers) {
+    AdmissionController::Options options;
+    options.max_in_flight = 2;
+    options.max_request_age = 10ms;
+    options.min_client_share = 100;
+    MatchingEngine engine;
+    AdmissionController admission(options, &engine);
+
+    auto a = admission.admit("10.0.0.1");
+    auto b = admission.admit("10.0.0.2");
+    ASSERT_TRUE(a.admitted());
+    ASSERT_TRUE(b.admitted());
+    auto c = admission.admit("10.0.0.3");
+    EXPECT_EQ(c.verdict(), AdmissionController::Verdict::Depth);
+    { auto done = std::move(a); }
+    EXPECT_TRUE(admission.admit("10.0.0.3").admitted());
+
+    // A request that already waited too long is turned away even with room
+    EXPECT_EQ(admission.admit("10.0.0.3", 20ms).verdict(), AdmissionController::Verdict::Age);
+
+    auto stats = admission.stats();
+    EXPECT_EQ(stats.admitted, 3u);
+    EXPECT_EQ(stats.shed_depth, 1u);
+    EXPECT_EQ(stats.shed_age, 1u);
+    EXPECT_EQ(stats.in_flight, 1u);
+}
+
+TEST(AdmissionTest, FloodingClientIsShedFirstUnderCongestion) {
+    AdmissionController::Options options;
+    options.max_request_age = 10ms;
+    options.fairness_window = 10s;
+    options.min_client_share = 2;
+    AdmissionController admission(options);
+
+    // Quiet period: one client sends a lot and nobody minds
+    for (int i = 0; i < 10; ++i) ASSERT_TRUE(admission.admit("flood").admitted());
+
+    // Requests now arrive 6ms old - congested, but under the hard limit
+    EXPECT_TRUE(admission.admit("flood", 6ms).admitted());       // Still the only client
+    EXPECT_TRUE(admission.admit("polite", 6ms).admitted());
+    EXPECT_EQ(admission.admit("flood", 6ms).verdict(), AdmissionController::Verdict::Fairness);
+    EXPECT_TRUE(admission.admit("polite", 6ms).admitted());
+    EXPECT_EQ(admission.stats().shed_fairness, 1u);
+}
+
+// The filter's ticket outlives the filter chain and is handed back when the response is sent
+TEST(AdmissionTest, FilterHoldsTicketUntilResponse) {
+    AdmissionController::Options options;
+    options.max_in_flight = 1;
+    options.min_client_share = 100;
+    AdmissionController admission(options);
+    AdmissionFilter::controller = &admission;
+    AdmissionFilter filter;
+
+    auto req = drogon::HttpRequest::newHttpRequest();
+    bool passed = false;
+    filter.doFilter(req, [](const drogon::HttpResponsePtr&) {}, [&] { passed = true; });
+    ASSERT_TRUE(passed);
+    // The handler hasn't answered yet, so the slot is still taken
+    EXPECT_EQ(admission.stats().in_flight, 1u);
+    EXPECT_FALSE(admission.admit("10.0.0.9").admitted());
+
+    AdmissionFilter::release(req);
+    EXPECT_EQ(admission.stats().in_flight, 0u);
+    EXPECT_TRUE(admission.admit("10.0.0.9").admitted());
+    AdmissionFilter::controller = nullptr;
+}
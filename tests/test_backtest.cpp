@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+#include "backtest.hpp"
+#include <sstream>
+
+using namespace orderbook;
+
+// Timestamps are in seconds for readability; the feed is nanoseconds
+static std::string at(int64_t seconds, const std::string& rest) {
+    return std::to_string(seconds * 1'000'000'000LL) + "," + rest + "\n";
+}
+
+TEST(BacktestTest, ReplaysOnVirtualTime) {
+    const int64_t t0 = 1'700'000'000;
+    std::stringstream feed;
+    feed << "ts,action,id\n"
+         << at(t0, "new,s1,BTC-USD,sell,limit,100,5,mm")
+         << at(t0 + 1, "new,b1,BTC-USD,buy,limit,100,2,taker")
+         << at(t0 + 2, "modify,s1,101,3")
+         << at(t0 + 3, "new,s2,BTC-USD,sell,limit,105,1,mm," + std::to_string(t0 + 6))
+         << "garbage\n"
+         << at(t0 + 4, "cancel,nope")
+         << at(t0 + 20, "new,b2,BTC-USD,buy,market,0,1,taker");
+
+    BacktestOptions options;
+    options.snapshot_interval = std::chrono::seconds(10);
+    Backtester bt(options);
+    std::vector<Trade> fills;
+    std::vector<BookSnapshot> snaps;
+    bt.on_fill = [&](const Trade& t) { fills.push_back(t); };
+    bt.on_snapshot = [&](const BookSnapshot& s) { snaps.push_back(s); };
+    auto report = bt.run(feed);
+
+    EXPECT_EQ(report.events, 6u);
+    EXPECT_EQ(report.bad_lines, 1u);
+    EXPECT_EQ(report.misses, 1u);
+    ASSERT_EQ(fills.size(), 2u);
+    // Fills carry the event's virtual time, not the wall's
+    auto secs = [](const Trade& t) { return std::chrono::duration_cast<std::chrono::seconds>(t.timestamp.time_since_epoch()).count(); };
+    EXPECT_EQ(secs(fills[0]), t0 + 1);
+    EXPECT_EQ(fills[0].quantity, 2u);
+    // s2 expired at t0+6 and was swept before the event at t0+20, so the market buy hits s1 instead
+    EXPECT_EQ(secs(fills[1]), t0 + 20);
+    EXPECT_EQ(fills[1].sell_order_id, "s1");
+    EXPECT_EQ(fills[1].price, 101u);
+
+    // The quiet stretch up to t0+20 gets one snapshot, taken before that event
+    ASSERT_EQ(snaps.size(), 1u);
+    EXPECT_EQ(snaps[0].ts_ns, (t0 + 20) * 1'000'000'000LL);
+    ASSERT_EQ(snaps[0].asks.size(), 1u);
+    EXPECT_EQ(snaps[0].asks[0], std::make_pair(Price(101), Quantity(3)));
+    EXPECT_GT(report.speedup(), 1.0);
+}
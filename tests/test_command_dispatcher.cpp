@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "command_dispatcher.hpp"
+#include <string>
+#include <vector>
+
+using namespace orderbook;
+using Lane = CommandDispatcher::Lane;
+
+TEST(CommandDispatcherTest, CancelsOvertakeNewOrdersButNewOrdersStillRun) {
+    CommandDispatcher::Options opts;
+    opts.max_burst = 2;
+    CommandDispatcher dispatcher(opts);
+    std::string ran;
+    // A flood of new orders queued first, then a modify and a run of cancels behind it
+    for (int i = 0; i < 3; ++i) ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ran += 'N'; }));
+    ASSERT_TRUE(dispatcher.submit(Lane::Modify, [&] { ran += 'M'; }));
+    for (int i = 0; i < 5; ++i) ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += 'C'; }));
+    while (dispatcher.run_one()) {}
+    // Cancels go first, but every lane passed over twice gets the next slot
+    EXPECT_EQ(ran, "CCMNCCNCN");
+    EXPECT_EQ(dispatcher.depth(), 0u);
+    EXPECT_EQ(dispatcher.stats(Lane::Cancel).executed, 5u);
+    EXPECT_EQ(dispatcher.stats(Lane::New).submitted, 3u);
+}
+
+TEST(CommandDispatcherTest, FullLaneRejectsWithoutTakingTheCommand) {
+    CommandDispatcher::Options opts;
+    opts.capacity = {1, 1, 2};
+    CommandDispatcher dispatcher(opts);
+    int runs = 0;
+    ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ++runs; }));
+    ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ++runs; }));
+    CommandDispatcher::Command extra = [&] { runs += 100; };
+    EXPECT_FALSE(dispatcher.submit(Lane::New, std::move(extra)));
+    // The caller still owns the refused command, so it can answer "busy" itself
+    ASSERT_TRUE(extra);
+    // Other lanes have their own room
+    EXPECT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ++runs; }));
+    EXPECT_EQ(dispatcher.stats(Lane::New).rejected, 1u);
+
+    // The engine thread drains everything on stop, exceptions included
+    EXPECT_TRUE(dispatcher.submit(Lane::Modify, [] { throw std::runtime_error("boom"); }));
+    dispatcher.start();
+    dispatcher.stop();
+    EXPECT_EQ(runs, 3);
+    EXPECT_EQ(dispatcher.stats(Lane::Modify).executed, 1u);
+}
+
+// A cancel or modify for an order that's still queued waits behind it instead of overtaking it
+TEST(CommandDispatcherTest, CancelForQueuedOrderWaitsBehindIt) {
+    CommandDispatcher dispatcher;
+    std::string ran;
+    ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ran += "N1 "; }, "o1"));
+    ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ran += "N2 "; }, "o2"));
+    ASSERT_TRUE(dispatcher.submit(Lane::Modify, [&] { ran += "M1 "; }, "o1"));
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C1 "; }, "o1"));
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C9 "; }, "o9"));     // Not queued - keeps its lane
+    for (int i = 0; i < 3; ++i) ASSERT_TRUE(dispatcher.run_one());
+    // Once o2 has run, a cancel for it goes back to the top lane
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C2 "; }, "o2"));
+    while (dispatcher.run_one()) {}
+    EXPECT_EQ(ran, "C9 N1 N2 C2 M1 C1 ");
+    EXPECT_EQ(dispatcher.stats(Lane::New).executed, 4u);
+    EXPECT_EQ(dispatcher.stats(Lane::Cancel).executed, 2u);
+}
+
+TEST(CommandDispatcherTest, BatchRegistersEveryOrderItPlaces) {
+    CommandDispatcher dispatcher;
+    std::string ran;
+    ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ran += "B "; }, std::vector<std::string>{"b-0", "b-1"}));
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C1 "; }, "b-1"));
+    // A batch cancelling a queued order waits behind it as well
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "BC "; }, std::vector<std::string>{"x", "b-0"}));
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C9 "; }, "o9"));
+    while (dispatcher.run_one()) {}
+    EXPECT_EQ(ran, "C9 B C1 BC ");
+    // All forgotten once they ran
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C0 "; }, "b-0"));
+    ASSERT_TRUE(dispatcher.submit(Lane::New, [&] { ran += "N "; }));
+    ASSERT_TRUE(dispatcher.submit(Lane::Cancel, [&] { ran += "C1 "; }, "b-1"));
+    while (dispatcher.run_one()) {}
+    EXPECT_EQ(ran, "C9 B C1 BC C0 C1 N ");
+}
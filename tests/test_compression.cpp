@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "compression.hpp"
+#include "matching_engine.hpp"
+#include <memory>
+#include <zlib.h>
+
+using namespace orderbook;
+
+static std::string gunzip(const std::string& in) {
+    z_stream zs{};
+    inflateInit2(&zs, 15 + 16);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    std::string out;
+    char buf[4096];
+    int rc;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(buf);
+        zs.avail_out = sizeof(buf);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (rc == Z_OK);
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : "<corrupt>";
+}
+
+TEST(CompressionTest, NegotiatesByQualityThenPreference) {
+    EXPECT_EQ(negotiate_encoding(""), ContentEncoding::Identity);
+    EXPECT_EQ(negotiate_encoding("gzip"), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiate_encoding("deflate, GZIP;q=0.5"), ContentEncoding::Gzip);
+    EXPECT_EQ(negotiate_encoding("gzip;q=0, deflate"), ContentEncoding::Identity);
+    EXPECT_EQ(negotiate_encoding("*;q=0"), ContentEncoding::Identity);
+    // Whatever else is built in, gzip always is, and "*" or a tie can only do better
+    EXPECT_NE(negotiate_encoding("*"), ContentEncoding::Identity);
+    auto best = negotiate_encoding("gzip, br, zstd");
+    EXPECT_TRUE(content_encoding_available(best));
+    if (content_encoding_available(ContentEncoding::Brotli)) {
+        EXPECT_EQ(negotiate_encoding("gzip;q=0.9, br"), ContentEncoding::Brotli);
+        EXPECT_EQ(negotiate_encoding("gzip, br;q=0.9"), ContentEncoding::Gzip);
+    }
+}
+
+TEST(CompressionTest, GzipRoundTripsWholeAndStreamed) {
+    std::string body;
+    for (int i = 0; i < 5000; ++i) body += "{\"price\":" + std::to_string(100 + i % 50) + ",\"quantity\":7},";
+
+    std::string packed;
+    ASSERT_TRUE(compress_body(ContentEncoding::Gzip, body, packed));
+    EXPECT_LT(packed.size(), body.size() / 4);
+    EXPECT_EQ(gunzip(packed), body);
+
+    // Same body fed through in uneven pieces
+    StreamCompressor stream(ContentEncoding::Gzip);
+    std::string streamed;
+    for (size_t at = 0; at < body.size(); at += 777) {
+        ASSERT_TRUE(stream.write(std::string_view(body).substr(at, 777), streamed, false));
+    }
+    ASSERT_TRUE(stream.write({}, streamed, true));
+    EXPECT_EQ(gunzip(streamed), body);
+}
+
+TEST(CompressionTest, CachedBodiesLastUntilTheBookChanges) {
+    MatchingEngine engine;
+    VersionedBodyCache cache(2);
+    engine.add_order(std::make_shared<Order>("1", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 100, 5, "alice"));
+
+    std::vector<OrderBookLevel> bids, asks;
+    uint64_t v1 = engine.get_depth("BTC-USD", 10, bids, asks);
+    ASSERT_EQ(bids.size(), 1u);
+    EXPECT_EQ(v1, engine.get_book_version("BTC-USD"));
+    cache.store("BTC-USD|1", v1, ContentEncoding::Gzip, std::make_shared<const std::string>("v1"));
+    ASSERT_TRUE(cache.find("BTC-USD|1", v1, ContentEncoding::Gzip));
+    EXPECT_FALSE(cache.find("BTC-USD|1", v1, ContentEncoding::Identity));
+
+    // A fill changes the levels, so the stored page is stale
+    engine.add_order(std::make_shared<Order>("2", "BTC-USD", OrderSide::SELL, OrderType::LIMIT, 100, 2, "bob"));
+    uint64_t v2 = engine.get_book_version("BTC-USD");
+    EXPECT_GT(v2, v1);
+    EXPECT_FALSE(cache.find("BTC-USD|1", v2, ContentEncoding::Gzip));
+    cache.store("BTC-USD|1", v2, ContentEncoding::Identity, std::make_shared<const std::string>("v2"));
+    cache.store("BTC-USD|1", v1, ContentEncoding::Gzip, std::make_shared<const std::string>("late"));
+    EXPECT_FALSE(cache.find("BTC-USD|1", v1, ContentEncoding::Gzip));
+    EXPECT_EQ(*cache.find("BTC-USD|1", v2, ContentEncoding::Identity), "v2");
+
+    // A book cleared and made again never repeats a version
+    engine.clear();
+    engine.add_order(std::make_shared<Order>("3", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 90, 1, "alice"));
+    EXPECT_GT(engine.get_book_version("BTC-USD"), v2);
+
+    cache.store("ETH-USD|1", 1, ContentEncoding::Identity, std::make_shared<const std::string>("e"));
+    cache.store("SOL-USD|1", 1, ContentEncoding::Identity, std::make_shared<const std::string>("s"));
+    EXPECT_EQ(cache.size(), 2u);
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include "fast_json.hpp"
+#include "request_arena.hpp"
+#include <json/json.h>
+#include <sstream>
+
+using namespace orderbook;
+
+TEST(FastJsonTest, ReadsFlatOrderBodiesAndDefersTheRest) {
+    RequestArena::Scope arena;
+    FlatJsonObject obj;
+    ASSERT_TRUE(obj.parse(R"( {"symbol":"BTC-USD", "price": 50000, "quantity":2, "ioc":true, "note":null, "price":50001} )"));
+    EXPECT_EQ(obj.string("symbol"), "BTC-USD");
+    EXPECT_TRUE(obj.is_uint64("quantity"));
+    EXPECT_EQ(obj.uint64("quantity"), 2u);
+    // Last duplicate wins, same as jsoncpp
+    EXPECT_EQ(obj.uint64("price"), 50001u);
+    EXPECT_FALSE(obj.is_string("ioc"));
+    EXPECT_FALSE(obj.has("missing"));
+
+    // Shapes jsoncpp has to judge
+    for (const char* body : {R"({"a":"x\"y"})", R"({"a":{"b":1}})", R"({"a":1.5})", R"({"a":-1})",
+                             R"({"a":1e3})", R"({"a":007})", R"({"a":18446744073709551616})",
+                             R"({"a":1} trailing)", "[1,2]", ""}) {
+        EXPECT_FALSE(obj.parse(body)) << body;
+    }
+}
+
+TEST(FastJsonTest, WriterOutputParsesBackWithJsoncpp) {
+    RequestArena::Scope arena;
+    JsonWriter w;
+    w.begin_object()
+        .field("status", "filled")
+        .field("id", std::string_view("quote \"1\"\n"))
+        .field("price", uint64_t{18446744073709551615ull})
+        .field("expiry", int64_t{-5})
+        .key("trades").begin_array();
+    for (uint64_t q : {1, 2}) w.begin_object().field("quantity", q).end_object();
+    w.end_array().end_object();
+
+    Json::Value j;
+    std::string errs;
+    std::istringstream in(w.str());
+    ASSERT_TRUE(Json::parseFromStream(Json::CharReaderBuilder(), in, &j, &errs)) << w.str();
+    EXPECT_EQ(j["status"].asString(), "filled");
+    EXPECT_EQ(j["id"].asString(), "quote \"1\"\n");
+    EXPECT_EQ(j["price"].asUInt64(), 18446744073709551615ull);
+    EXPECT_EQ(j["expiry"].asInt64(), -5);
+    ASSERT_EQ(j["trades"].size(), 2u);
+    EXPECT_EQ(j["trades"][1]["quantity"].asUInt64(), 2u);
+}
+
+TEST(FastJsonTest, ArenaIsReusedAcrossRequests) {
+    auto before = RequestArena::heap_fallbacks();
+    for (int i = 0; i < 1000; ++i) {
+        RequestArena::Scope arena;
+        FlatJsonObject obj;
+        ASSERT_TRUE(obj.parse(R"({"symbol":"ETH-USD","side":"buy","price":100,"quantity":1})"));
+        JsonWriter w;
+        w.begin_object().field("symbol", obj.string("symbol")).end_object();
+    }
+    // Every request fit in the thread's block, so nothing went to the heap
+    EXPECT_EQ(RequestArena::heap_fallbacks(), before);
+}
@@ -10,6 +10,11 @@
 #include "OrderBookWebSocket.h"
 #include "matching_engine.hpp"
 #include "order.hpp"
+#include "security.hpp"
+#include "jwt-cpp/jwt.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
 #include <future>
 #include <sstream>
@@ -27,7 +32,14 @@ protected:
         // Start Drogon app in a background thread on port 18081
         appThread = std::thread([]() {
             static MatchingEngine engine;
+            static auto ws = std::make_shared<OrderBookWebSocket>(&engine);
+            static bool registered = false;
+            if (!registered) {
+                drogon::app().registerController(ws);
+                registered = true;
+            }
             OrderBookController::setEngine(&engine);
+            OrderBookController::setWebSocketController(ws.get());
             drogon::app().addListener("127.0.0.1", 18081);
             drogon::app().run();
         });
@@ -176,4 +188,71 @@ TEST_F(OrderBookIntegrationTest, FuzzPlaceOrders) {
     ASSERT_EQ(successCount.load(std::memory_order_relaxed), N);
 }
 
+// Test 4: WebSocketOrderEntry - place, reject and a malformed frame on an authenticated session
+TEST_F(OrderBookIntegrationTest, WebSocketOrderEntry) {
+    std::string token = jwt::create()
+        .set_issuer("orderbook")
+        .set_type("JWS")
+        .set_payload_claim("username", jwt::claim(std::string("carol")))
+        .set_expires_at(std::chrono::system_clock::now() + std::chrono::hours(1))
+        .sign(jwt::algorithm::hs256{orderbook::get_jwt_secret()});
+
+    // Replies only - book broadcasts and execution reports are skipped
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Json::Value> replies;
+    auto wsClient = WebSocketClient::newWebSocketClient("ws://127.0.0.1:18081");
+    wsClient->setMessageHandler([&](std::string&& message, const WebSocketClientPtr&, const WebSocketMessageType&) {
+        Json::Value j;
+        Json::CharReaderBuilder rbuilder;
+        std::string errs;
+        std::istringstream ss(message);
+        if (!Json::parseFromStream(rbuilder, ss, &j, &errs)) return;
+        auto type = j["type"].asString();
+        if (type != "ack" && type != "reject") return;
+        std::lock_guard<std::mutex> lock(mutex);
+        replies.push_back(j);
+        cv.notify_all();
+    });
+    auto next_reply = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!cv.wait_for(lock, std::chrono::seconds(2), [&] { return !replies.empty(); })) return Json::Value();
+        auto j = replies.front();
+        replies.pop_front();
+        return j;
+    };
+
+    std::promise<bool> connected;
+    auto wsReq = HttpRequest::newHttpRequest();
+    wsReq->setPath("/ws/orderbook");
+    wsReq->setParameter("token", token);
+    wsClient->connectToServer(wsReq, [&connected](ReqResult result, const HttpResponsePtr&, const WebSocketClientPtr&) {
+        connected.set_value(result == ReqResult::Ok);
+    });
+    auto connectedFuture = connected.get_future();
+    ASSERT_EQ(connectedFuture.wait_for(std::chrono::seconds(2)), std::future_status::ready) << "WebSocket connection timed out";
+    ASSERT_TRUE(connectedFuture.get());
+    auto conn = wsClient->getConnection();
+
+    conn->send("{not json");
+    auto malformed = next_reply();
+    ASSERT_EQ(malformed["type"].asString(), "reject");
+    EXPECT_EQ(malformed["error"].asString(), "Invalid JSON");
+
+    conn->send(R"({"type":"place","req_id":1,"symbol":"WSUSD","side":"buy","order_type":"limit","price":10000,"quantity":2})");
+    auto placed = next_reply();
+    ASSERT_EQ(placed["type"].asString(), "ack");
+    EXPECT_EQ(placed["op"].asString(), "place");
+    EXPECT_EQ(placed["req_id"].asInt(), 1);
+    EXPECT_EQ(placed["status"].asString(), "open");
+    ASSERT_TRUE(placed["order_id"].isString());
 
+    // No price - rejected with the request's ID, and nothing reaches the book
+    conn->send(R"({"type":"place","req_id":2,"symbol":"WSUSD","side":"sell","order_type":"limit","quantity":2})");
+    auto rejected = next_reply();
+    ASSERT_EQ(rejected["type"].asString(), "reject");
+    EXPECT_EQ(rejected["req_id"].asInt(), 2);
+    EXPECT_EQ(rejected["error"].asString(), "Missing or invalid 'price'");
+
+    conn->shutdown();
+}
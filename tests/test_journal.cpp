@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "journal.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+using namespace orderbook;
+
+namespace {
+
+std::string temp_prefix(const char* name) {
+    auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return (dir / "audit.log").string();
+}
+
+std::string read_all(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+} // namespace
+
+// Segments rotate on size and, read back in order, hold every line exactly once
+TEST(JournalTest, RotatesSegmentsWithoutLosingLines) {
+    auto prefix = temp_prefix("ob_test_journal_rotate");
+    SegmentJournal::Options options;
+    options.path = prefix;
+    options.segment_bytes = 8 * 1024;
+    SegmentJournal journal(options);
+    ASSERT_TRUE(journal.start());
+    std::string expected;
+    for (int i = 0; i < 2000; ++i) {
+        std::string line = "{\"event\":\"trade\",\"n\":" + std::to_string(i) + "}\n";
+        expected += line;
+        journal.append(line);
+        if (i % 100 == 99) journal.flush();
+    }
+    journal.stop();
+    EXPECT_GT(journal.stats().segments, 2u);
+    EXPECT_EQ(journal.stats().errors, 0u);
+
+    std::string actual;
+    for (uint64_t i = 1; std::filesystem::exists(SegmentJournal::segment_name(prefix, i)); ++i) {
+        actual += read_all(SegmentJournal::segment_name(prefix, i));
+    }
+    EXPECT_EQ(actual, expected);
+}
+
+// Same data through both I/O paths, with O_DIRECT where the filesystem allows it
+TEST(JournalTest, DirectAndPwritePathsMatch) {
+    for (bool uring : {true, false}) {
+        auto prefix = temp_prefix(uring ? "ob_test_journal_uring" : "ob_test_journal_pwrite");
+        SegmentJournal::Options options;
+        options.path = prefix;
+        options.direct = true;
+        options.use_io_uring = uring;
+        SegmentJournal journal(options);
+        ASSERT_TRUE(journal.start());
+        std::string expected;
+        for (int i = 0; i < 500; ++i) {
+            std::string line(1 + i % 300, static_cast<char>('a' + i % 26));
+            line += '\n';
+            expected += line;
+            journal.append(line);
+            if (i % 7 == 0) journal.flush();    // Lots of partial-block rewrites
+        }
+        journal.stop();
+        EXPECT_EQ(read_all(SegmentJournal::segment_name(prefix, 1)), expected);
+        // Restarting picks a fresh segment instead of appending to the old one
+        SegmentJournal again(options);
+        ASSERT_TRUE(again.start());
+        again.append("x\n");
+        again.stop();
+        EXPECT_EQ(read_all(SegmentJournal::segment_name(prefix, 2)), "x\n");
+    }
+}
+
+// Flushing a journal nothing has been appended to succeeds - there's nothing to lose
+TEST(JournalTest, EmptyJournalFlushes) {
+    for (bool uring : {true, false}) {
+        SegmentJournal::Options options;
+        options.path = temp_prefix(uring ? "ob_test_journal_empty_uring" : "ob_test_journal_empty_pwrite");
+        options.use_io_uring = uring;
+        SegmentJournal journal(options);
+        ASSERT_TRUE(journal.start());
+        EXPECT_TRUE(journal.flush());
+        journal.stop();
+    }
+}
+
+#ifndef _WIN32
+// A batch whose write fails isn't reported durable, on either I/O path
+TEST(JournalTest, FailedWriteIsReportedToFlush) {
+    for (bool uring : {true, false}) {
+        auto prefix = temp_prefix(uring ? "ob_test_journal_fail_uring" : "ob_test_journal_fail_pwrite");
+        SegmentJournal::Options options;
+        options.path = prefix;
+        options.use_io_uring = uring;
+        SegmentJournal journal(options);
+        ASSERT_TRUE(journal.start());
+        journal.append("first\n");
+        EXPECT_TRUE(journal.flush());
+
+        // Past the file size limit the write comes back with EFBIG
+        std::signal(SIGXFSZ, SIG_IGN);
+        rlimit old_limit{};
+        getrlimit(RLIMIT_FSIZE, &old_limit);
+        rlimit limit = old_limit;
+        limit.rlim_cur = 6;
+        setrlimit(RLIMIT_FSIZE, &limit);
+        journal.append("second\n");
+        bool flushed = journal.flush();
+        setrlimit(RLIMIT_FSIZE, &old_limit);
+        std::signal(SIGXFSZ, SIG_DFL);
+        EXPECT_FALSE(flushed);
+        EXPECT_EQ(journal.stats().errors, 1u);
+
+        journal.append("third\n");
+        EXPECT_TRUE(journal.flush());
+        journal.stop();
+    }
+}
+#endif
@@ -84,6 +84,18 @@ TEST_F(MatchingEngineTest, GetUserTrades) {
     ASSERT_EQ(trades[0].buy_order_id, "12");
 }
 
+TEST_F(MatchingEngineTest, UserTradesOutliveTheirOrders) {
+    engine->add_order(std::make_shared<Order>("40", "BTCUSD", OrderSide::SELL, OrderType::LIMIT, 10000, 2, "bob"));
+    engine->add_order(std::make_shared<Order>("41", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 10000, 1, "alice"));
+    // Bob's order leaves the book with its fill already done
+    ASSERT_TRUE(engine->cancel_order("40"));
+    auto trades = engine->get_user_trades("bob");
+    ASSERT_EQ(trades.size(), 1);
+    ASSERT_EQ(trades[0].sell_order_id, "40");
+    ASSERT_EQ(engine->get_user_trades("alice").size(), 1);
+    ASSERT_TRUE(engine->get_user_trades("carol").empty());
+}
+
 TEST_F(MatchingEngineTest, BestBidAskAndSpread) {
     engine->add_order(std::make_shared<Order>("13", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 9990, 1, "alice"));
     engine->add_order(std::make_shared<Order>("14", "BTCUSD", OrderSide::SELL, OrderType::LIMIT, 10010, 1, "bob"));
@@ -117,4 +129,113 @@ TEST_F(MatchingEngineTest, ClearEngine) {
     ASSERT_EQ(engine->get_all_orders().size(), 0);
 }
 
+TEST_F(MatchingEngineTest, MassCancel) {
+    engine->add_order(std::make_shared<Order>("17", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 10000, 1, "alice"));
+    engine->add_order(std::make_shared<Order>("18", "ETHUSD", OrderSide::SELL, OrderType::LIMIT, 2000, 1, "alice"));
+    engine->add_order(std::make_shared<Order>("19", "BTCUSD", OrderSide::SELL, OrderType::LIMIT, 10010, 1, "bob"));
+    std::set<std::string> symbols;
+    auto cancelled = engine->mass_cancel({"17", "18", "missing"}, &symbols);
+    ASSERT_EQ(cancelled.size(), 2);
+    ASSERT_EQ(symbols.size(), 2);
+    ASSERT_EQ(engine->get_order("17"), nullptr);
+    ASSERT_EQ(engine->get_order("18"), nullptr);
+    ASSERT_NE(engine->get_order("19"), nullptr);
+    ASSERT_EQ(engine->get_best_bid("BTCUSD"), 0);
+}
+
+TEST_F(MatchingEngineTest, MassQuoteReplacesPreviousQuotes) {
+    auto quote = [](const std::string& id, OrderSide side, Price price) {
+        return std::make_shared<Order>(id, "BTCUSD", side, OrderType::LIMIT, price, 5, "mm");
+    };
+    engine->add_order(std::make_shared<Order>("20", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 9000, 1, "mm"));
+    auto first = engine->mass_quote("mm", {{"BTCUSD", {quote("q1", OrderSide::BUY, 9990), quote("q2", OrderSide::SELL, 10010)}}});
+    ASSERT_EQ(first.size(), 1);
+    ASSERT_TRUE(first[0].cancelled.empty());
+    ASSERT_EQ(engine->get_best_bid("BTCUSD"), 9990);
+
+    auto second = engine->mass_quote("mm", {{"BTCUSD", {quote("q3", OrderSide::BUY, 9995), quote("q4", OrderSide::SELL, 10005)}}});
+    ASSERT_EQ(second[0].cancelled.size(), 2);
+    ASSERT_EQ(engine->get_order("q1"), nullptr);
+    ASSERT_EQ(engine->get_best_bid("BTCUSD"), 9995);
+    ASSERT_EQ(engine->get_best_ask("BTCUSD"), 10005);
+    // Plain orders from the same user are not part of the quote set
+    ASSERT_NE(engine->get_order("20"), nullptr);
+    ASSERT_EQ(engine->get_user_orders("mm").size(), 3);
+}
+
+TEST_F(MatchingEngineTest, MmpPullsQuotesWhenLimitReached) {
+    auto quote = [](const std::string& id, OrderSide side, Price price) {
+        return std::make_shared<Order>(id, "BTCUSD", side, OrderType::LIMIT, price, 5, "mm");
+    };
+    MmpConfig config;
+    config.window = std::chrono::seconds(10);
+    config.max_quantity = 4;
+    engine->set_mmp("BTCUSD", "mm", config);
+    std::vector<std::string> pulled_ids;
+    engine->on_mmp_trigger = [&](const std::string&, const UserId&, const std::vector<OrderId>& pulled) {
+        pulled_ids = pulled;
+    };
+    engine->mass_quote("mm", {{"BTCUSD", {quote("q1", OrderSide::SELL, 10000), quote("q2", OrderSide::SELL, 10001),
+                                          quote("q3", OrderSide::BUY, 9990)}}});
+
+    // Buying 8 would sweep both asks, but the first 5 lots trip MMP and the rest are pulled
+    auto taker = std::make_shared<Order>("t1", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 10001, 8, "taker");
+    auto trades = engine->add_order(taker);
+    ASSERT_EQ(trades.size(), 1);
+    ASSERT_EQ(trades[0].sell_order_id, "q1");
+    ASSERT_EQ(pulled_ids.size(), 2);
+    ASSERT_EQ(engine->get_order("q2"), nullptr);
+    ASSERT_EQ(engine->get_order("q3"), nullptr);
+    ASSERT_EQ(engine->get_best_bid("BTCUSD"), 10001);  // taker's remainder rests
+
+    // Tripped: new quotes are refused until MMP is re-armed
+    auto refused = engine->mass_quote("mm", {{"BTCUSD", {quote("q4", OrderSide::BUY, 9980)}}});
+    ASSERT_EQ(refused[0].placed[0]->status, OrderStatus::REJECTED);
+    engine->set_mmp("BTCUSD", "mm", config);
+    auto accepted = engine->mass_quote("mm", {{"BTCUSD", {quote("q5", OrderSide::BUY, 9980)}}});
+    ASSERT_EQ(accepted[0].placed[0]->status, OrderStatus::NEW);
+}
+
+TEST_F(MatchingEngineTest, ModifiedQuoteStaysUnderMmp) {
+    auto quote = [](const std::string& id, OrderSide side, Price price) {
+        return std::make_shared<Order>(id, "BTCUSD", side, OrderType::LIMIT, price, 5, "mm");
+    };
+    MmpConfig config;
+    config.window = std::chrono::seconds(10);
+    config.max_quantity = 4;
+    engine->set_mmp("BTCUSD", "mm", config);
+    std::vector<std::string> pulled_ids;
+    engine->on_mmp_trigger = [&](const std::string&, const UserId&, const std::vector<OrderId>& pulled) {
+        pulled_ids = pulled;
+    };
+    engine->mass_quote("mm", {{"BTCUSD", {quote("q1", OrderSide::SELL, 10000), quote("q2", OrderSide::BUY, 9990)}}});
+
+    // A price change re-enters the quote; it has to come back as a quote
+    ASSERT_TRUE(engine->modify_order("q1", 10002, 6));
+    auto modified = engine->get_order("q1");
+    ASSERT_NE(modified, nullptr);
+    ASSERT_TRUE(modified->is_quote);
+
+    // Filling it counts towards MMP and pulls the rest of the set
+    auto trades = engine->add_order(std::make_shared<Order>("t1", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 10002, 5, "taker"));
+    ASSERT_EQ(trades.size(), 1);
+    ASSERT_EQ(trades[0].sell_order_id, "q1");
+    ASSERT_EQ(pulled_ids.size(), 2);
+    ASSERT_EQ(engine->get_order("q2"), nullptr);
+}
+
+TEST(MmpCounterTest, WindowExpiresOldFills) {
+    MmpCounter counter(std::chrono::milliseconds(160));
+    auto t0 = MmpCounter::Clock::time_point(std::chrono::seconds(1));
+    counter.add(t0, 3);
+    counter.add(t0 + std::chrono::milliseconds(100), 2);
+    ASSERT_EQ(counter.quantity(), 5);
+    ASSERT_EQ(counter.fills(), 2);
+    counter.add(t0 + std::chrono::milliseconds(170), 1);
+    ASSERT_EQ(counter.quantity(), 3);
+    counter.add(t0 + std::chrono::seconds(5), 1);
+    ASSERT_EQ(counter.quantity(), 1);
+    ASSERT_EQ(counter.fills(), 1);
+}
+
 // Add more tests for other functionalities as needed.
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "order_book_impl.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace orderbook;
+
+namespace {
+
+// What a book did with a workload: every trade, then the depth it ended with
+struct Outcome {
+    std::vector<std::string> trades;
+    std::vector<std::pair<Price, Quantity>> bids, asks;
+    size_t order_count = 0;
+};
+
+template <typename Book>
+Outcome run_workload(uint32_t seed) {
+    Book book("BTC-USD");
+    std::mt19937 rng(seed);
+    Outcome out;
+    std::vector<OrderId> ids;
+    for (int i = 0; i < 3000; ++i) {
+        uint32_t op = rng() % 10;
+        if (op < 6 || ids.empty()) {
+            auto id = std::to_string(i);
+            auto side = rng() % 2 ? OrderSide::BUY : OrderSide::SELL;
+            auto type = rng() % 10 == 0 ? OrderType::MARKET : OrderType::LIMIT;
+            auto order = std::make_shared<Order>(id, "BTC-USD", side, type, 990 + rng() % 21, 1 + rng() % 9, "u" + std::to_string(rng() % 5));
+            for (const auto& t : book.add_order(order)) {
+                out.trades.push_back(t.buy_order_id + "/" + t.sell_order_id + "@" + std::to_string(t.price) + "x" + std::to_string(t.quantity));
+            }
+            ids.push_back(id);
+        } else if (op < 8) {
+            book.cancel_order(ids[rng() % ids.size()]);
+        } else {
+            book.modify_order(ids[rng() % ids.size()], 990 + rng() % 21, 1 + rng() % 9);
+        }
+    }
+    for (const auto& level : book.get_bid_levels(100)) out.bids.emplace_back(level.price, level.total_quantity);
+    for (const auto& level : book.get_ask_levels(100)) out.asks.emplace_back(level.price, level.total_quantity);
+    out.order_count = book.get_order_count();
+    return out;
+}
+
+template <typename Policy>
+void expect_same_as_reference(uint32_t seed) {
+    auto expected = run_workload<OrderBook>(seed);
+    auto actual = run_workload<BasicOrderBook<Policy>>(seed);
+    ASSERT_FALSE(expected.trades.empty());
+    EXPECT_EQ(actual.trades, expected.trades);
+    EXPECT_EQ(actual.bids, expected.bids);
+    EXPECT_EQ(actual.asks, expected.asks);
+    EXPECT_EQ(actual.order_count, expected.order_count);
+}
+
+} // namespace
+
+TEST(OrderBookPolicyTest, EveryLayoutMatchesTheReferenceBook) {
+    for (uint32_t seed : {1u, 2u, 3u}) {
+        expect_same_as_reference<BookPolicy<VectorLevels>>(seed);
+        expect_same_as_reference<BookPolicy<MapLevels, ListQueue>>(seed);
+        expect_same_as_reference<BookPolicy<MapLevels, DequeQueue, HashIdIndex>>(seed);
+        expect_same_as_reference<BookPolicy<MapLevels, DequeQueue, OrderedIdIndex, PoolAllocation, NoLocking>>(seed);
+        expect_same_as_reference<BookPolicy<VectorLevels, ListQueue, HashIdIndex, PoolAllocation, NoLocking>>(seed);
+    }
+}
+
+TEST(OrderBookExpiryTest, EntriesGoWhenOrdersLeaveTheBook) {
+    VirtualClock clock(std::chrono::system_clock::time_point(std::chrono::seconds(1000)));
+    OrderBook book("BTC-USD");
+    book.set_clock(&clock);
+
+    // Filled and cancelled orders stop being tracked straight away
+    book.add_order(std::make_shared<Order>("a", "BTC-USD", OrderSide::SELL, OrderType::LIMIT, 100, 1, "bob", 0, 2000));
+    book.add_order(std::make_shared<Order>("b", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 100, 1, "alice", 0, 2000));
+    book.add_order(std::make_shared<Order>("c", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 90, 1, "alice", 0, 2000));
+    ASSERT_EQ(book.expiring_count(), 1u);
+    book.cancel_order("c");
+    EXPECT_EQ(book.expiring_count(), 0u);
+
+    // A part-filled order doesn't expire, but its entry still goes once it's due
+    book.add_order(std::make_shared<Order>("d", "BTC-USD", OrderSide::SELL, OrderType::LIMIT, 100, 2, "bob", 0, 2000));
+    book.add_order(std::make_shared<Order>("e", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 100, 1, "alice"));
+    ASSERT_EQ(book.expiring_count(), 1u);
+    clock.advance(std::chrono::seconds(1500));
+    book.cancel_expired_orders();
+    EXPECT_EQ(book.expiring_count(), 0u);
+    ASSERT_NE(book.get_order("d"), nullptr);
+    EXPECT_EQ(book.get_order("d")->status, OrderStatus::PARTIAL);
+}
+
+TEST(OrderBookExpiryTest, ModifyKeepsTheExpiry) {
+    VirtualClock clock(std::chrono::system_clock::time_point(std::chrono::seconds(1000)));
+    OrderBook book("BTC-USD");
+    book.set_clock(&clock);
+
+    book.add_order(std::make_shared<Order>("a", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 90, 1, "alice", 0, 2000));
+    ASSERT_TRUE(book.modify_order("a", 95, 2));
+    EXPECT_EQ(book.expiring_count(), 1u);
+
+    clock.advance(std::chrono::seconds(500));
+    book.cancel_expired_orders();
+    ASSERT_NE(book.get_order("a"), nullptr);
+
+    clock.advance(std::chrono::seconds(1000));
+    book.cancel_expired_orders();
+    EXPECT_EQ(book.get_order("a"), nullptr);
+    EXPECT_EQ(book.expiring_count(), 0u);
+}
@@ -5,8 +5,11 @@
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
 #include <json/json.h>
+#include <chrono>
 #include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
 using namespace orderbook;
 using namespace drogon;
@@ -92,19 +95,149 @@ TEST_F(OrderBookControllerTest, CancelOrder_NotFound) {
 TEST_F(OrderBookControllerTest, GetOrders_Empty) {
     OrderBookController controller;
     auto req = HttpRequest::newHttpRequest();
-    bool called = false;
-    controller.getOrders(req, [&](const HttpResponsePtr& resp) {
-        ASSERT_EQ(resp->statusCode(), k200OK);
+    auto resp = drogon::sync_wait(controller.getOrders(req, "alice"));
+    ASSERT_EQ(resp->statusCode(), k200OK);
+    Json::Value j;
+    Json::CharReaderBuilder rbuilder;
+    std::string errs;
+    std::istringstream s(std::string(resp->body()));
+    ASSERT_TRUE(Json::parseFromStream(rbuilder, s, &j, &errs));
+    ASSERT_TRUE(j["orders"].isArray());
+    ASSERT_EQ(j["orders"].size(), 0);
+}
+
+TEST_F(OrderBookControllerTest, MassQuote_ReplacesQuoteSet) {
+    OrderBookController controller;
+    auto send = [&](Price bid, Price ask) {
+        auto req = HttpRequest::newHttpRequest();
+        Json::Value body;
+        body["user_id"] = "mm";
+        Json::Value set;
+        set["symbol"] = "BTCUSD";
+        set["bids"].append(Json::Value());
+        set["bids"][0]["price"] = bid;
+        set["bids"][0]["quantity"] = 5;
+        set["asks"].append(Json::Value());
+        set["asks"][0]["price"] = ask;
+        set["asks"][0]["quantity"] = 5;
+        body["quotes"].append(set);
+        Json::StreamWriterBuilder wbuilder;
+        req->setBody(Json::writeString(wbuilder, body));
+        Json::Value j;
+        controller.massQuote(req, [&](const HttpResponsePtr& resp) {
+            ASSERT_EQ(resp->statusCode(), k200OK);
+            Json::CharReaderBuilder rbuilder;
+            std::string errs;
+            std::istringstream s(std::string(resp->body()));
+            ASSERT_TRUE(Json::parseFromStream(rbuilder, s, &j, &errs));
+        });
+        return j;
+    };
+    auto first = send(9990, 10010);
+    ASSERT_EQ(first["books"][0]["orders"].size(), 2);
+    ASSERT_EQ(first["books"][0]["cancelled"].asUInt64(), 0);
+    auto second = send(9995, 10005);
+    ASSERT_EQ(second["books"][0]["cancelled"].asUInt64(), 2);
+    ASSERT_EQ(engine->get_best_bid("BTCUSD"), 9995);
+    ASSERT_EQ(engine->get_best_ask("BTCUSD"), 10005);
+}
+
+TEST_F(OrderBookControllerTest, OrderAndTradeTimestampsShareUnit) {
+    OrderBookController controller;
+    auto place = [&](const std::string& user, const std::string& side, int qty) {
+        auto req = HttpRequest::newHttpRequest();
+        Json::Value body;
+        body["symbol"] = "BTCUSD";
+        body["side"] = side;
+        body["type"] = "limit";
+        body["price"] = 10000;
+        body["quantity"] = qty;
+        body["user_id"] = user;
+        Json::StreamWriterBuilder wbuilder;
+        req->setBody(Json::writeString(wbuilder, body));
+        controller.placeOrder(req, [](const HttpResponsePtr& resp) {
+            ASSERT_EQ(resp->statusCode(), k200OK);
+        });
+    };
+    auto parse = [](const HttpResponsePtr& resp) {
         Json::Value j;
         Json::CharReaderBuilder rbuilder;
         std::string errs;
         std::istringstream s(std::string(resp->body()));
-        ASSERT_TRUE(Json::parseFromStream(rbuilder, s, &j, &errs));
-        ASSERT_TRUE(j["orders"].isArray());
-        ASSERT_EQ(j["orders"].size(), 0);
-        called = true;
-    }, "alice");
-    ASSERT_TRUE(called);
+        EXPECT_TRUE(Json::parseFromStream(rbuilder, s, &j, &errs));
+        return j;
+    };
+    auto before = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    place("alice", "sell", 1);
+    place("bob", "buy", 2); // fills 1, leaves 1 resting
+    auto after = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    auto orders = parse(drogon::sync_wait(controller.getOrders(HttpRequest::newHttpRequest(), "bob")));
+    ASSERT_EQ(orders["orders"].size(), 1);
+    auto trades = parse(drogon::sync_wait(controller.getTradeHistory(HttpRequest::newHttpRequest(), "bob")));
+    // Same envelope as the database path
+    ASSERT_EQ(trades["trades"].size(), 1);
+    EXPECT_TRUE(trades["next_cursor"].isNull());
+
+    // Both have to be milliseconds since the epoch, not one in seconds and one in ms
+    int64_t order_ts = orders["orders"][0]["timestamp"].asInt64();
+    int64_t trade_ts = trades["trades"][0]["timestamp"].asInt64();
+    EXPECT_GE(order_ts, before - 1000);
+    EXPECT_LE(order_ts, after + 1000);
+    EXPECT_GE(trade_ts, before - 1000);
+    EXPECT_LE(trade_ts, after + 1000);
+    EXPECT_LE(order_ts, trade_ts);
+
+    // from_ts/to_ts filter in the same unit
+    auto filtered = [&](int64_t from_ts, int64_t to_ts) {
+        auto req = HttpRequest::newHttpRequest();
+        req->setParameter("from_ts", std::to_string(from_ts));
+        req->setParameter("to_ts", std::to_string(to_ts));
+        return parse(drogon::sync_wait(controller.getOrders(req, "bob")))["orders"].size();
+    };
+    EXPECT_EQ(filtered(order_ts, order_ts), 1);
+    EXPECT_EQ(filtered(order_ts + 1, order_ts + 1000), 0);
+}
+
+// The engine only holds resting orders, so history without a database is refused rather than empty
+TEST_F(OrderBookControllerTest, OrderHistoryWithoutDatabase) {
+    OrderBookController controller;
+    auto req = HttpRequest::newHttpRequest();
+    req->setParameter("history", "1");
+    auto resp = drogon::sync_wait(controller.getOrders(req, "alice"));
+    EXPECT_EQ(resp->statusCode(), k501NotImplemented);
 }
 
 // Add more tests for modifyOrder, getOrderById, getTradeHistory, etc.
+
+// Clearing goes through storage as cancels, so a journal replay doesn't bring the orders back
+TEST_F(OrderBookControllerTest, ClearOrders_WritesCancels) {
+    struct Recording : Storage {
+        void write(StorageRecord&& record) override { records.push_back(std::move(record)); }
+        StorageStats stats() const override { return {}; }
+        const char* name() const override { return "recording"; }
+        std::vector<StorageRecord> records;
+    } storage;
+    OrderBookController::setStorage(&storage);
+    engine->on_order_update = [](const Order& order) { OrderBookController::persistOrderStatus(order); };
+    engine->add_order(std::make_shared<Order>("c1", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 9000, 1, "alice"));
+    engine->add_order(std::make_shared<Order>("c2", "ETHUSD", OrderSide::SELL, OrderType::LIMIT, 3000, 1, "bob"));
+
+    OrderBookController controller;
+    bool called = false;
+    controller.clearAllOrders(HttpRequest::newHttpRequest(), [&](const HttpResponsePtr& resp) {
+        EXPECT_EQ(resp->statusCode(), k200OK);
+        called = true;
+    });
+    OrderBookController::setStorage(nullptr);
+    ASSERT_TRUE(called);
+    EXPECT_EQ(engine->get_order("c1"), nullptr);
+    // Restore goes by the last status each order was written with
+    std::set<std::string> cancelled;
+    for (const auto& r : storage.records) {
+        if (r.type == RecordType::UpdateOrderStatus && r.values[1] == "cancelled") cancelled.insert(r.values[0]);
+    }
+    EXPECT_EQ(cancelled, (std::set<std::string>{"c1", "c2"}));
+}
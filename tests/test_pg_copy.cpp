@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "pg_copy.hpp"
+#include <string>
+
+using namespace orderbook;
+
+// Splits an encoded stream the way the server sends it: header + first row, further rows, trailer
+TEST(PgCopyTest, BinaryRowsRoundTrip) {
+    PgBinaryEncoder enc;
+    enc.header();
+    enc.begin_row(3);
+    enc.add_text("BTCUSD");
+    enc.add_int64(10050);
+    enc.add_null();
+    size_t first_end = enc.buffer().size();
+    enc.begin_row(3);
+    enc.add_text("");
+    enc.add_int64(-42);
+    enc.add_int64(int64_t(1) << 40);
+    size_t second_end = enc.buffer().size();
+    enc.trailer();
+    const std::string& buf = enc.buffer();
+
+    PgBinaryRow row;
+    ASSERT_TRUE(row.parse(buf.data(), first_end, true));
+    ASSERT_EQ(row.size(), 3u);
+    EXPECT_EQ(row.text(0), "BTCUSD");
+    EXPECT_EQ(row.int64(1), 10050);
+    EXPECT_TRUE(row.is_null(2));
+
+    ASSERT_TRUE(row.parse(buf.data() + first_end, second_end - first_end, false));
+    EXPECT_FALSE(row.is_null(0));
+    EXPECT_EQ(row.text(0), "");
+    EXPECT_EQ(row.int64(1), -42);
+    EXPECT_EQ(row.int64(2), int64_t(1) << 40);
+
+    ASSERT_TRUE(row.parse(buf.data() + second_end, buf.size() - second_end, false));
+    EXPECT_TRUE(row.is_trailer());
+}
+
+TEST(PgCopyTest, RejectsTruncatedRows) {
+    PgBinaryEncoder enc;
+    enc.header();
+    enc.begin_row(1);
+    enc.add_text("abcdef");
+    PgBinaryRow row;
+    EXPECT_FALSE(row.parse(enc.buffer().data(), enc.buffer().size() - 2, true));
+    EXPECT_FALSE(row.parse("NOTPGCOPY-------------", 22, true));
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "response_stream.hpp"
+#include "matching_engine.hpp"
+#include <memory>
+
+using namespace orderbook;
+
+TEST(ResponseStreamTest, HandsOutChunksThroughSmallBuffers) {
+    int calls = 0;
+    ResponseStream stream([&](std::string& out) {
+        ++calls;
+        if (calls == 2) return true;            // An empty chunk just means "ask again"
+        out += "chunk" + std::to_string(calls) + ";";
+        return calls < 4;
+    });
+    std::string body;
+    char buf[3];
+    while (size_t n = stream.read(buf, sizeof(buf))) body.append(buf, n);
+    EXPECT_EQ(body, "chunk1;chunk3;chunk4;");
+    EXPECT_EQ(stream.bytes_sent(), body.size());
+    EXPECT_EQ(calls, 4);
+    EXPECT_EQ(stream.read(buf, sizeof(buf)), 0u);
+}
+
+TEST(ResponseStreamTest, EngineScansMatchTheFullLists) {
+    MatchingEngine engine;
+    int id = 0;
+    for (const char* symbol : {"BTC-USD", "ETH-USD", "SOL-USD"}) {
+        for (int i = 0; i < 7; ++i) {
+            engine.add_order(std::make_shared<Order>(std::to_string(id++), symbol, OrderSide::SELL, OrderType::LIMIT, 100 + i, 2, "mm"));
+            engine.add_order(std::make_shared<Order>(std::to_string(id++), symbol, OrderSide::BUY, OrderType::LIMIT, 100 + i, 1, "taker"));
+        }
+    }
+
+    ScanCursor trades_cursor;
+    std::vector<Trade> trades;
+    while (!trades_cursor.done) engine.scan_user_trades("mm", trades_cursor, 4, trades);
+    auto all_trades = engine.get_user_trades("mm");
+    ASSERT_EQ(trades.size(), all_trades.size());
+    for (size_t i = 0; i < trades.size(); ++i) EXPECT_EQ(trades[i].buy_order_id, all_trades[i].buy_order_id);
+
+    ScanCursor orders_cursor;
+    std::vector<std::shared_ptr<Order>> orders;
+    while (!orders_cursor.done) engine.scan_user_orders("mm", orders_cursor, 4, orders);
+    EXPECT_EQ(orders.size(), engine.get_user_orders("mm").size());
+    EXPECT_GT(orders.size(), 4u);  // More than one chunk, across books
+}
+
+TEST(ResponseStreamTest, TradeScanIsBoundedByEntriesLookedAt) {
+    MatchingEngine engine;
+    // 20 trades between other users, then one of alice's at the end
+    for (int i = 0; i < 20; ++i) {
+        engine.add_order(std::make_shared<Order>("s" + std::to_string(i), "BTC-USD", OrderSide::SELL, OrderType::LIMIT, 100, 1, "mm"));
+        engine.add_order(std::make_shared<Order>("b" + std::to_string(i), "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 100, 1, "taker"));
+    }
+    engine.add_order(std::make_shared<Order>("s-alice", "BTC-USD", OrderSide::SELL, OrderType::LIMIT, 100, 1, "mm"));
+    engine.add_order(std::make_shared<Order>("b-alice", "BTC-USD", OrderSide::BUY, OrderType::LIMIT, 100, 1, "alice"));
+
+    ScanCursor cursor;
+    std::vector<Trade> trades;
+    engine.scan_user_trades("alice", cursor, 4, trades);
+    EXPECT_TRUE(trades.empty());
+    EXPECT_FALSE(cursor.done);
+    EXPECT_EQ(cursor.position, 4u);
+
+    int calls = 1;
+    while (!cursor.done) {
+        engine.scan_user_trades("alice", cursor, 4, trades);
+        ++calls;
+    }
+    ASSERT_EQ(trades.size(), 1u);
+    EXPECT_EQ(trades[0].buy_order_id, "b-alice");
+    EXPECT_EQ(calls, 6);  // 21 entries, 4 a call
+}
+
+TEST(ResponseStreamTest, RestoredTradesShowUpInUserScans) {
+    MatchingEngine engine;
+    Trade trade;
+    trade.symbol = "ETH-USD";
+    trade.buy_order_id = "1";
+    trade.sell_order_id = "2";
+    trade.buy_user_id = "alice";
+    trade.sell_user_id = "bob";
+    trade.price = 100;
+    trade.quantity = 3;
+    engine.restore_trade(trade);
+
+    ScanCursor cursor;
+    std::vector<Trade> trades;
+    while (!cursor.done) engine.scan_user_trades("bob", cursor, 16, trades);
+    ASSERT_EQ(trades.size(), 1u);
+    EXPECT_EQ(trades[0].sell_order_id, "2");
+    EXPECT_EQ(engine.get_user_trades("alice").size(), 1u);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "sanitize.hpp"
+#include <random>
+#include <sys/mman.h>
+#include <cstring>
+
+using namespace orderbook;
+
+static std::string reference_sanitize(std::string_view s) {
+    std::string out;
+    for (unsigned char c : s) {
+        if ((c < 0x80 && std::isalnum(c)) || c == '_' || c == '-') out += static_cast<char>(c);
+    }
+    return out;
+}
+
+TEST(SanitizeTest, MatchesScalarReferenceAtEveryLengthAndOffset) {
+    std::mt19937 rng(7);
+    const std::string alphabet = "abcXYZ019_-";
+    std::string buf(200, 'a');
+    for (size_t len = 0; len <= 100; ++len) {
+        for (size_t offset = 0; offset < 33; offset += 8) {
+            for (int round = 0; round < 20; ++round) {
+                for (size_t i = 0; i < len; ++i) buf[offset + i] = alphabet[rng() % alphabet.size()];
+                // Sometimes drop in a byte from outside the set (including non-ASCII)
+                if (len && round % 2) buf[offset + rng() % len] = " .;/\"\x80\xff@[`{"[rng() % 11];
+                std::string_view in(buf.data() + offset, len);
+                std::string scratch;
+                auto expected = reference_sanitize(in);
+                EXPECT_EQ(sanitize_view(in, scratch), expected);
+                EXPECT_EQ(is_clean_identifier(in), expected.size() == len);
+            }
+        }
+    }
+    // Clean input comes back as the same bytes, no copy
+    std::string scratch;
+    std::string_view clean = "BTC-USD_perp";
+    EXPECT_EQ(sanitize_view(clean, scratch).data(), clean.data());
+    EXPECT_EQ(sanitize("al;ice' OR 1=1--"), "aliceOR11--");
+}
+
+TEST(SanitizeTest, ShortInputAtTheEndOfAPageIsSafe) {
+    // The vector tail load must not step into an unmapped page
+    long page = 4096;
+    auto* mem = static_cast<char*>(mmap(nullptr, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(mem, MAP_FAILED);
+    ASSERT_EQ(mprotect(mem + page, page, PROT_NONE), 0);
+    for (size_t len = 1; len < 16; ++len) {
+        char* p = mem + page - len;
+        std::memset(p, 'k', len);
+        EXPECT_TRUE(is_clean_identifier(std::string_view(p, len)));
+        p[len - 1] = '!';
+        EXPECT_EQ(first_invalid_char(std::string_view(p, len)), len - 1);
+    }
+    munmap(mem, page * 2);
+}
@@ -0,0 +1,413 @@
+#include <gtest/gtest.h>
+#include "storage.hpp"
+#include "clock.hpp"
+#include "matching_engine.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+using namespace orderbook;
+
+namespace {
+
+std::string temp_journal(const char* name) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::remove(path.c_str());
+    std::remove((path + ".offset").c_str());
+    return path;
+}
+
+Trade make_trade(Price price) {
+    Trade trade;
+    trade.symbol = "BTCUSD";
+    trade.buy_order_id = "b1";
+    trade.sell_order_id = "s1";
+    trade.buy_user_id = "alice";
+    trade.sell_user_id = "bob";
+    trade.price = price;
+    trade.quantity = 3;
+    return trade;
+}
+
+// Collects what a FileStorage replicates downstream
+class RecordingStorage : public Storage {
+public:
+    void write(StorageRecord&& record) override { records.push_back(std::move(record)); }
+    StorageStats stats() const override { return {}; }
+    const char* name() const override { return "recording"; }
+    std::vector<StorageRecord> records;
+};
+
+// Drops the first few writes and reports them failed, like a lost connection -
+// or rejected, like a database refusing the statements
+class FlakyStorage : public RecordingStorage {
+public:
+    explicit FlakyStorage(int failures, bool reject = false) : failures_(failures), reject_(reject) {}
+    void write(StorageRecord&& record) override {
+        if (failures_ > 0) {
+            failures_--;
+            (reject_ ? rejected_ : failed_)++;
+            return;
+        }
+        RecordingStorage::write(std::move(record));
+        delivered++;
+    }
+    StorageStats stats() const override {
+        StorageStats s;
+        s.failed = failed_;
+        s.rejected = rejected_;
+        return s;
+    }
+    std::atomic<size_t> delivered{0};
+private:
+    int failures_;
+    bool reject_;
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> rejected_{0};
+};
+
+// A record as journals wrote it before later fields were added
+std::string legacy_record(RecordType type, std::initializer_list<std::string> values) {
+    auto put_u32 = [](std::string& out, uint32_t n) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((n >> (8 * i)) & 0xff));
+    };
+    std::string body;
+    body.push_back(static_cast<char>(type));
+    body.append(2, '\0');
+    for (const auto& v : values) {
+        put_u32(body, static_cast<uint32_t>(v.size()));
+        body += v;
+    }
+    std::string record;
+    put_u32(record, static_cast<uint32_t>(body.size()));
+    return record + body;
+}
+
+} // namespace
+
+TEST(StorageTest, FileJournalRoundTrip) {
+    auto path = temp_journal("ob_test_roundtrip.journal");
+    RecordingStorage downstream;
+    {
+        FileStorage::Options options;
+        options.path = path;
+        options.replicate_to = &downstream;
+        FileStorage storage(options);
+        ASSERT_TRUE(storage.start());
+        auto order = std::make_shared<Order>("o1", "BTCUSD", OrderSide::BUY, OrderType::LIMIT, 10050, 5, "alice");
+        storage.write(StorageRecord::order(*order));
+        storage.write(StorageRecord::action("cancel", "o1"));
+        storage.write(StorageRecord::trade(make_trade(10050)));
+        storage.flush();
+        EXPECT_EQ(storage.stats().written, 3u);
+        storage.stop();
+        EXPECT_EQ(storage.replicated(), 3u);
+    }
+    std::vector<StorageRecord> replayed;
+    FileStorage::replay(path, [&](const StorageRecord& r) { replayed.push_back(r); });
+    ASSERT_EQ(replayed.size(), 3u);
+    EXPECT_EQ(replayed[0].type, RecordType::UpsertOrder);
+    EXPECT_EQ(replayed[0].values[4], "10050");
+    EXPECT_EQ(replayed[0].values[7], "open");
+    EXPECT_EQ(replayed[1].null_mask, 0b1100);
+    EXPECT_EQ(replayed[2].values[3], "alice");
+    ASSERT_EQ(downstream.records.size(), 3u);
+    EXPECT_EQ(downstream.records[2].values[6], "3");
+}
+
+// Actions and trades carry their own write_id, which has to survive the journal for retries to dedupe
+TEST(StorageTest, WriteIdsAreUniqueAndJournaled) {
+    auto path = temp_journal("ob_test_write_id.journal");
+    auto a = StorageRecord::trade(make_trade(100));
+    auto b = StorageRecord::trade(make_trade(100));
+    EXPECT_FALSE(a.values[7].empty());
+    EXPECT_NE(a.values[7], b.values[7]);
+    EXPECT_FALSE(a.values[8].empty());
+    {
+        FileStorage storage(FileStorage::Options{path});
+        ASSERT_TRUE(storage.start());
+        storage.write(StorageRecord(a));
+        storage.stop();
+    }
+    std::vector<StorageRecord> replayed;
+    FileStorage::replay(path, [&](const StorageRecord& r) { replayed.push_back(r); });
+    ASSERT_EQ(replayed.size(), 1u);
+    EXPECT_EQ(replayed[0].values[7], a.values[7]);
+    EXPECT_EQ(replayed[0].values[8], a.values[8]);
+}
+
+// Journals from before write_id existed still replay - the new fields come back NULL
+TEST(StorageTest, LegacyTradeRecordsReplay) {
+    auto path = temp_journal("ob_test_legacy.journal");
+    std::string log = legacy_record(RecordType::InsertTrade, {"BTCUSD", "b1", "s1", "alice", "bob", "100", "3"});
+    std::string order = legacy_record(RecordType::UpsertOrder, {"o1", "BTCUSD", "buy", "limit", "100", "5", "alice", "open", "0"});
+    log += order;
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    std::fwrite(log.data(), 1, log.size(), f);
+    std::fclose(f);
+
+    std::vector<StorageRecord> replayed;
+    uint64_t valid = FileStorage::replay(path, [&](const StorageRecord& r) { replayed.push_back(r); });
+    EXPECT_EQ(valid, log.size());
+    ASSERT_EQ(replayed.size(), 2u);
+    EXPECT_EQ(replayed[0].values[6], "3");
+    EXPECT_EQ(replayed[0].null_mask, (1u << 7) | (1u << 8));
+    // Orders from before stop_price..ts_us come back with the Order defaults
+    auto restored = replayed[1].to_order();
+    EXPECT_EQ(restored->price, 100u);
+    EXPECT_EQ(restored->stop_price, 0u);
+    EXPECT_EQ(restored->tif, "GTC");
+    EXPECT_FALSE(restored->is_quote);
+}
+
+// A restart puts orders back exactly as they were - stop price, TIF, expiry and arrival time included
+TEST(StorageTest, RestartRestoresStopAndGtdOrders) {
+    auto path = temp_journal("ob_test_restore.journal");
+    auto stop = std::make_shared<Order>("s1", "BTCUSD", OrderSide::BUY, OrderType::STOP, 0, 2, "alice", 10100);
+    auto gtd = std::make_shared<Order>("g1", "BTCUSD", OrderSide::SELL, OrderType::LIMIT, 10200, 1, "bob", 0, 2000, "GTD");
+    stop->timestamp -= std::chrono::hours(1);
+    {
+        FileStorage storage(FileStorage::Options{path});
+        ASSERT_TRUE(storage.start());
+        storage.write(StorageRecord::order(*stop));
+        storage.write(StorageRecord::order(*gtd));
+        storage.stop();
+    }
+
+    MatchingEngine engine;
+    size_t restored = FileStorage::restore(path, [&](std::shared_ptr<Order> order) { engine.add_order(order); },
+                                           [](const Trade&) {});
+    ASSERT_EQ(restored, 2u);
+    auto as_us = [](std::chrono::high_resolution_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+    };
+    auto s1 = engine.get_order("s1");
+    ASSERT_NE(s1, nullptr);
+    EXPECT_EQ(s1->type, OrderType::STOP);
+    EXPECT_EQ(s1->stop_price, 10100u);
+    EXPECT_EQ(as_us(s1->timestamp), as_us(stop->timestamp));
+    auto g1 = engine.get_order("g1");
+    ASSERT_NE(g1, nullptr);
+    EXPECT_EQ(g1->tif, "GTD");
+    EXPECT_EQ(g1->expiry, 2000);
+    EXPECT_EQ(as_us(g1->timestamp), as_us(gtd->timestamp));
+
+    // The GTD order still expires after the restart
+    VirtualClock clock(std::chrono::system_clock::time_point(std::chrono::seconds(2500)));
+    engine.set_clock(&clock);
+    engine.cancel_expired_orders();
+    EXPECT_EQ(engine.get_order("g1"), nullptr);
+    EXPECT_NE(engine.get_order("s1"), nullptr);
+}
+
+// Quotes come back as quotes, so the next mass quote after a restart still replaces them
+TEST(StorageTest, RestoredQuotesAreReplacedByTheNextMassQuote) {
+    auto path = temp_journal("ob_test_restore_quotes.journal");
+    auto quote = [](const std::string& id, OrderSide side, Price price) {
+        return std::make_shared<Order>(id, "BTCUSD", side, OrderType::LIMIT, price, 5, "mm");
+    };
+    {
+        MatchingEngine engine;
+        FileStorage storage(FileStorage::Options{path});
+        ASSERT_TRUE(storage.start());
+        auto placed = engine.mass_quote("mm", {{"BTCUSD", {quote("q1", OrderSide::BUY, 9990), quote("q2", OrderSide::SELL, 10010)}}});
+        for (const auto& order : placed[0].placed) storage.write(StorageRecord::order(*order));
+        storage.stop();
+    }
+
+    MatchingEngine engine;
+    FileStorage::restore(path, [&](std::shared_ptr<Order> order) { engine.add_order(order); }, [](const Trade&) {});
+    ASSERT_NE(engine.get_order("q1"), nullptr);
+    EXPECT_TRUE(engine.get_order("q1")->is_quote);
+    auto replaced = engine.mass_quote("mm", {{"BTCUSD", {quote("q3", OrderSide::BUY, 9995), quote("q4", OrderSide::SELL, 10005)}}});
+    EXPECT_EQ(replaced[0].cancelled.size(), 2u);
+    EXPECT_EQ(engine.get_order("q1"), nullptr);
+    EXPECT_EQ(engine.get_order("q2"), nullptr);
+    EXPECT_EQ(engine.get_best_bid("BTCUSD"), 9995u);
+    EXPECT_EQ(engine.get_best_ask("BTCUSD"), 10005u);
+}
+
+TEST(StorageTest, TornTailIsTruncatedOnStart) {
+    auto path = temp_journal("ob_test_torn.journal");
+    {
+        FileStorage storage(FileStorage::Options{path});
+        ASSERT_TRUE(storage.start());
+        storage.write(StorageRecord::trade(make_trade(100)));
+        storage.write(StorageRecord::trade(make_trade(101)));
+        storage.stop();
+    }
+    auto full = std::filesystem::file_size(path);
+    // Simulate a crash halfway through appending the second record
+    std::filesystem::resize_file(path, full - 5);
+    {
+        FileStorage storage(FileStorage::Options{path});
+        ASSERT_TRUE(storage.start());
+        storage.write(StorageRecord::trade(make_trade(102)));
+        storage.stop();
+    }
+    std::vector<Price> prices;
+    uint64_t valid = FileStorage::replay(path, [&](const StorageRecord& r) { prices.push_back(std::stoull(r.values[5])); });
+    EXPECT_EQ(prices, (std::vector<Price>{100, 102}));
+    EXPECT_EQ(valid, std::filesystem::file_size(path));
+}
+
+// The saved offset only moves past records the downstream applied - failed ones are sent again
+TEST(StorageTest, ReplicationRetriesFailedWrites) {
+    auto path = temp_journal("ob_test_replicate_retry.journal");
+    FlakyStorage downstream(1);
+    {
+        FileStorage::Options options;
+        options.path = path;
+        options.replicate_to = &downstream;
+        FileStorage storage(options);
+        ASSERT_TRUE(storage.start());
+        storage.write(StorageRecord::trade(make_trade(100)));
+        storage.write(StorageRecord::trade(make_trade(101)));
+        storage.flush();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (downstream.delivered < 3 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        storage.stop();
+    }
+    // First pass lost trade 100 and delivered 101, the retry delivered both
+    std::vector<Price> prices;
+    for (const auto& r : downstream.records) prices.push_back(std::stoull(r.values[5]));
+    EXPECT_EQ(prices, (std::vector<Price>{101, 100, 101}));
+    EXPECT_EQ(downstream.records[0].values[7], downstream.records[2].values[7]);
+}
+
+#ifndef _WIN32
+// A batch that only partly reaches the file is cut off, so later appends follow the last good record
+// A record the downstream refuses is skipped - resending it would stall replication for good
+TEST(StorageTest, ReplicationSkipsRejectedWrites) {
+    auto path = temp_journal("ob_test_replicate_reject.journal");
+    FlakyStorage downstream(1, true);
+    {
+        FileStorage::Options options;
+        options.path = path;
+        options.replicate_to = &downstream;
+        FileStorage storage(options);
+        ASSERT_TRUE(storage.start());
+        storage.write(StorageRecord::trade(make_trade(100)));
+        storage.write(StorageRecord::trade(make_trade(101)));
+        storage.write(StorageRecord::trade(make_trade(102)));
+        storage.flush();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (downstream.delivered < 2 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        storage.stop();
+    }
+    std::vector<Price> prices;
+    for (const auto& r : downstream.records) prices.push_back(std::stoull(r.values[5]));
+    EXPECT_EQ(prices, (std::vector<Price>{101, 102}));
+    // The checkpoint moved past the rejected record
+    std::FILE* f = std::fopen((path + ".offset").c_str(), "rb");
+    ASSERT_NE(f, nullptr);
+    unsigned long long offset = 0;
+    EXPECT_EQ(std::fscanf(f, "%llu", &offset), 1);
+    std::fclose(f);
+    EXPECT_EQ(offset, std::filesystem::file_size(path));
+}
+
+TEST(StorageTest, FailedAppendIsTruncated) {
+    auto path = temp_journal("ob_test_failed_append.journal");
+    FileStorage storage(FileStorage::Options{path});
+    ASSERT_TRUE(storage.start());
+    storage.write(StorageRecord::trade(make_trade(100)));
+    storage.flush();
+    auto good = std::filesystem::file_size(path);
+
+    // Cap the file size just past the first record so the next batch is written halfway
+    std::signal(SIGXFSZ, SIG_IGN);
+    rlimit old_limit{};
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    rlimit limit = old_limit;
+    limit.rlim_cur = good + 10;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    std::atomic<bool> durable{true};
+    storage.write(StorageRecord::trade(make_trade(101)));
+    storage.write(StorageRecord::trade(make_trade(102)));
+    storage.when_durable([&](bool ok) { durable = ok; });
+    storage.flush();
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    std::signal(SIGXFSZ, SIG_DFL);
+    EXPECT_FALSE(durable.load());
+    EXPECT_EQ(std::filesystem::file_size(path), good);
+    // Asking after the batch is done still reports it lost
+    bool late = true;
+    storage.when_durable([&](bool ok) { late = ok; });
+    EXPECT_FALSE(late);
+
+    storage.write(StorageRecord::trade(make_trade(103)));
+    storage.stop();
+    std::vector<Price> prices;
+    uint64_t valid = FileStorage::replay(path, [&](const StorageRecord& r) { prices.push_back(std::stoull(r.values[5])); });
+    EXPECT_EQ(prices, (std::vector<Price>{100, 103}));
+    EXPECT_EQ(valid, std::filesystem::file_size(path));
+}
+#endif
+
+TEST(StorageTest, NullStorageCountsWrites) {
+    NullStorage storage;
+    storage.write(StorageRecord::action("cancel", "o1"));
+    storage.write(StorageRecord::action("amend", "o1", 100, 2));
+    storage.flush();
+    EXPECT_EQ(storage.stats().written, 2u);
+    EXPECT_STREQ(storage.name(), "null");
+}
+
+// Acks come back only after their batch is appended and synced, many records per sync
+TEST(StorageTest, GroupCommitReleasesAcksAfterSync) {
+    auto path = temp_journal("ob_test_group_commit.journal");
+    FileStorage::Options options;
+    options.path = path;
+    options.sync = true;
+    options.max_batch = 64;
+    options.flush_interval = std::chrono::milliseconds(50);
+    FileStorage storage(options);
+    ASSERT_TRUE(storage.start());
+    std::atomic<int> acked{0};
+    std::atomic<bool> all_durable{true};
+    for (int i = 0; i < 256; ++i) {
+        storage.write(StorageRecord::trade(make_trade(100 + i)));
+        storage.when_durable([&](bool ok) {
+            if (!ok) all_durable = false;
+            acked++;
+        });
+    }
+    storage.stop();     // Joins the writer, so every callback has run
+    EXPECT_EQ(acked.load(), 256);
+    EXPECT_TRUE(all_durable.load());
+    // Batches filled by count, not one sync per record
+    EXPECT_LE(storage.stats().batches, 8u);
+    EXPECT_EQ(storage.stats().written, 256u);
+}
+
+// A request that wrote nothing on a fresh store has nothing to wait for, and nothing failed
+TEST(StorageTest, FreshStoreReportsDurable) {
+    auto path = temp_journal("ob_test_fresh_durable.journal");
+    FileStorage::Options options;
+    options.path = path;
+    options.sync = true;
+    FileStorage storage(options);
+    ASSERT_TRUE(storage.start());
+    bool called = false;
+    bool durable = false;
+    storage.when_durable([&](bool ok) {
+        called = true;
+        durable = ok;
+    });
+    EXPECT_TRUE(called);
+    EXPECT_TRUE(durable);
+    storage.stop();
+}
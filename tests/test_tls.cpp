@@ -0,0 +1,20 @@
+#include <gtest/gtest.h>
+#include "tls.hpp"
+
+using namespace orderbook;
+
+TEST(TlsTest, KtlsIsOnlyRequestedWhenAskedFor) {
+    TlsOptions options;
+    options.cert_file = "/nonexistent/cert.pem";
+    options.key_file = "/nonexistent/key.pem";
+    EXPECT_FALSE(tls_files_present(options));
+    EXPECT_TRUE(tls_conf_commands(options).empty());
+
+    options.ktls = true;
+    auto commands = tls_conf_commands(options);
+    ASSERT_EQ(commands.size(), 1u);
+    EXPECT_EQ(commands[0].first, "Options");
+    EXPECT_EQ(commands[0].second, "KTLS");
+    // Whatever this machine has, the probe explains itself
+    EXPECT_FALSE(probe_ktls().detail.empty());
+}
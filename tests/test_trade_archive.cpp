@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "trade_archive.hpp"
+#include <filesystem>
+
+using namespace orderbook;
+
+namespace {
+
+constexpr int64_t DAY = 86400LL * 1000000;
+constexpr int64_t MINUTE = 60LL * 1000000;
+
+std::string temp_root(const char* name) {
+    auto root = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(root);
+    return root.string();
+}
+
+} // namespace
+
+// More trades than fit in one block, so ranges cross block boundaries
+TEST(TradeArchiveTest, RangeScanAcrossBlocks) {
+    TradeArchive archive(temp_root("ob_test_archive_range"));
+    const int64_t day_start = 20000 * DAY;
+    std::vector<ArchivedTrade> trades;
+    for (int64_t i = 0; i < 10000; ++i) {
+        trades.push_back(ArchivedTrade{day_start + i * 1000, static_cast<Price>(10000 + (i % 7) - 3), static_cast<Quantity>(1 + i % 5)});
+    }
+    ASSERT_TRUE(archive.write_segment("BTCUSD", trades));
+    EXPECT_NE(archive.segment_path("BTCUSD", 20000).find("2024-10-04.seg"), std::string::npos);
+
+    auto all = archive.trades("BTCUSD", day_start, day_start + DAY);
+    ASSERT_EQ(all.size(), trades.size());
+    for (size_t i = 0; i < all.size(); i += 997) {
+        EXPECT_EQ(all[i].ts_us, trades[i].ts_us);
+        EXPECT_EQ(all[i].price, trades[i].price);
+        EXPECT_EQ(all[i].quantity, trades[i].quantity);
+    }
+    // [4000, 8500) by index
+    auto part = archive.trades("BTCUSD", day_start + 4000 * 1000, day_start + 8500 * 1000);
+    ASSERT_EQ(part.size(), 4500u);
+    EXPECT_EQ(part.front().ts_us, trades[4000].ts_us);
+    EXPECT_EQ(part.back().ts_us, trades[8499].ts_us);
+    EXPECT_TRUE(archive.trades("ETHUSD", day_start, day_start + DAY).empty());
+    EXPECT_EQ(archive.trades("BTCUSD", day_start, day_start + DAY, 10).size(), 10u);
+}
+
+TEST(TradeArchiveTest, VwapPerMinute) {
+    TradeArchive archive(temp_root("ob_test_archive_vwap"));
+    const int64_t t = 20000 * DAY + 10 * MINUTE;
+    ASSERT_TRUE(archive.write_segment("BTCUSD", {
+        {t + 1, 100, 1}, {t + 2, 200, 3},           // minute 0: (100 + 600) / 4
+        {t + MINUTE + 5, 150, 2},                   // minute 1
+        {t + 3 * MINUTE, 90, 10},                   // minute 3 (minute 2 has no trades)
+    }));
+    auto bars = archive.vwap_per_minute("BTCUSD", t, t + 10 * MINUTE);
+    ASSERT_EQ(bars.size(), 3u);
+    EXPECT_EQ(bars[0].minute_us, t);
+    EXPECT_DOUBLE_EQ(bars[0].vwap, 175.0);
+    EXPECT_EQ(bars[0].volume, 4u);
+    EXPECT_EQ(bars[0].trades, 2u);
+    EXPECT_DOUBLE_EQ(bars[1].vwap, 150.0);
+    EXPECT_EQ(bars[2].minute_us, t + 3 * MINUTE);
+    EXPECT_EQ(bars[2].volume, 10u);
+}
+
+// Scans only visit the segments that exist and stop as soon as the callback says so
+TEST(TradeArchiveTest, SparseRangeScanStopsEarly) {
+    TradeArchive archive(temp_root("ob_test_archive_sparse"));
+    ASSERT_TRUE(archive.write_segment("BTCUSD", {{100 * DAY + 5, 100, 1}, {100 * DAY + 6, 101, 1}}));
+    ASSERT_TRUE(archive.write_segment("BTCUSD", {{20000 * DAY + 5, 200, 2}}));
+    EXPECT_EQ(archive.segment_days("BTCUSD"), (std::vector<int64_t>{100, 20000}));
+    EXPECT_TRUE(archive.segment_days("ETHUSD").empty());
+
+    auto all = archive.trades("BTCUSD", 0, 30000 * DAY);
+    ASSERT_EQ(all.size(), 3u);
+    EXPECT_EQ(all[2].price, 200u);
+
+    int calls = 0;
+    archive.scan("BTCUSD", 0, 30000 * DAY, [&](const TradeColumns&) {
+        calls++;
+        return false;
+    });
+    EXPECT_EQ(calls, 1);
+    auto first = archive.trades("BTCUSD", 0, 30000 * DAY, 1);
+    ASSERT_EQ(first.size(), 1u);
+    EXPECT_EQ(first[0].price, 100u);
+}
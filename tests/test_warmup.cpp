@@ -0,0 +1,24 @@
+#include <gtest/gtest.h>
+#include "warmup.hpp"
+
+using namespace orderbook;
+
+TEST(WarmupTest, ExercisesTheShadowEngineWithoutTouchingLiveState) {
+    MatchingEngine live;
+    WarmupOptions options;
+    options.symbols = {"BTC-USD", "ETH-USD", "SOL-USD"};
+    options.rounds = 400;
+    auto report = warm_up(live, options);
+    EXPECT_EQ(report.books, 3u);
+    EXPECT_EQ(report.orders, 400u);
+    EXPECT_GT(report.trades, 0u);
+    // Nothing synthetic leaks into the live books
+    EXPECT_EQ(live.get_order_count(), 0u);
+    EXPECT_EQ(live.get_stats().total_trades, 0u);
+    EXPECT_TRUE(live.get_bid_levels("BTC-USD", 10).empty());
+
+    // The pre-created books take real orders as usual
+    live.add_order(std::make_shared<Order>("1", "ETH-USD", OrderSide::BUY, OrderType::LIMIT, 100, 5, "alice"));
+    auto trades = live.add_order(std::make_shared<Order>("2", "ETH-USD", OrderSide::SELL, OrderType::LIMIT, 100, 5, "bob"));
+    EXPECT_EQ(trades.size(), 1u);
+}